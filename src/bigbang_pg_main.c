@@ -3,6 +3,7 @@
  */
 
 #include <libpq-fe.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -424,13 +425,212 @@ is_sector_used (PGconn *c, int sector_id)
 }
 
 
+/* In-memory copy of sector_warps for create_random_warps: out-degrees
+   and a hash set of edges, so candidates are checked without a query and
+   the new warps go out in one COPY. */
+typedef struct
+{
+  int max_id;
+  int *deg;
+  unsigned char *used;
+  uint64_t *set;		/* open addressing on (from << 32 | to), 0 = empty */
+  size_t set_cap, set_n;
+  int *pairs;			/* warps added since the load, (from, to) */
+  size_t n_pairs, pairs_cap;
+} warp_set_t;
+
+
+static int
+warp_set_insert (warp_set_t *ws, uint64_t key)
+{
+  if ((ws->set_n + 1) * 2 > ws->set_cap)
+    {
+      size_t cap = ws->set_cap ? ws->set_cap * 2 : 4096;
+      uint64_t *set = calloc (cap, sizeof (*set));
+      if (!set)
+	{
+	  return -1;
+	}
+      for (size_t i = 0; i < ws->set_cap; i++)
+	{
+	  if (ws->set[i])
+	    {
+	      size_t j = (size_t) (ws->set[i] * 0x9E3779B97F4A7C15ULL) & (cap - 1);
+	      while (set[j])
+		{
+		  j = (j + 1) & (cap - 1);
+		}
+	      set[j] = ws->set[i];
+	    }
+	}
+      free (ws->set);
+      ws->set = set;
+      ws->set_cap = cap;
+    }
+
+  size_t j = (size_t) (key * 0x9E3779B97F4A7C15ULL) & (ws->set_cap - 1);
+  while (ws->set[j])
+    {
+      if (ws->set[j] == key)
+	{
+	  return 0;
+	}
+      j = (j + 1) & (ws->set_cap - 1);
+    }
+  ws->set[j] = key;
+  ws->set_n++;
+  return 1;
+}
+
+
+/* Same contract as insert_warp_unique: 1 if added, 0 if present, -1 on
+   error. Sectors outside 1..max_id are refused. */
+static int
+warp_set_add (warp_set_t *ws, int from, int to, int record)
+{
+  if (from <= 0 || from > ws->max_id || to <= 0 || to > ws->max_id)
+    {
+      return -1;
+    }
+  int rc = warp_set_insert (ws, ((uint64_t) from << 32) | (uint32_t) to);
+  if (rc <= 0)
+    {
+      return rc;
+    }
+  ws->deg[from]++;
+  if (!record)
+    {
+      return 1;
+    }
+  if (ws->n_pairs == ws->pairs_cap)
+    {
+      size_t cap = ws->pairs_cap ? ws->pairs_cap * 2 : 4096;
+      int *tmp = realloc (ws->pairs, cap * 2 * sizeof (int));
+      if (!tmp)
+	{
+	  return -1;
+	}
+      ws->pairs = tmp;
+      ws->pairs_cap = cap;
+    }
+  ws->pairs[2 * ws->n_pairs] = from;
+  ws->pairs[2 * ws->n_pairs + 1] = to;
+  ws->n_pairs++;
+  return 1;
+}
+
+
+static void
+warp_set_free (warp_set_t *ws)
+{
+  free (ws->deg);
+  free (ws->used);
+  free (ws->set);
+  free (ws->pairs);
+}
+
+
+static int
+warp_set_load (PGconn *c, warp_set_t *ws, int numSectors)
+{
+  memset (ws, 0, sizeof (*ws));
+  fetch_int (c, "SELECT COALESCE(MAX(sector_id), 0) FROM sectors", &ws->max_id);
+  if (ws->max_id < numSectors)
+    {
+      ws->max_id = numSectors;
+    }
+  ws->deg = calloc ((size_t) ws->max_id + 1, sizeof (int));
+  ws->used = calloc ((size_t) ws->max_id + 1, 1);
+  if (!ws->deg || !ws->used)
+    {
+      return -1;
+    }
+
+  PGresult *r = PQexec (c, "SELECT from_sector, to_sector FROM sector_warps");
+  if (!r || PQresultStatus (r) != PGRES_TUPLES_OK)
+    {
+      PQclear (r);
+      return -1;
+    }
+  for (int i = 0; i < PQntuples (r); i++)
+    {
+      if (warp_set_add (ws, atoi (PQgetvalue (r, i, 0)),
+			atoi (PQgetvalue (r, i, 1)), 0) < 0)
+	{
+	  PQclear (r);
+	  return -1;
+	}
+    }
+  PQclear (r);
+
+  r = PQexec (c, "SELECT used FROM used_sectors");
+  if (!r || PQresultStatus (r) != PGRES_TUPLES_OK)
+    {
+      PQclear (r);
+      return -1;
+    }
+  for (int i = 0; i < PQntuples (r); i++)
+    {
+      int u = atoi (PQgetvalue (r, i, 0));
+      if (u > 0 && u <= ws->max_id)
+	{
+	  ws->used[u] = 1;
+	}
+    }
+  PQclear (r);
+  return 0;
+}
+
+
+static int
+warp_set_store (db_t *db, const warp_set_t *ws)
+{
+  static const char *const cols[] = { "from_sector", "to_sector" };
+  db_error_t err;
+  int64_t rows = 0;
+
+  db_error_clear (&err);
+  db_copy_t *cp = db_copy_begin (db, "sector_warps", cols, 2, &err);
+  if (!cp)
+    {
+      fprintf (stderr, "ERROR: COPY sector_warps failed: %s\n", err.message);
+      return -1;
+    }
+  for (size_t i = 0; i < ws->n_pairs; i++)
+    {
+      db_bind_t row[2] = { db_bind_i64 (ws->pairs[2 * i]),
+	db_bind_i64 (ws->pairs[2 * i + 1])
+      };
+      if (!db_copy_row (cp, row, &err))
+	{
+	  break;
+	}
+    }
+  if (!db_copy_end (cp, &rows, &err))
+    {
+      fprintf (stderr, "ERROR: COPY sector_warps failed: %s\n", err.message);
+      return -1;
+    }
+  printf ("BIGBANG: Added %lld random warps.\n", (long long) rows);
+  return 0;
+}
+
+
 static int
-create_random_warps (PGconn *c, int numSectors, int maxWarps)
+create_random_warps (PGconn *c, db_t *db, int numSectors, int maxWarps)
 {
-  exec_sql (c, "BEGIN", "BEGIN random warps");
+  warp_set_t ws;
+  if (warp_set_load (c, &ws, numSectors) != 0)
+    {
+      fprintf (stderr, "ERROR: Failed to load existing warps: %s\n",
+	       PQerrorMessage (c));
+      warp_set_free (&ws);
+      return -1;
+    }
+
   for (int s = 11; s <= numSectors; s++)
     {
-      if (is_sector_used (c, s))
+      if (ws.used[s])
 	{
 	  continue;
 	}
@@ -455,63 +655,36 @@ create_random_warps (PGconn *c, int numSectors, int maxWarps)
 	      attempts++;
 	      continue;
 	    }
-	  
-	  /* Check if adding a warp would exceed maxWarps limit on either sector */
-	  char check_sql[256];
-	  snprintf (check_sql, sizeof (check_sql),
-		   "SELECT (SELECT COUNT(*) FROM sector_warps WHERE from_sector = %d) as s_count, "
-		   "       (SELECT COUNT(*) FROM sector_warps WHERE from_sector = %d) as t_count;",
-		   s, t);
-	  
-	  PGresult *check_r = PQexec (c, check_sql);
-	  int s_count = 0, t_count = 0;
-	  if (check_r && PQresultStatus (check_r) != PGRES_FATAL_ERROR && PQntuples (check_r) > 0)
-	    {
-	      s_count = atoi (PQgetvalue (check_r, 0, 0));
-	      t_count = atoi (PQgetvalue (check_r, 0, 1));
-	      PQclear (check_r);
-	    }
-	  
+
 	  /* Skip if either sector already has max warps */
-	  if (s_count >= maxWarps || t_count >= maxWarps)
+	  if (ws.deg[s] >= maxWarps || ws.deg[t] >= maxWarps)
 	    {
 	      attempts++;
 	      continue;
 	    }
-	  
+
 	  /* Note: Removed is_sector_used(c, t) check to allow connecting
 	     tunnel sectors to the main graph. This prevents tunnel sectors
 	     from becoming orphaned. */
 
-	  int res = insert_warp_unique (c, s, t);
+	  int res = warp_set_add (&ws, s, t, 1);
 
 
 	  if (res > 0)
 	    {
 	      has_warp = 1;
-	      
-	      /* Check reverse warp count before adding it */
-	      char rev_check[128];
-	      snprintf (rev_check, sizeof (rev_check),
-		       "SELECT COUNT(*) FROM sector_warps WHERE from_sector = %d;", t);
-	      PGresult *rev_r = PQexec (c, rev_check);
-	      int t_rev_count = 0;
-	      if (rev_r && PQresultStatus (rev_r) != PGRES_FATAL_ERROR && PQntuples (rev_r) > 0)
-		{
-		  t_rev_count = atoi (PQgetvalue (rev_r, 0, 0));
-		  PQclear (rev_r);
-		}
-	      
+
 	      /* Only add reverse warp if target hasn't hit max */
-	      if ((rand () % 100) >= DEFAULT_PERCENT_ONEWAY && t_rev_count < maxWarps)
+	      if ((rand () % 100) >= DEFAULT_PERCENT_ONEWAY
+		  && ws.deg[t] < maxWarps)
 		{
-		  insert_warp_unique (c, t, s);
+		  warp_set_add (&ws, t, s, 1);
 		}
 	      deg++;
 	    }
 	  attempts++;
 	}
-      
+
       /* Safety net: If no warps were created after 200 attempts,
          force at least one connection to prevent orphaned sectors. */
       if (!has_warp && deg == 0)
@@ -519,16 +692,18 @@ create_random_warps (PGconn *c, int numSectors, int maxWarps)
 	  int t = 11 + (rand () % (numSectors - 10));
 	  if (t != s)
 	    {
-	      insert_warp_unique (c, s, t);
+	      warp_set_add (&ws, s, t, 1);
 	      if ((rand () % 100) >= DEFAULT_PERCENT_ONEWAY)
 		{
-		  insert_warp_unique (c, t, s);
+		  warp_set_add (&ws, t, s, 1);
 		}
 	    }
 	}
     }
-  exec_sql (c, "COMMIT", "COMMIT random warps");
-  return 0;
+
+  int rc = warp_set_store (db, &ws);
+  warp_set_free (&ws);
+  return rc;
 }
 
 
@@ -1253,11 +1428,25 @@ main (int argc, char **argv)
   exec_sql (app, "SELECT spawn_orion_fleet()", "spawn_orion_fleet");
 
   // Then generate random warps for the rest of the universe
-  create_random_warps (app, sectors, density);
-  ensure_fedspace_exit (app, 11, sectors);
+  db_config_t wcfg = { .backend = DB_BACKEND_POSTGRES, .pg_conninfo = app_cs };
+  db_error_t werr;
+  db_t *wdb = db_open (&wcfg, &werr);
+  int warps_rc = wdb ? create_random_warps (app, wdb, sectors, density) : -1;
+
+
+  if (!wdb)
+    {
+      fprintf (stderr, "ERROR: connect for warp load failed: %s\n",
+	       werr.message);
+    }
+  db_close (wdb);
+  if (warps_rc == 0)
+    {
+      ensure_fedspace_exit (app, 11, sectors);
+    }
 
   /* Validate universe connectivity - ensure no orphan sectors */
-  if (validate_universe_connectivity (app) != 0)
+  if (warps_rc != 0 || validate_universe_connectivity (app) != 0)
     {
       fprintf (stderr, "FATAL: Universe validation failed. Aborting bigbang.\n");
       PQfinish (app);
@@ -0,0 +1,297 @@
+/* src/client_registry.c */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* local includes */
+#include "client_registry.h"
+#include "server_log.h"
+
+#define REG_SHARDS   64		/* per index; ids spread by id % REG_SHARDS */
+#define REG_BUCKETS  64		/* per shard, by id / REG_SHARDS */
+
+/* A connection's place in one index */
+typedef struct reg_link_s
+{
+  struct reg_link_s *prev;
+  struct reg_link_s *next;
+  client_ctx_t *ctx;
+  int key;			/* player or sector id; 0 = not filed */
+} reg_link_t;
+
+/* The player link is only touched on the connection's own thread. The
+   sector link is also refiled by client_registry_move_player from other
+   threads, under mu. Lock order: player shard, mu, sector shard. */
+typedef struct
+{
+  reg_link_t player;
+  reg_link_t sector;
+  pthread_mutex_t mu;
+  int own_sector;		/* sector key last taken from ctx itself */
+} reg_conn_t;
+
+typedef struct
+{
+  pthread_rwlock_t lock;
+  reg_link_t *buckets[REG_BUCKETS];
+} reg_shard_t;
+
+typedef struct
+{
+  reg_shard_t shards[REG_SHARDS];
+  _Atomic int64_t filed;
+} reg_index_t;
+
+static reg_index_t g_players;
+static reg_index_t g_sectors;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static _Atomic int64_t g_conns = 0;
+
+
+static void
+reg_init (void)
+{
+  for (int i = 0; i < REG_SHARDS; i++)
+    {
+      pthread_rwlock_init (&g_players.shards[i].lock, NULL);
+      pthread_rwlock_init (&g_sectors.shards[i].lock, NULL);
+    }
+}
+
+
+static reg_shard_t *
+reg_shard (reg_index_t *idx, int key, reg_link_t ***bucket)
+{
+  unsigned k = (unsigned) key;
+  reg_shard_t *sh = &idx->shards[k % REG_SHARDS];
+
+  *bucket = &sh->buckets[(k / REG_SHARDS) % REG_BUCKETS];
+  return sh;
+}
+
+
+/* Move l from its current key to key (<= 0 leaves it unfiled) */
+static void
+reg_refile (reg_index_t *idx, reg_link_t *l, int key)
+{
+  reg_link_t **head;
+  reg_shard_t *sh;
+
+  if (key <= 0)
+    {
+      key = 0;
+    }
+  if (l->key == key)
+    {
+      return;
+    }
+  if (l->key)
+    {
+      sh = reg_shard (idx, l->key, &head);
+      pthread_rwlock_wrlock (&sh->lock);
+      if (l->prev)
+	{
+	  l->prev->next = l->next;
+	}
+      else
+	{
+	  *head = l->next;
+	}
+      if (l->next)
+	{
+	  l->next->prev = l->prev;
+	}
+      pthread_rwlock_unlock (&sh->lock);
+      atomic_fetch_sub_explicit (&idx->filed, 1, memory_order_relaxed);
+    }
+  l->key = key;
+  l->prev = NULL;
+  l->next = NULL;
+  if (key)
+    {
+      sh = reg_shard (idx, key, &head);
+      pthread_rwlock_wrlock (&sh->lock);
+      l->next = *head;
+      if (*head)
+	{
+	  (*head)->prev = l;
+	}
+      *head = l;
+      pthread_rwlock_unlock (&sh->lock);
+      atomic_fetch_add_explicit (&idx->filed, 1, memory_order_relaxed);
+    }
+}
+
+
+static int
+reg_for_each (reg_index_t *idx, int key, client_visit_fn fn, void *arg)
+{
+  reg_link_t **head;
+  int n = 0;
+
+  if (key <= 0 || !fn)
+    {
+      return 0;
+    }
+  pthread_once (&g_once, reg_init);
+
+  reg_shard_t *sh = reg_shard (idx, key, &head);
+
+  pthread_rwlock_rdlock (&sh->lock);
+  for (reg_link_t * l = *head; l; l = l->next)
+    {
+      if (l->key == key)
+	{
+	  fn (l->ctx, arg);
+	  n++;
+	}
+    }
+  pthread_rwlock_unlock (&sh->lock);
+  return n;
+}
+
+
+void
+client_registry_add (client_ctx_t *ctx)
+{
+  pthread_once (&g_once, reg_init);
+  reg_conn_t *rc = calloc (1, sizeof (*rc));
+
+  if (!rc)
+    {
+      LOGE ("[cid=%" PRIu64 "] client registry: out of memory", ctx->cid);
+      return;
+    }
+  rc->player.ctx = ctx;
+  rc->sector.ctx = ctx;
+  pthread_mutex_init (&rc->mu, NULL);
+  ctx->registry = rc;
+  atomic_fetch_add_explicit (&g_conns, 1, memory_order_relaxed);
+  client_registry_update (ctx);
+}
+
+
+void
+client_registry_remove (client_ctx_t *ctx)
+{
+  reg_conn_t *rc = (reg_conn_t *) ctx->registry;
+
+  if (!rc)
+    {
+      return;
+    }
+  /* Unfiled from the players first, no mover can reach rc any more */
+  reg_refile (&g_players, &rc->player, 0);
+  pthread_mutex_lock (&rc->mu);
+  reg_refile (&g_sectors, &rc->sector, 0);
+  pthread_mutex_unlock (&rc->mu);
+  pthread_mutex_destroy (&rc->mu);
+  ctx->registry = NULL;
+  atomic_fetch_sub_explicit (&g_conns, 1, memory_order_relaxed);
+  free (rc);
+}
+
+
+void
+client_registry_update (client_ctx_t *ctx)
+{
+  reg_conn_t *rc = (reg_conn_t *) ctx->registry;
+
+  if (!rc)
+    {
+      return;
+    }
+  reg_refile (&g_players, &rc->player, ctx->player_id);
+  /* Only a player is somewhere; anonymous connections sit in sector 1 */
+  int sector = ctx->player_id > 0 ? ctx->sector_id : 0;
+
+  /* An unchanged ctx->sector_id may just be stale after someone else moved
+     the player: keep the sector client_registry_move_player filed */
+  pthread_mutex_lock (&rc->mu);
+  if (sector != rc->own_sector)
+    {
+      rc->own_sector = sector;
+      reg_refile (&g_sectors, &rc->sector, sector);
+    }
+  pthread_mutex_unlock (&rc->mu);
+}
+
+
+void
+client_registry_move_player (int player_id, int sector_id)
+{
+  reg_link_t **head;
+
+  if (player_id <= 0)
+    {
+      return;
+    }
+  pthread_once (&g_once, reg_init);
+
+  reg_shard_t *sh = reg_shard (&g_players, player_id, &head);
+
+  pthread_rwlock_rdlock (&sh->lock);
+  for (reg_link_t * l = *head; l; l = l->next)
+    {
+      if (l->key == player_id)
+	{
+	  reg_conn_t *rc = (reg_conn_t *) l->ctx->registry;
+
+	  pthread_mutex_lock (&rc->mu);
+	  reg_refile (&g_sectors, &rc->sector, sector_id);
+	  pthread_mutex_unlock (&rc->mu);
+	}
+    }
+  pthread_rwlock_unlock (&sh->lock);
+}
+
+
+bool
+client_registry_in_sector (client_ctx_t *ctx, int sector_id)
+{
+  reg_conn_t *rc = (reg_conn_t *) ctx->registry;
+  bool in = false;
+
+  if (rc && sector_id > 0)
+    {
+      pthread_mutex_lock (&rc->mu);
+      in = rc->sector.key == sector_id;
+      pthread_mutex_unlock (&rc->mu);
+    }
+  return in;
+}
+
+
+int
+client_registry_for_each_player (int player_id, client_visit_fn fn,
+				 void *arg)
+{
+  return reg_for_each (&g_players, player_id, fn, arg);
+}
+
+
+int
+client_registry_for_each_sector (int sector_id, client_visit_fn fn,
+				 void *arg)
+{
+  return reg_for_each (&g_sectors, sector_id, fn, arg);
+}
+
+
+json_t *
+client_registry_stats_json (void)
+{
+  json_t *o = json_object ();
+
+  json_object_set_new (o, "connections",
+		       json_integer ((json_int_t) atomic_load (&g_conns)));
+  json_object_set_new (o, "with_player",
+		       json_integer ((json_int_t)
+				     atomic_load (&g_players.filed)));
+  json_object_set_new (o, "in_sector",
+		       json_integer ((json_int_t)
+				     atomic_load (&g_sectors.filed)));
+  return o;
+}
@@ -0,0 +1,53 @@
+#ifndef CLIENT_REGISTRY_H
+#define CLIENT_REGISTRY_H
+#include <stdbool.h>
+#include <jansson.h>
+#include "common.h"
+
+/*
+ * Live connections by player and by sector.
+ *
+ * Each connection is filed under its ctx->player_id and ctx->sector_id in
+ * two sharded hash indexes, each shard with its own rwlock. Delivering to
+ * one player or to everyone in a sector takes one shard's read lock and
+ * visits only those connections; unrelated deliveries and moves do not
+ * contend.
+ *
+ * The keys are copied, so after changing ctx->player_id or ctx->sector_id
+ * the connection's own thread calls client_registry_update: on login and
+ * session restore, on logout, and when the ship moves (warp, transwarp,
+ * land, launch). A player moved by someone else (towed, fleeing, podded,
+ * respawned) is refiled with client_registry_move_player once the move is
+ * committed; that player's ctx->sector_id catches up on its next request.
+ */
+
+/* Register a new connection, and drop it before ctx is freed */
+void client_registry_add (client_ctx_t * ctx);
+void client_registry_remove (client_ctx_t * ctx);
+
+/* Re-file ctx under its current player_id and sector_id; cheap when
+   neither changed. Call on ctx's own thread. */
+void client_registry_update (client_ctx_t * ctx);
+
+/* File every connection of player_id under sector_id (<= 0: no sector),
+   from any thread. */
+void client_registry_move_player (int player_id, int sector_id);
+
+/* Whether ctx is filed under sector_id. Any thread may ask while ctx is
+   registered, except from inside a client_registry visitor. */
+bool client_registry_in_sector (client_ctx_t * ctx, int sector_id);
+
+/* Called once per connection. Runs under a shard's read lock: it must not
+   block or call back into client_registry. */
+typedef void (*client_visit_fn) (client_ctx_t * ctx, void *arg);
+
+/* Return the number of connections visited */
+int client_registry_for_each_player (int player_id, client_visit_fn fn,
+				     void *arg);
+int client_registry_for_each_sector (int sector_id, client_visit_fn fn,
+				     void *arg);
+
+/* New reference: connections, and those filed under a player or sector */
+json_t *client_registry_stats_json (void);
+
+#endif /* CLIENT_REGISTRY_H */
@@ -0,0 +1,172 @@
+/* src/cmd_index.c */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* local includes */
+#include "cmd_index.h"
+
+typedef struct
+{
+  const char *key;		/* NULL = empty slot */
+  uint32_t hash;
+  void *value;
+} cmd_slot_t;
+
+struct cmd_index_s
+{
+  cmd_slot_t *slots;
+  size_t mask;			/* capacity - 1, capacity is a power of two */
+  size_t count;
+};
+
+
+/* FNV-1a over the ASCII case-folded key */
+static uint32_t
+cmd_index_hash (const char *key)
+{
+  uint32_t h = 2166136261u;
+
+  for (const unsigned char *p = (const unsigned char *) key; *p; p++)
+    {
+      unsigned char ch = *p;
+
+      if (ch >= 'A' && ch <= 'Z')
+	{
+	  ch = (unsigned char) (ch + ('a' - 'A'));
+	}
+      h ^= ch;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+
+static int
+cmd_index_resize (cmd_index_t *ix, size_t cap)
+{
+  cmd_slot_t *slots = calloc (cap, sizeof (*slots));
+
+  if (!slots)
+    {
+      return -1;
+    }
+  for (size_t i = 0; ix->slots && i <= ix->mask; i++)
+    {
+      cmd_slot_t *s = &ix->slots[i];
+
+      if (!s->key)
+	{
+	  continue;
+	}
+      size_t j = s->hash & (cap - 1);
+
+      while (slots[j].key)
+	{
+	  j = (j + 1) & (cap - 1);
+	}
+      slots[j] = *s;
+    }
+  free (ix->slots);
+  ix->slots = slots;
+  ix->mask = cap - 1;
+  return 0;
+}
+
+
+cmd_index_t *
+cmd_index_new (size_t expected)
+{
+  cmd_index_t *ix = calloc (1, sizeof (*ix));
+  size_t cap = 16;
+
+  if (!ix)
+    {
+      return NULL;
+    }
+  /* keep the load factor at or below 1/2 */
+  while (cap < expected * 2)
+    {
+      cap <<= 1;
+    }
+  if (cmd_index_resize (ix, cap) != 0)
+    {
+      free (ix);
+      return NULL;
+    }
+  return ix;
+}
+
+
+void
+cmd_index_free (cmd_index_t *ix)
+{
+  if (!ix)
+    {
+      return;
+    }
+  free (ix->slots);
+  free (ix);
+}
+
+
+int
+cmd_index_put (cmd_index_t *ix, const char *key, void *value)
+{
+  if (!ix || !key)
+    {
+      return -1;
+    }
+  if ((ix->count + 1) * 2 > ix->mask + 1
+      && cmd_index_resize (ix, (ix->mask + 1) * 2) != 0)
+    {
+      return -1;
+    }
+
+  uint32_t h = cmd_index_hash (key);
+  size_t i = h & ix->mask;
+
+  while (ix->slots[i].key)
+    {
+      if (ix->slots[i].hash == h && strcasecmp (ix->slots[i].key, key) == 0)
+	{
+	  return 0;
+	}
+      i = (i + 1) & ix->mask;
+    }
+  ix->slots[i].key = key;
+  ix->slots[i].hash = h;
+  ix->slots[i].value = value;
+  ix->count++;
+  return 1;
+}
+
+
+void *
+cmd_index_get (const cmd_index_t *ix, const char *key)
+{
+  if (!ix || !key)
+    {
+      return NULL;
+    }
+
+  uint32_t h = cmd_index_hash (key);
+  size_t i = h & ix->mask;
+
+  while (ix->slots[i].key)
+    {
+      if (ix->slots[i].hash == h && strcasecmp (ix->slots[i].key, key) == 0)
+	{
+	  return ix->slots[i].value;
+	}
+      i = (i + 1) & ix->mask;
+    }
+  return NULL;
+}
+
+
+size_t
+cmd_index_count (const cmd_index_t *ix)
+{
+  return ix ? ix->count : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef CMD_INDEX_H
+#define CMD_INDEX_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Case-insensitive string -> pointer index (open addressing, linear probe).
+ *
+ * Built once and then read concurrently without locking: callers must finish
+ * every cmd_index_put before the index is shared between threads. Keys are
+ * borrowed, not copied, so they must outlive the index (registry names are
+ * string literals).
+ */
+typedef struct cmd_index_s cmd_index_t;
+
+cmd_index_t *cmd_index_new (size_t expected);
+void cmd_index_free (cmd_index_t * ix);
+
+/* Returns 1 if inserted, 0 if the key already existed (first one wins),
+   -1 on allocation failure. */
+int cmd_index_put (cmd_index_t * ix, const char *key, void *value);
+
+/* NULL if absent. */
+void *cmd_index_get (const cmd_index_t * ix, const char *key);
+
+size_t cmd_index_count (const cmd_index_t * ix);
+
+#endif /* CMD_INDEX_H */
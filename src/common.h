@@ -55,9 +55,22 @@ typedef struct
   /* --- TLS support --- */
   void *ssl_conn;		// SSL* (opaque pointer to avoid OpenSSL in common.h)
   int is_tls;			// 1 if TLS, 0 if plaintext
-  unsigned char ssl_read_buf[8192];  // Buffer for SSL_read remnants
-  size_t ssl_read_pos;		// Current read position in buffer
-  size_t ssl_read_used;		// Bytes actually in buffer
+  pthread_mutex_t io_mu;	// Serializes SSL_read/SSL_write on ssl_conn
+
+  /* --- reactor --- */
+  void *io;			// reactor_conn_t* (server_reactor.c), NULL once closed
+
+  /* --- tracing --- */
+  void *trace;			// trace_req_t* (request_trace.c) while a request runs
+
+  /* --- pub/sub --- */
+  void *topics;			// topic_conn_t* (topic_index.c) while bound to a player
+
+  /* --- registry --- */
+  void *registry;		// reg_conn_t* (client_registry.c) while connected
+
+  /* --- event batching --- */
+  _Atomic (void *) batch;	// event_batch_t* (event_batch.c) once opted in
 } client_ctx_t;
 // Structure to represent a commodity's essential data
 typedef struct
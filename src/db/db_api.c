@@ -8,6 +8,7 @@
 #include "db_api.h"
 #include "db_int.h" // Internal header for shared struct definitions
 #include "sql_driver.h" // For sql_build
+#include "../server_log.h"
 
 // Include specific backend open functions
 #include "pg/db_pg.h"
@@ -52,19 +53,25 @@ sql_needs_build(const char *sql)
   return 0;
 }
 
+/* Rendering only ever shortens the text ({N} -> $N or ?), so templates up to
+   this size render into the caller's stack buffer */
+#define DB_RENDER_STACK 1024
+
 /**
  * @brief Render SQL placeholders from {N} to backend-specific format.
  * 
- * Returns allocated SQL string if rendering was needed and successful,
- * NULL otherwise. Caller must free the returned string when done.
+ * Returns the SQL to run: sql itself if no rendering is needed, else the
+ * rendered text in stack (DB_RENDER_STACK bytes) or, for long templates, in
+ * *heap, which the caller must free.
  * 
- * On error, sets err and returns NULL.
+ * On error, sets err and returns sql unchanged.
  */
-static char *
-db_render_sql(db_t *db, const char *sql, db_error_t *err)
+static const char *
+db_render_sql(db_t *db, const char *sql, char *stack, char **heap, db_error_t *err)
 {
+  *heap = NULL;
   if (!sql || !sql_needs_build(sql)) {
-    return NULL;  /* No rendering needed */
+    return sql;  /* No rendering needed */
   }
   
   if (!db) {
@@ -72,32 +79,55 @@ db_render_sql(db_t *db, const char *sql, db_error_t *err)
       err->code = ERR_DB_INTERNAL;
       snprintf(err->message, sizeof(err->message), "db_render_sql: NULL db handle");
     }
-    return NULL;
+    return sql;
   }
   
-  /* Allocate buffer for rendered SQL */
-  char *rendered = malloc(4096);
-  if (!rendered) {
-    if (err) {
-      err->code = ERR_DB_NOMEM;
-      snprintf(err->message, sizeof(err->message), "db_render_sql: malloc failed");
+  size_t need = strlen(sql) + 1;
+  char *rendered = stack;
+  if (need > DB_RENDER_STACK) {
+    rendered = *heap = malloc(need);
+    if (!rendered) {
+      if (err) {
+        err->code = ERR_DB_NOMEM;
+        snprintf(err->message, sizeof(err->message), "db_render_sql: malloc failed");
+      }
+      return sql;
     }
-    return NULL;
   }
   
   /* Render {N} to backend-specific placeholders */
-  if (sql_build(db, sql, rendered, 4096) != 0) {
-    free(rendered);
+  if (sql_build(db, sql, rendered, need) != 0) {
+    free(*heap);
+    *heap = NULL;
     if (err) {
       err->code = ERR_DB_INTERNAL;
       snprintf(err->message, sizeof(err->message), "db_render_sql: sql_build failed");
     }
-    return NULL;
+    return sql;
   }
   
   return rendered;
 }
 
+/**
+ * @brief Records one dispatched statement in the per-template statistics,
+ *        hands it to the trace hook, and logs it if it ran longer than the
+ *        slow-query threshold.
+ */
+static void
+db_observe(const db_t *db, const char *sql, const char *q, size_t n_params, uint64_t t0, int64_t rows, bool ok)
+{
+  uint64_t us = db_stats_now_us() - t0;
+  db_stats_record(sql, us, rows, ok);
+  db_trace_hook_fn hook = db_trace_hook();
+  if (hook) hook(sql, t0, us, ok);
+
+  int slow_ms = db->config.log_slow_ms > 0 ? db->config.log_slow_ms : db_slow_query_ms();
+  if (slow_ms > 0 && us >= (uint64_t)slow_ms * 1000) {
+    LOGW("slow query: %llu ms, %zu binds%s: %s", (unsigned long long)(us / 1000), n_params, ok ? "" : ", failed", q);
+  }
+}
+
 bool
 db_exec_insert_id(db_t *db,
                   const char *sql,
@@ -116,8 +146,11 @@ db_exec_insert_id(db_t *db,
         return false;
     }
 
-    char *rendered = db_render_sql(db, sql, err);
-    bool result = db->vt->exec_insert_id(db, rendered ? rendered : sql, params, n_params, id_col, out_id, err);
+    char render_buf[DB_RENDER_STACK], *rendered;
+    const char *q = db_render_sql(db, sql, render_buf, &rendered, err);
+    uint64_t t0 = db_stats_now_us();
+    bool result = db->vt->exec_insert_id(db, q, params, n_params, id_col, out_id, err);
+    db_observe(db, sql, q, n_params, t0, result ? 1 : 0, result);
     free(rendered);
     return result;
 }
@@ -233,11 +266,33 @@ bool db_tx_commit(db_t *db, db_error_t *err) {
 
     db->tx_nest_level--;
     if (db->tx_nest_level == 0) {
-        return db->vt->tx_commit(db, err);
+        bool ok = db->vt->tx_commit(db, err);
+        int n = db->n_on_commit;
+        db->n_on_commit = 0;
+        for (int i = 0; ok && i < n; i++) db->on_commit[i]();
+        return ok;
     }
     return true;
 }
 
+bool db_on_commit(db_t *db, db_commit_fn fn) {
+    if (!db || !fn) return false;
+    if (db->tx_nest_level == 0) {
+        fn();
+        return true;
+    }
+    for (int i = 0; i < db->n_on_commit; i++) {
+        if (db->on_commit[i] == fn) return true;
+    }
+    if (db->n_on_commit == DB_ON_COMMIT_MAX) return false;
+    db->on_commit[db->n_on_commit++] = fn;
+    return true;
+}
+
+int db_tx_depth(const db_t *db) {
+    return db ? db->tx_nest_level : 0;
+}
+
 bool db_tx_rollback(db_t *db, db_error_t *err) {
     if (!db || !db->vt || !db->vt->tx_rollback) {
         err->code = ERR_DB_CLOSED;
@@ -252,6 +307,7 @@ bool db_tx_rollback(db_t *db, db_error_t *err) {
         success = db->vt->tx_rollback(db, err);
     }
     db->tx_nest_level = 0;
+    db->n_on_commit = 0;
     return success;
 }
 
@@ -264,8 +320,11 @@ bool db_exec(db_t *db, const char *sql, const db_bind_t *params, size_t n_params
         return false;
     }
     
-    char *rendered = db_render_sql(db, sql, err);
-    bool result = db->vt->exec(db, rendered ? rendered : sql, params, n_params, err);
+    char render_buf[DB_RENDER_STACK], *rendered;
+    const char *q = db_render_sql(db, sql, render_buf, &rendered, err);
+    uint64_t t0 = db_stats_now_us();
+    bool result = db->vt->exec(db, q, params, n_params, err);
+    db_observe(db, sql, q, n_params, t0, 0, result);
     free(rendered);
     return result;
 }
@@ -279,8 +338,11 @@ bool db_exec_rows_affected(db_t *db, const char *sql, const db_bind_t *params, s
         return false;
     }
     
-    char *rendered = db_render_sql(db, sql, err);
-    bool result = db->vt->exec_rows_affected(db, rendered ? rendered : sql, params, n_params, out_rows, err);
+    char render_buf[DB_RENDER_STACK], *rendered;
+    const char *q = db_render_sql(db, sql, render_buf, &rendered, err);
+    uint64_t t0 = db_stats_now_us();
+    bool result = db->vt->exec_rows_affected(db, q, params, n_params, out_rows, err);
+    db_observe(db, sql, q, n_params, t0, result && out_rows ? *out_rows : 0, result);
     free(rendered);
     return result;
 }
@@ -294,8 +356,31 @@ bool db_query(db_t *db, const char *sql, const db_bind_t *params, size_t n_param
         return false;
     }
     
-    char *rendered = db_render_sql(db, sql, err);
-    bool result = db->vt->query(db, rendered ? rendered : sql, params, n_params, out_res, err);
+    char render_buf[DB_RENDER_STACK], *rendered;
+    const char *q = db_render_sql(db, sql, render_buf, &rendered, err);
+    uint64_t t0 = db_stats_now_us();
+    bool result = db->vt->query(db, q, params, n_params, out_res, err);
+    db_observe(db, sql, q, n_params, t0, result && *out_res ? (*out_res)->num_rows : 0, result);
+    free(rendered);
+    return result;
+}
+
+bool db_query_stream(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err) {
+    if (!db || !db->vt || !db->vt->query) {
+        if (err) {
+            err->code = ERR_DB_CLOSED;
+            strncpy(err->message, "db_query_stream: Invalid DB handle or vtable", sizeof(err->message));
+        }
+        return false;
+    }
+
+    char render_buf[DB_RENDER_STACK], *rendered;
+    const char *q = db_render_sql(db, sql, render_buf, &rendered, err);
+    uint64_t t0 = db_stats_now_us();
+    bool result = db->vt->query_stream
+        ? db->vt->query_stream(db, q, params, n_params, out_res, err)
+        : db->vt->query(db, q, params, n_params, out_res, err);
+    db_observe(db, sql, q, n_params, t0, 0, result);
     free(rendered);
     return result;
 }
@@ -317,8 +402,11 @@ bool db_exec_returning(db_t *db, const char *sql, const db_bind_t *params, size_
         return false;
     }
     
-    char *rendered = db_render_sql(db, sql, err);
-    bool result = db->vt->exec_returning(db, rendered ? rendered : sql, params, n_params, out_res, err);
+    char render_buf[DB_RENDER_STACK], *rendered;
+    const char *q = db_render_sql(db, sql, render_buf, &rendered, err);
+    uint64_t t0 = db_stats_now_us();
+    bool result = db->vt->exec_returning(db, q, params, n_params, out_res, err);
+    db_observe(db, sql, q, n_params, t0, result && *out_res ? (*out_res)->num_rows : 0, result);
     free(rendered);
     return result;
 }
@@ -442,6 +530,219 @@ void db_res_finalize(db_res_t *res) {
     }
 }
 
+db_batch_t *db_batch_new(db_t *db) {
+    if (!db || !db->vt) return NULL;
+    db_batch_t *b = calloc(1, sizeof(*b));
+    if (b) b->db = db;
+    return b;
+}
+
+int db_batch_add(db_batch_t *b, const char *sql, const db_bind_t *params, size_t n_params) {
+    if (!b || b->ran || !sql) return -1;
+    if (b->n == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 8;
+        db_batch_item_t *items = realloc(b->items, cap * sizeof(*items));
+        if (!items) return -1;
+        b->items = items;
+        b->cap = cap;
+    }
+
+    db_batch_item_t *it = &b->items[b->n];
+    memset(it, 0, sizeof(*it));
+    char render_buf[DB_RENDER_STACK], *rendered;
+    db_error_t err;
+    const char *q = db_render_sql(b->db, sql, render_buf, &rendered, &err);
+    it->sql = rendered ? rendered : strdup(q);
+    if (n_params > 0) {
+        it->params = malloc(n_params * sizeof(db_bind_t));
+        if (it->params) memcpy(it->params, params, n_params * sizeof(db_bind_t));
+    }
+    if (!it->sql || (n_params > 0 && !it->params)) {
+        free(it->sql);
+        free(it->params);
+        return -1;
+    }
+    it->n_params = n_params;
+    return (int)b->n++;
+}
+
+bool db_batch_run(db_batch_t *b, db_error_t *err) {
+    if (!b || b->ran) {
+        if (err) {
+            err->code = ERR_DB_INTERNAL;
+            strncpy(err->message, "db_batch_run: Invalid or already run batch", sizeof(err->message));
+        }
+        return false;
+    }
+    b->ran = true;
+    if (b->n == 0) return true;
+    if (b->db->vt->batch_run) {
+        return b->db->vt->batch_run(b->db, b->items, b->n, err);
+    }
+    for (size_t i = 0; i < b->n; i++) {
+        db_batch_item_t *it = &b->items[i];
+        if (!b->db->vt->query(b->db, it->sql, it->params, it->n_params, &it->res, &it->err)) {
+            it->res = NULL;
+        }
+    }
+    return true;
+}
+
+db_res_t *db_batch_result(db_batch_t *b, int idx, db_error_t *err) {
+    if (!b || !b->ran || idx < 0 || (size_t)idx >= b->n) {
+        if (err) {
+            err->code = ERR_DB_INTERNAL;
+            strncpy(err->message, "db_batch_result: No such statement", sizeof(err->message));
+        }
+        return NULL;
+    }
+    db_batch_item_t *it = &b->items[idx];
+    if (!it->res && err) *err = it->err;
+    return it->res;
+}
+
+void db_batch_free(db_batch_t *b) {
+    if (!b) return;
+    for (size_t i = 0; i < b->n; i++) {
+        db_res_finalize(b->items[i].res);
+        free(b->items[i].sql);
+        free(b->items[i].params);
+    }
+    free(b->items);
+    free(b);
+}
+
+// Names reach the SQL unquoted, so only plain identifiers are allowed.
+static bool db_copy_ident_ok(const char *s, bool dotted) {
+    if (!s || !*s || isdigit((unsigned char)*s)) return false;
+    for (; *s; s++) {
+        if (*s == '.' && dotted) { dotted = false; continue; }
+        if (!isalnum((unsigned char)*s) && *s != '_') return false;
+    }
+    return true;
+}
+
+db_copy_t *db_copy_begin(db_t *db, const char *table, const char *const *cols, size_t n_cols, db_error_t *err) {
+    if (!db || !db->vt) {
+        db_error_set(err, ERR_DB_CLOSED, DB_ERR_CAT_CONNECTION, "db_copy_begin: Invalid DB handle or vtable");
+        return NULL;
+    }
+    bool ok = n_cols > 0 && db_copy_ident_ok(table, true);
+    for (size_t i = 0; ok && i < n_cols; i++) ok = db_copy_ident_ok(cols[i], false);
+    if (!ok) {
+        db_error_set(err, ERR_DB_INTERNAL, DB_ERR_CAT_UNKNOWN, "db_copy_begin: Bad table or column name");
+        return NULL;
+    }
+
+    db_copy_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        db_error_set(err, ERR_DB_NOMEM, DB_ERR_CAT_UNKNOWN, "db_copy_begin: Out of memory");
+        return NULL;
+    }
+    c->db = db;
+    c->n_cols = n_cols;
+    if (db->vt->copy_begin) {
+        if (!db->vt->copy_begin(c, table, cols, n_cols, err)) {
+            free(c);
+            return NULL;
+        }
+        return c;
+    }
+
+    // INSERT INTO table (a, b) VALUES ({1}, {2}), rendered once and run
+    // inside one transaction (nested in the caller's, if any) so the load
+    // is all or nothing here too
+    size_t cap = strlen(table) + 32;
+    for (size_t i = 0; i < n_cols; i++) cap += strlen(cols[i]) + 16;
+    char *tmpl = malloc(cap);
+    if (tmpl) {
+        size_t len = (size_t)snprintf(tmpl, cap, "INSERT INTO %s (", table);
+        for (size_t i = 0; i < n_cols; i++) len += (size_t)snprintf(tmpl + len, cap - len, "%s%s", i ? ", " : "", cols[i]);
+        len += (size_t)snprintf(tmpl + len, cap - len, ") VALUES (");
+        for (size_t i = 0; i < n_cols; i++) len += (size_t)snprintf(tmpl + len, cap - len, "%s{%zu}", i ? ", " : "", i + 1);
+        snprintf(tmpl + len, cap - len, ")");
+
+        char render_buf[DB_RENDER_STACK], *rendered;
+        const char *q = db_render_sql(db, tmpl, render_buf, &rendered, err);
+        c->insert_sql = rendered ? rendered : strdup(q);
+        free(tmpl);
+    }
+    if (!c->insert_sql) {
+        db_error_set(err, ERR_DB_NOMEM, DB_ERR_CAT_UNKNOWN, "db_copy_begin: Out of memory");
+        free(c);
+        return NULL;
+    }
+    if (!db_tx_begin(db, DB_TX_DEFAULT, err)) {
+        free(c->insert_sql);
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+bool db_copy_row(db_copy_t *c, const db_bind_t *vals, db_error_t *err) {
+    if (!c || c->failed) {
+        db_error_set(err, ERR_DB_INTERNAL, DB_ERR_CAT_UNKNOWN, "db_copy_row: Invalid or failed load");
+        return false;
+    }
+    db_error_t row_err = { 0 };
+    bool ok = c->db->vt->copy_row
+        ? c->db->vt->copy_row(c, vals, &row_err)
+        : c->db->vt->exec(c->db, c->insert_sql, vals, c->n_cols, &row_err);
+    if (!ok) {
+        c->failed = true;
+        c->first_err = row_err;
+        if (err) *err = row_err;
+    } else if (!c->db->vt->copy_row) {
+        c->rows++;
+    }
+    return ok;
+}
+
+static bool db_copy_finish(db_copy_t *c, bool commit, int64_t *out_rows, db_error_t *err) {
+    bool ok = true;
+    if (c->db->vt->copy_end) {
+        ok = c->db->vt->copy_end(c, commit, out_rows, err);
+    } else if (commit) {
+        ok = db_tx_commit(c->db, err);
+        if (ok && out_rows) *out_rows = c->rows;
+    } else {
+        db_error_t rb_err = { 0 };
+        db_tx_rollback(c->db, &rb_err);
+    }
+    free(c->insert_sql);
+    free(c);
+    return ok;
+}
+
+bool db_copy_end(db_copy_t *c, int64_t *out_rows, db_error_t *err) {
+    if (out_rows) *out_rows = 0;
+    if (!c) {
+        db_error_set(err, ERR_DB_INTERNAL, DB_ERR_CAT_UNKNOWN, "db_copy_end: Invalid load");
+        return false;
+    }
+    if (c->failed) {
+        db_error_t first = c->first_err;
+        db_copy_finish(c, false, NULL, NULL);
+        if (err) {
+            *err = first;
+            if (!err->code) db_error_set(err, ERR_DB_INTERNAL, DB_ERR_CAT_UNKNOWN, "db_copy_end: A row was rejected");
+        }
+        return false;
+    }
+    return db_copy_finish(c, true, out_rows, err);
+}
+
+void db_copy_cancel(db_copy_t *c) {
+    if (c) db_copy_finish(c, false, NULL, NULL);
+}
+
+void db_stmt_cache_stats(db_stmt_cache_stats_t *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    db_pg_stmt_cache_stats(out);
+}
+
 const db_ops_vtable_t* db_get_ops(db_t *db) {
     if (!db) return NULL;
     return db->ops_vt;
@@ -104,8 +104,74 @@ typedef struct
   int lock_timeout_ms;         // Optional, 0 means default
   bool app_name_pid;           // If true, append pid to application_name
   int log_slow_ms;             // Log queries slower than this (0 disables)
+  bool pg_serialize;           // Postgres: serialize all libpq calls process-wide (debug only)
+  int pg_stmt_cache_size;      // Postgres: prepared statements kept per connection (0 = default, <0 disables)
 } db_config_t;
 
+/**
+ * @brief Process-wide prepared statement cache counters (all connections).
+ *        Backends without a statement cache report zeros.
+ */
+typedef struct
+{
+  uint64_t hits;                // executed an already prepared statement
+  uint64_t misses;              // statement not cached yet
+  uint64_t prepares;            // statements prepared on the server
+  uint64_t evictions;           // least recently used statements deallocated
+  uint64_t resets;              // reconnects after a dropped connection (cache cleared)
+} db_stmt_cache_stats_t;
+
+void db_stmt_cache_stats (db_stmt_cache_stats_t *out);
+
+/**
+ * @brief Process-wide timings of one statement template.
+ *
+ * Recorded around db_exec, db_exec_rows_affected, db_exec_insert_id,
+ * db_exec_returning, db_query and db_query_stream (for streams, the time to
+ * the first rows; their rows are not counted). Batches and bulk loads are
+ * not included. Percentiles come from log-linear histograms and are upper
+ * bounds within 25%.
+ */
+typedef struct
+{
+  const char *sql;              // template as passed in; valid for the process lifetime
+  uint64_t calls;
+  uint64_t errors;
+  uint64_t rows;                // rows returned (queries) or affected
+  uint64_t total_us;
+  uint64_t max_us;
+  uint64_t p50_us;
+  uint64_t p90_us;
+  uint64_t p99_us;
+} db_query_stat_t;
+
+/**
+ * @brief Merges every thread's statistics into *out, heaviest total time
+ *        first. Free the array with db_query_stats_free().
+ * @param out_overflow Receives the number of calls not recorded because
+ *        their thread's template table was full (may be NULL).
+ * @return The number of templates.
+ */
+size_t db_query_stats (db_query_stat_t **out, uint64_t *out_overflow);
+void db_query_stats_free (db_query_stat_t *stats);
+
+/**
+ * @brief Statements slower than ms are logged with their rendered SQL and
+ *        bind count (0 disables). A handle's own log_slow_ms, when set,
+ *        takes precedence.
+ */
+void db_set_slow_query_ms (int ms);
+int db_slow_query_ms (void);
+
+/**
+ * @brief Called after every statement timed above, on the thread that ran
+ *        it, with its SQL template, start time and duration in microseconds
+ *        of CLOCK_MONOTONIC. Used by request tracing; NULL (the default)
+ *        disables it. Set once, before other threads use the DB layer.
+ */
+typedef void (*db_trace_hook_fn) (const char *sql, uint64_t start_us, uint64_t dur_us, bool ok);
+void db_set_trace_hook (db_trace_hook_fn fn);
+
 // -----------------------------------------------------------------------------
 // Core Connection Lifecycle
 // -----------------------------------------------------------------------------
@@ -161,12 +227,33 @@ bool db_tx_begin    (db_t *db, db_tx_flags_t flags, db_error_t *err);
 
 /**
  * @brief Commits the current database transaction.
+ *        If the connection dropped while the transaction was open, every
+ *        statement after that fails and so does the commit; the connection
+ *        is re-established only once the transaction has ended.
  * @param db The database handle.
  * @param err Pointer to an error structure to fill on failure.
  * @return true on success, false on failure.
  */
 bool db_tx_commit   (db_t *db, db_error_t *err);
 
+/**
+ * @brief Runs fn once what db has done so far is committed: straight away
+ *        outside a transaction, else after the outermost db_tx_commit()
+ *        succeeds. Dropped if the transaction rolls back or fails to
+ *        commit. Registering the same fn again in one transaction runs it
+ *        once. For invalidating process-wide caches of committed data.
+ * @return false if too many different fns are already waiting (fn not run).
+ */
+#define DB_ON_COMMIT_MAX 8
+typedef void (*db_commit_fn) (void);
+bool db_on_commit   (db_t *db, db_commit_fn fn);
+
+/**
+ * @brief Current transaction nesting depth (0 = no transaction open).
+ * @param db The database handle.
+ */
+int  db_tx_depth    (const db_t *db);
+
 // -----------------------------------------------------------------------------
 // Bind Parameters
 // -----------------------------------------------------------------------------
@@ -270,6 +357,19 @@ bool db_tx_rollback (db_t *db, db_error_t *err);
  */
 bool db_query(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err);
 
+/**
+ * @brief Like db_query(), but rows are fetched from the server while stepping
+ *        instead of all at once, so scans of whole tables run in constant
+ *        memory and the first row is available sooner.
+ *
+ * The connection is busy until the last row has been stepped or the result
+ * is finalized: issue no other statement on db in between. Finalizing early
+ * reads and discards the remaining rows. A db_res_step() returning false
+ * with err->code set means the query failed part way. Backends without
+ * streaming return an ordinary result.
+ */
+bool db_query_stream(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err);
+
 /**
  * @brief Executes a SQL statement that does not return a result set (INSERT, UPDATE, DELETE).
  * @param db The database handle.
@@ -456,6 +556,102 @@ const void *db_res_col_blob (const db_res_t *res, int col_idx, size_t *out_len,
  */
 void db_res_finalize (db_res_t *res);
 
+// -----------------------------------------------------------------------------
+// Batches
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief A set of independent statements sent to the server together.
+ *
+ * Queue statements with db_batch_add(), send them with db_batch_run(), then
+ * read each statement's rows with db_batch_result(). On PostgreSQL the batch
+ * goes out in pipeline mode, so it costs one network round trip however many
+ * statements it holds; other backends run the statements one by one.
+ *
+ * Each statement succeeds or fails on its own, as if issued with db_query()
+ * in queue order. Inside a transaction a failure aborts the transaction, and
+ * the statements after it fail too. Bind arrays are copied by db_batch_add(),
+ * but the text and blob buffers they point to must stay valid until
+ * db_batch_run() returns.
+ */
+typedef struct db_batch_s db_batch_t;
+
+/** @return A new empty batch for db, or NULL if out of memory. */
+db_batch_t *db_batch_new (db_t *db);
+
+/**
+ * @brief Queues a statement (SQL template with {N} placeholders, as db_query).
+ * @return The statement's index for db_batch_result(), or -1 if out of memory
+ *         or the batch has already run.
+ */
+int db_batch_add (db_batch_t *b, const char *sql, const db_bind_t *params, size_t n_params);
+
+/**
+ * @brief Sends every queued statement and collects the results.
+ * @return false only if the batch could not be sent at all; per-statement
+ *         failures are reported by db_batch_result().
+ */
+bool db_batch_run (db_batch_t *b, db_error_t *err);
+
+/**
+ * @brief Rows of statement idx after db_batch_run().
+ * @return The result set, owned by the batch (do not finalize it), or NULL
+ *         with err filled in if the statement failed.
+ */
+db_res_t *db_batch_result (db_batch_t *b, int idx, db_error_t *err);
+
+/** @brief Frees the batch and all of its result sets. Safe with NULL. */
+void db_batch_free (db_batch_t *b);
+
+// -----------------------------------------------------------------------------
+// Bulk load
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief A stream of rows appended to one table.
+ *
+ * db_copy_begin() names the table and columns, db_copy_row() adds one row
+ * (one bind per column, in that order), db_copy_end() finishes the load. On
+ * PostgreSQL this is a binary COPY: rows are buffered and sent in large
+ * chunks and the server applies them as a single statement, so the load is
+ * all or nothing. Other backends insert row by row inside a transaction of
+ * their own (nested in the caller's, if one is open), which gives the same
+ * all or nothing result.
+ *
+ * Binds are converted to the column's type: integer binds fit integer,
+ * float, boolean and timestamp (as epoch seconds) columns, text binds text
+ * columns, json binds json/jsonb, blobs bytea. Other column types are
+ * rejected by db_copy_begin(). There is no ON CONFLICT: a duplicate key
+ * fails the whole load, and inside a transaction a failed or cancelled
+ * load aborts the transaction. The connection is busy until db_copy_end()
+ * or db_copy_cancel(): issue no other statement on db in between.
+ */
+typedef struct db_copy_s db_copy_t;
+
+/**
+ * @brief Starts loading rows into table (cols[0..n_cols-1]). Table and
+ *        column names must be plain identifiers (optionally schema.table).
+ * @return The load, or NULL with err filled in.
+ */
+db_copy_t *db_copy_begin (db_t *db, const char *table, const char *const *cols, size_t n_cols, db_error_t *err);
+
+/**
+ * @brief Appends one row of n_cols values. Text and blob buffers may be
+ *        reused as soon as it returns.
+ * @return false if the row was rejected; the load can then only be
+ *         cancelled (db_copy_end() fails too, with this row's error).
+ */
+bool db_copy_row (db_copy_t *c, const db_bind_t *vals, db_error_t *err);
+
+/**
+ * @brief Sends what is left and completes the load. Frees c either way.
+ * @param out_rows Receives the number of rows stored (may be NULL).
+ */
+bool db_copy_end (db_copy_t *c, int64_t *out_rows, db_error_t *err);
+
+/** @brief Abandons the load; nothing from it is stored. Safe with NULL. */
+void db_copy_cancel (db_copy_t *c);
+
 // -----------------------------------------------------------------------------
 // Optional: Operation-Level API (V-Table for Optimized Backend Operations)
 // -----------------------------------------------------------------------------
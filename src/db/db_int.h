@@ -17,6 +17,32 @@
 struct db_pg_impl_s; // For PostgreSQL driver
 
 
+// One queued statement of a db_batch_t
+typedef struct db_batch_item_s {
+    char *sql;                      // Rendered for the backend
+    db_bind_t *params;              // Copy of the caller's binds
+    size_t n_params;
+    db_res_t *res;                  // Set by batch_run on success
+    db_error_t err;                 // Set by batch_run on failure
+} db_batch_item_t;
+
+struct db_batch_s {
+    db_t *db;
+    db_batch_item_t *items;
+    size_t n, cap;
+    bool ran;
+};
+
+struct db_copy_s {
+    db_t *db;
+    size_t n_cols;
+    char *insert_sql;               // Generic path: rendered per-row INSERT
+    void *impl;                     // Backend state between copy_begin and copy_end
+    int64_t rows;                   // Generic path: rows inserted so far
+    bool failed;                    // A row was rejected; only cancel remains
+    db_error_t first_err;           // Why the first rejected row was rejected
+};
+
 // V-table for generic DB operations
 typedef struct db_vt_s {
     // Core connection lifecycle
@@ -35,8 +61,21 @@ typedef struct db_vt_s {
 
     // Query (rows)
     bool (*query)(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err);
+    // Optional: rows fetched incrementally while stepping (see db_query_stream)
+    bool (*query_stream)(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err);
     bool (*exec_returning)(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err);
 
+    // Batches (optional): fill res or err of every item; false if nothing
+    // could be sent. Without it, db_batch_run() issues each item via query.
+    bool (*batch_run)(db_t *db, db_batch_item_t *items, size_t n, db_error_t *err);
+
+    // Bulk load (optional, all three or none): copy_begin sets c->impl,
+    // copy_end releases it whether or not commit is set. Without them
+    // db_copy_row() runs one INSERT per row.
+    bool (*copy_begin)(db_copy_t *c, const char *table, const char *const *cols, size_t n_cols, db_error_t *err);
+    bool (*copy_row)(db_copy_t *c, const db_bind_t *vals, db_error_t *err);
+    bool (*copy_end)(db_copy_t *c, bool commit, int64_t *out_rows, db_error_t *err);
+
     // Result Set Navigation
     bool (*res_step)(db_res_t *res, db_error_t *err);
     void (*res_cancel)(db_res_t *res);
@@ -77,8 +116,15 @@ struct db_s {
     db_config_t config;             // Copy of the configuration used to open this DB
     const db_ops_vtable_t *ops_vt;  // Optional vtable for high-level optimized operations
     int tx_nest_level;              // To track nested transaction calls
+    db_commit_fn on_commit[DB_ON_COMMIT_MAX]; // Run after the outermost commit
+    int n_on_commit;
 };
 
+// Statement statistics (db_stats.c), fed by the db_api.c dispatchers
+uint64_t db_stats_now_us(void);
+void db_stats_record(const char *sql, uint64_t us, int64_t rows, bool ok);
+db_trace_hook_fn db_trace_hook(void);
+
 // db_res_t handle definition (opaque to external users)
 struct db_res_s {
     const db_t *db;                 // Pointer to the parent db_t handle
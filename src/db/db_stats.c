@@ -0,0 +1,276 @@
+#define TW_DB_INTERNAL 1
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "db_api.h"
+#include "db_int.h"
+
+// Per-template statement statistics.
+//
+// Every thread records into its own shard, so the hot path takes no lock
+// and issues no locked instruction: a shard has a single writer, and
+// readers merging it only need each counter to be read whole (relaxed
+// atomics). A shard outlives its thread and is handed to the next thread
+// that starts recording, so the shard count stays at the peak number of
+// threads that ever ran statements at once.
+//
+// Templates are keyed by their text. A shard holds DB_STATS_SLOTS of them;
+// statements that find no free slot (SQL built with literal values, mostly)
+// only bump the shard's overflow counter.
+
+#define DB_STATS_SLOTS      2048    // per shard, power of two
+#define DB_STATS_PROBES     16
+#define DB_STATS_SUB_BITS   2       // histogram: 4 buckets per power of two
+#define DB_STATS_SUB        (1 << DB_STATS_SUB_BITS)
+#define DB_STATS_MAX_EXP    40      // ~12 days in microseconds
+#define DB_STATS_BUCKETS    ((DB_STATS_MAX_EXP - DB_STATS_SUB_BITS + 1) * DB_STATS_SUB)
+
+typedef struct {
+    uint64_t hash;
+    char *sql;
+    _Atomic uint64_t calls, errors, rows, total_us, max_us;
+    _Atomic uint32_t hist[DB_STATS_BUCKETS];
+} db_stat_entry_t;
+
+typedef struct db_stats_shard_s {
+    struct db_stats_shard_s *next;
+    bool live;                                  // guarded by g_stats_mu
+    _Atomic uint64_t overflow;
+    _Atomic(db_stat_entry_t *) slots[DB_STATS_SLOTS];
+} db_stats_shard_t;
+
+static pthread_mutex_t g_stats_mu = PTHREAD_MUTEX_INITIALIZER;
+static db_stats_shard_t *g_shards = NULL;
+static pthread_key_t g_stats_key;
+static pthread_once_t g_stats_once = PTHREAD_ONCE_INIT;
+static __thread db_stats_shard_t *t_shard = NULL;
+static _Atomic int g_slow_ms = 0;
+static db_trace_hook_fn g_trace_hook = NULL;
+
+static void db_stats_release(void *p) {
+    pthread_mutex_lock(&g_stats_mu);
+    ((db_stats_shard_t *)p)->live = false;
+    pthread_mutex_unlock(&g_stats_mu);
+}
+
+static void db_stats_key_init(void) {
+    pthread_key_create(&g_stats_key, db_stats_release);
+}
+
+static db_stats_shard_t *db_stats_shard(void) {
+    if (t_shard) return t_shard;
+    pthread_once(&g_stats_once, db_stats_key_init);
+
+    pthread_mutex_lock(&g_stats_mu);
+    db_stats_shard_t *sh = g_shards;
+    while (sh && sh->live) sh = sh->next;
+    if (!sh && (sh = calloc(1, sizeof(*sh))) != NULL) {
+        sh->next = g_shards;
+        g_shards = sh;
+    }
+    if (sh) sh->live = true;
+    pthread_mutex_unlock(&g_stats_mu);
+
+    if (sh) pthread_setspecific(g_stats_key, sh);
+    t_shard = sh;
+    return sh;
+}
+
+// Single writer: a plain load and store is enough
+static inline void stat_add(_Atomic uint64_t *c, uint64_t v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static int db_stats_bucket(uint64_t us) {
+    if (us < DB_STATS_SUB) return (int)us;
+    int e = 63 - __builtin_clzll(us);
+    if (e >= DB_STATS_MAX_EXP) return DB_STATS_BUCKETS - 1;
+    int sub = (int)(us >> (e - DB_STATS_SUB_BITS)) & (DB_STATS_SUB - 1);
+    return (e - DB_STATS_SUB_BITS + 1) * DB_STATS_SUB + sub;
+}
+
+// Largest value that falls in bucket b
+static uint64_t db_stats_bucket_top(int b) {
+    if (b < DB_STATS_SUB) return (uint64_t)b;
+    int e = b / DB_STATS_SUB + DB_STATS_SUB_BITS - 1;
+    uint64_t lo = (uint64_t)(DB_STATS_SUB + b % DB_STATS_SUB) << (e - DB_STATS_SUB_BITS);
+    return lo + (1ULL << (e - DB_STATS_SUB_BITS)) - 1;
+}
+
+static uint64_t db_stats_hash(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+uint64_t db_stats_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+void db_stats_record(const char *sql, uint64_t us, int64_t rows, bool ok) {
+    db_stats_shard_t *sh = db_stats_shard();
+    if (!sh || !sql) return;
+
+    uint64_t h = db_stats_hash(sql);
+    db_stat_entry_t *e = NULL;
+    for (int i = 0; i < DB_STATS_PROBES; i++) {
+        _Atomic(db_stat_entry_t *) *slot = &sh->slots[(h + (uint64_t)i) & (DB_STATS_SLOTS - 1)];
+        db_stat_entry_t *cur = atomic_load_explicit(slot, memory_order_relaxed);
+        if (!cur) {
+            cur = calloc(1, sizeof(*cur));
+            if (cur && !(cur->sql = strdup(sql))) {
+                free(cur);
+                cur = NULL;
+            }
+            if (!cur) break;
+            cur->hash = h;
+            atomic_store_explicit(slot, cur, memory_order_release);
+            e = cur;
+            break;
+        }
+        if (cur->hash == h && strcmp(cur->sql, sql) == 0) {
+            e = cur;
+            break;
+        }
+    }
+    if (!e) {
+        stat_add(&sh->overflow, 1);
+        return;
+    }
+
+    stat_add(&e->calls, 1);
+    if (!ok) stat_add(&e->errors, 1);
+    if (rows > 0) stat_add(&e->rows, (uint64_t)rows);
+    stat_add(&e->total_us, us);
+    if (us > atomic_load_explicit(&e->max_us, memory_order_relaxed)) {
+        atomic_store_explicit(&e->max_us, us, memory_order_relaxed);
+    }
+    _Atomic uint32_t *b = &e->hist[db_stats_bucket(us)];
+    atomic_store_explicit(b, atomic_load_explicit(b, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void db_set_slow_query_ms(int ms) {
+    atomic_store(&g_slow_ms, ms > 0 ? ms : 0);
+}
+
+int db_slow_query_ms(void) {
+    return atomic_load(&g_slow_ms);
+}
+
+void db_set_trace_hook(db_trace_hook_fn fn) {
+    g_trace_hook = fn;
+}
+
+db_trace_hook_fn db_trace_hook(void) {
+    return g_trace_hook;
+}
+
+// Merge state for one template
+typedef struct {
+    db_query_stat_t st;
+    uint64_t hash;
+    uint64_t hist[DB_STATS_BUCKETS];
+} db_stats_acc_t;
+
+static uint64_t db_stats_percentile(const uint64_t *hist, uint64_t calls, double q) {
+    uint64_t want = (uint64_t)((double)calls * q + 0.5), seen = 0;
+    if (want == 0) want = 1;
+    for (int b = 0; b < DB_STATS_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= want) return db_stats_bucket_top(b);
+    }
+    return 0;
+}
+
+static int db_stats_cmp_total(const void *a, const void *b) {
+    const db_query_stat_t *x = a, *y = b;
+    return x->total_us < y->total_us ? 1 : x->total_us > y->total_us ? -1 : 0;
+}
+
+size_t db_query_stats(db_query_stat_t **out, uint64_t *out_overflow) {
+    *out = NULL;
+    if (out_overflow) *out_overflow = 0;
+
+    pthread_mutex_lock(&g_stats_mu);
+    size_t total = 0;
+    for (db_stats_shard_t *sh = g_shards; sh; sh = sh->next) {
+        for (int i = 0; i < DB_STATS_SLOTS; i++) {
+            if (atomic_load_explicit(&sh->slots[i], memory_order_relaxed)) total++;
+        }
+    }
+
+    // Open-addressed by template hash; at most half full
+    size_t cap = 16;
+    while (cap < total * 2) cap *= 2;
+    db_stats_acc_t **map = calloc(cap, sizeof(*map));
+    db_stats_acc_t *accs = calloc(total ? total : 1, sizeof(*accs));
+    size_t n = 0;
+    if (!map || !accs) {
+        pthread_mutex_unlock(&g_stats_mu);
+        free(map);
+        free(accs);
+        return 0;
+    }
+
+    for (db_stats_shard_t *sh = g_shards; sh; sh = sh->next) {
+        if (out_overflow) *out_overflow += atomic_load_explicit(&sh->overflow, memory_order_relaxed);
+        for (int i = 0; i < DB_STATS_SLOTS; i++) {
+            db_stat_entry_t *e = atomic_load_explicit(&sh->slots[i], memory_order_acquire);
+            if (!e) continue;
+            size_t j = e->hash & (cap - 1);
+            while (map[j] && (map[j]->hash != e->hash || strcmp(map[j]->st.sql, e->sql) != 0)) {
+                j = (j + 1) & (cap - 1);
+            }
+            db_stats_acc_t *a = map[j];
+            if (!a) {
+                if (n == total) continue;   // appeared after the count; next time
+                a = map[j] = &accs[n++];
+                a->hash = e->hash;
+                a->st.sql = e->sql;     // entries are never freed
+            }
+            a->st.calls += atomic_load_explicit(&e->calls, memory_order_relaxed);
+            a->st.errors += atomic_load_explicit(&e->errors, memory_order_relaxed);
+            a->st.rows += atomic_load_explicit(&e->rows, memory_order_relaxed);
+            a->st.total_us += atomic_load_explicit(&e->total_us, memory_order_relaxed);
+            uint64_t mx = atomic_load_explicit(&e->max_us, memory_order_relaxed);
+            if (mx > a->st.max_us) a->st.max_us = mx;
+            for (int b = 0; b < DB_STATS_BUCKETS; b++) {
+                a->hist[b] += atomic_load_explicit(&e->hist[b], memory_order_relaxed);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_stats_mu);
+    free(map);
+
+    db_query_stat_t *res = calloc(n ? n : 1, sizeof(*res));
+    if (!res) {
+        free(accs);
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        db_stats_acc_t *a = &accs[i];
+        // The histogram may be a few calls ahead of or behind calls
+        uint64_t cnt = 0;
+        for (int b = 0; b < DB_STATS_BUCKETS; b++) cnt += a->hist[b];
+        a->st.p50_us = db_stats_percentile(a->hist, cnt, 0.50);
+        a->st.p90_us = db_stats_percentile(a->hist, cnt, 0.90);
+        a->st.p99_us = db_stats_percentile(a->hist, cnt, 0.99);
+        res[i] = a->st;
+    }
+    free(accs);
+    qsort(res, n, sizeof(*res), db_stats_cmp_total);
+    *out = res;
+    return n;
+}
+
+void db_query_stats_free(db_query_stat_t *stats) {
+    free(stats);
+}
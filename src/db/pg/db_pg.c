@@ -2,10 +2,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <libpq-fe.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <unistd.h>
+#include <endian.h>
 
 // local includes
 #include "db_pg.h"
@@ -16,24 +19,103 @@
 
 // PostgreSQL Type OIDs
 #define BOOLOID 16
+#define BYTEAOID 17
+#define CHAROID 18
+#define NAMEOID 19
 #define INT8OID 20
+#define INT2OID 21
 #define INT4OID 23
 #define TEXTOID 25
+#define OIDOID 26
 #define JSONOID 114
+#define FLOAT4OID 700
+#define FLOAT8OID 701
+#define BPCHAROID 1042
+#define VARCHAROID 1043
+#define TIMESTAMPOID 1114
 #define TIMESTAMPTZOID 1184
+#define VOIDOID 2278
+#define JSONBOID 3802
 
-// GOAL C: Temporary serialization of DB calls with a mutex
+// Binary timestamptz counts microseconds from 2000-01-01 00:00:00 UTC
+#define PG_EPOCH_UNIX 946684800LL
+
+// Parameters are sent in binary (format 1) from fixed buffers; up to this
+// many need no allocation at all.
+#define PG_STACK_PARAMS 16
+
+// Process-wide lock used only by connections opened in serialized mode
+// (db_config_t.pg_serialize, or a libpq built without thread safety).
+// Each PGconn is owned by exactly one thread, so the normal mode runs
+// every connection independently.
 static pthread_mutex_t g_pg_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Prepared statement cache: every statement this connection runs is
+// prepared once under a generated name and executed with PQexecPrepared
+// afterwards. Keyed by final SQL text plus parameter types; least recently
+// used entries are deallocated when the cache is full. Prepared statements
+// whose result columns are all simple types (ints, floats, bool, text, json)
+// return binary results; the rest stay in text.
+#define PG_STMT_CACHE_DEFAULT 256
+#define PG_STMT_SQL_MAX 16384   // longer statements are run unprepared
+
+typedef struct pg_stmt_s {
+  uint64_t hash;
+  char *sql;
+  int n_params;
+  Oid *types;
+  uint64_t used;
+  bool binary;                  // every result column has a simple binary form
+  char name[16];
+} pg_stmt_t;
+
 typedef struct db_pg_impl_s {
   PGconn *conn;
   bool in_tx;
+  bool tx_lost;                 // connection dropped inside the open transaction
+  bool serialize;               // Route libpq calls through g_pg_mutex
+  pg_stmt_t *stmts;
+  int stmt_cap;                 // 0 = cache disabled
+  int stmt_count;
+  uint64_t stmt_tick;
+  unsigned stmt_seq;            // statement names are never reused
 } db_pg_impl_t;
 
+// Process-wide counters across all connections
+static _Atomic uint64_t g_stmt_hits = 0;
+static _Atomic uint64_t g_stmt_misses = 0;
+static _Atomic uint64_t g_stmt_prepares = 0;
+static _Atomic uint64_t g_stmt_evictions = 0;
+static _Atomic uint64_t g_stmt_resets = 0;
+
+static inline void pg_lock(const db_pg_impl_t *impl) {
+    if (impl->serialize) pthread_mutex_lock(&g_pg_mutex);
+}
+
+static inline void pg_unlock(const db_pg_impl_t *impl) {
+    if (impl->serialize) pthread_mutex_unlock(&g_pg_mutex);
+}
+
 typedef struct db_pg_res_impl_s {
     PGresult *pg_res;
+    char (*scratch)[32];        // text form of binary columns, one per column
+    db_pg_impl_t *stream;       // connection still delivering rows (streamed)
 } db_pg_res_impl_t;
 
+typedef struct {
+    int n;
+    Oid *types;
+    const char **values;
+    int *lengths;
+    int *formats;
+    char (*bin)[8];
+    Oid s_types[PG_STACK_PARAMS];
+    const char *s_values[PG_STACK_PARAMS];
+    int s_lengths[PG_STACK_PARAMS];
+    int s_formats[PG_STACK_PARAMS];
+    char s_bin[PG_STACK_PARAMS][8];
+} pg_params_t;
+
 
 // GOAL D: Improve error mapping
 static void pg_map_error(PGconn *conn, PGresult *pg_res, db_error_t *err) {
@@ -108,43 +190,351 @@ static void pg_map_error(PGconn *conn, PGresult *pg_res, db_error_t *err) {
 }
 
 
-static char* pg_bind_param_to_string(const db_bind_t *param) {
-    char *buf = NULL;
-    switch (param->type) {
-        case DB_BIND_NULL: return NULL;
-        case DB_BIND_I64: if (asprintf(&buf, "%lld", (long long)param->v.i64) < 0) buf = NULL; break;
-        case DB_BIND_I32: if (asprintf(&buf, "%d", param->v.i32) < 0) buf = NULL; break;
-        case DB_BIND_BOOL: if (asprintf(&buf, "%s", param->v.b ? "t" : "f") < 0) buf = NULL; break;
-        case DB_BIND_TIMESTAMP: {
-            struct tm tm;
-            time_t t = (time_t)param->v.timestamp;
-            gmtime_r(&t, &tm);
-            char tmp[32];
-            strftime(tmp, sizeof(tmp), "%Y-%m-%dT%H:%M:%SZ", &tm);
-            buf = strdup(tmp);
-            break;
+static inline void pg_put_be64(char *buf, uint64_t v) {
+    v = htobe64(v);
+    memcpy(buf, &v, 8);
+}
+
+static inline void pg_put_be32(char *buf, uint32_t v) {
+    v = htobe32(v);
+    memcpy(buf, &v, 4);
+}
+
+static void pg_params_free(pg_params_t *p) {
+    if (p->types != p->s_types) {
+        free(p->types);
+        free(p->values);
+        free(p->lengths);
+        free(p->formats);
+        free(p->bin);
+    }
+}
+
+// Encodes binds for PQexecParams/PQexecPrepared. Fixed-width values go out
+// in network byte order; text and JSON are passed through without copying.
+static bool pg_params_init(pg_params_t *p, const db_bind_t *params, size_t n_params) {
+    p->n = (int)n_params;
+    if (n_params <= PG_STACK_PARAMS) {
+        p->types = p->s_types;
+        p->values = p->s_values;
+        p->lengths = p->s_lengths;
+        p->formats = p->s_formats;
+        p->bin = p->s_bin;
+    } else {
+        p->types = calloc(n_params, sizeof(Oid));
+        p->values = calloc(n_params, sizeof(char*));
+        p->lengths = calloc(n_params, sizeof(int));
+        p->formats = calloc(n_params, sizeof(int));
+        p->bin = calloc(n_params, sizeof(*p->bin));
+        if (!p->types || !p->values || !p->lengths || !p->formats || !p->bin) {
+            pg_params_free(p);
+            return false;
         }
-        case DB_BIND_TEXT: 
-            if (param->v.text.ptr == NULL)
-                return NULL;
-            return strdup(param->v.text.ptr);
-        case DB_BIND_JSON:
-            if (param->v.text.ptr == NULL)
-                return NULL;
-            return strdup(param->v.text.ptr);
-        default: return NULL;
     }
-    return buf;
+
+    for (size_t i = 0; i < n_params; i++) {
+        const db_bind_t *b = &params[i];
+        char *bin = p->bin[i];
+
+        p->types[i] = 0;
+        p->values[i] = NULL;
+        p->lengths[i] = 0;
+        p->formats[i] = 1;
+        switch (b->type) {
+            case DB_BIND_I64:
+                p->types[i] = INT8OID; pg_put_be64(bin, (uint64_t)b->v.i64); p->lengths[i] = 8; break;
+            case DB_BIND_U64:
+                p->types[i] = INT8OID; pg_put_be64(bin, b->v.u64); p->lengths[i] = 8; break;
+            case DB_BIND_I32:
+                p->types[i] = INT4OID; pg_put_be32(bin, (uint32_t)b->v.i32); p->lengths[i] = 4; break;
+            case DB_BIND_U32:
+                p->types[i] = INT8OID; pg_put_be64(bin, (uint64_t)b->v.u32); p->lengths[i] = 8; break;
+            case DB_BIND_BOOL:
+                p->types[i] = BOOLOID; bin[0] = b->v.b ? 1 : 0; p->lengths[i] = 1; break;
+            case DB_BIND_TIMESTAMP:
+                p->types[i] = TIMESTAMPTZOID;
+                pg_put_be64(bin, (uint64_t)((b->v.timestamp - PG_EPOCH_UNIX) * 1000000LL));
+                p->lengths[i] = 8;
+                break;
+            case DB_BIND_TEXT:
+                p->types[i] = TEXTOID;
+                p->values[i] = b->v.text.ptr;
+                if (b->v.text.ptr && b->v.text.len > 0) p->lengths[i] = (int)b->v.text.len;
+                else p->formats[i] = 0;
+                continue;
+            case DB_BIND_JSON:
+                p->types[i] = JSONOID; p->values[i] = b->v.text.ptr; p->formats[i] = 0; continue;
+            case DB_BIND_BLOB:
+                p->types[i] = BYTEAOID; p->values[i] = b->v.blob.ptr; p->lengths[i] = (int)b->v.blob.len; continue;
+            default:
+                p->formats[i] = 0; continue; // NULL; let PG infer the type
+        }
+        p->values[i] = bin;
+    }
+    return true;
+}
+
+// Result columns whose binary form the accessors decode (or that are
+// byte-identical to text). Statements returning anything else (numeric,
+// timestamps, arrays, jsonb, ...) keep text results.
+static bool pg_types_binary_safe(const PGresult *desc) {
+    for (int c = 0; c < PQnfields(desc); c++) {
+        switch (PQftype(desc, c)) {
+            case BOOLOID: case CHAROID: case NAMEOID: case INT8OID: case INT2OID:
+            case INT4OID: case TEXTOID: case OIDOID: case JSONOID: case FLOAT4OID:
+            case FLOAT8OID: case BPCHAROID: case VARCHAROID: case VOIDOID:
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// Binary-format integer/bool/float columns, widened. False when the
+// column is not binary or not one of these types (callers then parse text).
+static bool pg_bin_int(const PGresult *r, int row, int col, int64_t *out) {
+    if (PQfformat(r, col) != 1) return false;
+    const char *v = PQgetvalue(r, row, col);
+    if (PQgetisnull(r, row, col)) { *out = 0; return true; }
+    uint64_t u64; uint32_t u32; uint16_t u16;
+    switch (PQftype(r, col)) {
+        case INT8OID: memcpy(&u64, v, 8); *out = (int64_t)be64toh(u64); return true;
+        case INT4OID: memcpy(&u32, v, 4); *out = (int32_t)be32toh(u32); return true;
+        case OIDOID:  memcpy(&u32, v, 4); *out = (int64_t)be32toh(u32); return true;
+        case INT2OID: memcpy(&u16, v, 2); *out = (int16_t)be16toh(u16); return true;
+        case BOOLOID: *out = v[0] != 0; return true;
+        default: return false;
+    }
+}
+
+static bool pg_bin_float(const PGresult *r, int row, int col, double *out) {
+    if (PQfformat(r, col) != 1) return false;
+    const char *v = PQgetvalue(r, row, col);
+    if (PQgetisnull(r, row, col)) { *out = 0.0; return true; }
+    switch (PQftype(r, col)) {
+        case FLOAT8OID: {
+            uint64_t u; double d;
+            memcpy(&u, v, 8); u = be64toh(u); memcpy(&d, &u, 8);
+            *out = d; return true;
+        }
+        case FLOAT4OID: {
+            uint32_t u; float f;
+            memcpy(&u, v, 4); u = be32toh(u); memcpy(&f, &u, 4);
+            *out = f; return true;
+        }
+        default: return false;
+    }
+}
+
+static int64_t pg_get_i64(const PGresult *r, int row, int col) {
+    int64_t i; double d;
+    if (pg_bin_int(r, row, col, &i)) return i;
+    if (pg_bin_float(r, row, col, &d)) return (int64_t)d;
+    const char *val = PQgetvalue(r, row, col);
+    if (!val) return 0;
+    if (val[0] == 't') return 1;
+    if (val[0] == 'f') return 0;
+    return atoll(val);
+}
+
+static uint64_t pg_stmt_hash(const char *sql, int n_params, const Oid *types) {
+    uint64_t h = 1469598103934665603ULL;        // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)sql; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    for (int i = 0; i < n_params; i++) {
+        h ^= (uint64_t)types[i] + 0x9e3779b97f4a7c15ULL;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void pg_stmt_free_all(db_pg_impl_t *impl) {
+    for (int i = 0; i < impl->stmt_count; i++) {
+        free(impl->stmts[i].sql);
+        free(impl->stmts[i].types);
+    }
+    impl->stmt_count = 0;
+}
+
+// Removes entry i; the server-side statement is deallocated if dealloc.
+static void pg_stmt_remove(db_pg_impl_t *impl, int i, bool dealloc) {
+    pg_stmt_t *st = &impl->stmts[i];
+    if (dealloc) {
+        char cmd[32];
+        snprintf(cmd, sizeof cmd, "DEALLOCATE %s", st->name);
+        PGresult *r = PQexec(impl->conn, cmd);
+        PQclear(r);
+    }
+    free(st->sql);
+    free(st->types);
+    impl->stmts[i] = impl->stmts[--impl->stmt_count];
+}
+
+// After a dropped connection: reconnect and forget every prepared statement.
+static void pg_conn_reset(db_pg_impl_t *impl) {
+    LOGW("PostgreSQL connection lost; resetting (%d prepared statements dropped).", impl->stmt_count);
+    pg_stmt_free_all(impl);
+    impl->in_tx = false;
+    impl->tx_lost = false;
+    atomic_fetch_add(&g_stmt_resets, 1);
+    PQreset(impl->conn);
+    if (PQstatus(impl->conn) == CONNECTION_OK) {
+        PGresult *r = PQexec(impl->conn, "SET client_min_messages TO WARNING");
+        PQclear(r);
+    }
+}
+
+// The connection dropped (or fell out of step). Outside a transaction,
+// reconnect now. Inside one, the work so far died with the session: a new
+// session must not quietly run the rest of it, so the transaction stays
+// failed until it is rolled back or its COMMIT is refused.
+static void pg_conn_lost(db_pg_impl_t *impl) {
+    if (!impl->in_tx) {
+        pg_conn_reset(impl);
+    } else if (!impl->tx_lost) {
+        LOGW("PostgreSQL connection lost inside a transaction; failing the transaction.");
+        impl->tx_lost = true;
+    }
+}
+
+// True, with err set, once the open transaction was lost. Caller holds pg_lock.
+static bool pg_tx_lost(const db_pg_impl_t *impl, db_error_t *err) {
+    if (!impl->tx_lost) return false;
+    if (err) {
+        db_error_clear(err);
+        err->code = ERR_DB_TX;
+        err->category = DB_ERR_CAT_CONNECTION;
+        strlcpy(err->message, "Connection lost during the transaction; it was not applied.", sizeof(err->message));
+    }
+    return true;
+}
+
+static bool pg_res_sqlstate_is(const PGresult *res, const char *state) {
+    const char *s = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+    return s && strcmp(s, state) == 0;
+}
+
+static int pg_stmt_find(const db_pg_impl_t *impl, const char *sql, const pg_params_t *p, uint64_t h) {
+    for (int i = 0; i < impl->stmt_count; i++) {
+        const pg_stmt_t *st = &impl->stmts[i];
+        if (st->hash == h && st->n_params == p->n && strcmp(st->sql, sql) == 0
+            && (p->n == 0 || memcmp(st->types, p->types, p->n * sizeof(Oid)) == 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Sets up the free slot after the last entry (not yet counted) under a new
+// name; NULL if out of memory. Caller checked there is room.
+static pg_stmt_t *pg_stmt_fill(db_pg_impl_t *impl, const char *sql, const pg_params_t *p, uint64_t h) {
+    pg_stmt_t *st = &impl->stmts[impl->stmt_count];
+    memset(st, 0, sizeof(*st));
+    st->sql = strdup(sql);
+    st->types = p->n > 0 ? malloc(p->n * sizeof(Oid)) : NULL;
+    if (!st->sql || (p->n > 0 && !st->types)) {
+        free(st->sql);
+        free(st->types);
+        return NULL;
+    }
+    if (p->n > 0) memcpy(st->types, p->types, p->n * sizeof(Oid));
+    st->hash = h;
+    st->n_params = p->n;
+    snprintf(st->name, sizeof st->name, "tw_%u", ++impl->stmt_seq);
+    return st;
+}
+
+// Runs sql through the statement cache. Caller holds pg_lock.
+static PGresult *pg_run(db_pg_impl_t *impl, const char *sql, const pg_params_t *p) {
+    PGresult *res;
+    int n_params = p->n;
+    const Oid *types = p->types;
+
+    if (impl->stmt_cap <= 0 || strlen(sql) > PG_STMT_SQL_MAX) {
+        res = PQexecParams(impl->conn, sql, n_params, types, p->values, p->lengths, p->formats, 0);
+        goto done;
+    }
+
+    uint64_t h = pg_stmt_hash(sql, n_params, types);
+    int i = pg_stmt_find(impl, sql, p, h);
+    if (i >= 0) {
+        pg_stmt_t *st = &impl->stmts[i];
+        atomic_fetch_add(&g_stmt_hits, 1);
+        st->used = ++impl->stmt_tick;
+        res = PQexecPrepared(impl->conn, st->name, n_params, p->values, p->lengths, p->formats, st->binary);
+        // Deallocated behind our back (e.g. DISCARD ALL): prepare again
+        if (!pg_res_sqlstate_is(res, "26000") || impl->in_tx) goto done;
+        PQclear(res);
+        pg_stmt_remove(impl, i, false);
+    }
+    atomic_fetch_add(&g_stmt_misses, 1);
+
+    if (impl->stmt_count == impl->stmt_cap) {
+        // Evicting while a transaction is open could hit an aborted one;
+        // run unprepared until the next miss outside a transaction.
+        if (impl->in_tx) {
+            res = PQexecParams(impl->conn, sql, n_params, types, p->values, p->lengths, p->formats, 0);
+            goto done;
+        }
+        int lru = 0;
+        for (int j = 1; j < impl->stmt_count; j++) {
+            if (impl->stmts[j].used < impl->stmts[lru].used) lru = j;
+        }
+        pg_stmt_remove(impl, lru, true);
+        atomic_fetch_add(&g_stmt_evictions, 1);
+    }
+
+    pg_stmt_t *st = pg_stmt_fill(impl, sql, p, h);
+    if (!st) {
+        res = PQexecParams(impl->conn, sql, n_params, types, p->values, p->lengths, p->formats, 0);
+        goto done;
+    }
+
+    // A failed prepare carries the parse/plan error; hand it back as is
+    res = PQprepare(impl->conn, st->name, sql, n_params, types);
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        free(st->sql);
+        free(st->types);
+        goto done;
+    }
+    PQclear(res);
+    res = PQdescribePrepared(impl->conn, st->name);
+    st->binary = PQresultStatus(res) == PGRES_COMMAND_OK && pg_types_binary_safe(res);
+    PQclear(res);
+    atomic_fetch_add(&g_stmt_prepares, 1);
+    st->used = ++impl->stmt_tick;
+    impl->stmt_count++;
+    res = PQexecPrepared(impl->conn, st->name, n_params, p->values, p->lengths, p->formats, st->binary);
+
+done:
+    if (PQstatus(impl->conn) == CONNECTION_BAD) {
+        pg_conn_lost(impl);
+    }
+    return res;
+}
+
+void db_pg_stmt_cache_stats(db_stmt_cache_stats_t *out) {
+    if (!out) return;
+    out->hits = atomic_load(&g_stmt_hits);
+    out->misses = atomic_load(&g_stmt_misses);
+    out->prepares = atomic_load(&g_stmt_prepares);
+    out->evictions = atomic_load(&g_stmt_evictions);
+    out->resets = atomic_load(&g_stmt_resets);
 }
 
 static void pg_close_impl(db_t *db) {
     db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
     if (impl) {
         if (impl->conn) {
-            pthread_mutex_lock(&g_pg_mutex);
+            pg_lock(impl);
             PQfinish(impl->conn);
-            pthread_mutex_unlock(&g_pg_mutex);
+            pg_unlock(impl);
         }
+        pg_stmt_free_all(impl);
+        free(impl->stmts);
         free(impl);
     }
 }
@@ -152,60 +542,69 @@ static void pg_close_impl(db_t *db) {
 static bool pg_tx_begin_impl(db_t *db, db_tx_flags_t flags, db_error_t *err) {
     db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
     (void)flags;
-    pthread_mutex_lock(&g_pg_mutex);
+    pg_lock(impl);
     PGresult *res = PQexec(impl->conn, "BEGIN");
-    pthread_mutex_unlock(&g_pg_mutex);
+    pg_unlock(impl);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) { pg_map_error(impl->conn, res, err); PQclear(res); return false; }
     PQclear(res); impl->in_tx = true; return true;
 }
 
+// A refused COMMIT still ends the transaction, as it does on the server;
+// a lost one is refused and only then is the connection reset.
 static bool pg_tx_commit_impl(db_t *db, db_error_t *err) {
     db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
-    pthread_mutex_lock(&g_pg_mutex);
+    pg_lock(impl);
+    if (pg_tx_lost(impl, err)) {
+        pg_conn_reset(impl);
+        pg_unlock(impl);
+        return false;
+    }
     PGresult *res = PQexec(impl->conn, "COMMIT");
-    pthread_mutex_unlock(&g_pg_mutex);
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) { pg_map_error(impl->conn, res, err); PQclear(res); return false; }
-    PQclear(res); impl->in_tx = false; return true;
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    if (!ok) pg_map_error(impl->conn, res, err);
+    PQclear(res);
+    impl->in_tx = false;
+    if (PQstatus(impl->conn) == CONNECTION_BAD) pg_conn_reset(impl);
+    pg_unlock(impl);
+    return ok;
 }
 
 static bool pg_tx_rollback_impl(db_t *db, db_error_t *err) {
     db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
-    pthread_mutex_lock(&g_pg_mutex);
+    pg_lock(impl);
+    if (impl->tx_lost) {
+        // Nothing left to roll back: the server dropped it with the session
+        pg_conn_reset(impl);
+        pg_unlock(impl);
+        return true;
+    }
     PGresult *res = PQexec(impl->conn, "ROLLBACK");
-    pthread_mutex_unlock(&g_pg_mutex);
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) { pg_map_error(impl->conn, res, err); PQclear(res); return false; }
-    PQclear(res); impl->in_tx = false; return true;
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    if (!ok) pg_map_error(impl->conn, res, err);
+    PQclear(res);
+    impl->in_tx = false;
+    if (PQstatus(impl->conn) == CONNECTION_BAD) pg_conn_reset(impl);
+    pg_unlock(impl);
+    return ok;
 }
 
 static bool pg_exec_internal(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, int64_t *out_rows, db_error_t *err) {
     db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
-    char **values = calloc(n_params, sizeof(char*));
-    Oid *types = calloc(n_params, sizeof(Oid));
-    if ((!values || !types) && n_params > 0) {
+    pg_params_t p;
+    if (!pg_params_init(&p, params, n_params)) {
         err->code = ERR_DB_QUERY_FAILED;
         snprintf(err->message, sizeof(err->message), "Memory allocation failed");
-        free(values); free(types);
         return false;
     }
-    for (size_t i = 0; i < n_params; i++) {
-        values[i] = pg_bind_param_to_string(&params[i]);
-        switch (params[i].type) {
-            case DB_BIND_BOOL: types[i] = BOOLOID; break;
-            case DB_BIND_I64:  types[i] = INT8OID; break;
-            case DB_BIND_I32:  types[i] = INT4OID; break;
-            case DB_BIND_TIMESTAMP: types[i] = TIMESTAMPTZOID; break;
-            case DB_BIND_TEXT: types[i] = TEXTOID; break;
-            case DB_BIND_JSON: types[i] = JSONOID; break;
-            default: types[i] = 0; break; // Let PG infer
-        }
+    pg_lock(impl);
+    if (pg_tx_lost(impl, err)) {
+        pg_unlock(impl);
+        pg_params_free(&p);
+        return false;
     }
-    pthread_mutex_lock(&g_pg_mutex);
-    PGresult *res = PQexecParams(impl->conn, sql, n_params, types, (const char* const*)values, NULL, NULL, 0);
-    pthread_mutex_unlock(&g_pg_mutex);
-    for (size_t i = 0; i < n_params; i++)
-      free(values[i]);
-    free(values);
-    free(types);
+    PGresult *res = pg_run(impl, sql, &p);
+    pg_unlock(impl);
+    pg_params_free(&p);
     if (PQresultStatus(res) != PGRES_COMMAND_OK && PQresultStatus(res) != PGRES_TUPLES_OK) { pg_map_error(impl->conn, res, err); PQclear(res); return false; }
     if (out_rows) *out_rows = atoll(PQcmdTuples(res));
     PQclear(res); return true;
@@ -234,71 +633,29 @@ static bool pg_exec_insert_id_impl(db_t *db, const char *sql, const db_bind_t *p
         free_sql = true;
     }
 
-    char **values = calloc(n_params, sizeof(char*));
-    Oid *types = calloc(n_params, sizeof(Oid));
-    if ((!values || !types) && n_params > 0) {
+    pg_params_t p;
+    if (!pg_params_init(&p, params, n_params)) {
         err->code = ERR_DB_QUERY_FAILED;
         snprintf(err->message, sizeof(err->message), "Memory allocation failed");
         if (free_sql) free(sql_with_returning);
-        free(values); free(types);
         return false;
     }
-    for (size_t i = 0; i < n_params; i++) {
-        values[i] = pg_bind_param_to_string(&params[i]);
-        switch (params[i].type) {
-            case DB_BIND_BOOL: types[i] = BOOLOID; break;
-            case DB_BIND_I64:  types[i] = INT8OID; break;
-            case DB_BIND_I32:  types[i] = INT4OID; break;
-            case DB_BIND_TIMESTAMP: types[i] = TIMESTAMPTZOID; break;
-            case DB_BIND_TEXT: types[i] = TEXTOID; break;
-            case DB_BIND_JSON: types[i] = JSONOID; break;
-            default: types[i] = 0; break;
-        }
-    }
-    pthread_mutex_lock(&g_pg_mutex);
-    PGresult *res = PQexecParams(impl->conn, sql_with_returning, n_params, types, (const char* const*)values, NULL, NULL, 0);
-    pthread_mutex_unlock(&g_pg_mutex);
+    pg_lock(impl);
+    PGresult *res = pg_tx_lost(impl, err) ? NULL : pg_run(impl, sql_with_returning, &p);
+    pg_unlock(impl);
     
     if (free_sql) free(sql_with_returning);
 
-    for (size_t i = 0; i < n_params; i++)
-      free(values[i]);
-    free(values);
-    free(types);
+    pg_params_free(&p);
+    if (!res) return false;
     if (PQresultStatus(res) != PGRES_TUPLES_OK) { pg_map_error(impl->conn, res, err); PQclear(res); return false; }
-    if (out_id) *out_id = atoll(PQgetvalue(res, 0, 0));
+    if (out_id) *out_id = pg_get_i64(res, 0, 0);
     PQclear(res); return true;
 }
 
-static bool pg_query_impl(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err) {
+// Takes ownership of pg_res: a db_res_t on success, else maps the error.
+static bool pg_wrap_result(db_t *db, PGresult *pg_res, db_res_t **out_res, db_error_t *err) {
     db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
-    char **values = calloc(n_params, sizeof(char*));
-    Oid *types = calloc(n_params, sizeof(Oid));
-    if ((!values || !types) && n_params > 0) {
-        err->code = ERR_DB_QUERY_FAILED;
-        snprintf(err->message, sizeof(err->message), "Memory allocation failed");
-        free(values); free(types);
-        return false;
-    }
-    for (size_t i = 0; i < n_params; i++) {
-        values[i] = pg_bind_param_to_string(&params[i]);
-        switch (params[i].type) {
-            case DB_BIND_BOOL: types[i] = BOOLOID; break;
-            case DB_BIND_I64:  types[i] = INT8OID; break;
-            case DB_BIND_I32:  types[i] = INT4OID; break;
-            case DB_BIND_TIMESTAMP: types[i] = TIMESTAMPTZOID; break;
-            case DB_BIND_TEXT: types[i] = TEXTOID; break;
-            case DB_BIND_JSON: types[i] = JSONOID; break;
-            default: types[i] = 0; break;
-        }
-    }
-    pthread_mutex_lock(&g_pg_mutex);
-    PGresult *pg_res = PQexecParams(impl->conn, sql, n_params, types, (const char* const*)values, NULL, NULL, 0);
-    pthread_mutex_unlock(&g_pg_mutex);
-    for (size_t i = 0; i < n_params; i++)
-      free(values[i]);
-    free(values);
-    free(types);
     ExecStatusType status = PQresultStatus(pg_res);
     if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) { pg_map_error(impl->conn, pg_res, err); PQclear(pg_res); return false; }
     db_pg_res_impl_t *res_impl = calloc(1, sizeof(db_pg_res_impl_t));
@@ -321,14 +678,604 @@ static bool pg_query_impl(db_t *db, const char *sql, const db_bind_t *params, si
     *out_res = res; return true;
 }
 
+static bool pg_query_impl(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err) {
+    db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
+    pg_params_t p;
+    if (!pg_params_init(&p, params, n_params)) {
+        err->code = ERR_DB_QUERY_FAILED;
+        snprintf(err->message, sizeof(err->message), "Memory allocation failed");
+        return false;
+    }
+    pg_lock(impl);
+    if (pg_tx_lost(impl, err)) {
+        pg_unlock(impl);
+        pg_params_free(&p);
+        return false;
+    }
+    PGresult *pg_res = pg_run(impl, sql, &p);
+    pg_unlock(impl);
+    pg_params_free(&p);
+    return pg_wrap_result(db, pg_res, out_res, err);
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+// Statements per pipeline round. The connection is blocking and replies are
+// read only after the round is sent, so this bounds what the server has to
+// buffer for us.
+#define PG_BATCH_CHUNK 64
+
+typedef struct {
+    pg_params_t p;
+    int mode;                   // PG_BATCH_*
+    char name[16];              // statement being prepared (PG_BATCH_PREPARE)
+} pg_batch_slot_t;
+
+enum { PG_BATCH_PARAMS, PG_BATCH_PREPARED, PG_BATCH_PREPARE };
+
+// Queues one item: through the statement cache like pg_run, except that a
+// full cache is not evicted mid-pipeline (the item runs unprepared). Every
+// item ends with a sync so a failure does not abort the items after it.
+static bool pg_batch_send(db_pg_impl_t *impl, const db_batch_item_t *it, pg_batch_slot_t *sl) {
+    const pg_params_t *p = &sl->p;
+    int ok;
+
+    sl->mode = PG_BATCH_PARAMS;
+    if (impl->stmt_cap > 0 && strlen(it->sql) <= PG_STMT_SQL_MAX) {
+        uint64_t h = pg_stmt_hash(it->sql, p->n, p->types);
+        int i = pg_stmt_find(impl, it->sql, p, h);
+        pg_stmt_t *st = NULL;
+        if (i >= 0) {
+            st = &impl->stmts[i];
+            sl->mode = PG_BATCH_PREPARED;
+            atomic_fetch_add(&g_stmt_hits, 1);
+        } else {
+            atomic_fetch_add(&g_stmt_misses, 1);
+            if (impl->stmt_count < impl->stmt_cap && (st = pg_stmt_fill(impl, it->sql, p, h)) != NULL) {
+                sl->mode = PG_BATCH_PREPARE;
+                snprintf(sl->name, sizeof sl->name, "%s", st->name);
+                impl->stmt_count++;
+                if (!PQsendPrepare(impl->conn, st->name, it->sql, p->n, p->types)
+                    || !PQsendDescribePrepared(impl->conn, st->name)) {
+                    return false;
+                }
+            }
+        }
+        if (st) {
+            st->used = ++impl->stmt_tick;
+            ok = PQsendQueryPrepared(impl->conn, st->name, p->n, p->values, p->lengths, p->formats,
+                                     sl->mode == PG_BATCH_PREPARED && st->binary);
+            return ok && PQpipelineSync(impl->conn);
+        }
+    }
+    ok = PQsendQueryParams(impl->conn, it->sql, p->n, p->types, p->values, p->lengths, p->formats, 0);
+    return ok && PQpipelineSync(impl->conn);
+}
+
+// Next result of the current command, consuming the NULL that ends it
+static PGresult *pg_pipe_next(PGconn *conn) {
+    PGresult *r = PQgetResult(conn);
+    if (r && PQresultStatus(r) != PGRES_PIPELINE_SYNC) {
+        PGresult *end = PQgetResult(conn);
+        PQclear(end);
+    }
+    return r;
+}
+
+static void pg_batch_fail(db_batch_item_t *it, PGconn *conn) {
+    db_error_clear(&it->err);
+    it->err.code = ERR_DB_QUERY_FAILED;
+    snprintf(it->err.message, sizeof it->err.message, "%s", PQerrorMessage(conn));
+}
+
+// Reads back one item sent by pg_batch_send; false if the stream broke.
+static bool pg_batch_collect(db_t *db, db_pg_impl_t *impl, db_batch_item_t *it, const pg_batch_slot_t *sl) {
+    PGresult *prep_err = NULL, *r;
+
+    if (sl->mode == PG_BATCH_PREPARE) {
+        if (!(r = pg_pipe_next(impl->conn))) return false;
+        int i = -1;
+        for (int k = 0; k < impl->stmt_count; k++) {
+            if (strcmp(impl->stmts[k].name, sl->name) == 0) { i = k; break; }
+        }
+        if (PQresultStatus(r) == PGRES_COMMAND_OK) {
+            PQclear(r);
+            atomic_fetch_add(&g_stmt_prepares, 1);
+            if (!(r = pg_pipe_next(impl->conn))) return false;
+            if (i >= 0) impl->stmts[i].binary = PQresultStatus(r) == PGRES_COMMAND_OK && pg_types_binary_safe(r);
+            PQclear(r);
+        } else {
+            // The describe and execute behind it come back aborted
+            prep_err = r;
+            if (i >= 0) pg_stmt_remove(impl, i, false);
+            PQclear(pg_pipe_next(impl->conn));
+        }
+    }
+
+    if (!(r = pg_pipe_next(impl->conn))) { PQclear(prep_err); return false; }
+    if (prep_err) {
+        PQclear(r);
+        r = prep_err;
+    }
+    if (!pg_wrap_result(db, r, &it->res, &it->err)) it->res = NULL;
+
+    r = PQgetResult(impl->conn);
+    bool synced = r && PQresultStatus(r) == PGRES_PIPELINE_SYNC;
+    PQclear(r);
+    return synced;
+}
+
+static bool pg_batch_run_impl(db_t *db, db_batch_item_t *items, size_t n, db_error_t *err) {
+    db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
+    size_t chunk = n < PG_BATCH_CHUNK ? n : PG_BATCH_CHUNK;
+    pg_batch_slot_t *slots = calloc(chunk, sizeof(*slots));
+    if (!slots) {
+        err->code = ERR_DB_QUERY_FAILED;
+        snprintf(err->message, sizeof(err->message), "Memory allocation failed");
+        return false;
+    }
+
+    pg_lock(impl);
+    if (impl->tx_lost) {
+        for (size_t i = 0; i < n; i++) pg_tx_lost(impl, &items[i].err);
+        pg_unlock(impl);
+        free(slots);
+        return true;
+    }
+    bool broken = false;
+    for (size_t base = 0; base < n; base += chunk) {
+        size_t m = n - base < chunk ? n - base : chunk, sent = 0, done = 0;
+
+        if (broken || !PQenterPipelineMode(impl->conn)) {
+            for (size_t i = base; i < base + m; i++) pg_batch_fail(&items[i], impl->conn);
+            broken = true;
+            continue;
+        }
+        for (; sent < m; sent++) {
+            if (!pg_params_init(&slots[sent].p, items[base + sent].params, items[base + sent].n_params)) break;
+            if (!pg_batch_send(impl, &items[base + sent], &slots[sent])) {
+                pg_params_free(&slots[sent].p);
+                broken = true;
+                break;
+            }
+        }
+        if (!broken && sent > 0) {
+            for (; done < sent; done++) {
+                if (!pg_batch_collect(db, impl, &items[base + done], &slots[done])) {
+                    broken = true;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < sent; i++) pg_params_free(&slots[i].p);
+        for (size_t i = base + done; i < base + m; i++) {
+            if (!items[i].res) pg_batch_fail(&items[i], impl->conn);
+        }
+        if (broken || !PQexitPipelineMode(impl->conn)) {
+            // Out of step with the server: start over on a fresh session,
+            // once any open transaction has ended
+            pg_conn_lost(impl);
+            broken = true;
+        }
+    }
+    pg_unlock(impl);
+    free(slots);
+    return true;
+}
+#endif
+
+// Bulk load via COPY ... FROM STDIN (FORMAT binary). The column types are
+// read from the catalog up front so each bind is encoded the way the column
+// expects; rows are buffered and handed to libpq PG_COPY_FLUSH bytes at a
+// time. The connection stays busy, and pg_lock held, until copy_end.
+#define PG_COPY_FLUSH (64 * 1024)
+
+typedef struct {
+    Oid *types;                 // per COPY column
+    char *buf;
+    size_t len, cap;
+} pg_copy_t;
+
+static bool pg_copy_type_ok(Oid t) {
+    switch (t) {
+        case BOOLOID: case BYTEAOID: case NAMEOID: case INT8OID: case INT2OID:
+        case INT4OID: case TEXTOID: case OIDOID: case JSONOID: case FLOAT4OID:
+        case FLOAT8OID: case BPCHAROID: case VARCHAROID: case TIMESTAMPOID:
+        case TIMESTAMPTZOID: case JSONBOID:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool pg_copy_put(pg_copy_t *pc, const void *data, size_t n) {
+    if (pc->len + n > pc->cap) {
+        size_t cap = pc->cap ? pc->cap : PG_COPY_FLUSH;
+        while (cap < pc->len + n) cap *= 2;
+        char *buf = realloc(pc->buf, cap);
+        if (!buf) return false;
+        pc->buf = buf;
+        pc->cap = cap;
+    }
+    memcpy(pc->buf + pc->len, data, n);
+    pc->len += n;
+    return true;
+}
+
+static bool pg_copy_put32(pg_copy_t *pc, uint32_t v) {
+    v = htobe32(v);
+    return pg_copy_put(pc, &v, 4);
+}
+
+// One field: length word, then the column type's binary form. False if the
+// bind cannot be stored in a column of that type (or out of memory).
+static bool pg_copy_field(pg_copy_t *pc, Oid type, const db_bind_t *b) {
+    int64_t iv = 0;
+    bool is_int = true;
+    switch (b->type) {
+        case DB_BIND_NULL: return pg_copy_put32(pc, (uint32_t)-1);
+        case DB_BIND_I64: iv = b->v.i64; break;
+        case DB_BIND_U64: iv = (int64_t)b->v.u64; break;
+        case DB_BIND_I32: iv = b->v.i32; break;
+        case DB_BIND_U32: iv = b->v.u32; break;
+        case DB_BIND_BOOL: iv = b->v.b; break;
+        case DB_BIND_TIMESTAMP: iv = b->v.timestamp; break;
+        default: is_int = false; break;
+    }
+
+    char bin[8];
+    switch (type) {
+        case INT2OID: {
+            if (!is_int || iv < INT16_MIN || iv > INT16_MAX) return false;
+            uint16_t v = htobe16((uint16_t)iv);
+            return pg_copy_put32(pc, 2) && pg_copy_put(pc, &v, 2);
+        }
+        case INT4OID: case OIDOID:
+            if (!is_int || iv < (type == OIDOID ? 0 : INT32_MIN) || iv > (type == OIDOID ? (int64_t)UINT32_MAX : INT32_MAX)) return false;
+            return pg_copy_put32(pc, 4) && pg_copy_put32(pc, (uint32_t)iv);
+        case INT8OID:
+            if (!is_int) return false;
+            pg_put_be64(bin, (uint64_t)iv);
+            return pg_copy_put32(pc, 8) && pg_copy_put(pc, bin, 8);
+        case BOOLOID:
+            if (!is_int) return false;
+            bin[0] = iv != 0;
+            return pg_copy_put32(pc, 1) && pg_copy_put(pc, bin, 1);
+        case FLOAT4OID: {
+            if (!is_int) return false;
+            float f = (float)iv;
+            uint32_t u;
+            memcpy(&u, &f, 4);
+            return pg_copy_put32(pc, 4) && pg_copy_put32(pc, u);
+        }
+        case FLOAT8OID: {
+            if (!is_int) return false;
+            double d = (double)iv;
+            uint64_t u;
+            memcpy(&u, &d, 8);
+            pg_put_be64(bin, u);
+            return pg_copy_put32(pc, 8) && pg_copy_put(pc, bin, 8);
+        }
+        case TIMESTAMPOID: case TIMESTAMPTZOID:
+            if (!is_int) return false;
+            pg_put_be64(bin, (uint64_t)((iv - PG_EPOCH_UNIX) * 1000000LL));
+            return pg_copy_put32(pc, 8) && pg_copy_put(pc, bin, 8);
+        case BYTEAOID:
+            if (b->type != DB_BIND_BLOB) return false;
+            return pg_copy_put32(pc, (uint32_t)b->v.blob.len) && pg_copy_put(pc, b->v.blob.ptr, b->v.blob.len);
+        default: {
+            // Text-like columns; jsonb's binary form is a version byte and the text
+            bool json = type == JSONOID || type == JSONBOID;
+            if (b->type != (json ? DB_BIND_JSON : DB_BIND_TEXT)) return false;
+            if (!b->v.text.ptr) return pg_copy_put32(pc, (uint32_t)-1);
+            size_t n = b->v.text.len > 0 ? b->v.text.len : strlen(b->v.text.ptr);
+            if (type == JSONBOID) {
+                bin[0] = 1;
+                return pg_copy_put32(pc, (uint32_t)n + 1) && pg_copy_put(pc, bin, 1) && pg_copy_put(pc, b->v.text.ptr, n);
+            }
+            return pg_copy_put32(pc, (uint32_t)n) && pg_copy_put(pc, b->v.text.ptr, n);
+        }
+    }
+}
+
+static bool pg_copy_flush(db_pg_impl_t *impl, pg_copy_t *pc, db_error_t *err) {
+    if (pc->len == 0) return true;
+    if (PQputCopyData(impl->conn, pc->buf, (int)pc->len) != 1) {
+        pg_map_error(impl->conn, NULL, err);
+        return false;
+    }
+    pc->len = 0;
+    return true;
+}
+
+static void pg_copy_free(pg_copy_t *pc) {
+    if (!pc) return;
+    free(pc->types);
+    free(pc->buf);
+    free(pc);
+}
+
+// Fills pc->types from the catalog; names were checked by db_copy_begin.
+static bool pg_copy_load_types(db_pg_impl_t *impl, pg_copy_t *pc, const char *table, const char *const *cols, size_t n_cols, db_error_t *err) {
+    char sql[512];
+    snprintf(sql, sizeof(sql),
+             "SELECT attname, atttypid FROM pg_catalog.pg_attribute "
+             "WHERE attrelid = '%s'::regclass AND attnum > 0 AND NOT attisdropped", table);
+    PGresult *r = PQexec(impl->conn, sql);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+        pg_map_error(impl->conn, r, err);
+        PQclear(r);
+        return false;
+    }
+    for (size_t i = 0; i < n_cols; i++) {
+        pc->types[i] = 0;
+        for (int row = 0; row < PQntuples(r); row++) {
+            if (strcasecmp(PQgetvalue(r, row, 0), cols[i]) == 0) {
+                pc->types[i] = (Oid)strtoul(PQgetvalue(r, row, 1), NULL, 10);
+                break;
+            }
+        }
+        if (!pg_copy_type_ok(pc->types[i])) {
+            if (err) {
+                db_error_clear(err);
+                err->code = ERR_DB_QUERY_FAILED;
+                snprintf(err->message, sizeof(err->message), "COPY %s: column %s is missing or of a type COPY cannot bind", table, cols[i]);
+            }
+            PQclear(r);
+            return false;
+        }
+    }
+    PQclear(r);
+    return true;
+}
+
+static bool pg_copy_begin_impl(db_copy_t *c, const char *table, const char *const *cols, size_t n_cols, db_error_t *err) {
+    db_pg_impl_t *impl = (db_pg_impl_t*)c->db->impl;
+    pg_copy_t *pc = calloc(1, sizeof(*pc));
+    if (pc) pc->types = calloc(n_cols, sizeof(Oid));
+    if (!pc || !pc->types) goto oom;
+
+    pg_lock(impl);
+    if (pg_tx_lost(impl, err) || !pg_copy_load_types(impl, pc, table, cols, n_cols, err)) goto fail;
+
+    size_t cap = strlen(table) + 64;
+    for (size_t i = 0; i < n_cols; i++) cap += strlen(cols[i]) + 2;
+    char *sql = malloc(cap);
+    if (!sql) {
+        pg_unlock(impl);
+        goto oom;
+    }
+    size_t len = (size_t)snprintf(sql, cap, "COPY %s (", table);
+    for (size_t i = 0; i < n_cols; i++) len += (size_t)snprintf(sql + len, cap - len, "%s%s", i ? ", " : "", cols[i]);
+    snprintf(sql + len, cap - len, ") FROM STDIN (FORMAT binary)");
+    PGresult *r = PQexec(impl->conn, sql);
+    free(sql);
+    if (PQresultStatus(r) != PGRES_COPY_IN) {
+        pg_map_error(impl->conn, r, err);
+        PQclear(r);
+        goto fail;
+    }
+    PQclear(r);
+
+    // Signature, flags, header extension length
+    static const char hdr[19] = "PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0";
+    if (!pg_copy_put(pc, hdr, sizeof(hdr))) {
+        PQputCopyEnd(impl->conn, "out of memory");
+        while ((r = PQgetResult(impl->conn)) != NULL) PQclear(r);
+        pg_unlock(impl);
+        goto oom;
+    }
+    c->impl = pc;
+    return true;
+
+oom:
+    if (err) {
+        err->code = ERR_DB_QUERY_FAILED;
+        snprintf(err->message, sizeof(err->message), "Memory allocation failed");
+    }
+    pg_copy_free(pc);
+    return false;
+
+fail:
+    if (PQstatus(impl->conn) == CONNECTION_BAD) pg_conn_lost(impl);
+    pg_unlock(impl);
+    pg_copy_free(pc);
+    return false;
+}
+
+static bool pg_copy_row_impl(db_copy_t *c, const db_bind_t *vals, db_error_t *err) {
+    db_pg_impl_t *impl = (db_pg_impl_t*)c->db->impl;
+    pg_copy_t *pc = c->impl;
+    size_t mark = pc->len;
+    uint16_t nf = htobe16((uint16_t)c->n_cols);
+    bool ok = pg_copy_put(pc, &nf, 2);
+    for (size_t i = 0; ok && i < c->n_cols; i++) {
+        if (!pg_copy_field(pc, pc->types[i], &vals[i])) {
+            if (err) {
+                db_error_clear(err);
+                err->code = ERR_DB_QUERY_FAILED;
+                snprintf(err->message, sizeof(err->message), "COPY: value %zu does not fit its column", i + 1);
+            }
+            ok = false;
+        }
+    }
+    if (!ok) {
+        pc->len = mark;
+        return false;
+    }
+    return pc->len < PG_COPY_FLUSH || pg_copy_flush(impl, pc, err);
+}
+
+static bool pg_copy_end_impl(db_copy_t *c, bool commit, int64_t *out_rows, db_error_t *err) {
+    db_pg_impl_t *impl = (db_pg_impl_t*)c->db->impl;
+    pg_copy_t *pc = c->impl;
+    static const char trailer[2] = { '\xff', '\xff' };
+    bool ok = commit && pg_copy_put(pc, trailer, 2) && pg_copy_flush(impl, pc, err);
+
+    if (PQputCopyEnd(impl->conn, ok ? NULL : "load cancelled") != 1 && ok) {
+        pg_map_error(impl->conn, NULL, err);
+        ok = false;
+    }
+    PGresult *r;
+    bool seen = false;
+    while ((r = PQgetResult(impl->conn)) != NULL) {
+        if (!seen && ok) {
+            if (PQresultStatus(r) == PGRES_COMMAND_OK) {
+                if (out_rows) *out_rows = atoll(PQcmdTuples(r));
+            } else {
+                pg_map_error(impl->conn, r, err);
+                ok = false;
+            }
+        }
+        seen = true;
+        PQclear(r);
+    }
+    if (PQstatus(impl->conn) == CONNECTION_BAD) pg_conn_lost(impl);
+    pg_unlock(impl);
+    pg_copy_free(pc);
+    c->impl = NULL;
+    return ok;
+}
+
+// Streamed queries: rows arrive a few at a time (chunked rows mode where
+// libpq has it, else one per PGresult) and db_res_step() fetches the next
+// batch when the current one runs out. The connection stays busy, and
+// pg_lock held, until the last row is read or the result is finalized.
+#define PG_STREAM_CHUNK_ROWS 256
+
+static void pg_res_finalize_impl(db_res_t *res);
+
+static bool pg_res_is_rows(const PGresult *r) {
+    ExecStatusType st = PQresultStatus(r);
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    if (st == PGRES_TUPLES_CHUNK) return true;
+#endif
+    return st == PGRES_SINGLE_TUPLE;
+}
+
+// Reads and discards whatever the server still has for this query, then
+// releases the connection.
+static void pg_stream_end(db_pg_res_impl_t *ri) {
+    db_pg_impl_t *impl = ri->stream;
+    PGresult *r;
+    while ((r = PQgetResult(impl->conn)) != NULL) PQclear(r);
+    if (PQstatus(impl->conn) == CONNECTION_BAD) pg_conn_lost(impl);
+    ri->stream = NULL;
+    pg_unlock(impl);
+}
+
+// Replaces the exhausted batch with the next one; false at the end of the
+// rows or on error (err set).
+static bool pg_stream_next(db_res_t *res, db_error_t *err) {
+    db_pg_res_impl_t *ri = (db_pg_res_impl_t*)res->impl;
+    PGresult *r = PQgetResult(ri->stream->conn);
+
+    if (r && pg_res_is_rows(r)) {
+        PQclear(ri->pg_res);
+        ri->pg_res = r;
+        res->num_rows = PQntuples(r);
+        res->current_row = 0;
+        return true;
+    }
+    if (r) {
+        ExecStatusType st = PQresultStatus(r);
+        if (st != PGRES_TUPLES_OK && st != PGRES_COMMAND_OK) pg_map_error(ri->stream->conn, r, err);
+        // Keep the final (row-less) result so column metadata stays valid
+        PQclear(ri->pg_res);
+        ri->pg_res = r;
+    }
+    pg_stream_end(ri);
+    res->num_rows = 0;
+    res->current_row = 0;
+    return false;
+}
+
+static bool pg_query_stream_impl(db_t *db, const char *sql, const db_bind_t *params, size_t n_params, db_res_t **out_res, db_error_t *err) {
+    db_pg_impl_t *impl = (db_pg_impl_t*)db->impl;
+    pg_params_t p;
+    if (!pg_params_init(&p, params, n_params)) {
+        err->code = ERR_DB_QUERY_FAILED;
+        snprintf(err->message, sizeof(err->message), "Memory allocation failed");
+        return false;
+    }
+
+    // Reuse a cached prepared statement if there is one; a miss runs
+    // unprepared rather than paying for a prepare round trip up front.
+    pg_lock(impl);
+    if (pg_tx_lost(impl, err)) {
+        pg_unlock(impl);
+        pg_params_free(&p);
+        return false;
+    }
+    int sent, i = -1;
+    if (impl->stmt_cap > 0 && strlen(sql) <= PG_STMT_SQL_MAX) {
+        i = pg_stmt_find(impl, sql, &p, pg_stmt_hash(sql, p.n, p.types));
+    }
+    if (i >= 0) {
+        pg_stmt_t *st = &impl->stmts[i];
+        atomic_fetch_add(&g_stmt_hits, 1);
+        st->used = ++impl->stmt_tick;
+        sent = PQsendQueryPrepared(impl->conn, st->name, p.n, p.values, p.lengths, p.formats, st->binary);
+    } else {
+        sent = PQsendQueryParams(impl->conn, sql, p.n, p.types, p.values, p.lengths, p.formats, 0);
+    }
+    pg_params_free(&p);
+    if (!sent) {
+        pg_map_error(impl->conn, NULL, err);
+        if (PQstatus(impl->conn) == CONNECTION_BAD) pg_conn_lost(impl);
+        pg_unlock(impl);
+        return false;
+    }
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    PQsetChunkedRowsMode(impl->conn, PG_STREAM_CHUNK_ROWS);
+#else
+    PQsetSingleRowMode(impl->conn);
+#endif
+
+    db_pg_res_impl_t *ri = calloc(1, sizeof(*ri));
+    db_res_t *res = calloc(1, sizeof(*res));
+    if (!ri || !res) {
+        free(ri);
+        free(res);
+        db_pg_res_impl_t tmp = { .stream = impl };
+        pg_stream_end(&tmp);
+        err->code = ERR_DB_QUERY_FAILED;
+        snprintf(err->message, sizeof(err->message), "Memory allocation failed");
+        return false;
+    }
+    ri->stream = impl;
+    res->db = db;
+    res->impl = ri;
+
+    // The first batch tells us whether the query failed and what the
+    // columns are; hand it out as the current one, before the first row.
+    db_error_clear(err);
+    bool rows = pg_stream_next(res, err);
+    if (!rows && err->code != 0) {
+        pg_res_finalize_impl(res);
+        return false;
+    }
+    res->num_cols = ri->pg_res ? PQnfields(ri->pg_res) : 0;
+    res->current_row = -1;
+    *out_res = res;
+    return true;
+}
+
 static bool pg_res_step_impl(db_res_t *res, db_error_t *err) {
-    (void)err; res->current_row++; return (res->current_row < res->num_rows);
+    res->current_row++;
+    if (res->current_row < res->num_rows) return true;
+    db_pg_res_impl_t *ri = (db_pg_res_impl_t*)res->impl;
+    return ri->stream && pg_stream_next(res, err) && res->num_rows > 0;
 }
 
 static void pg_res_finalize_impl(db_res_t *res) {
     if (!res) return;
     db_pg_res_impl_t *impl = (db_pg_res_impl_t*)res->impl;
-    if (impl) { PQclear(impl->pg_res); free(impl); }
+    if (impl) {
+        if (impl->stream) pg_stream_end(impl);
+        PQclear(impl->pg_res);
+        free(impl->scratch);
+        free(impl);
+    }
     free(res);
 }
 
@@ -357,32 +1304,69 @@ static bool pg_res_col_is_null_impl(const db_res_t *res, int col_idx) {
 
 static bool pg_res_col_bool_impl(const db_res_t *res, int col_idx, db_error_t *err) {
     (void)err;
-    const char *val = PQgetvalue(((db_pg_res_impl_t*)res->impl)->pg_res, res->current_row, col_idx);
+    const PGresult *r = ((db_pg_res_impl_t*)res->impl)->pg_res;
+    int64_t i; double d;
+    if (pg_bin_int(r, res->current_row, col_idx, &i)) return i != 0;
+    if (pg_bin_float(r, res->current_row, col_idx, &d)) return d != 0.0;
+    const char *val = PQgetvalue(r, res->current_row, col_idx);
     if (!val) return false;
     return (val[0] == 't' || val[0] == '1' || val[0] == 'T' || strcasecmp(val, "true") == 0);
 }
 
 static int64_t pg_res_col_i64_impl(const db_res_t *res, int col_idx, db_error_t *err) {
     (void)err;
-    const char *val = PQgetvalue(((db_pg_res_impl_t*)res->impl)->pg_res, res->current_row, col_idx);
-    if (!val) return 0;
-    if (val[0] == 't') return 1;
-    if (val[0] == 'f') return 0;
-    return atoll(val);
+    return pg_get_i64(((db_pg_res_impl_t*)res->impl)->pg_res, res->current_row, col_idx);
 }
 static int32_t pg_res_col_i32_impl(const db_res_t *res, int col_idx, db_error_t *err) {
     (void)err;
-    const char *val = PQgetvalue(((db_pg_res_impl_t*)res->impl)->pg_res, res->current_row, col_idx);
+    const PGresult *r = ((db_pg_res_impl_t*)res->impl)->pg_res;
+    int64_t i; double d;
+    if (pg_bin_int(r, res->current_row, col_idx, &i)) return (int32_t)i;
+    if (pg_bin_float(r, res->current_row, col_idx, &d)) return (int32_t)d;
+    const char *val = PQgetvalue(r, res->current_row, col_idx);
     if (!val) return 0;
     if (val[0] == 't') return 1;
     if (val[0] == 'f') return 0;
     return atoi(val);
 }
 static double pg_res_col_double_impl(const db_res_t *res, int col_idx, db_error_t *err) {
-    (void)err; return atof(PQgetvalue(((db_pg_res_impl_t*)res->impl)->pg_res, res->current_row, col_idx));
+    (void)err;
+    const PGresult *r = ((db_pg_res_impl_t*)res->impl)->pg_res;
+    int64_t i; double d;
+    if (pg_bin_float(r, res->current_row, col_idx, &d)) return d;
+    if (pg_bin_int(r, res->current_row, col_idx, &i)) return (double)i;
+    return atof(PQgetvalue(r, res->current_row, col_idx));
 }
 static const char* pg_res_col_text_impl(const db_res_t *res, int col_idx, db_error_t *err) {
-    (void)err; return PQgetvalue(((db_pg_res_impl_t*)res->impl)->pg_res, res->current_row, col_idx);
+    (void)err;
+    db_pg_res_impl_t *impl = (db_pg_res_impl_t*)res->impl;
+    const PGresult *r = impl->pg_res;
+    int row = res->current_row;
+    int64_t i = 0; double d = 0.0;
+    bool is_int = false;
+
+    // Text-like types are byte-identical in binary; numbers need formatting
+    if (PQgetisnull(r, row, col_idx)
+        || !((is_int = pg_bin_int(r, row, col_idx, &i)) || pg_bin_float(r, row, col_idx, &d))) {
+        return PQgetvalue(r, row, col_idx);
+    }
+    if (!impl->scratch) {
+        impl->scratch = calloc(res->num_cols, sizeof(*impl->scratch));
+        if (!impl->scratch) return NULL;
+    }
+    char *buf = impl->scratch[col_idx];
+    size_t cap = sizeof(impl->scratch[0]);
+    if (is_int && PQftype(r, col_idx) == BOOLOID) {
+        snprintf(buf, cap, "%s", i ? "t" : "f");
+    } else if (is_int) {
+        snprintf(buf, cap, "%lld", (long long)i);
+    } else {
+        // Shortest form that reads back exactly, like the server's output
+        int prec = PQftype(r, col_idx) == FLOAT4OID ? 6 : 15;
+        snprintf(buf, cap, "%.*g", prec, d);
+        if (strtod(buf, NULL) != d) snprintf(buf, cap, "%.*g", prec + 3, d);
+    }
+    return buf;
 }
 
 static bool
@@ -406,10 +1390,15 @@ pg_ship_repair_atomic(db_t *db,
       }
       return false;
   }
-  pthread_mutex_lock(&g_pg_mutex);
+  pg_lock(impl);
+  if (pg_tx_lost(impl, err))
+    {
+      pg_unlock(impl);
+      return false;
+    }
   if (PQstatus(conn) != CONNECTION_OK)
     {
-      pthread_mutex_unlock(&g_pg_mutex);
+      pg_unlock(impl);
       if (err) {
         pg_map_error(conn, NULL, err);
       }
@@ -440,7 +1429,7 @@ pg_ship_repair_atomic(db_t *db,
   const char *params[3] = { p1, p2, p3 };
 
   PGresult *res = PQexecParams(conn, sql, 3, NULL, params, NULL, NULL, 0);
-  pthread_mutex_unlock(&g_pg_mutex);
+  pg_unlock(impl);
   if (!res || (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1))
     {
       pg_map_error(conn, res, err);
@@ -506,6 +1495,8 @@ static void pg_close_child_impl(db_t *db) {
             // closed FD, fail (EBADF), and just clean up the memory.
             PQfinish(impl->conn);
         }
+        pg_stmt_free_all(impl);
+        free(impl->stmts);
         free(impl);
     }
 }
@@ -516,7 +1507,14 @@ static const db_vt_t pg_vt = {
     .tx_begin = pg_tx_begin_impl, .tx_commit = pg_tx_commit_impl, .tx_rollback = pg_tx_rollback_impl,
     .exec = pg_exec_impl, .exec_rows_affected = pg_exec_rows_affected_impl, .exec_insert_id = pg_exec_insert_id_impl,
     .query = pg_query_impl,
+    .query_stream = pg_query_stream_impl,
     .exec_returning = pg_exec_returning_impl,
+#ifdef LIBPQ_HAS_PIPELINING
+    .batch_run = pg_batch_run_impl,
+#endif
+    .copy_begin = pg_copy_begin_impl,
+    .copy_row = pg_copy_row_impl,
+    .copy_end = pg_copy_end_impl,
     .res_step = pg_res_step_impl, .res_finalize = pg_res_finalize_impl, .res_cancel = pg_res_cancel_impl,
     .res_col_count = pg_res_col_count_impl, .res_col_name = pg_res_col_name_impl, .res_col_type = pg_res_col_type_impl,
     .res_col_is_null = pg_res_col_is_null_impl,
@@ -527,16 +1525,19 @@ static const db_vt_t pg_vt = {
 };
 
 void* db_pg_open_internal(db_t *parent_db, const db_config_t *cfg, db_error_t *err) {
-    pthread_mutex_lock(&g_pg_mutex);
+    // Serialization is opt-in; a non-thread-safe libpq forces it on.
+    db_pg_impl_t probe = { .serialize = cfg->pg_serialize || !PQisthreadsafe() };
+
+    pg_lock(&probe);
     PGconn *conn = PQconnectdb(cfg->pg_conninfo);
-    pthread_mutex_unlock(&g_pg_mutex);
+    pg_unlock(&probe);
     if (PQstatus(conn) != CONNECTION_OK) { pg_map_error(conn, NULL, err); if (conn) PQfinish(conn); return NULL; }
 
     /* Suppress NOTICE messages (e.g. "relation already exists, skipping") */
-    pthread_mutex_lock(&g_pg_mutex);
+    pg_lock(&probe);
     PGresult *res_quiet = PQexec(conn, "SET client_min_messages TO WARNING");
     if (res_quiet) PQclear(res_quiet);
-    pthread_mutex_unlock(&g_pg_mutex);
+    pg_unlock(&probe);
 
     db_pg_impl_t *impl = calloc(1, sizeof(db_pg_impl_t));
     if (!impl) {
@@ -546,8 +1547,16 @@ void* db_pg_open_internal(db_t *parent_db, const db_config_t *cfg, db_error_t *e
         return NULL;
     }
     impl->conn = conn;
+    impl->serialize = probe.serialize;
+    impl->stmt_cap = cfg->pg_stmt_cache_size == 0 ? PG_STMT_CACHE_DEFAULT
+                   : (cfg->pg_stmt_cache_size < 0 ? 0 : cfg->pg_stmt_cache_size);
+    if (impl->stmt_cap > 0) {
+        impl->stmts = calloc(impl->stmt_cap, sizeof(pg_stmt_t));
+        if (!impl->stmts) impl->stmt_cap = 0;
+    }
+    if (impl->serialize && !cfg->pg_serialize) {
+        LOGW("libpq is not thread-safe; serializing PostgreSQL calls process-wide.");
+    }
     parent_db->vt = &pg_vt;
     return impl;
 }
-
-
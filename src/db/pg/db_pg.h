@@ -4,5 +4,6 @@
 #include "../db_api.h"
 
 void *db_pg_open_internal(db_t *db, const db_config_t *cfg, db_error_t *err);
+void db_pg_stmt_cache_stats(db_stmt_cache_stats_t *out);
 
 #endif /* DB_PG_H */
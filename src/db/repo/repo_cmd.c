@@ -18,6 +18,7 @@
 #include "errors.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "warp_graph.h"
 
 
 /* ==================================================================== */
@@ -3000,6 +3001,23 @@ cleanup:
 }
 
 
+/* Sector view reads, shared by the single-query helpers below and
+   db_sector_scan_json() */
+static const char *SQL_SECTOR_BASIC =
+  "SELECT sector_id, name, beacon FROM sectors WHERE sector_id = {1};";
+static const char *SQL_SECTOR_ADJACENT =
+  "SELECT to_sector FROM sector_warps WHERE from_sector = {1};";
+static const char *SQL_SECTOR_PORTS =
+  "SELECT port_id, name, type FROM ports WHERE sector_id = {1};";
+static const char *SQL_SECTOR_SHIPS =
+  "SELECT ship_id, name FROM ships WHERE sector_id = {1};";
+static const char *SQL_SECTOR_PLANETS =
+  "SELECT planet_id, name, type FROM planets WHERE sector_id = {1};";
+static const char *SQL_SECTOR_ASSETS =
+  "SELECT asset_type, SUM(quantity) AS quantity FROM sector_assets "
+  "WHERE sector_id = {1} GROUP BY asset_type;";
+
+
 int
 db_sector_basic_json (db_t *db, int sid, json_t **out)
 {
@@ -3012,7 +3030,7 @@ db_sector_basic_json (db_t *db, int sid, json_t **out)
   int rc = -1;
 
 
-  const char *sql_template = "SELECT sector_id, name, beacon FROM sectors WHERE sector_id = {1};";
+  const char *sql_template = SQL_SECTOR_BASIC;
   char sql[256];
   sql_build(db, sql_template, sql, sizeof sql);
 
@@ -3055,7 +3073,7 @@ db_adjacent_sectors_json (db_t *db, int sid, json_t **out)
   int rc = -1;
 
 
-  const char *sql_template = "SELECT to_sector FROM sector_warps WHERE from_sector = {1};";
+  const char *sql_template = SQL_SECTOR_ADJACENT;
   char sql[256];
   sql_build(db, sql_template, sql, sizeof sql);
 
@@ -3089,7 +3107,7 @@ db_ports_at_sector_json (db_t *db, int sid, json_t **out)
   int rc = -1;
 
 
-  const char *sql_template = "SELECT port_id, name, type FROM ports WHERE sector_id = {1};";
+  const char *sql_template = SQL_SECTOR_PORTS;
   char sql[256];
   sql_build(db, sql_template, sql, sizeof sql);
 
@@ -3122,7 +3140,7 @@ db_ships_at_sector_json (db_t *db, int pid, int sid, json_t **out)
   db_error_t err = {0};
   int rc = -1;
 
-  const char *sql_template = "SELECT ship_id, name FROM ships WHERE sector_id = {1};";
+  const char *sql_template = SQL_SECTOR_SHIPS;
   char sql[256];
   sql_build(db, sql_template, sql, sizeof sql);
 
@@ -3152,7 +3170,7 @@ db_planets_at_sector_json (db_t *db, int sid, json_t **out)
   db_error_t err = {0};
   int rc = -1;
 
-  const char *sql_template = "SELECT planet_id, name, type FROM planets WHERE sector_id = {1};";
+  const char *sql_template = SQL_SECTOR_PLANETS;
   char sql[256];
   sql_build(db, sql_template, sql, sizeof sql);
 
@@ -3174,6 +3192,67 @@ cleanup:
 }
 
 
+int
+db_sector_scan_json (db_t *db, int sid, db_sector_scan_t *out)
+{
+  if (!db || !out)
+    {
+      return -1;
+    }
+  memset (out, 0, sizeof (*out));
+
+  const char *sqls[] = {
+    SQL_SECTOR_BASIC, SQL_SECTOR_ADJACENT, SQL_SECTOR_SHIPS,
+    SQL_SECTOR_PORTS, SQL_SECTOR_PLANETS, SQL_SECTOR_ASSETS
+  };
+  json_t **dst[] = {
+    &out->basic, &out->adjacent, &out->ships,
+    &out->ports, &out->planets, &out->assets
+  };
+  int idx[6];
+  db_bind_t params[] = { db_bind_i64 (sid) };
+  db_error_t err = {0};
+  db_batch_t *b = db_batch_new (db);
+
+  if (!b)
+    {
+      return ERR_NOMEM;
+    }
+  for (int i = 0; i < 6; i++)
+    {
+      idx[i] = db_batch_add (b, sqls[i], params, 1);
+    }
+  if (!db_batch_run (b, &err))
+    {
+      db_batch_free (b);
+      return err.code ? err.code : -1;
+    }
+
+  for (int i = 0; i < 6; i++)
+    {
+      db_res_t *res;
+
+      db_error_clear (&err);
+      if (idx[i] >= 0 && (res = db_batch_result (b, idx[i], &err)) != NULL)
+        {
+          stmt_to_json_array (res, dst[i], &err);
+        }
+    }
+  db_batch_free (b);
+
+  /* basic is the sector row itself, not a list */
+  if (out->basic)
+    {
+      json_t *row = json_array_get (out->basic, 0);
+
+      json_incref (row);
+      json_decref (out->basic);
+      out->basic = row;
+    }
+  return 0;
+}
+
+
 int
 db_players_at_sector_json (db_t *db, int sid, json_t **out)
 {
@@ -4650,6 +4729,7 @@ db_chain_traps_and_bridge (db_t *db, int fedspace_max)
            (db_bind_t[]){ db_bind_i64 (traps[0]), db_bind_i64 (anchor) },
            2,
            &err);
+  db_on_commit (db, warp_graph_invalidate);
 
 
   free (traps);
@@ -27,6 +27,21 @@ int db_players_at_sector_json (db_t *db, int sector_id, json_t **out_array);
 int db_beacons_at_sector_json (db_t *db, int sector_id, json_t **out_array);
 int db_planets_at_sector_json (db_t *db, int sector_id, json_t **out_array);
 
+/* Everything a sector scan shows, read in one db_batch (a single round trip
+   on PostgreSQL). Members whose query failed are NULL; the caller owns the
+   rest. */
+typedef struct
+{
+  json_t *basic;		/* {sector_id, name, beacon} */
+  json_t *adjacent;		/* [{to_sector}] */
+  json_t *ships;		/* [{ship_id, name}] */
+  json_t *ports;		/* [{port_id, name, type}] */
+  json_t *planets;		/* [{planet_id, name, type}] */
+  json_t *assets;		/* [{asset_type, quantity}] */
+} db_sector_scan_t;
+
+int db_sector_scan_json (db_t *db, int sector_id, db_sector_scan_t *out);
+
 int db_player_set_sector (int player_id, int sector_id);
 
 int db_player_set_alignment (db_t *db, int player_id, int alignment);
@@ -6,8 +6,10 @@
 #include <time.h>
 #include <jansson.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "globals.h"
 #include "repo_cron.h"
+#include "server_log.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
 
@@ -315,6 +317,52 @@ db_cron_reset_turns_for_all_players (db_t *db, int max_turns, int64_t now_s, int
 
 
 
+/* On PostgreSQL cron locks are session advisory locks keyed by
+   (CRON_LOCK_CLASS, hash of the task name): one statement to take or drop,
+   nothing written, and a lock held by a dead connection goes with it. Other
+   backends use the locks table with a TTL. Holders show up in pg_locks
+   (locktype 'advisory', classid/objid as below, objsubid 2). */
+#define CRON_LOCK_CLASS 0x54570001	/* keeps clear of other advisory lock users */
+
+static int32_t
+cron_lock_key (const char *name)
+{
+  uint32_t h = 2166136261u;
+
+  for (const unsigned char *p = (const unsigned char *) name; *p; p++)
+    {
+      h ^= *p;
+      h *= 16777619u;
+    }
+  return (int32_t) (h & 0x7fffffff);	/* non-negative, so it reads as an oid */
+}
+
+
+/* SELECT fn(class, key): 1 or 0 from its boolean result, -1 on error */
+static int
+cron_advisory (db_t *db, const char *fn, const char *name)
+{
+  char tmpl[128], sql[128];
+  snprintf (tmpl, sizeof (tmpl), "SELECT %s({1}::int, {2}::int);", fn);
+  if (sql_build (db, tmpl, sql, sizeof (sql)) != 0) return -1;
+
+  db_error_t err;
+  db_error_clear (&err);
+  db_res_t *res = NULL;
+  int rc = -1;
+  db_bind_t params[] = { db_bind_i32 (CRON_LOCK_CLASS), db_bind_i32 (cron_lock_key (name)) };
+
+  if (db_query (db, sql, params, 2, &res, &err))
+    {
+      if (db_res_step (res, &err)) rc = db_res_col_bool (res, 0, &err) ? 1 : 0;
+      db_res_finalize (res);
+    }
+  if (rc < 0) LOGW ("cron lock %s(%s) failed: %s", fn, name, err.message);
+  return rc;
+}
+
+
+
 int
 
 db_cron_try_lock (db_t *db, const char *name, int64_t now_s)
@@ -323,6 +371,9 @@ db_cron_try_lock (db_t *db, const char *name, int64_t now_s)
 
   if (!db || !name) return 0;
 
+  if (db_backend (db) == DB_BACKEND_POSTGRES)
+    return cron_advisory (db, "pg_try_advisory_lock", name) == 1;
+
   db_error_t err;
 
   db_error_clear (&err);
@@ -425,6 +476,22 @@ db_cron_get_lock_until (db_t *db, const char *name)
 
   char SQL[512];
 
+  if (db_backend (db) == DB_BACKEND_POSTGRES)
+    {
+      /* Advisory locks do not expire: held means held until released */
+      sql_build(db, "SELECT count(*) FROM pg_locks WHERE locktype = 'advisory' AND granted AND classid = {1}::int::oid AND objid = {2}::int::oid AND objsubid = 2;", SQL, sizeof(SQL));
+      db_res_t *res = NULL;
+      db_error_t err;
+      db_error_clear (&err);
+      int64_t held = 0;
+      if (db_query (db, SQL, (db_bind_t[]){ db_bind_i32 (CRON_LOCK_CLASS), db_bind_i32 (cron_lock_key (name)) }, 2, &res, &err))
+        {
+          if (db_res_step (res, &err)) held = db_res_col_i64 (res, 0, &err);
+          db_res_finalize (res);
+        }
+      return held > 0 ? INT64_MAX : 0;
+    }
+
   sql_build(db, "SELECT until_ms FROM locks WHERE lock_name = {1};", SQL, sizeof(SQL));
 
   db_res_t *res = NULL;
@@ -456,6 +523,8 @@ int
 db_cron_unlock (db_t *db, const char *name)
 {
   if (!db || !name) return -1;
+  if (db_backend (db) == DB_BACKEND_POSTGRES)
+    return cron_advisory (db, "pg_advisory_unlock", name) == 1 ? 0 : -1;
   db_error_t err;
   db_error_clear (&err);
   char SQL[512];
@@ -1452,90 +1521,257 @@ db_cron_traps_process (db_t *db, int64_t now_s)
 
 
 
-int
-
-db_cron_port_get_economy_data_json (db_t *db, json_t **out_array)
+/* Port economy tick: one read, then multi-row writes in chunks */
+#define PORT_ECON_CHUNK 500
 
+int
+db_cron_port_load_economy (db_t *db, port_economy_row_t **out_rows, int *out_count)
 {
-
-  if (!db || !out_array) return -1;
-
-  *out_array = json_array();
+  if (!db || !out_rows || !out_count) return -1;
+  *out_rows = NULL;
+  *out_count = 0;
 
   db_res_t *res = NULL;
-
   db_error_t err;
-
   db_error_clear (&err);
 
+  /* Price inputs match db_ports_get_price_info; o picks one open order per
+     side (as db_get_open_order does) and counts all of them */
+  const char *sql =
+    "SELECT p.port_id, p.size, p.type, es.quantity, ec.base_restock_rate, "
+    "       c.commodities_id, c.base_price, p.techlevel, "
+    "       ec.price_elasticity, ec.volatility_factor, "
+    "       COALESCE(o.buy_id, 0), COALESCE(o.sell_id, 0), "
+    "       COALESCE(o.n_open, 0) "
+    "FROM ports p "
+    "JOIN entity_stock es ON p.port_id = es.entity_id AND es.entity_type = 'port' "
+    "JOIN economy_curve ec ON p.economy_curve_id = ec.economy_curve_id "
+    "JOIN commodities c ON es.commodity_code = c.code "
+    "LEFT JOIN (SELECT actor_id, commodity_id, "
+    "                  MIN(CASE WHEN side = 'buy' THEN commodity_orders_id END) AS buy_id, "
+    "                  MIN(CASE WHEN side = 'sell' THEN commodity_orders_id END) AS sell_id, "
+    "                  COUNT(*) AS n_open "
+    "           FROM commodity_orders "
+    "           WHERE actor_type = 'port' AND status = 'open' "
+    "           GROUP BY actor_id, commodity_id) o "
+    "  ON o.actor_id = p.port_id AND o.commodity_id = c.commodities_id;";
+
+  if (!db_query_stream (db, sql, NULL, 0, &res, &err))
+    {
+      LOGE ("db_cron_port_load_economy: query failed: %s", err.message);
+      return -1;
+    }
 
+  int cap = 1024, n = 0;
+  port_economy_row_t *rows = malloc ((size_t) cap * sizeof (*rows));
 
-  const char *sql =
+  while (rows && db_res_step (res, &err))
+    {
+      if (n == cap)
+        {
+          port_economy_row_t *tmp = realloc (rows, (size_t) cap * 2 * sizeof (*rows));
+          if (!tmp)
+            {
+              free (rows);
+              rows = NULL;
+              break;
+            }
+          rows = tmp;
+          cap *= 2;
+        }
 
-    "SELECT p.port_id AS port_id, "
+      port_economy_row_t *r = &rows[n++];
+      r->port_id = db_res_col_i32 (res, 0, &err);
+      r->port_size = db_res_col_i32 (res, 1, &err);
+      r->port_type = db_res_col_i32 (res, 2, &err);
+      r->current_quantity = db_res_col_i32 (res, 3, &err);
+      r->base_restock_rate = db_res_col_double (res, 4, &err);
+      r->commodity_id = db_res_col_i32 (res, 5, &err);
+      r->base_price = db_res_col_i32 (res, 6, &err);
+      r->techlevel = db_res_col_i32 (res, 7, &err);
+      r->price_elasticity = db_res_col_double (res, 8, &err);
+      r->volatility_factor = db_res_col_double (res, 9, &err);
+      r->buy_order_id = db_res_col_i32 (res, 10, &err);
+      r->sell_order_id = db_res_col_i32 (res, 11, &err);
+      r->open_orders = db_res_col_i32 (res, 12, &err);
+    }
+  db_res_finalize (res);
 
-    "       p.size AS port_size, "
+  if (!rows)
+    {
+      LOGE ("db_cron_port_load_economy: OOM");
+      return -1;
+    }
+  *out_rows = rows;
+  *out_count = n;
+  return 0;
+}
 
-    "       p.type AS port_type, "
 
-    "       es.commodity_code, "
+static int
+h_port_econ_exec (db_t *db, const char *tmpl, const db_bind_t *params, int n_params)
+{
+  size_t sz = strlen (tmpl) * 2 + 64;
+  char *sql = malloc (sz);
+  db_error_t err;
+  db_error_clear (&err);
 
-    "       es.quantity AS current_quantity, "
+  if (!sql) return -1;
+  if (sql_build (db, tmpl, sql, sz) != 0 || !db_exec (db, sql, params, n_params, &err))
+    {
+      LOGE ("port_economy: batch statement failed: %s (code=%d)", err.message, err.code);
+      free (sql);
+      return -1;
+    }
+  free (sql);
+  return 0;
+}
 
-    "       ec.base_restock_rate, "
 
-    "       ec.target_stock, "
+int
+db_cron_port_insert_orders (db_t *db, const port_econ_order_t *orders, int n)
+{
+  if (!db || (n > 0 && !orders)) return -1;
 
-    "       c.commodities_id AS commodity_id "
+  size_t cap = 256 + (size_t) PORT_ECON_CHUNK * 96;
+  char *tmpl = malloc (cap);
+  db_bind_t *params = malloc ((size_t) PORT_ECON_CHUNK * 6 * sizeof (*params));
+  int rc = 0;
 
-    "FROM ports p "
+  if (!tmpl || !params)
+    {
+      free (tmpl);
+      free (params);
+      return -1;
+    }
 
-    "JOIN entity_stock es ON p.port_id = es.entity_id AND es.entity_type = 'port' "
+  for (int base = 0; rc == 0 && base < n; base += PORT_ECON_CHUNK)
+    {
+      int m = (n - base < PORT_ECON_CHUNK) ? n - base : PORT_ECON_CHUNK;
+      size_t len = (size_t) snprintf (tmpl, cap,
+                         "INSERT INTO commodity_orders (actor_type, actor_id, location_type, "
+                         "location_id, commodity_id, side, quantity, filled_quantity, price) VALUES ");
+      int k = 0;
 
-    "JOIN economy_curve ec ON p.economy_curve_id = ec.economy_curve_id "
+      for (int i = 0; i < m; i++)
+        {
+          const port_econ_order_t *o = &orders[base + i];
+          len += (size_t) snprintf (tmpl + len, cap - len, "%s('port', {%d}, 'port', {%d}, {%d}, {%d}, {%d}, 0, {%d})",
+                          i ? ", " : "", k + 1, k + 2, k + 3, k + 4, k + 5, k + 6);
+          params[k++] = db_bind_i64 (o->port_id);
+          params[k++] = db_bind_i64 (o->port_id);
+          params[k++] = db_bind_i64 (o->commodity_id);
+          params[k++] = db_bind_text (o->side);
+          params[k++] = db_bind_i64 (o->quantity);
+          params[k++] = db_bind_i64 (o->price);
+        }
+      rc = h_port_econ_exec (db, tmpl, params, k);
+    }
 
-    "JOIN commodities c ON es.commodity_code = c.code;";
+  free (tmpl);
+  free (params);
+  return rc;
+}
 
 
+int
+db_cron_port_bump_orders (db_t *db, const port_econ_order_t *orders, int n)
+{
+  if (!db || (n > 0 && !orders)) return -1;
 
-  if (db_query (db, sql, NULL, 0, &res, &err))
+  size_t cap = 256 + (size_t) PORT_ECON_CHUNK * 64;
+  char *tmpl = malloc (cap);
+  db_bind_t *params = malloc ((size_t) PORT_ECON_CHUNK * 3 * sizeof (*params));
+  int rc = 0;
 
+  if (!tmpl || !params)
     {
+      free (tmpl);
+      free (params);
+      return -1;
+    }
 
-      while (db_res_step (res, &err))
+  for (int base = 0; rc == 0 && base < n; base += PORT_ECON_CHUNK)
+    {
+      int m = (n - base < PORT_ECON_CHUNK) ? n - base : PORT_ECON_CHUNK;
+      size_t len = (size_t) snprintf (tmpl, cap,
+                         "UPDATE commodity_orders SET quantity = filled_quantity + "
+                         "CASE commodity_orders_id");
+      int k = 0;
 
+      for (int i = 0; i < m; i++)
         {
+          len += (size_t) snprintf (tmpl + len, cap - len, " WHEN {%d} THEN {%d}", k + 1, k + 2);
+          params[k++] = db_bind_i64 (orders[base + i].order_id);
+          params[k++] = db_bind_i64 (orders[base + i].quantity);
+        }
+      len += (size_t) snprintf (tmpl + len, cap - len, " END WHERE status = 'open' AND commodity_orders_id IN (");
+      for (int i = 0; i < m; i++)
+        {
+          len += (size_t) snprintf (tmpl + len, cap - len, "%s{%d}", i ? ", " : "", k + 1);
+          params[k++] = db_bind_i64 (orders[base + i].order_id);
+        }
+      snprintf (tmpl + len, cap - len, ")");
+      rc = h_port_econ_exec (db, tmpl, params, k);
+    }
 
-          json_t *obj = json_object();
-
-          json_object_set_new(obj, "port_id", json_integer(db_res_col_i32(res, 0, &err)));
-
-          json_object_set_new(obj, "port_size", json_integer(db_res_col_i32(res, 1, &err)));
+  free (tmpl);
+  free (params);
+  return rc;
+}
 
-          json_object_set_new(obj, "port_type", json_integer(db_res_col_i32(res, 2, &err)));
 
-          json_object_set_new(obj, "commodity_code", json_string(db_res_col_text(res, 3, &err)));
+static int
+h_port_econ_cmp_commodity (const void *a, const void *b)
+{
+  const port_econ_order_t *x = a, *y = b;
+  if (x->commodity_id != y->commodity_id) return (x->commodity_id > y->commodity_id) - (x->commodity_id < y->commodity_id);
+  return (x->port_id > y->port_id) - (x->port_id < y->port_id);
+}
 
-          json_object_set_new(obj, "current_quantity", json_integer(db_res_col_i32(res, 4, &err)));
 
-                    json_object_set_new(obj, "base_restock_rate", json_real(db_res_col_double(res, 5, &err)));
+int
+db_cron_port_cancel_orders (db_t *db, port_econ_order_t *orders, int n)
+{
+  if (!db || (n > 0 && !orders)) return -1;
 
-                    json_object_set_new(obj, "target_stock", json_integer(db_res_col_i32(res, 6, &err)));
+  /* One statement per commodity (and chunk): actor_id IN (...) */
+  qsort (orders, (size_t) n, sizeof (*orders), h_port_econ_cmp_commodity);
 
-                    json_object_set_new(obj, "commodity_id", json_integer(db_res_col_i32(res, 7, &err)));
+  size_t cap = 256 + (size_t) PORT_ECON_CHUNK * 16;
+  char *tmpl = malloc (cap);
+  db_bind_t *params = malloc (((size_t) PORT_ECON_CHUNK + 1) * sizeof (*params));
+  int rc = 0;
 
-          json_array_append_new(*out_array, obj);
+  if (!tmpl || !params)
+    {
+      free (tmpl);
+      free (params);
+      return -1;
+    }
 
+  for (int i = 0; rc == 0 && i < n; )
+    {
+      int commodity_id = orders[i].commodity_id;
+      size_t len = (size_t) snprintf (tmpl, cap,
+                         "UPDATE commodity_orders SET status = 'cancelled' "
+                         "WHERE actor_type = 'port' AND status = 'open' "
+                         "AND commodity_id = {1} AND actor_id IN (");
+      int k = 0;
+
+      params[k++] = db_bind_i64 (commodity_id);
+      for (; i < n && orders[i].commodity_id == commodity_id && k <= PORT_ECON_CHUNK; i++)
+        {
+          len += (size_t) snprintf (tmpl + len, cap - len, "%s{%d}", k > 1 ? ", " : "", k + 1);
+          params[k++] = db_bind_i64 (orders[i].port_id);
         }
-
-      db_res_finalize (res);
-
-      return 0;
-
+      snprintf (tmpl + len, cap - len, ")");
+      rc = h_port_econ_exec (db, tmpl, params, k);
     }
 
-  return -1;
-
+  free (tmpl);
+  free (params);
+  return rc;
 }
 
 
@@ -1636,7 +1872,7 @@ db_cron_news_get_events_json (db_t *db, int64_t start_s, int64_t end_s, json_t *
 
 
 
-  if (db_query (db, sql, (db_bind_t[]){ db_bind_timestamp_text (start_s), db_bind_timestamp_text (end_s) }, 2, &res, &err))
+  if (db_query_stream (db, sql, (db_bind_t[]){ db_bind_timestamp_text (start_s), db_bind_timestamp_text (end_s) }, 2, &res, &err))
 
     {
 
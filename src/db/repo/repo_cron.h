@@ -36,7 +36,42 @@ int db_cron_planet_update_production_stock (db_t *db, int64_t now_s);
 int db_cron_planet_get_market_data_json (db_t *db, json_t **out_array);
 int db_cron_broadcast_cleanup (db_t *db, int64_t now_s);
 int db_cron_traps_process (db_t *db, int64_t now_s);
-int db_cron_port_get_economy_data_json (db_t *db, json_t **out_array);
+
+/* Port economy tick: every port/commodity row with its price inputs and
+   the open port orders for it (ids 0 when none) */
+typedef struct
+{
+  int port_id;
+  int port_size;
+  int port_type;
+  int commodity_id;
+  int current_quantity;
+  double base_restock_rate;
+  int base_price;
+  int techlevel;
+  double price_elasticity;
+  double volatility_factor;
+  int buy_order_id;
+  int sell_order_id;
+  int open_orders;
+} port_economy_row_t;
+
+typedef struct
+{
+  int order_id;                 /* bump only */
+  int port_id;
+  int commodity_id;
+  const char *side;             /* insert only */
+  int quantity;                 /* insert: quantity; bump: added to filled */
+  int price;                    /* insert only */
+} port_econ_order_t;
+
+int db_cron_port_load_economy (db_t *db, port_economy_row_t **out_rows, int *out_count);
+int db_cron_port_insert_orders (db_t *db, const port_econ_order_t *orders, int n);
+int db_cron_port_bump_orders (db_t *db, const port_econ_order_t *orders, int n);
+/* Cancels every open port order for each (port_id, commodity_id); sorts orders */
+int db_cron_port_cancel_orders (db_t *db, port_econ_order_t *orders, int n);
+
 int db_cron_get_all_commodities_json (db_t *db, json_t **out_array);
 int db_cron_expire_market_orders (db_t *db, int64_t now_s);
 int db_cron_news_get_events_json (db_t *db, int64_t start_s, int64_t end_s, json_t **out_array);
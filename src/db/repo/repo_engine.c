@@ -109,6 +109,8 @@ int repo_engine_mark_command_error(db_t *db, const char *ts_fmt, int64_t now_s,
 }
 
 int repo_engine_reclaim_stale_locks(db_t *db, int64_t stale_threshold_ms) {
+    /* Cron locks on PostgreSQL are advisory (repo_cron.c); nothing to reclaim */
+    if (db_backend(db) == DB_BACKEND_POSTGRES) return 0;
     db_error_t err;
     /* SQL_VERBATIM: Q10 */
     const char *q10 = "DELETE FROM locks WHERE owner='server' AND until_ms < {1};";
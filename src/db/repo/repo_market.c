@@ -370,7 +370,7 @@ db_load_open_orders_for_commodity (db_t *db,
   db_res_t *res = NULL;
 
 
-  if (!db_query (db, sql, params, 2, &res, &err))
+  if (!db_query_stream (db, sql, params, 2, &res, &err))
     {
       LOGE (
         "db_load_open_orders_for_commodity: query failed: %s (code=%d backend=%d)",
@@ -82,17 +82,34 @@ db_subscribe_disable (db_t *db, int64_t pid, const char *topic, int *locked_out)
   sql_build (db,
              "UPDATE subscriptions SET enabled = {3} WHERE player_id = {1} AND event_type = {2} AND locked = FALSE;",
              sql, sizeof (sql));
-  if (!db_exec (db,
-                sql,
-                (db_bind_t[]){db_bind_i64 (pid), db_bind_text (topic), db_bind_bool(false)},
-                3,
-                &err))
+  int64_t rows = 0;
+  if (!db_exec_rows_affected (db,
+                              sql,
+                              (db_bind_t[]){db_bind_i64 (pid), db_bind_text (topic), db_bind_bool(false)},
+                              3,
+                              &rows,
+                              &err))
     {
       return -1;
     }
   if (locked_out)
     {
       *locked_out = 0;
+      if (rows == 0)
+        {
+          /* Nothing changed: tell a locked row apart from a missing one */
+          db_res_t *res = NULL;
+          sql_build (db,
+                     "SELECT 1 FROM subscriptions WHERE player_id = {1} AND event_type = {2} AND locked = TRUE;",
+                     sql, sizeof (sql));
+          if (db_query (db, sql,
+                        (db_bind_t[]){db_bind_i64 (pid), db_bind_text (topic)},
+                        2, &res, &err))
+            {
+              *locked_out = db_res_step (res, &err) ? 1 : 0;
+              db_res_finalize (res);
+            }
+        }
     }
   return 0;
 }
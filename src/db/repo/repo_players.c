@@ -3,6 +3,7 @@
 #include "repo_players.h"
 #include "repo_universe.h"
 #include "db/sql_driver.h"
+#include "warp_graph.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -461,41 +462,26 @@ int repo_players_record_visit(db_t *db, int player_id, int sector_id) {
     return 0;
 }
 
-/* Adjacency list for BFS */
-typedef struct {
-    int *head;
-    int *next;
-    int *to;
-    int nodes;
-    int edges;
-} repo_adj_list_t;
-
-static int h_repo_players_bfs_fast(repo_adj_list_t *adj, int from, int to, int max_dist, int *dist, int *queue) {
-    if (from == to) return 0;
-    if (max_dist <= 0) return -1;
-    if (from < 0 || from >= adj->nodes || to < 0 || to >= adj->nodes) return -1;
-
-    for (int i = 0; i < adj->nodes; i++) dist[i] = -1;
-    dist[from] = 0;
-    queue[0] = from;
-    int q_head = 0, q_tail = 1;
-
-    while (q_head < q_tail) {
-        int curr = queue[q_head++];
-        if (dist[curr] >= max_dist) continue;
-
-        for (int i = adj->head[curr]; i != -1; i = adj->next[i]) {
-            int v = adj->to[i];
-            if (dist[v] == -1) {
-                dist[v] = dist[curr] + 1;
-                if (v == to) return dist[v];
-                queue[q_tail++] = v;
-            }
-        }
-    }
-    return -1;
+/* Hop count src -> dst from a bounded row of src, -1 if not within bound */
+static int h_repo_players_row_hops(const warp_hops_t *row, int src, int dst, int max_id) {
+    if (src == dst) return 0;
+    if (!row || dst <= 0 || dst > max_id || row[dst] == WARP_HOPS_NONE) return -1;
+    return row[dst];
 }
 
+static int h_repo_players_route_cmp_sector_a(const void *a, const void *b) {
+    const trade_route_t *ra = *(const trade_route_t * const *)a;
+    const trade_route_t *rb = *(const trade_route_t * const *)b;
+    return (ra->sector_a_id > rb->sector_a_id) - (ra->sector_a_id < rb->sector_a_id);
+}
+
+/*
+ * Every known-port pair is scored, with no cap: one bounded BFS from the
+ * player's sector covers hops_from_player for all pairs, and pairs are
+ * visited grouped by sector_a so each distinct port sector costs one bounded
+ * BFS for hops_between. Rows come from the warp graph's shared LRU, so
+ * players working the same region reuse each other's searches.
+ */
 int repo_players_get_recommended_routes(db_t *db, int player_id, int current_sector_id,
                                         int max_hops_between, int max_hops_from_player,
                                         int require_two_way,
@@ -507,46 +493,7 @@ int repo_players_get_recommended_routes(db_t *db, int player_id, int current_sec
     if (out_truncated) *out_truncated = 0;
     if (out_pairs_checked) *out_pairs_checked = 0;
 
-    int max_id = 0;
-    if (repo_universe_get_max_sector_id(db, &max_id) != 0) return -1;
-    int nodes = max_id + 1;
-
-    int warp_count = 0;
-    if (repo_universe_get_warp_count(db, &warp_count) != 0) return -1;
-
-    repo_adj_list_t adj;
-    adj.nodes = nodes;
-    adj.edges = warp_count;
-    adj.head = malloc(nodes * sizeof(int));
-    adj.next = malloc(warp_count * sizeof(int));
-    adj.to = malloc(warp_count * sizeof(int));
-    int *dist_buf = malloc(nodes * sizeof(int));
-    int *queue_buf = malloc(nodes * sizeof(int));
-
-    if (!adj.head || !adj.next || !adj.to || !dist_buf || !queue_buf) {
-        free(adj.head); free(adj.next); free(adj.to);
-        free(dist_buf); free(queue_buf);
-        return -1;
-    }
-
-    for (int i = 0; i < nodes; i++) adj.head[i] = -1;
-    
     db_error_t err;
-    db_res_t *res_warps = repo_universe_get_all_warps(db, &err);
-    int edge_idx = 0;
-    if (res_warps) {
-        while (db_res_step(res_warps, &err)) {
-            int u = db_res_col_i32(res_warps, 0, &err);
-            int v = db_res_col_i32(res_warps, 1, &err);
-            if (u >= 0 && u < nodes && v >= 0 && v < nodes && edge_idx < warp_count) {
-                adj.to[edge_idx] = v;
-                adj.next[edge_idx] = adj.head[u];
-                adj.head[u] = edge_idx++;
-            }
-        }
-        db_res_finalize(res_warps);
-    }
-
     db_res_t *res = NULL;
     /* SQL_VERBATIM: Q_ROUTES */
     const char *q_routes = 
@@ -566,71 +513,90 @@ int repo_players_get_recommended_routes(db_t *db, int player_id, int current_sec
 
     char sql[2048]; sql_build(db, q_routes, sql, sizeof(sql));
     if (!db_query(db, sql, (db_bind_t[]){ db_bind_i64(player_id) }, 1, &res, &err)) {
-        free(adj.head); free(adj.next); free(adj.to);
-        free(dist_buf); free(queue_buf);
         return err.code;
     }
 
+    /* 1. Collect candidate pairs (SQL order is the output order) */
     int capacity = 32;
     trade_route_t *routes = malloc(capacity * sizeof(trade_route_t));
     int count = 0;
     int pairs_checked = 0;
-    int truncated = 0;
-    const int MAX_PAIRS_CHECKED = 2000;
 
-    while (db_res_step(res, &err)) {
-        if (pairs_checked >= MAX_PAIRS_CHECKED) {
-            truncated = 1;
-            break;
-        }
+    while (routes && db_res_step(res, &err)) {
         pairs_checked++;
 
-        int p_a = db_res_col_i32(res, 0, &err);
-        int p_b = db_res_col_i32(res, 1, &err);
-        int s_a = db_res_col_i32(res, 2, &err);
-        int s_b = db_res_col_i32(res, 3, &err);
         int a_to_b = db_res_col_i32(res, 4, &err);
         int b_to_a = db_res_col_i32(res, 5, &err);
 
         if (require_two_way && (a_to_b == 0 || b_to_a == 0)) continue;
 
-        /* Calculate distances */
-        int dist_ab = h_repo_players_bfs_fast(&adj, s_a, s_b, max_hops_between, dist_buf, queue_buf);
-        if (dist_ab == -1 || dist_ab > max_hops_between) continue;
-
-        int dist_pa = h_repo_players_bfs_fast(&adj, current_sector_id, s_a, max_hops_from_player, dist_buf, queue_buf);
-        int dist_pb = h_repo_players_bfs_fast(&adj, current_sector_id, s_b, max_hops_from_player, dist_buf, queue_buf);
-        
-        int dist_player = -1;
-        if (dist_pa != -1 && dist_pb != -1) dist_player = (dist_pa < dist_pb) ? dist_pa : dist_pb;
-        else if (dist_pa != -1) dist_player = dist_pa;
-        else if (dist_pb != -1) dist_player = dist_pb;
-
-        if (dist_player == -1 || dist_player > max_hops_from_player) continue;
-
         if (count >= capacity) {
+            trade_route_t *grown = realloc(routes, capacity * 2 * sizeof(trade_route_t));
+            if (!grown) { free(routes); routes = NULL; break; }
+            routes = grown;
             capacity *= 2;
-            routes = realloc(routes, capacity * sizeof(trade_route_t));
         }
 
-        routes[count].port_a_id = p_a;
-        routes[count].port_b_id = p_b;
-        routes[count].sector_a_id = s_a;
-        routes[count].sector_b_id = s_b;
-        routes[count].hops_between = dist_ab;
-        routes[count].hops_from_player = dist_player;
+        routes[count].port_a_id = db_res_col_i32(res, 0, &err);
+        routes[count].port_b_id = db_res_col_i32(res, 1, &err);
+        routes[count].sector_a_id = db_res_col_i32(res, 2, &err);
+        routes[count].sector_b_id = db_res_col_i32(res, 3, &err);
+        routes[count].hops_between = -1;
+        routes[count].hops_from_player = -1;
         routes[count].is_two_way = (a_to_b > 0 && b_to_a > 0) ? 1 : 0;
-        routes[count].commodity = NULL; 
+        routes[count].commodity = NULL;
         count++;
     }
     db_res_finalize(res);
+    if (!routes) return -1;
+
+    const warp_graph_t *g = warp_graph_acquire(db);
+    trade_route_t **order = malloc((count ? count : 1) * sizeof(*order));
+    if (!g || !order) {
+        free(order);
+        free(routes);
+        if (g) warp_graph_release(g);
+        return -1;
+    }
+
+    /* 2. Distances: one row from the player, one per distinct sector_a */
+    const warp_hops_t *player_row = (max_hops_from_player > 0)
+        ? warp_graph_hops_acquire(g, current_sector_id, max_hops_from_player) : NULL;
+
+    for (int i = 0; i < count; i++) order[i] = &routes[i];
+    qsort(order, count, sizeof(*order), h_repo_players_route_cmp_sector_a);
 
-    free(adj.head); free(adj.next); free(adj.to);
-    free(dist_buf); free(queue_buf);
+    for (int i = 0; i < count; ) {
+        int s_a = order[i]->sector_a_id;
+        const warp_hops_t *row = (max_hops_between > 0)
+            ? warp_graph_hops_acquire(g, s_a, max_hops_between) : NULL;
+
+        for (; i < count && order[i]->sector_a_id == s_a; i++) {
+            trade_route_t *r = order[i];
+            r->hops_between = h_repo_players_row_hops(row, s_a, r->sector_b_id, g->max_id);
+
+            int dist_pa = h_repo_players_row_hops(player_row, current_sector_id, r->sector_a_id, g->max_id);
+            int dist_pb = h_repo_players_row_hops(player_row, current_sector_id, r->sector_b_id, g->max_id);
+            if (dist_pa != -1 && dist_pb != -1) r->hops_from_player = (dist_pa < dist_pb) ? dist_pa : dist_pb;
+            else r->hops_from_player = (dist_pa != -1) ? dist_pa : dist_pb;
+        }
+        warp_graph_hops_release(row);
+    }
+    warp_graph_hops_release(player_row);
+    warp_graph_release(g);
+    free(order);
+
+    /* 3. Keep reachable pairs, preserving SQL order */
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        trade_route_t *r = &routes[i];
+        if (r->hops_between == -1 || r->hops_between > max_hops_between) continue;
+        if (r->hops_from_player == -1 || r->hops_from_player > max_hops_from_player) continue;
+        routes[kept++] = *r;
+    }
 
     *out_routes = routes;
-    *out_count = count;
-    if (out_truncated) *out_truncated = truncated;
+    *out_count = kept;
     if (out_pairs_checked) *out_pairs_checked = pairs_checked;
     return 0;
 }
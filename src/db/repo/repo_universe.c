@@ -254,7 +254,7 @@ db_res_t* repo_universe_get_all_warps(db_t *db, db_error_t *err) {
     /* SQL_VERBATIM: Q21 */
     const char *q21 = "SELECT from_sector, to_sector FROM sector_warps;";
     db_res_t *res = NULL;
-    db_query(db, q21, NULL, 0, &res, err);
+    db_query_stream(db, q21, NULL, 0, &res, err);
     return res;
 }
 
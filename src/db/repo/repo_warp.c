@@ -2,6 +2,7 @@
 #include "db_int.h"
 #include "repo_warp.h"
 #include "db/sql_driver.h"
+#include "warp_graph.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -63,6 +64,7 @@ int repo_warp_delete_warp(db_t *db, int from_sector, int to_sector) {
     const char *sql_delete_warp = "DELETE FROM sector_warps WHERE from_sector = {1} AND to_sector = {2};";
     char sql_converted[256]; sql_build(db, sql_delete_warp, sql_converted, sizeof(sql_converted));
     if (!db_exec (db, sql_converted, (db_bind_t[]){ db_bind_i64(from_sector), db_bind_i64(to_sector) }, 2, &err)) return err.code;
+    db_on_commit(db, warp_graph_invalidate);
     return 0;
 }
 
@@ -72,6 +74,7 @@ int repo_warp_insert_warp(db_t *db, int from_sector, int to_sector) {
     const char *sql_insert_warp = "INSERT INTO sector_warps (from_sector, to_sector) VALUES ({1}, {2});";
     char sql_converted[256]; sql_build(db, sql_insert_warp, sql_converted, sizeof(sql_converted));
     if (!db_exec (db, sql_converted, (db_bind_t[]){ db_bind_i64(from_sector), db_bind_i64(to_sector) }, 2, &err)) return err.code;
+    db_on_commit(db, warp_graph_invalidate);
     return 0;
 }
 
@@ -113,5 +116,6 @@ int repo_warp_delete_warps_from_sector(db_t *db, int from_sector) {
     const char *sql_delete = "DELETE FROM sector_warps WHERE from_sector = {1};";
     char sql_converted[256]; sql_build(db, sql_delete, sql_converted, sizeof(sql_converted));
     if (!db_exec (db, sql_converted, (db_bind_t[]){ db_bind_i64(from_sector) }, 1, &err)) return err.code;
+    db_on_commit(db, warp_graph_invalidate);
     return 0;
 }
@@ -12,7 +12,10 @@
 #include "server_communication.h"	// (optional if you want to also emit immediately)
 #include "engine_consumer.h"
 #include "server_engine.h"	// For h_player_progress_from_event_payload
+#include "server_players.h"
 #include "server_log.h"
+#include "session_cache.h"
+#include "client_registry.h"
 
 
 /* --- helpers -------------------------------------------------------------- */
@@ -194,6 +197,8 @@ handle_ship_self_destruct_initiated (db_t *db, db_res_t *ev_row)
       json_decref (payload);
       return 1;			// Quarantine
     }
+  session_cache_invalidate_player (player_id);
+  client_registry_move_player (player_id, h_get_player_sector (db, player_id));
   // Log ship.destroyed event
   json_t *destroyed_payload = json_object ();
 
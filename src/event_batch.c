@@ -0,0 +1,398 @@
+/* src/event_batch.c */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/* local includes */
+#include "event_batch.h"
+#include "server_envelope.h"
+#include "server_log.h"
+
+/* Events that describe where something is now: a newer one for the same
+   entity makes any queued one obsolete. The entity is named by the key
+   field of the event data; NULL for one-of-a-kind entities such as the
+   ISS, where the type alone is enough. */
+static const struct
+{
+  const char *type;
+  const char *key;
+} k_state_events[] = {
+  {"iss.move", NULL},
+  {"iss.warp", NULL},
+  {"npc.move.v1", "npc_id"},
+  {NULL, NULL}
+};
+
+typedef struct
+{
+  char *type;
+  json_t *data;
+} batch_ev_t;
+
+typedef struct event_batch_s
+{
+  client_ctx_t *ctx;
+  pthread_mutex_t mu;		/* guards the queue below */
+  batch_ev_t *evs;
+  size_t n;
+  size_t cap;
+  uint64_t first_ms;		/* when evs[0] was queued */
+  int collapsed;
+  struct event_batch_s *next;	/* g_batches; guarded by g_mu */
+} event_batch_t;
+
+/* A queue taken off its connection. It is sent before the connection's
+   lock is released, so batches never overtake one another. */
+typedef struct
+{
+  batch_ev_t *evs;
+  size_t n;
+  int collapsed;
+} batch_take_t;
+
+static pthread_mutex_t g_mu = PTHREAD_MUTEX_INITIALIZER;
+static event_batch_t *g_batches = NULL;
+static int g_window_ms = 0;
+static int g_max_events = 64;
+/* Earliest time any queue may be due; flush_due skips the walk before it */
+static _Atomic uint64_t g_next_due_ms = UINT64_MAX;
+
+static _Atomic uint64_t g_frames = 0;
+static _Atomic uint64_t g_events = 0;
+static _Atomic uint64_t g_collapsed = 0;
+static _Atomic int64_t g_conns = 0;
+
+
+static uint64_t
+batch_now_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000ULL + (uint64_t) ts.tv_nsec / 1000000ULL;
+}
+
+
+/* The state_events entry for type, or -1 */
+static int
+state_event_index (const char *type)
+{
+  for (int i = 0; k_state_events[i].type; i++)
+    {
+      if (strcmp (type, k_state_events[i].type) == 0)
+	{
+	  return i;
+	}
+    }
+  return -1;
+}
+
+
+/* Whether queued event ev describes the same entity as (type, data) */
+static bool
+same_entity (const batch_ev_t *ev, const char *type, json_t *data, int si)
+{
+  if (strcmp (ev->type, type) != 0)
+    {
+      return false;
+    }
+  const char *key = k_state_events[si].key;
+
+  if (!key)
+    {
+      return true;
+    }
+  json_t *a = json_object_get (ev->data, key);
+  json_t *b = json_object_get (data, key);
+
+  /* No id to tell entities apart: keep both */
+  return a && b && json_equal (a, b);
+}
+
+
+/* Lower g_next_due_ms to due_ms if that is earlier */
+static void
+next_due_lower (uint64_t due_ms)
+{
+  uint64_t cur = atomic_load (&g_next_due_ms);
+
+  while (due_ms < cur
+	 && !atomic_compare_exchange_weak (&g_next_due_ms, &cur, due_ms))
+    {
+    }
+}
+
+
+static void
+batch_take (event_batch_t *b, batch_take_t *t)
+{
+  t->evs = b->evs;
+  t->n = b->n;
+  t->collapsed = b->collapsed;
+  b->evs = NULL;
+  b->n = 0;
+  b->cap = 0;
+  b->collapsed = 0;
+}
+
+
+static void
+take_free (batch_take_t *t)
+{
+  for (size_t i = 0; i < t->n; i++)
+    {
+      free (t->evs[i].type);
+      json_decref (t->evs[i].data);
+    }
+  free (t->evs);
+}
+
+
+static void
+take_send (client_ctx_t *ctx, batch_take_t *t)
+{
+  reactor_buf_t *rendered = NULL;
+
+  if (t->n == 1)
+    {
+      rendered = render_enveloped_ok (t->evs[0].type, t->evs[0].data);
+    }
+  else if (t->n > 1)
+    {
+      json_t *data = json_object ();
+      json_t *events = json_array ();
+
+      for (size_t i = 0; i < t->n; i++)
+	{
+	  json_t *ev = json_object ();
+
+	  json_object_set_new (ev, "type", json_string (t->evs[i].type));
+	  json_object_set (ev, "data", t->evs[i].data);
+	  json_array_append_new (events, ev);
+	}
+      json_object_set_new (data, "events", events);
+      json_object_set_new (data, "collapsed", json_integer (t->collapsed));
+      rendered = render_enveloped_ok ("events.batch_v1", data);
+      json_decref (data);
+    }
+  if (rendered)
+    {
+      send_all_rendered (ctx->fd, rendered);
+      reactor_buf_release (rendered);
+      atomic_fetch_add_explicit (&g_frames, 1, memory_order_relaxed);
+    }
+  take_free (t);
+}
+
+
+void
+event_batch_configure (int window_ms, int max_events)
+{
+  g_window_ms = window_ms > 0 ? window_ms : 0;
+  g_max_events = max_events > 1 ? max_events : 64;
+  if (g_window_ms)
+    {
+      LOGI ("event batching on: %d ms window, up to %d events a frame",
+	    g_window_ms, g_max_events);
+    }
+}
+
+
+int
+event_batch_window_ms (void)
+{
+  return g_window_ms;
+}
+
+
+bool
+event_batch_enable (client_ctx_t *ctx)
+{
+  if (!g_window_ms)
+    {
+      return false;
+    }
+  if (atomic_load (&ctx->batch))
+    {
+      return true;
+    }
+  event_batch_t *b = calloc (1, sizeof (*b));
+
+  if (!b)
+    {
+      return false;
+    }
+  b->ctx = ctx;
+  pthread_mutex_init (&b->mu, NULL);
+
+  pthread_mutex_lock (&g_mu);
+  b->next = g_batches;
+  g_batches = b;
+  pthread_mutex_unlock (&g_mu);
+  atomic_fetch_add_explicit (&g_conns, 1, memory_order_relaxed);
+  atomic_store (&ctx->batch, b);
+  return true;
+}
+
+
+void
+event_batch_drop (client_ctx_t *ctx)
+{
+  event_batch_t *b = atomic_exchange (&ctx->batch, NULL);
+
+  if (!b)
+    {
+      return;
+    }
+  pthread_mutex_lock (&g_mu);
+  event_batch_t **pp = &g_batches;
+
+  while (*pp != b)
+    {
+      pp = &(*pp)->next;
+    }
+  *pp = b->next;
+  pthread_mutex_unlock (&g_mu);
+
+  /* The connection is going away: nothing left to send to */
+  batch_take_t t;
+
+  batch_take (b, &t);
+  take_free (&t);
+  pthread_mutex_destroy (&b->mu);
+  free (b);
+  atomic_fetch_sub_explicit (&g_conns, 1, memory_order_relaxed);
+}
+
+
+bool
+event_batch_push (client_ctx_t *ctx, const char *type, json_t *data)
+{
+  event_batch_t *b = atomic_load (&ctx->batch);
+
+  if (!b || !type || !data)
+    {
+      return false;
+    }
+  char *copy = strdup (type);
+
+  if (!copy)
+    {
+      return false;
+    }
+
+  int si = state_event_index (type);
+
+  pthread_mutex_lock (&b->mu);
+  if (si >= 0)
+    {
+      for (size_t i = 0; i < b->n; i++)
+	{
+	  if (same_entity (&b->evs[i], type, data, si))
+	    {
+	      free (b->evs[i].type);
+	      json_decref (b->evs[i].data);
+	      memmove (&b->evs[i], &b->evs[i + 1],
+		       (b->n - i - 1) * sizeof (*b->evs));
+	      b->n--;
+	      b->collapsed++;
+	      atomic_fetch_add_explicit (&g_collapsed, 1,
+					 memory_order_relaxed);
+	      break;		/* at most one was queued */
+	    }
+	}
+    }
+  if (b->n == b->cap)
+    {
+      size_t ncap = b->cap ? b->cap * 2 : 8;
+      batch_ev_t *nevs = realloc (b->evs, ncap * sizeof (*nevs));
+
+      if (!nevs)
+	{
+	  pthread_mutex_unlock (&b->mu);
+	  free (copy);
+	  return false;
+	}
+      b->evs = nevs;
+      b->cap = ncap;
+    }
+  if (b->n == 0)
+    {
+      b->first_ms = batch_now_ms ();
+      next_due_lower (b->first_ms + (uint64_t) g_window_ms);
+    }
+  b->evs[b->n].type = copy;
+  b->evs[b->n].data = json_incref (data);
+  b->n++;
+  if (b->n >= (size_t) g_max_events)
+    {
+      batch_take_t t;
+
+      batch_take (b, &t);
+      take_send (ctx, &t);
+    }
+  pthread_mutex_unlock (&b->mu);
+  atomic_fetch_add_explicit (&g_events, 1, memory_order_relaxed);
+  return true;
+}
+
+
+void
+event_batch_flush_due (void)
+{
+  if (!g_window_ms)
+    {
+      return;
+    }
+  uint64_t now = batch_now_ms ();
+
+  if (now < atomic_load (&g_next_due_ms))
+    {
+      return;
+    }
+  /* Cleared before the walk: a queue started meanwhile lowers it again,
+     and the walk puts back the deadline of any queue not yet due */
+  atomic_store (&g_next_due_ms, UINT64_MAX);
+
+  /* Holding g_mu keeps every listed ctx alive (see event_batch_drop) */
+  pthread_mutex_lock (&g_mu);
+  for (event_batch_t *b = g_batches; b; b = b->next)
+    {
+      pthread_mutex_lock (&b->mu);
+      if (b->n && now - b->first_ms >= (uint64_t) g_window_ms)
+	{
+	  batch_take_t t;
+
+	  batch_take (b, &t);
+	  take_send (b->ctx, &t);
+	}
+      else if (b->n)
+	{
+	  next_due_lower (b->first_ms + (uint64_t) g_window_ms);
+	}
+      pthread_mutex_unlock (&b->mu);
+    }
+  pthread_mutex_unlock (&g_mu);
+}
+
+
+json_t *
+event_batch_stats_json (void)
+{
+  json_t *o = json_object ();
+
+  json_object_set_new (o, "window_ms", json_integer (g_window_ms));
+  json_object_set_new (o, "max_events", json_integer (g_max_events));
+  json_object_set_new (o, "connections",
+		       json_integer ((json_int_t) atomic_load (&g_conns)));
+  json_object_set_new (o, "frames",
+		       json_integer ((json_int_t) atomic_load (&g_frames)));
+  json_object_set_new (o, "events",
+		       json_integer ((json_int_t) atomic_load (&g_events)));
+  json_object_set_new (o, "collapsed",
+		       json_integer ((json_int_t) atomic_load (&g_collapsed)));
+  return o;
+}
@@ -0,0 +1,44 @@
+#ifndef EVENT_BATCH_H
+#define EVENT_BATCH_H
+#include <stdbool.h>
+#include <jansson.h>
+#include "common.h"
+
+/*
+ * Optional per-connection event coalescing.
+ *
+ * A client that lists "events.batch_v1" in system.hello capabilities gets
+ * its pushed events (server_deliver_to_ctx) queued for up to
+ * event_batch_ms, then sent as one events.batch_v1 frame, in publish order.
+ * A state event (k_state_events in event_batch.c) replaces an older one of
+ * the same type for the same entity (e.g. the same npc_id) still queued,
+ * so only each entity's latest position goes out. A
+ * window holding a single event sends it as a plain event frame.
+ *
+ * Off unless event_batch_ms > 0; server_loop flushes due batches once per
+ * tick and runs its ticks no further apart than the window.
+ */
+
+void event_batch_configure (int window_ms, int max_events);
+/* 0 when batching is off */
+int event_batch_window_ms (void);
+
+/* Opt ctx in; false when batching is off. Call on ctx's own thread, as for
+   event_batch_drop, which discards ctx's queue before ctx is freed. */
+bool event_batch_enable (client_ctx_t * ctx);
+void event_batch_drop (client_ctx_t * ctx);
+
+/* Queue an event for ctx; false if ctx does not batch, and the caller
+   sends it as usual. Takes a reference to data, which may be serialised
+   later on another thread: publishers must not change it afterwards. */
+bool event_batch_push (client_ctx_t * ctx, const char *type, json_t * data);
+
+/* Send every batch whose oldest event has waited a full window. Returns
+   without walking the connections until the earliest queue is due. */
+void event_batch_flush_due (void);
+
+/* New reference: window_ms, max_events, connections, frames, events,
+   collapsed */
+json_t *event_batch_stats_json (void);
+
+#endif /* EVENT_BATCH_H */
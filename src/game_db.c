@@ -1,5 +1,8 @@
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <time.h>
 #include "game_db.h"
 #include "server_config.h"
 #include "server_log.h"
@@ -14,6 +17,51 @@ static pthread_once_t g_db_key_once = PTHREAD_ONCE_INIT;
 static char g_main_conninfo[1024];
 static db_backend_t g_main_backend;
 
+// --- Request Connection Pool ---
+
+#define DB_POOL_HEALTH_IDLE_MS  30000	/* ping connections idle longer than this */
+#define DB_POOL_TRIM_IDLE_MS    60000	/* close extras (above min) idle this long */
+
+typedef struct
+{
+  db_t *db;
+  uint64_t idle_since_ms;
+} pool_slot_t;
+
+static pthread_mutex_t g_pool_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pool_cv = PTHREAD_COND_INITIALIZER;
+static pool_slot_t *g_pool_idle;	/* stack; most recently used on top */
+static int g_pool_idle_n;
+static int g_pool_open;		/* idle + checked out + being opened */
+static int g_pool_waiters;
+static int g_pool_min, g_pool_max, g_pool_wait_ms;	/* max 0 = pool off */
+
+/* Counters, guarded by g_pool_mu */
+static uint64_t g_pool_checkouts, g_pool_waits, g_pool_wait_us_total;
+static uint64_t g_pool_wait_us_max, g_pool_timeouts, g_pool_opened;
+static uint64_t g_pool_closed, g_pool_health_failed;
+
+/* The connection this thread has checked out, and checkout nesting */
+static __thread db_t *t_pool_db;
+static __thread int t_pool_depth;
+
+// --- Read Replica ---
+
+#define DB_REPLICA_RETRY_MS     5000	/* after a failed connect, use the primary this long */
+#define DB_REPLICA_PLAYER_SLOTS 4096	/* power of two; collisions only cost replica reads */
+
+static char g_replica_conninfo[1024];	/* empty: no replica */
+static pthread_key_t g_replica_key;
+static pthread_once_t g_replica_key_once = PTHREAD_ONCE_INIT;
+/* Monotonic ms of each player's last write, by player_id slot */
+static _Atomic uint64_t g_player_write_ms[DB_REPLICA_PLAYER_SLOTS];
+static _Atomic uint64_t g_replica_reads, g_replica_after_write;
+static _Atomic uint64_t g_replica_unavailable;
+
+/* Set while a read-only command is routed to the replica */
+static __thread db_t *t_replica_db;
+static __thread uint64_t t_replica_retry_ms;
+
 
 static void
 db_connection_destructor (void *handle)
@@ -56,7 +104,14 @@ game_db_init (void)
 	("game_db_init: PostgreSQL backend enabled but no connection string is configured.");
       return -1;
     }
+  if (g_cfg.pg_replica_conn_str[0] != '\0')
+    {
+      strlcpy (g_replica_conninfo, g_cfg.pg_replica_conn_str,
+	       sizeof (g_replica_conninfo));
+      LOGI ("game_db_init: Read-only commands will use the read replica.");
+    }
 #endif
+
   return 0;
 }
 
@@ -67,37 +122,76 @@ game_db_close (void)
   // This function is now primarily for server shutdown.
   // The pthread_key_delete could be called here if we had a mechanism
   // to ensure all threads are joined, but the destructor handles cleanup.
+  pthread_mutex_lock (&g_pool_mu);
+  while (g_pool_idle_n > 0)
+    {
+      db_close (g_pool_idle[--g_pool_idle_n].db);
+      g_pool_open--;
+      g_pool_closed++;
+    }
+  pthread_mutex_unlock (&g_pool_mu);
   LOGI ("Game DB layer shut down.");
 }
 
 
+static db_t *
+game_db_open_conninfo (const char *conninfo)
+{
+  db_config_t db_cfg = { 0 };
+  db_error_t err = { 0 };
+
+
+  db_cfg.backend = g_main_backend;
+
+#ifdef DB_BACKEND_PG
+  db_cfg.pg_conninfo = conninfo;
+  db_cfg.pg_stmt_cache_size = g_cfg.pg_stmt_cache_size;
+#else
+  (void) conninfo;
+#endif
+
+  db_t *db = db_open (&db_cfg, &err);
+  if (!db)
+    {
+      LOGE ("Failed to open database connection (code: %d): %s",
+	    err.code, err.message);
+    }
+  return db;
+}
+
+
+static db_t *
+game_db_open_conn (void)
+{
+  return game_db_open_conninfo (g_main_conninfo);
+}
+
+
 db_t *
 game_db_get_handle (void)
 {
+  /* A read-only command routed to the replica */
+  if (t_replica_db)
+    {
+      return t_replica_db;
+    }
+  /* Inside a request: the pooled connection (NULL if none was free) */
+  if (t_pool_depth > 0)
+    {
+      return t_pool_db;
+    }
+
   pthread_once (&g_db_key_once, make_db_key);
   db_t *db = (db_t *) pthread_getspecific (g_db_handle_key);
 
 
   if (!db)
     {
-      db_config_t db_cfg = { 0 };
-      db_error_t err = { 0 };
-
-
-      db_cfg.backend = g_main_backend;
-
-#ifdef DB_BACKEND_PG
-      db_cfg.pg_conninfo = g_main_conninfo;
-      LOGI ("game_db_get_handle: Creating new PG connection for thread %lu.",
+      LOGI ("game_db_get_handle: Creating new DB connection for thread %lu.",
 	    (unsigned long) pthread_self ());
-#endif
-
-      db = db_open (&db_cfg, &err);
+      db = game_db_open_conn ();
       if (!db)
 	{
-	  LOGE
-	    ("Failed to open new thread-local database connection (code: %d): %s",
-	     err.code, err.message);
 	  return NULL;
 	}
 
@@ -113,6 +207,393 @@ game_db_get_handle (void)
 }
 
 
+static uint64_t
+pool_now_us (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000ULL;
+}
+
+
+/* Cheap round trip; a failed one means the connection is not worth reusing */
+static int
+pool_conn_healthy (db_t *db)
+{
+  db_error_t err = { 0 };
+
+  return db_exec (db, "SELECT 1", NULL, 0, &err);
+}
+
+
+static db_t *
+pool_acquire (void)
+{
+  uint64_t t0 = pool_now_us ();
+  struct timespec deadline;
+  pool_slot_t slot = { 0 };
+  int waited = 0;
+
+  clock_gettime (CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += g_pool_wait_ms / 1000;
+  deadline.tv_nsec += (long) (g_pool_wait_ms % 1000) * 1000000L;
+  if (deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+
+  pthread_mutex_lock (&g_pool_mu);
+  for (;;)
+    {
+      if (g_pool_idle_n > 0)
+	{
+	  slot = g_pool_idle[--g_pool_idle_n];
+	  break;
+	}
+      if (g_pool_open < g_pool_max)
+	{
+	  g_pool_open++;	/* reserve; opened below */
+	  break;
+	}
+      waited = 1;
+      g_pool_waiters++;
+      int rc = pthread_cond_timedwait (&g_pool_cv, &g_pool_mu, &deadline);
+      g_pool_waiters--;
+      if (rc == ETIMEDOUT && g_pool_idle_n == 0 && g_pool_open >= g_pool_max)
+	{
+	  g_pool_timeouts++;
+	  pthread_mutex_unlock (&g_pool_mu);
+	  LOGW ("DB pool: no connection free after %d ms (max %d).",
+		g_pool_wait_ms, g_pool_max);
+	  return NULL;
+	}
+    }
+  g_pool_checkouts++;
+  if (waited)
+    {
+      uint64_t us = pool_now_us () - t0;
+
+      g_pool_waits++;
+      g_pool_wait_us_total += us;
+      if (us > g_pool_wait_us_max)
+	{
+	  g_pool_wait_us_max = us;
+	}
+    }
+  pthread_mutex_unlock (&g_pool_mu);
+
+  if (slot.db
+      && pool_now_us () / 1000 - slot.idle_since_ms > DB_POOL_HEALTH_IDLE_MS
+      && !pool_conn_healthy (slot.db))
+    {
+      LOGW ("DB pool: dropping connection %p that failed its health check.",
+	    (void *) slot.db);
+      db_close (slot.db);
+      slot.db = NULL;
+      pthread_mutex_lock (&g_pool_mu);
+      g_pool_health_failed++;
+      g_pool_closed++;
+      pthread_mutex_unlock (&g_pool_mu);
+    }
+  if (!slot.db)
+    {
+      slot.db = game_db_open_conn ();
+      pthread_mutex_lock (&g_pool_mu);
+      if (slot.db)
+	{
+	  g_pool_opened++;
+	}
+      else
+	{
+	  g_pool_open--;
+	  pthread_cond_signal (&g_pool_cv);
+	}
+      pthread_mutex_unlock (&g_pool_mu);
+    }
+  return slot.db;
+}
+
+
+static void
+pool_release (db_t *db)
+{
+  db_t *trim = NULL;
+  uint64_t now_ms = pool_now_us () / 1000;
+
+  pthread_mutex_lock (&g_pool_mu);
+  g_pool_idle[g_pool_idle_n].db = db;
+  g_pool_idle[g_pool_idle_n].idle_since_ms = now_ms;
+  g_pool_idle_n++;
+  /* The bottom of the stack is the longest idle; shrink towards min */
+  if (g_pool_open > g_pool_min && g_pool_idle_n > 1
+      && now_ms - g_pool_idle[0].idle_since_ms > DB_POOL_TRIM_IDLE_MS)
+    {
+      trim = g_pool_idle[0].db;
+      memmove (&g_pool_idle[0], &g_pool_idle[1],
+	       (size_t) (g_pool_idle_n - 1) * sizeof (pool_slot_t));
+      g_pool_idle_n--;
+      g_pool_open--;
+      g_pool_closed++;
+    }
+  pthread_cond_signal (&g_pool_cv);
+  pthread_mutex_unlock (&g_pool_mu);
+
+  if (trim)
+    {
+      db_close (trim);
+    }
+}
+
+
+/* Config is loaded from the DB after game_db_init(), so size the pool on
+   first use */
+static pthread_once_t g_pool_once = PTHREAD_ONCE_INIT;
+
+static void
+pool_setup (void)
+{
+  if (g_cfg.db_pool_max <= 0)
+    {
+      return;
+    }
+
+  pool_slot_t *idle = calloc ((size_t) g_cfg.db_pool_max, sizeof (*idle));
+
+  if (!idle)
+    {
+      LOGE ("DB pool: cannot allocate %d slots; using per-thread connections.",
+	    g_cfg.db_pool_max);
+      return;
+    }
+  pthread_mutex_lock (&g_pool_mu);
+  g_pool_idle = idle;
+  g_pool_min = g_cfg.db_pool_min < 0 ? 0
+    : (g_cfg.db_pool_min > g_cfg.db_pool_max ? g_cfg.db_pool_max
+       : g_cfg.db_pool_min);
+  g_pool_wait_ms = g_cfg.db_pool_wait_ms > 0 ? g_cfg.db_pool_wait_ms : 5000;
+  g_pool_max = g_cfg.db_pool_max;
+  pthread_mutex_unlock (&g_pool_mu);
+  LOGI ("DB pool: request connections min=%d max=%d wait=%dms.",
+	g_pool_min, g_pool_max, g_pool_wait_ms);
+}
+
+
+db_t *
+game_db_checkout (void)
+{
+  pthread_once (&g_pool_once, pool_setup);
+  if (g_pool_max <= 0)
+    {
+      return game_db_get_handle ();
+    }
+  if (t_pool_depth++ == 0)
+    {
+      t_pool_db = pool_acquire ();
+    }
+  return t_pool_db;
+}
+
+
+void
+game_db_checkin (void)
+{
+  if (g_pool_max <= 0 || t_pool_depth == 0 || --t_pool_depth > 0)
+    {
+      return;
+    }
+
+  db_t *db = t_pool_db;
+
+  t_pool_db = NULL;
+  if (!db)
+    {
+      return;
+    }
+  /* A request that returns mid-transaction must not hand it to the next */
+  if (db_tx_depth (db) > 0)
+    {
+      db_error_t err = { 0 };
+
+      LOGW ("DB pool: request left a transaction open; rolling back.");
+      db_tx_rollback (db, &err);
+    }
+  pool_release (db);
+}
+
+
+static void
+make_replica_key (void)
+{
+  pthread_key_create (&g_replica_key, db_connection_destructor);
+}
+
+
+/* This thread's replica connection, opened on first use */
+static db_t *
+replica_handle (void)
+{
+  pthread_once (&g_replica_key_once, make_replica_key);
+  db_t *db = (db_t *) pthread_getspecific (g_replica_key);
+
+  if (db)
+    {
+      return db;
+    }
+
+  uint64_t now_ms = pool_now_us () / 1000;
+
+  if (now_ms < t_replica_retry_ms)
+    {
+      return NULL;
+    }
+  db = game_db_open_conninfo (g_replica_conninfo);
+  if (!db || pthread_setspecific (g_replica_key, db) != 0)
+    {
+      LOGW ("DB replica: unavailable; reading from the primary for %d ms.",
+	    DB_REPLICA_RETRY_MS);
+      if (db)
+	{
+	  db_close (db);
+	}
+      t_replica_retry_ms = now_ms + DB_REPLICA_RETRY_MS;
+      return NULL;
+    }
+  return db;
+}
+
+
+static inline _Atomic uint64_t *
+player_write_slot (int player_id)
+{
+  return &g_player_write_ms[(uint32_t) player_id & (DB_REPLICA_PLAYER_SLOTS -
+						    1)];
+}
+
+
+int
+game_db_begin_readonly (int player_id)
+{
+  if (g_replica_conninfo[0] == '\0' || t_replica_db)
+    {
+      return 0;
+    }
+
+  /* A request inside a transaction must keep seeing its own writes */
+  pthread_once (&g_db_key_once, make_db_key);
+  db_t *primary = t_pool_depth > 0 ? t_pool_db
+    : (db_t *) pthread_getspecific (g_db_handle_key);
+
+  if (primary && db_tx_depth (primary) > 0)
+    {
+      return 0;
+    }
+
+  if (player_id > 0 && g_cfg.db_replica_stick_ms > 0)
+    {
+      uint64_t last = atomic_load_explicit (player_write_slot (player_id),
+					    memory_order_relaxed);
+
+      if (last
+	  && pool_now_us () / 1000 - last <
+	  (uint64_t) g_cfg.db_replica_stick_ms)
+	{
+	  atomic_fetch_add_explicit (&g_replica_after_write, 1,
+				     memory_order_relaxed);
+	  return 0;
+	}
+    }
+
+  db_t *db = replica_handle ();
+
+  if (!db)
+    {
+      atomic_fetch_add_explicit (&g_replica_unavailable, 1,
+				 memory_order_relaxed);
+      return 0;
+    }
+  atomic_fetch_add_explicit (&g_replica_reads, 1, memory_order_relaxed);
+  t_replica_db = db;
+  return 1;
+}
+
+
+void
+game_db_end_readonly (int routed)
+{
+  if (routed)
+    {
+      t_replica_db = NULL;
+    }
+}
+
+
+void
+game_db_note_write (int player_id)
+{
+  if (g_replica_conninfo[0] != '\0' && player_id > 0)
+    {
+      atomic_store_explicit (player_write_slot (player_id),
+			     pool_now_us () / 1000, memory_order_relaxed);
+    }
+}
+
+
+json_t *
+game_db_replica_stats_json (void)
+{
+  json_t *o = json_object ();
+
+  json_object_set_new (o, "enabled",
+		       json_boolean (g_replica_conninfo[0] != '\0'));
+  json_object_set_new (o, "stick_ms", json_integer (g_cfg.db_replica_stick_ms));
+  json_object_set_new (o, "reads",
+		       json_integer ((json_int_t) atomic_load
+				     (&g_replica_reads)));
+  json_object_set_new (o, "primary_after_write",
+		       json_integer ((json_int_t) atomic_load
+				     (&g_replica_after_write)));
+  json_object_set_new (o, "primary_unavailable",
+		       json_integer ((json_int_t) atomic_load
+				     (&g_replica_unavailable)));
+  return o;
+}
+
+
+json_t *
+game_db_pool_stats_json (void)
+{
+  json_t *o = json_object ();
+
+  pthread_mutex_lock (&g_pool_mu);
+  json_object_set_new (o, "enabled", json_boolean (g_pool_max > 0));
+  json_object_set_new (o, "min", json_integer (g_pool_min));
+  json_object_set_new (o, "max", json_integer (g_pool_max));
+  json_object_set_new (o, "open", json_integer (g_pool_open));
+  json_object_set_new (o, "idle", json_integer (g_pool_idle_n));
+  json_object_set_new (o, "in_use",
+		       json_integer (g_pool_open - g_pool_idle_n));
+  json_object_set_new (o, "waiting", json_integer (g_pool_waiters));
+  json_object_set_new (o, "checkouts",
+		       json_integer ((json_int_t) g_pool_checkouts));
+  json_object_set_new (o, "waits", json_integer ((json_int_t) g_pool_waits));
+  json_object_set_new (o, "wait_ms_avg",
+		       json_real (g_pool_waits ?
+				  (double) g_pool_wait_us_total /
+				  (double) g_pool_waits / 1000.0 : 0.0));
+  json_object_set_new (o, "wait_ms_max",
+		       json_real ((double) g_pool_wait_us_max / 1000.0));
+  json_object_set_new (o, "timeouts",
+		       json_integer ((json_int_t) g_pool_timeouts));
+  json_object_set_new (o, "opened", json_integer ((json_int_t) g_pool_opened));
+  json_object_set_new (o, "closed", json_integer ((json_int_t) g_pool_closed));
+  json_object_set_new (o, "health_failed",
+		       json_integer ((json_int_t) g_pool_health_failed));
+  pthread_mutex_unlock (&g_pool_mu);
+  return o;
+}
+
+
 void
 game_db_after_fork_child (void)
 {
@@ -130,4 +611,30 @@ game_db_after_fork_child (void)
       db_close_child (db);
       pthread_setspecific (g_db_handle_key, NULL);
     }
+
+  /* Pooled connections belong to the parent too; the child starts empty */
+  pthread_mutex_init (&g_pool_mu, NULL);
+  pthread_cond_init (&g_pool_cv, NULL);
+  while (g_pool_idle_n > 0)
+    {
+      db_close_child (g_pool_idle[--g_pool_idle_n].db);
+    }
+  if (t_pool_db)
+    {
+      db_close_child (t_pool_db);
+      t_pool_db = NULL;
+    }
+  t_pool_depth = 0;
+  g_pool_open = 0;
+  g_pool_waiters = 0;
+
+  pthread_once (&g_replica_key_once, make_replica_key);
+  db_t *replica = (db_t *) pthread_getspecific (g_replica_key);
+
+  if (replica)
+    {
+      db_close_child (replica);
+      pthread_setspecific (g_replica_key, NULL);
+    }
+  t_replica_db = NULL;
 }
@@ -11,10 +11,22 @@
  * - game_db_init() caches the connection configuration but does not create a
  *   global connection.
  * - Connections are automatically closed on thread exit via a TLS destructor.
+ *
+ * With db_pool_max > 0, client requests instead borrow a connection from a
+ * bounded pool: game_db_checkout() before handling a message and
+ * game_db_checkin() after it. Between the two, game_db_get_handle() on that
+ * thread returns the borrowed connection (NULL if none came free within
+ * db_pool_wait_ms). Threads outside a checkout (engine, cron, main) keep
+ * their own per-thread connection as above.
+ *
+ * When the bootstrap config names a read replica, commands flagged
+ * CMD_FLAG_READONLY run against a per-thread replica connection instead
+ * (game_db_begin_readonly/end_readonly around the handler).
  */
 #ifndef GAME_DB_H
 #define GAME_DB_H
 
+#include <jansson.h>
 #include "db/db_api.h"
 
 /**
@@ -38,6 +50,43 @@ void game_db_close (void);
  */
 db_t *game_db_get_handle (void);
 
+/**
+ * @brief Borrows a pooled connection for the current request.
+ * Nested calls share the outer checkout. Without a pool this is
+ * game_db_get_handle().
+ * @return The connection, or NULL if the pool stayed exhausted.
+ */
+db_t *game_db_checkout (void);
+
+/**
+ * @brief Returns the connection taken by the matching game_db_checkout().
+ * A transaction still open at the outermost checkin is rolled back first.
+ */
+void game_db_checkin (void);
+
+/* New reference: pool size, usage and checkout wait-time counters. */
+json_t *game_db_pool_stats_json (void);
+
+/**
+ * @brief Routes game_db_get_handle() on this thread to the read replica
+ *        for a read-only command run on behalf of player_id.
+ * Stays on the primary (returns 0) when no replica is configured or it is
+ * unreachable, inside a transaction, or when the player wrote within the
+ * last db_replica_stick_ms, so a session reads its own writes.
+ * @return 1 if routed; pass the value to game_db_end_readonly().
+ */
+int game_db_begin_readonly (int player_id);
+void game_db_end_readonly (int routed);
+
+/**
+ * @brief Records that a command for player_id may have written, keeping
+ *        that player's reads on the primary for db_replica_stick_ms.
+ */
+void game_db_note_write (int player_id);
+
+/* New reference: replica routing counters. */
+json_t *game_db_replica_stats_json (void);
+
 /**
  * @brief Cleans up database state in a child process after a fork.
  * This should be called immediately in the child process to prevent using
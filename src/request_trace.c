@@ -0,0 +1,373 @@
+/* src/request_trace.c */
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* local includes */
+#include "request_trace.h"
+#include "server_log.h"
+#include "db/db_api.h"
+
+#define TRACE_LOG_NAMES  16	/* distinct span names in a log summary */
+
+typedef struct
+{
+  const char *name;		/* literal: request, session, schema, db, ... */
+  uint64_t start_us;
+  uint64_t dur_us;
+  char detail[TRACE_DETAIL_MAX];	/* command, SQL template, ... */
+} trace_span_t;
+
+struct trace_req_s
+{
+  uint64_t cid;
+  int tid;
+  int n_spans;
+  int dropped;
+  trace_span_t spans[TRACE_MAX_SPANS];	/* [0] is the request itself */
+};
+
+/* A published span and where it ran */
+typedef struct
+{
+  trace_span_t span;
+  uint64_t cid;
+  int tid;
+} trace_event_t;
+
+static pthread_mutex_t g_ring_mu = PTHREAD_MUTEX_INITIALIZER;
+static trace_event_t *g_ring = NULL;
+static size_t g_ring_cap = 0;
+static uint64_t g_ring_next = 0;	/* spans ever published; guarded by g_ring_mu */
+
+static bool g_enabled = false;
+static int g_log_sample = 0;
+static _Atomic uint64_t g_requests = 0;
+
+static pthread_key_t g_buf_key;	/* frees t_buf when its thread exits */
+static pthread_once_t g_buf_once = PTHREAD_ONCE_INIT;
+static __thread trace_req_t *t_buf = NULL;	/* this thread's buffer, reused */
+static __thread trace_req_t *t_req = NULL;	/* open request, if any */
+
+
+uint64_t
+trace_now_us (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000ULL + (uint64_t) ts.tv_nsec / 1000ULL;
+}
+
+
+/* Copy with whitespace runs folded, so multi-line SQL reads on one line */
+static void
+trace_copy_detail (char *dst, const char *src)
+{
+  size_t n = 0;
+  bool space = true;		/* also trims leading whitespace */
+
+  for (const char *p = src; p && *p && n < TRACE_DETAIL_MAX - 1; p++)
+    {
+      if (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')
+	{
+	  if (!space)
+	    {
+	      dst[n++] = ' ';
+	    }
+	  space = true;
+	  continue;
+	}
+      dst[n++] = *p;
+      space = false;
+    }
+  if (n > 0 && dst[n - 1] == ' ')
+    {
+      n--;
+    }
+  dst[n] = '\0';
+}
+
+
+static void
+trace_buf_key_init (void)
+{
+  pthread_key_create (&g_buf_key, free);
+}
+
+
+/* db_api.c calls this after every statement on any thread */
+static void
+trace_db_hook (const char *sql, uint64_t start_us, uint64_t dur_us, bool ok)
+{
+  if (t_req)
+    {
+      trace_span_add (ok ? "db" : "db.error", sql, start_us, dur_us);
+    }
+}
+
+
+void
+trace_init (int ring_spans, int log_sample)
+{
+  if (ring_spans > 0)
+    {
+      g_ring = calloc ((size_t) ring_spans, sizeof (*g_ring));
+      if (g_ring)
+	{
+	  g_ring_cap = (size_t) ring_spans;
+	}
+      else
+	{
+	  LOGW ("trace: cannot allocate a ring of %d spans", ring_spans);
+	}
+    }
+  g_log_sample = log_sample > 0 ? log_sample : 0;
+  g_enabled = g_ring_cap > 0 || g_log_sample > 0;
+  db_set_trace_hook (g_enabled ? trace_db_hook : NULL);
+  if (g_enabled)
+    {
+      LOGI ("request tracing on: ring %zu spans, logging 1/%d requests",
+	    g_ring_cap, g_log_sample);
+    }
+}
+
+
+trace_req_t *
+trace_request_begin (uint64_t cid, const char *name)
+{
+  if (!g_enabled || t_req)
+    {
+      return NULL;
+    }
+  if (!t_buf)
+    {
+      t_buf = calloc (1, sizeof (*t_buf));
+      if (!t_buf)
+	{
+	  return NULL;
+	}
+      t_buf->tid = (int) syscall (SYS_gettid);
+      pthread_once (&g_buf_once, trace_buf_key_init);
+      pthread_setspecific (g_buf_key, t_buf);
+    }
+  t_req = t_buf;
+  t_req->cid = cid;
+  t_req->n_spans = 0;
+  t_req->dropped = 0;
+  (void) trace_span_begin ("request", name);
+  return t_req;
+}
+
+
+int
+trace_span_begin (const char *name, const char *detail)
+{
+  trace_req_t *req = t_req;
+
+  if (!req)
+    {
+      return -1;
+    }
+  if (req->n_spans >= TRACE_MAX_SPANS)
+    {
+      req->dropped++;
+      return -1;
+    }
+
+  int i = req->n_spans++;
+  trace_span_t *s = &req->spans[i];
+
+  s->name = name;
+  trace_copy_detail (s->detail, detail);
+  s->dur_us = 0;
+  s->start_us = trace_now_us ();
+  return i;
+}
+
+
+void
+trace_span_end (int span)
+{
+  trace_req_t *req = t_req;
+
+  if (req && span >= 0 && span < req->n_spans)
+    {
+      trace_span_t *s = &req->spans[span];
+      s->dur_us = trace_now_us () - s->start_us;
+    }
+}
+
+
+void
+trace_span_add (const char *name, const char *detail,
+		uint64_t start_us, uint64_t dur_us)
+{
+  int i = trace_span_begin (name, detail);
+
+  if (i >= 0)
+    {
+      t_req->spans[i].start_us = start_us;
+      t_req->spans[i].dur_us = dur_us;
+    }
+}
+
+
+/* One line per sampled request: time per span name, nested spans included
+   in their parent's time. */
+static void
+trace_log (const trace_req_t *req)
+{
+  const char *names[TRACE_LOG_NAMES];
+  uint64_t total[TRACE_LOG_NAMES];
+  int count[TRACE_LOG_NAMES];
+  int n = 0;
+
+  for (int i = 1; i < req->n_spans; i++)
+    {
+      const trace_span_t *s = &req->spans[i];
+      int j = 0;
+
+      while (j < n && strcmp (names[j], s->name) != 0)
+	{
+	  j++;
+	}
+      if (j == n)
+	{
+	  if (n == TRACE_LOG_NAMES)
+	    {
+	      continue;
+	    }
+	  names[n] = s->name;
+	  total[n] = 0;
+	  count[n] = 0;
+	  n++;
+	}
+      total[j] += s->dur_us;
+      count[j]++;
+    }
+
+  char line[512];
+  size_t off = 0;
+
+  line[0] = '\0';
+  for (int j = 0; j < n && off < sizeof (line); j++)
+    {
+      int w = snprintf (line + off, sizeof (line) - off, "%s%s %.2f",
+			j ? ", " : "", names[j], (double) total[j] / 1000.0);
+      if (w > 0 && count[j] > 1 && off + (size_t) w < sizeof (line))
+	{
+	  w += snprintf (line + off + w, sizeof (line) - off - w, " (%d)",
+			 count[j]);
+	}
+      if (w < 0)
+	{
+	  break;
+	}
+      off += (size_t) w;
+    }
+
+  const trace_span_t *root = &req->spans[0];
+  LOGI ("[cid=%" PRIu64 "] trace %s %.2f ms: %s%s", req->cid, root->detail,
+	(double) root->dur_us / 1000.0, n ? line : "no spans",
+	req->dropped ? " (spans dropped)" : "");
+}
+
+
+void
+trace_request_end (trace_req_t *req)
+{
+  if (!req || req != t_req)
+    {
+      return;
+    }
+  trace_span_end (0);
+  t_req = NULL;
+
+  if (g_ring_cap > 0)
+    {
+      pthread_mutex_lock (&g_ring_mu);
+      for (int i = 0; i < req->n_spans; i++)
+	{
+	  trace_event_t *e = &g_ring[g_ring_next++ % g_ring_cap];
+
+	  e->span = req->spans[i];
+	  e->cid = req->cid;
+	  e->tid = req->tid;
+	}
+      pthread_mutex_unlock (&g_ring_mu);
+    }
+
+  if (g_log_sample > 0
+      && atomic_fetch_add_explicit (&g_requests, 1,
+				    memory_order_relaxed) % (uint64_t)
+      g_log_sample == 0)
+    {
+      trace_log (req);
+    }
+}
+
+
+json_t *
+trace_dump_chrome_json (void)
+{
+  trace_event_t *copy = NULL;
+  size_t n = 0;
+
+  /* Snapshot, then build the JSON without holding up request ends */
+  pthread_mutex_lock (&g_ring_mu);
+  if (g_ring_cap > 0)
+    {
+      n = g_ring_next < g_ring_cap ? (size_t) g_ring_next : g_ring_cap;
+      copy = n ? malloc (n * sizeof (*copy)) : NULL;
+      if (copy)
+	{
+	  uint64_t first = g_ring_next - n;
+
+	  for (size_t k = 0; k < n; k++)
+	    {
+	      copy[k] = g_ring[(first + k) % g_ring_cap];
+	    }
+	}
+      else
+	{
+	  n = 0;
+	}
+    }
+  pthread_mutex_unlock (&g_ring_mu);
+
+  json_t *events = json_array ();
+  json_int_t pid = (json_int_t) getpid ();
+
+  for (size_t k = 0; k < n; k++)
+    {
+      const trace_event_t *e = &copy[k];
+      json_t *ev = json_object ();
+      json_t *args = json_object ();
+
+      json_object_set_new (ev, "name",
+			   json_string (e->span.detail[0] ? e->span.
+					detail : e->span.name));
+      json_object_set_new (ev, "cat", json_string (e->span.name));
+      json_object_set_new (ev, "ph", json_string ("X"));
+      json_object_set_new (ev, "ts", json_integer ((json_int_t) e->span.start_us));
+      json_object_set_new (ev, "dur", json_integer ((json_int_t) e->span.dur_us));
+      json_object_set_new (ev, "pid", json_integer (pid));
+      json_object_set_new (ev, "tid", json_integer (e->tid));
+      json_object_set_new (args, "cid", json_integer ((json_int_t) e->cid));
+      json_object_set_new (ev, "args", args);
+      json_array_append_new (events, ev);
+    }
+  free (copy);
+
+  json_t *out = json_object ();
+  json_object_set_new (out, "traceEvents", events);
+  json_object_set_new (out, "displayTimeUnit", json_string ("ms"));
+  return out;
+}
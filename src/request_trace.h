@@ -0,0 +1,54 @@
+#ifndef REQUEST_TRACE_H
+#define REQUEST_TRACE_H
+#include <stdint.h>
+#include <jansson.h>
+
+/*
+ * Per-request tracing.
+ *
+ * A worker opens a trace around each request it processes
+ * (trace_request_begin/end); everything that runs on that thread in between
+ * can add timed spans: session resolution, schema validation, the handler,
+ * every DB statement (through the db_api.c trace hook) and response
+ * serialisation. Spans live in a per-thread buffer while the request runs,
+ * so recording takes no lock.
+ *
+ * When the request ends its spans are appended to a process-wide ring
+ * (trace_ring_spans, newest win) that sysop.trace.dump returns as Chrome
+ * trace-event JSON, and every Nth request (trace_log_sample) is summarised
+ * in the log. With both set to 0 tracing is off and every call below is a
+ * no-op.
+ */
+
+/* Spans kept per request; later ones are counted as dropped */
+#define TRACE_MAX_SPANS   128
+#define TRACE_DETAIL_MAX  96
+
+typedef struct trace_req_s trace_req_t;
+
+/* ring_spans <= 0 disables the ring, log_sample <= 0 disables logging.
+   Call once at startup, before the workers run. */
+void trace_init (int ring_spans, int log_sample);
+
+/* Open the calling thread's trace for one request (name: the command).
+   Returns NULL when tracing is off. */
+trace_req_t *trace_request_begin (uint64_t cid, const char *name);
+/* Close it: publish to the ring and, if sampled, log a summary. */
+void trace_request_end (trace_req_t * req);
+
+/* Spans of the calling thread's open request. name must be a string
+   literal; detail is copied (may be NULL). trace_span_begin returns a
+   handle for trace_span_end, or -1 when nothing is recorded. */
+int trace_span_begin (const char *name, const char *detail);
+void trace_span_end (int span);
+/* A span that has already finished (start_us on the trace_now_us clock) */
+void trace_span_add (const char *name, const char *detail,
+		     uint64_t start_us, uint64_t dur_us);
+
+uint64_t trace_now_us (void);
+
+/* New reference: { "traceEvents": [...], "displayTimeUnit": "ms" },
+   oldest span first. */
+json_t *trace_dump_chrome_json (void);
+
+#endif /* REQUEST_TRACE_H */
@@ -5,6 +5,7 @@
 #include "server_log.h"
 #include "server_config.h"
 #include "server_envelope.h"
+#include "cmd_index.h"
 
 
 /*
@@ -265,6 +266,442 @@ validate_json_schema (json_t *schema, json_t *payload, char **why)
 }
 
 
+/*
+ * =============================================================================
+ * --- Compiled validators ---
+ *
+ * validate_json_schema() re-reads the schema and strcmp()s type names on
+ * every request. schema_compile() does that once and produces a flat
+ * program: one type tag per property, a hashed property table with the keys
+ * copied (interned) into the program, and the "required" list as indices.
+ * schema_prog_validate() then walks the payload once, marking a bitmap of
+ * seen properties on the stack, and only allocates to report an error.
+ * Error messages and their precedence match validate_json_schema().
+ * =============================================================================
+ */
+
+#define SCHEMA_PROG_MAX_PROPS 256
+
+enum
+{
+  SCHEMA_T_ANY = 0,		/* unchecked (no/unknown type) */
+  SCHEMA_T_OBJECT,
+  SCHEMA_T_ARRAY,
+  SCHEMA_T_STRING,
+  SCHEMA_T_INTEGER,
+  SCHEMA_T_NUMBER,
+  SCHEMA_T_BOOLEAN,
+  SCHEMA_T_NULL,
+  SCHEMA_T_ERR_NO_TYPE,		/* schema has no "type" */
+  SCHEMA_T_ERR_TYPE_NOT_STRING	/* schema "type" is not a string */
+};
+
+static const char *const k_schema_type_names[] = {
+  [SCHEMA_T_OBJECT] = "object",
+  [SCHEMA_T_ARRAY] = "array",
+  [SCHEMA_T_STRING] = "string",
+  [SCHEMA_T_INTEGER] = "integer",
+  [SCHEMA_T_NUMBER] = "number",
+  [SCHEMA_T_BOOLEAN] = "boolean",
+  [SCHEMA_T_NULL] = "null",
+};
+
+typedef struct
+{
+  const char *key;		/* points into prog->keys */
+  uint32_t hash;
+  uint8_t tag;
+} schema_prop_t;
+
+struct schema_prog_s
+{
+  uint8_t top;			/* SCHEMA_T_* of the schema itself */
+  uint16_t nprops;
+  uint16_t nrequired;
+  uint16_t mask;		/* slot table size - 1 */
+  schema_prop_t *props;
+  uint16_t *slots;		/* prop index + 1, 0 = empty */
+  uint16_t *required;		/* prop indices, in "required" order */
+  char *keys;			/* interned property names */
+  json_t *fallback;		/* too many properties: interpret instead */
+};
+
+
+static uint32_t
+schema_key_hash (const char *k)
+{
+  uint32_t h = 2166136261u;
+
+  while (*k)
+    {
+      h ^= (unsigned char) *k++;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+
+static uint8_t
+schema_type_tag (json_t *type)
+{
+  const char *t = json_string_value (type);
+
+  if (!t)
+    {
+      return SCHEMA_T_ANY;
+    }
+  for (uint8_t i = SCHEMA_T_OBJECT; i <= SCHEMA_T_NULL; i++)
+    {
+      if (strcmp (t, k_schema_type_names[i]) == 0)
+	{
+	  return i;
+	}
+    }
+  return SCHEMA_T_ANY;
+}
+
+
+static int
+schema_prog_find (const schema_prog_t *prog, const char *key)
+{
+  if (prog->nprops == 0)
+    {
+      return -1;
+    }
+  uint32_t h = schema_key_hash (key);
+
+  for (uint16_t i = h & prog->mask; prog->slots[i];
+       i = (i + 1) & prog->mask)
+    {
+      const schema_prop_t *p = &prog->props[prog->slots[i] - 1];
+
+      if (p->hash == h && strcmp (p->key, key) == 0)
+	{
+	  return prog->slots[i] - 1;
+	}
+    }
+  return -1;
+}
+
+
+/* Add (or find) a property; its key is copied to *arena. */
+static int
+schema_prog_add (schema_prog_t *prog, const char *key, uint8_t tag,
+		 char **arena)
+{
+  int idx = schema_prog_find (prog, key);
+
+  if (idx >= 0)
+    {
+      if (tag != SCHEMA_T_ANY)
+	{
+	  prog->props[idx].tag = tag;
+	}
+      return idx;
+    }
+  size_t len = strlen (key) + 1;
+  schema_prop_t *p = &prog->props[prog->nprops];
+
+  memcpy (*arena, key, len);
+  p->key = *arena;
+  p->hash = schema_key_hash (key);
+  p->tag = tag;
+  *arena += len;
+
+  uint16_t i = p->hash & prog->mask;
+
+  while (prog->slots[i])
+    {
+      i = (i + 1) & prog->mask;
+    }
+  prog->slots[i] = (uint16_t) (prog->nprops + 1);
+  return prog->nprops++;
+}
+
+
+schema_prog_t *
+schema_compile (json_t *schema)
+{
+  if (!schema)
+    {
+      return NULL;
+    }
+  schema_prog_t *prog = calloc (1, sizeof (*prog));
+
+  if (!prog)
+    {
+      return NULL;
+    }
+
+  json_t *type = json_object_get (schema, "type");
+
+  if (!type)
+    {
+      prog->top = SCHEMA_T_ERR_NO_TYPE;
+      return prog;
+    }
+  if (!json_is_string (type))
+    {
+      prog->top = SCHEMA_T_ERR_TYPE_NOT_STRING;
+      return prog;
+    }
+  prog->top = schema_type_tag (type);
+  if (prog->top != SCHEMA_T_OBJECT)
+    {
+      return prog;
+    }
+
+  json_t *required = json_object_get (schema, "required");
+  json_t *properties = json_object_get (schema, "properties");
+
+  if (!json_is_array (required))
+    {
+      required = NULL;
+    }
+  if (!json_is_object (properties))
+    {
+      properties = NULL;
+    }
+
+  /* Size the tables: properties plus required names */
+  size_t nkeys = 0;
+  size_t keybytes = 0;
+  const char *key;
+  json_t *val;
+  size_t i;
+
+  json_object_foreach (properties, key, val)
+  {
+    nkeys++;
+    keybytes += strlen (key) + 1;
+  }
+  json_array_foreach (required, i, val)
+  {
+    if (json_is_string (val))
+      {
+	nkeys++;
+	keybytes += strlen (json_string_value (val)) + 1;
+      }
+  }
+  if (nkeys == 0)
+    {
+      return prog;
+    }
+  if (nkeys > SCHEMA_PROG_MAX_PROPS)
+    {
+      prog->fallback = json_incref (schema);
+      return prog;
+    }
+
+  size_t cap = 8;
+
+  while (cap < nkeys * 2)
+    {
+      cap <<= 1;
+    }
+  prog->mask = (uint16_t) (cap - 1);
+  prog->props = calloc (nkeys, sizeof (*prog->props));
+  prog->slots = calloc (cap, sizeof (*prog->slots));
+  prog->required = calloc (nkeys, sizeof (*prog->required));
+  prog->keys = malloc (keybytes);
+  if (!prog->props || !prog->slots || !prog->required || !prog->keys)
+    {
+      schema_prog_free (prog);
+      return NULL;
+    }
+
+  char *arena = prog->keys;
+
+  json_object_foreach (properties, key, val)
+  {
+    /* A property without a string "type" is not checked */
+    uint8_t tag = json_is_object (val)
+      ? schema_type_tag (json_object_get (val, "type")) : SCHEMA_T_ANY;
+
+    /* The interpreter has no "null" case for properties */
+    if (tag == SCHEMA_T_NULL)
+      {
+	tag = SCHEMA_T_ANY;
+      }
+    schema_prog_add (prog, key, tag, &arena);
+  }
+  json_array_foreach (required, i, val)
+  {
+    if (json_is_string (val))
+      {
+	prog->required[prog->nrequired++] =
+	  (uint16_t) schema_prog_add (prog, json_string_value (val),
+				      SCHEMA_T_ANY, &arena);
+      }
+  }
+  return prog;
+}
+
+
+void
+schema_prog_free (schema_prog_t *prog)
+{
+  if (!prog)
+    {
+      return;
+    }
+  free (prog->props);
+  free (prog->slots);
+  free (prog->required);
+  free (prog->keys);
+  if (prog->fallback)
+    {
+      json_decref (prog->fallback);
+    }
+  free (prog);
+}
+
+
+/* payload == NULL stands for an empty object */
+static bool
+schema_tag_matches (uint8_t tag, json_t *v)
+{
+  switch (tag)
+    {
+    case SCHEMA_T_OBJECT:
+      return v == NULL || json_is_object (v);
+    case SCHEMA_T_ARRAY:
+      return v && json_is_array (v);
+    case SCHEMA_T_STRING:
+      return v && json_is_string (v);
+    case SCHEMA_T_INTEGER:
+      return v && json_is_integer (v);
+    case SCHEMA_T_NUMBER:
+      return v && json_is_number (v);
+    case SCHEMA_T_BOOLEAN:
+      return v && json_is_boolean (v);
+    case SCHEMA_T_NULL:
+      return v && json_is_null (v);
+    default:
+      return true;
+    }
+}
+
+
+int
+schema_prog_validate (const schema_prog_t *prog, json_t *payload, char **why)
+{
+  char buf[256];
+
+  if (why)
+    {
+      *why = NULL;
+    }
+  if (payload && !json_is_object (payload))
+    {
+      if (why)
+	{
+	  *why = why_dup ("payload must be an object");
+	}
+      return -1;
+    }
+  if (!prog)
+    {
+      if (why)
+	{
+	  *why = why_dup ("Unknown command type");
+	}
+      return -1;
+    }
+  if (prog->fallback)
+    {
+      return schema_validate_json (prog->fallback, payload, why);
+    }
+
+  switch (prog->top)
+    {
+    case SCHEMA_T_ERR_NO_TYPE:
+      if (why)
+	*why = why_dup ("schema missing 'type' field");
+      return -1;
+    case SCHEMA_T_ERR_TYPE_NOT_STRING:
+      if (why)
+	*why = why_dup ("schema 'type' is not a string");
+      return -1;
+    case SCHEMA_T_OBJECT:
+      break;
+    case SCHEMA_T_ANY:
+      return 0;
+    default:
+      if (!schema_tag_matches (prog->top, payload))
+	{
+	  if (why)
+	    {
+	      snprintf (buf, sizeof (buf), "expected %s, got different type",
+			k_schema_type_names[prog->top]);
+	      *why = why_dup (buf);
+	    }
+	  return -1;
+	}
+      return 0;
+    }
+
+  if (prog->nprops == 0)
+    {
+      return 0;
+    }
+
+  uint64_t seen[SCHEMA_PROG_MAX_PROPS / 64] = { 0 };
+  const char *bad_key = NULL;
+  uint8_t bad_tag = SCHEMA_T_ANY;
+
+  if (payload)
+    {
+      const char *key;
+      json_t *value;
+
+      json_object_foreach (payload, key, value)
+      {
+	int idx = schema_prog_find (prog, key);
+
+	if (idx < 0)
+	  {
+	    continue;		/* additionalProperties: allowed */
+	  }
+	seen[idx / 64] |= 1ULL << (idx % 64);
+	if (!bad_key && !schema_tag_matches (prog->props[idx].tag, value))
+	  {
+	    bad_key = key;
+	    bad_tag = prog->props[idx].tag;
+	  }
+      }
+    }
+
+  /* Missing required properties are reported before type mismatches */
+  for (uint16_t r = 0; r < prog->nrequired; r++)
+    {
+      uint16_t idx = prog->required[r];
+
+      if (!(seen[idx / 64] & (1ULL << (idx % 64))))
+	{
+	  if (why)
+	    {
+	      snprintf (buf, sizeof (buf), "missing required property: %s",
+			prog->props[idx].key);
+	      *why = why_dup (buf);
+	    }
+	  return -1;
+	}
+    }
+  if (bad_key)
+    {
+      if (why)
+	{
+	  snprintf (buf, sizeof (buf), "property '%s' must be %s", bad_key,
+		    k_schema_type_names[bad_tag]);
+	  *why = why_dup (buf);
+	}
+      return -1;
+    }
+  return 0;
+}
+
+
 /*
  * =============================================================================
  * --- PUBLIC API: C2S Schema Registry ---
@@ -521,6 +958,20 @@ schema_placeholder (void)
 
 json_t *
 schema_get (const char *key)
+{
+  json_t *out = schema_lookup_builtin (key);
+
+  if (out)
+    {
+      return out;
+    }
+  /* Fallback to registry if not in our table */
+  return loop_get_schema_for_command (key);
+}
+
+
+json_t *
+schema_lookup_builtin (const char *key)
 {
   if (!key)
     {
@@ -553,9 +1004,7 @@ schema_get (const char *key)
     }
 
   pthread_mutex_unlock (&g_schema_mu);
-
-  /* Fallback to registry if not in our table */
-  return loop_get_schema_for_command (key);
+  return NULL;
 }
 
 
@@ -648,6 +1097,48 @@ capabilities_build (void)
  * --- PUBLIC API: C2S Schema Validation ---
  * =============================================================================
  */
+/* Compiled programs for g_schema_table, keyed like schema_get() */
+static cmd_index_t *g_schema_progs = NULL;
+static pthread_once_t g_schema_progs_once = PTHREAD_ONCE_INIT;
+
+
+static void
+schema_progs_build (void)
+{
+  size_t n = sizeof (g_schema_table) / sizeof (g_schema_table[0]);
+
+  g_schema_progs = cmd_index_new (n);
+  if (!g_schema_progs)
+    {
+      LOGE ("schema: cannot allocate validator index");
+      return;
+    }
+  for (size_t i = 0; i < n; i++)
+    {
+      json_t *schema = schema_lookup_builtin (g_schema_table[i].key);
+      schema_prog_t *prog = schema_compile (schema);
+
+      if (schema)
+	{
+	  json_decref (schema);
+	}
+      if (prog && cmd_index_put (g_schema_progs, g_schema_table[i].key,
+				 prog) != 1)
+	{
+	  schema_prog_free (prog);	/* duplicate key: first one wins */
+	}
+    }
+}
+
+
+static const schema_prog_t *
+schema_builtin_prog (const char *key)
+{
+  pthread_once (&g_schema_progs_once, schema_progs_build);
+  return (const schema_prog_t *) cmd_index_get (g_schema_progs, key);
+}
+
+
 int
 schema_validate_payload (const char *type, json_t *payload, char **why)
 {
@@ -664,6 +1155,24 @@ schema_validate_payload (const char *type, json_t *payload, char **why)
       return -1;
     }
 
+  const schema_prog_t *prog = schema_builtin_prog (type);
+
+  if (!prog)
+    {
+      prog = loop_get_validator_for_command (type);
+    }
+  return schema_prog_validate (prog, payload, why);
+}
+
+
+int
+schema_validate_json (json_t *schema, json_t *payload, char **why)
+{
+  if (why)
+    {
+      *why = NULL;
+    }
+
   // Handle NULL payload by treating it as an empty object
   json_t JSON_AUTO *temp_payload = NULL; // Declared with JSON_AUTO for automatic cleanup
   if (!payload)
@@ -680,9 +1189,6 @@ schema_validate_payload (const char *type, json_t *payload, char **why)
 	}
       return -1;
     }
-  /* 1. GET THE SCHEMA from your registry */
-  json_t *schema = schema_get (type);
-
 
   if (!schema)
     {
@@ -693,20 +1199,7 @@ schema_validate_payload (const char *type, json_t *payload, char **why)
       return -1;
     }
 
-  /*
-   * ===================================================================
-   * === ADD YOUR DEBUG CODE HERE ===
-   * We only want to print if the type matches
-   */
-
-  /* ===================================================================
-   */
-  /* 2. VALIDATE THE PAYLOAD against the schema */
-  int result = validate_json_schema (schema, payload, why);
-
-
-  json_decref (schema);
-  return result;
+  return validate_json_schema (schema, payload, why);
 }
 
 
@@ -1411,6 +1904,16 @@ schema_system_hello (void)
   json_object_set_new (props, "client_version", client_version_prop);
 
 
+  json_t *capabilities_prop = json_object ();
+  json_t *capabilities_items = json_object ();
+
+
+  json_object_set_new (capabilities_items, "type", json_string ("string"));
+  json_object_set_new (capabilities_prop, "type", json_string ("array"));
+  json_object_set_new (capabilities_prop, "items", capabilities_items);
+  json_object_set_new (props, "capabilities", capabilities_prop);
+
+
   return root;
 }
 
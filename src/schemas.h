@@ -25,6 +25,12 @@ json_t *capabilities_build (void);
  */
 json_t *schema_get (const char *key);
 
+/**
+ * @brief Like schema_get(), but only consults the built-in schema table
+ *        (never the command registry).
+ */
+json_t *schema_lookup_builtin (const char *key);
+
 /**
  * @brief Shutdown the schema system and free the cache.
  */
@@ -47,6 +53,39 @@ json_t *schema_keys (void);
  */
 int schema_validate_payload (const char *type, json_t * payload, char **why);
 
+/**
+ * @brief Validate a client payload against an already resolved schema.
+ *
+ * Same checks as schema_validate_payload(), minus the lookup by name.
+ * A NULL schema fails with "Unknown command type".
+ */
+int schema_validate_json (json_t * schema, json_t * payload, char **why);
+
+/**
+ * @brief A schema compiled into a flat validator program.
+ *
+ * Immutable once built, so it can be shared between threads without a lock.
+ */
+typedef struct schema_prog_s schema_prog_t;
+
+/**
+ * @brief Compile a JSON Schema. The program does not reference @p schema.
+ * @return A new program, or NULL if @p schema is NULL or allocation failed.
+ */
+schema_prog_t *schema_compile (json_t * schema);
+void schema_prog_free (schema_prog_t * prog);
+
+/**
+ * @brief Validate a payload with a compiled program.
+ *
+ * Same results and messages as schema_validate_json() on the source schema,
+ * but takes no lock and does not allocate unless validation fails. A NULL
+ * payload is treated as an empty object; a NULL program fails with
+ * "Unknown command type".
+ */
+int schema_prog_validate (const schema_prog_t * prog, json_t * payload,
+			  char **why);
+
 /**
  * @brief (S2S) Manually validate an inter-server (s2s) payload.
  *
@@ -60,6 +99,7 @@ int s2s_validate_payload (const char *type, json_t * payload, char **why);
 /* --- Registry Hooks (Implemented in server_loop.c) --- */
 json_t *loop_get_schema_for_command (const char *name);
 json_t *loop_get_all_schema_keys (void);
+const schema_prog_t *loop_get_validator_for_command (const char *name);
 
 /* --- Schema Generators (Exposed for Registry) --- */
 json_t *schema_envelope (void);
@@ -27,6 +27,9 @@
 #include "server_log.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "session_cache.h"
+#include "topic_index.h"
+#include "client_registry.h"
 
 
 static bool
@@ -55,6 +58,7 @@ subs_upsert_locked_defaults (db_t *db, int player_id, bool is_sysop)
     {
       return ERR_DB;
     }
+  topic_index_add (player_id, "global");
 
   char chan[64];
   snprintf (chan, sizeof (chan), "player.%d", player_id);
@@ -63,6 +67,7 @@ subs_upsert_locked_defaults (db_t *db, int player_id, bool is_sysop)
     {
       return ERR_DB;
     }
+  topic_index_add (player_id, chan);
 
   if (is_sysop)
     {
@@ -70,6 +75,7 @@ subs_upsert_locked_defaults (db_t *db, int player_id, bool is_sysop)
 	{
 	  return ERR_DB;
 	}
+      topic_index_add (player_id, "sysop");
     }
   return 0;
 }
@@ -125,7 +131,11 @@ hydrate_player_defaults (int player_id)
        sizeof (k_required_locked_topics) /
        sizeof (k_required_locked_topics[0]); ++i)
     {
-      upsert_locked_subscription (db, player_id, k_required_locked_topics[i]);
+      if (upsert_locked_subscription (db, player_id,
+				      k_required_locked_topics[i]) == 0)
+	{
+	  topic_index_add (player_id, k_required_locked_topics[i]);
+	}
     }
   for (size_t i = 0;
        i < sizeof (k_default_prefs) / sizeof (k_default_prefs[0]); ++i)
@@ -261,6 +271,7 @@ cmd_auth_login (client_ctx_t *ctx, json_t *root)
 
       ctx->player_id = pid;
       ctx->sector_id = sid;
+      client_registry_update (ctx);
 
       bool is_sysop = player_is_sysop (db, pid);
 
@@ -414,6 +425,7 @@ cmd_auth_register (client_ctx_t *ctx, json_t *root)
   repo_auth_insert_initial_turns (db, now_ts, pid, cfg->turnsperday);
 
   ctx->sector_id = spawn_sid;
+  client_registry_update (ctx);
 
   int start_creds = cfg->startingcredits > 0 ? cfg->startingcredits : 1000;
   repo_auth_update_player_credits (db, start_creds, pid);
@@ -497,8 +509,11 @@ cmd_auth_logout (client_ctx_t *ctx, json_t *root)
   if (tok)
     {
       db_session_revoke (tok);
+      session_cache_invalidate_token (tok);
     }
+  topic_index_unbind (ctx);
   ctx->player_id = 0;
+  client_registry_update (ctx);
   json_t *data = json_object ();
 
 
@@ -593,6 +608,7 @@ cmd_auth_refresh (client_ctx_t *ctx, json_t *root)
       h_generate_hex_uuid (newtok, sizeof (newtok));
       if (db_session_refresh (tok, 86400, newtok, &pid) == 0)
 	{
+	  session_cache_invalidate_token (tok);
 	  bool is_sysop = player_is_sysop (db, pid);
 
 
@@ -603,6 +619,7 @@ cmd_auth_refresh (client_ctx_t *ctx, json_t *root)
 	    {
 	      ctx->sector_id = 1;
 	    }
+	  client_registry_update (ctx);
 
 	  json_t *data = json_object ();
 
@@ -1,4 +1,3 @@
-#include "db/repo/repo_autopilot.h"
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
@@ -11,6 +10,7 @@
 #include "db/db_api.h"
 #include "common.h"
 #include "server_log.h"
+#include "warp_graph.h"
 
 
 int
@@ -62,46 +62,39 @@ cmd_move_autopilot_start (db_t *db, client_ctx_t *ctx, json_t *root)
       return 1;
     }
 
-  /* --- Query MAX(id) from sectors --- */
-  int max_id = 0;
-  if (repo_autopilot_get_max_sector_id (db, &max_id) != 0 || max_id <= 0)
+  const warp_graph_t *g = warp_graph_acquire (db);
+
+  if (!g)
     {
-      send_response_error (ctx, root, ERR_SECTOR_NOT_FOUND, "No sectors");
+      send_response_error (ctx,
+			   root,
+			   ERR_PLANET_NOT_FOUND, "Pathfind init failed");
       return 1;
     }
+  int max_id = g->max_id;
 
 
   /* Clamp from/to */
   if (from <= 0 || from > max_id || to <= 0 || to > max_id)
     {
+      warp_graph_release (g);
       send_response_error (ctx, root, ERR_SECTOR_NOT_FOUND,
 			   "Sector not found");
       return 1;
     }
 
-  /* allocate arrays sized max_id+1 */
+  /* allocate avoid[] sized max_id+1 */
   size_t N = (size_t) max_id + 1;
   unsigned char *avoid = (unsigned char *) calloc (N, 1);
-  unsigned char *seen = (unsigned char *) calloc (N, 1);
-  int *prev = (int *) malloc (N * sizeof (int));
-  int *queue = (int *) malloc (N * sizeof (int));
 
 
-  if (!avoid || !seen || !prev || !queue)
+  if (!avoid)
     {
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
+      warp_graph_release (g);
       send_response_error (ctx, root, ERR_PLANET_NOT_FOUND, "Out of memory");
       return 1;
     }
 
-  for (int i = 0; i <= max_id; ++i)
-    {
-      prev[i] = -1;
-    }
-
   /* Fill avoid[] from JSON */
   if (data)
     {
@@ -135,9 +128,7 @@ cmd_move_autopilot_start (db_t *db, client_ctx_t *ctx, json_t *root)
   if (avoid[from] || avoid[to])
     {
       free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
+      warp_graph_release (g);
       send_response_error (ctx, root, REF_SAFE_ZONE_ONLY, "Path not found");
       return 1;
     }
@@ -160,218 +151,25 @@ cmd_move_autopilot_start (db_t *db, client_ctx_t *ctx, json_t *root)
       send_response_ok_take (ctx, root, "move.autopilot.route_v1", &out);
 
       free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
+      warp_graph_release (g);
       return 0;
     }
 
-  /* --- Load entire warp graph into adjacency lists --- */
-  int *head = NULL;
-  int *to_v = NULL;
-  int *next = NULL;
-  int edges = 0;
-
-
-  head = (int *) malloc (N * sizeof (int));
-  if (!head)
-    {
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      send_response_error (ctx, root, ERR_PLANET_NOT_FOUND, "Out of memory");
-      return 1;
-    }
-  for (int i = 0; i <= max_id; ++i)
-    {
-      head[i] = -1;
-    }
-
-  /* pass 1: count edges */
-  if (repo_autopilot_get_warp_count (db, &edges) != 0 || edges < 0)
-    {
-      free (head);
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      send_response_error (ctx,
-			   root,
-			   ERR_PLANET_NOT_FOUND, "Pathfind init failed");
-      return 1;
-    }
-
-  to_v = (int *) malloc ((size_t) edges * sizeof (int));
-  next = (int *) malloc ((size_t) edges * sizeof (int));
-  if ((edges > 0) && (!to_v || !next))
-    {
-      free (to_v);
-      free (next);
-      free (head);
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      send_response_error (ctx, root, ERR_PLANET_NOT_FOUND, "Out of memory");
-      return 1;
-    }
-
-  /* pass 2: read edges and build adjacency */
-  {
-    db_res_t *res = NULL;
-    db_error_t err;
-    if (repo_autopilot_get_all_warps (db, &res) != 0)
-      {
-	free (to_v);
-	free (next);
-	free (head);
-	free (avoid);
-	free (seen);
-	free (prev);
-	free (queue);
-	send_response_error (ctx,
-			     root,
-			     ERR_PLANET_NOT_FOUND, "Pathfind init failed");
-	return 1;
-      }
-
-    int e = 0;
-
-
-    while (db_res_step (res, &err))
-      {
-	int u = (int) db_res_col_i64 (res, 0, &err);
-	int v = (int) db_res_col_i64 (res, 1, &err);
-
-
-	if (e >= edges)
-	  {
-	    break;		/* safety if count lied */
-	  }
-	if (u <= 0 || u > max_id || v <= 0 || v > max_id)
-	  {
-	    continue;
-	  }
-
-	to_v[e] = v;
-	next[e] = head[u];
-	head[u] = e;
-	e++;
-      }
-
-    db_res_finalize (res);
-
-    if (err.code != 0)
-      {
-	free (to_v);
-	free (next);
-	free (head);
-	free (avoid);
-	free (seen);
-	free (prev);
-	free (queue);
-	send_response_error (ctx,
-			     root,
-			     ERR_PLANET_NOT_FOUND, "Pathfind init failed");
-	return 1;
-      }
-
-    /* shrink edges to actual loaded count */
-    edges = e;
-  }
-
-  /* --- BFS on in-memory adjacency --- */
-  int qh = 0, qt = 0;
-
-
-  queue[qt++] = from;
-  seen[from] = 1;
-
-  int found = 0;
-
-
-  while (qh < qt)
-    {
-      int u = queue[qh++];
-
-
-      for (int ei = head[u]; ei != -1; ei = next[ei])
-	{
-	  int v = to_v[ei];
+  /* --- BFS on the shared warp graph --- */
+  int *path = NULL;
+  int hops = warp_graph_path (g, from, to, avoid, &path);
 
 
-	  if (avoid[v] || seen[v])
-	    {
-	      continue;
-	    }
-
-	  seen[v] = 1;
-	  prev[v] = u;
-	  queue[qt++] = v;
-
-	  if (v == to)
-	    {
-	      found = 1;
-	      break;
-	    }
-	}
-
-      if (found)
-	{
-	  break;
-	}
-    }
-
-  free (to_v);
-  free (next);
-  free (head);
-
-  if (!found)
-    {
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      send_response_error (ctx, root, REF_SAFE_ZONE_ONLY, "Path not found");
-      return 1;
-    }
-
-  /* reconstruct path */
-  int *stack = (int *) malloc (N * sizeof (int));
-
+  free (avoid);
+  warp_graph_release (g);
 
-  if (!stack)
+  if (hops == -2)
     {
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
       send_response_error (ctx, root, ERR_PLANET_NOT_FOUND, "Out of memory");
       return 1;
     }
-
-  int sp = 0;
-  int cur = to;
-
-
-  while (cur != -1)
+  if (hops < 0)
     {
-      stack[sp++] = cur;
-      if (cur == from)
-	{
-	  break;
-	}
-      cur = prev[cur];
-    }
-
-  if (sp <= 0 || stack[sp - 1] != from)
-    {
-      free (stack);
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
       send_response_error (ctx, root, REF_SAFE_ZONE_ONLY, "Path not found");
       return 1;
     }
@@ -379,19 +177,11 @@ cmd_move_autopilot_start (db_t *db, client_ctx_t *ctx, json_t *root)
   json_t *steps = json_array ();
 
 
-  for (int i = sp - 1; i >= 0; --i)
+  for (int i = 0; i <= hops; ++i)
     {
-      json_array_append_new (steps, json_integer (stack[i]));
+      json_array_append_new (steps, json_integer (path[i]));
     }
-
-  int hops = sp - 1;
-
-
-  free (stack);
-  free (avoid);
-  free (seen);
-  free (prev);
-  free (queue);
+  free (path);
 
   json_t *out = json_object ();
 
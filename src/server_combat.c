@@ -25,6 +25,8 @@
 #include "repo_combat.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "session_cache.h"
+#include "client_registry.h"
 
 typedef struct
 {
@@ -102,6 +104,7 @@ fedspace_enforce_no_aggression_hard (client_ctx_t *ctx, int attacker_ship_id,
     {
       LOGE ("Failed to destroy attacker ship %d", attacker_ship_id);
     }
+  session_cache_invalidate_player (attacker_player_id);
 
   /* 2. Pod attacker using existing DB primitive */
   if (db_create_podded_status_entry (db, attacker_player_id) != 0)
@@ -112,6 +115,8 @@ fedspace_enforce_no_aggression_hard (client_ctx_t *ctx, int attacker_ship_id,
     {
       LOGE ("Failed to update podded status for player %d", attacker_player_id);
     }
+  client_registry_move_player (attacker_player_id,
+			       h_get_player_sector (db, attacker_player_id));
 
   /* 3. Emit event: Captain Z intervention message */
   char msg[512];
@@ -536,6 +541,8 @@ handle_combat_flee (client_ctx_t *ctx, json_t *root)
 	  if (db_combat_move_ship_and_player
 	      (db, ship_id, ctx->player_id, dest) == 0)
 	    {
+	      session_cache_invalidate_player (ctx->player_id);
+	      client_registry_move_player (ctx->player_id, dest);
 	      server_combat_apply_entry_hazards (db, ctx, dest);
 	      json_t *res = json_object ();
 	      json_object_set_new (res, "success", json_true ());
@@ -962,7 +969,10 @@ int
 destroy_ship_and_handle_side_effects (client_ctx_t *ctx, int player_id)
 {
   (void) ctx;
-  (void) player_id;
+  session_cache_invalidate_player (player_id);
+  db_t *db = game_db_get_handle ();
+  if (db)
+    client_registry_move_player (player_id, h_get_player_sector (db, player_id));
   return 0;
 }
 
@@ -1013,6 +1023,10 @@ server_combat_apply_entry_hazards (db_t *db, client_ctx_t *ctx, int sector_id)
       int towed_sid = 0, towed_pid = 0, towed_cid = 0;
       if (repo_ships_get_towed_ship_info (db, ship_id, &towed_sid, &towed_pid, &towed_cid) == 0)
         {
+          /* The tow moved its owner along with us */
+          session_cache_invalidate_player (towed_pid);
+          client_registry_move_player (towed_pid, sector_id);
+
           /* Create a temporary context for the towed ship's owner */
           client_ctx_t towed_ctx = *ctx;
           towed_ctx.player_id = towed_pid;
@@ -1,5 +1,6 @@
 #include "db/repo/repo_communication.h"
 /* src/server_communication.c */
+#include <ctype.h>
 #include <jansson.h>
 #include <string.h>
 #include <strings.h>
@@ -19,6 +20,8 @@
 #include "server_loop.h"
 #include "repo_player_settings.h"
 #include "server_log.h"
+#include "client_registry.h"
+#include "topic_index.h"
 #include "repo_cmd.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
@@ -104,18 +107,27 @@ extern void attach_rate_limit_meta (json_t * env, client_ctx_t * ctx);
 extern void rl_tick (client_ctx_t * ctx);
 extern void send_all_json (int fd, json_t * obj);
 
-typedef struct sub_node
+/* Fan-out of one prebuilt envelope to a topic's subscribers (see
+   topic_index.h); rendered on the first recipient */
+struct push_ctx
 {
-  char *topic;
-  struct sub_node *next;
-} sub_node_t;
-typedef struct sub_map
+  json_t *env;
+  reactor_buf_t *rendered;
+};
+
+
+static void
+push_cb (client_ctx_t *c, void *arg)
 {
-  client_ctx_t *ctx;
-  sub_node_t *head;
-  struct sub_map *next;
-} sub_map_t;
-static sub_map_t *g_submaps = NULL;
+  struct push_ctx *push = (struct push_ctx *) arg;
+
+  if (!push->rendered)
+    {
+      push->rendered = render_json_line (push->env);
+    }
+  rl_tick (c);
+  send_all_rendered (c->fd, push->rendered);
+}
 
 
 static void
@@ -137,34 +149,34 @@ broadcast_system_notice (int notice_id,
     {
       return;
     }
-  for (sub_map_t * m = g_submaps; m; m = m->next)
-    {
-      json_t *env = json_object ();
+  /* One envelope for every subscriber, serialised once */
+  json_t *env = json_object ();
 
 
-      if (!env)
-	{
-	  continue;
-	}
-      json_object_set_new (env, "status", json_string ("ok"));
-      json_object_set_new (env, "type", json_string ("system.notice_v1"));
-      json_object_set (env, "data", data);	/* shared; incref below */
-      json_t *meta = json_object ();
+  if (!env)
+    {
+      json_decref (data);
+      return;
+    }
+  json_object_set_new (env, "status", json_string ("ok"));
+  json_object_set_new (env, "type", json_string ("system.notice_v1"));
+  json_object_set_new (env, "data", data);
+  json_t *meta = json_object ();
 
 
-      if (meta)
-	{
-	  json_object_set_new (meta, "topic", json_string ("system.notice"));
-	  json_object_set_new (meta, "mandatory", json_true ());
-	  json_object_set_new (meta, "persistent", json_true ());
-	  json_object_set_new (env, "meta", meta);
-	}
-      attach_rate_limit_meta (env, m->ctx);
-      rl_tick (m->ctx);
-      send_all_json (m->ctx->fd, env);
-      json_decref (env);
+  if (meta)
+    {
+      json_object_set_new (meta, "topic", json_string ("system.notice"));
+      json_object_set_new (meta, "mandatory", json_true ());
+      json_object_set_new (meta, "persistent", json_true ());
+      json_object_set_new (env, "meta", meta);
     }
-  json_decref (data);
+  struct push_ctx push = {.env = env };
+
+
+  topic_index_for_each ("system.notice", push_cb, &push);
+  reactor_buf_release (push.rendered);
+  json_decref (env);
 }
 
 
@@ -413,11 +425,20 @@ len_leq (const char *s, size_t m)
 }
 
 
-static int
-send_to_player (int player_id, const char *event_type, json_t *data)
+/* Topics are case-insensitive (see topic_index.h); store them lower-cased
+   so the subscriptions table agrees with the index. out holds >= 65 bytes
+   and s has passed len_leq (s, 64). */
+static const char *
+topic_lower (const char *s, char *out)
 {
-  // delegate to server_loop’s registry-based delivery
-  return server_deliver_to_player (player_id, event_type, data);
+  size_t i;
+
+  for (i = 0; s[i]; i++)
+    {
+      out[i] = (char) tolower ((unsigned char) s[i]);
+    }
+  out[i] = '\0';
+  return out;
 }
 
 
@@ -425,19 +446,16 @@ struct bc_ctx
 {
   const char *event_type;
   json_t *data;
-  int deliveries;
+  reactor_buf_t *rendered;	/* envelope, serialised once for everyone */
 };
 
 
-static int
-bc_cb (int player_id, void *arg)
+static void
+bc_cb (client_ctx_t *c, void *arg)
 {
   struct bc_ctx *bc = (struct bc_ctx *) arg;
-  if (send_to_player (player_id, bc->event_type, bc->data) == 0)
-    {
-      bc->deliveries++;
-    }
-  return 0;			// continue
+
+  server_deliver_to_ctx (c, bc->event_type, bc->data, &bc->rendered);
 }
 
 
@@ -448,18 +466,31 @@ server_broadcast_event (const char *type, json_t *data)
     {
       return -1;
     }
-  db_t *db = game_db_get_handle ();
+  struct bc_ctx bc = {.event_type = type,.data = data };
+  int n = topic_index_for_each (type, bc_cb, &bc);
 
+  reactor_buf_release (bc.rendered);
+  return n;
+}
+
+
+struct sector_bc_ctx
+{
+  struct bc_ctx bc;
+  int sector_id;
+};
 
-  if (!db)
-    {
-      return -1;
-    }
-  struct bc_ctx bc = {.event_type = type,.data = data,.deliveries = 0 };
-  int rc = db_for_each_subscriber (db, type, bc_cb, &bc);
 
+/* Topic subscribers, minus those already reached as occupants */
+static void
+sector_topic_cb (client_ctx_t *c, void *arg)
+{
+  struct sector_bc_ctx *sbc = (struct sector_bc_ctx *) arg;
 
-  return (rc == 0) ? bc.deliveries : rc;
+  if (!client_registry_in_sector (c, sbc->sector_id))
+    {
+      bc_cb (c, &sbc->bc);
+    }
 }
 
 
@@ -470,19 +501,19 @@ server_broadcast_to_sector (int sid, const char *name, json_t *payload)
     {
       return -1;
     }
-  // Create a copy of the payload for each recipient as comm_publish_sector_event consumes the reference
-  json_t *payload_copy = json_deep_copy (payload);
+  char topic[64];
 
+  snprintf (topic, sizeof (topic), "sector.%d", sid);
 
-  if (!payload_copy)
-    {
-      LOGE
-	("server_broadcast_to_sector: Failed to deep copy payload for sector %d.",
-	 sid);
-      return -1;
-    }
-  // This function acts as a wrapper to comm_publish_sector_event, ensuring sector-specific filtering
-  comm_publish_sector_event (sid, name, payload_copy);
+  // Everyone whose ship is in the sector, then the "sector.N" / "sector.*"
+  // subscribers elsewhere; rendered once for all of them
+  struct sector_bc_ctx sbc = {.bc = {.event_type = name,.data = payload},
+    .sector_id = sid
+  };
+
+  client_registry_for_each_sector (sid, bc_cb, &sbc.bc);
+  topic_index_for_each (topic, sector_topic_cb, &sbc);
+  reactor_buf_release (sbc.bc.rendered);
   return 0;			// Success
 }
 
@@ -562,37 +593,17 @@ comm_broadcast_message (comm_scope_t scope,
 	}
       json_decref (extra);
     }
-  /* Fan-out to subscribers of the computed topic */
-  for (sub_map_t * m = g_submaps; m; m = m->next)
-    {
-      int deliver = 0;
-
-
-      for (sub_node_t * n = m->head; n; n = n->next)
-	{
-	  if (matches_pattern (topic, n->topic))
-	    {
-	      deliver = 1;
-	      break;
-	    }
-	}
-      if (!deliver)
-	{
-	  continue;
-	}
-      json_t *env = json_object ();
-
-
-      if (!env)
-	{
-	  continue;
-	}
-      json_t *data = json_deep_copy (base);
+  /* Fan-out to subscribers of the computed topic. The envelope is the
+     same for everyone, so it is serialised once, on the first match; it
+     carries no per-client rate_limit meta. */
+  json_t *env = json_object ();
 
 
+  if (env)
+    {
       json_object_set_new (env, "status", json_string ("ok"));
       json_object_set_new (env, "type", json_string ("broadcast.message_v1"));
-      json_object_set_new (env, "data", data);
+      json_object_set (env, "data", base);
       json_t *meta = json_object ();
 
 
@@ -601,9 +612,11 @@ comm_broadcast_message (comm_scope_t scope,
 	  json_object_set_new (meta, "topic", json_string (topic));
 	  json_object_set_new (env, "meta", meta);
 	}
-      attach_rate_limit_meta (env, m->ctx);
-      rl_tick (m->ctx);
-      send_all_json (m->ctx->fd, env);
+      struct push_ctx push = {.env = env };
+
+
+      topic_index_for_each (topic, push_cb, &push);
+      reactor_buf_release (push.rendered);
       json_decref (env);
     }
   json_decref (base);
@@ -623,19 +636,6 @@ comm_publish_sector_event (int sid, const char *name, json_t *data)
     }
 
 
-  db_t *db = game_db_get_handle ();
-
-
-  if (!db)
-    {
-      if (data)
-	{
-	  json_decref (data);
-	}
-      return;
-    }
-
-
   /* Build concrete topic once (e.g., "sector.42") */
   char topic[64];
 
@@ -643,15 +643,14 @@ comm_publish_sector_event (int sid, const char *name, json_t *data)
   snprintf (topic, sizeof (topic), "sector.%d", sid);
 
 
-  struct bc_ctx bc = {.event_type = name,.data = data,
-    .deliveries = 0
-  };
+  struct bc_ctx bc = {.event_type = name,.data = data };
 
 
-  /* db_for_each_subscriber finds players subscribed to 'topic' (exact or wildcard) */
-  db_for_each_subscriber (db, topic, bc_cb, &bc);
+  /* Exact "sector.42" plus wildcard "sector.*" subscribers */
+  topic_index_for_each (topic, bc_cb, &bc);
 
 
+  reactor_buf_release (bc.rendered);
   json_decref (data);
 }
 
@@ -1478,31 +1477,7 @@ cmd_mail_delete (client_ctx_t *ctx, json_t *root)
 void
 comm_clear_subscriptions (client_ctx_t *ctx)
 {
-  sub_map_t **pp = &g_submaps;
-  for (; *pp; pp = &(*pp)->next)
-    {
-      if ((*pp)->ctx == ctx)
-	{
-	  sub_map_t *dead = *pp;
-
-
-	  *pp = dead->next;
-	  sub_node_t *n = dead->head;
-
-
-	  while (n)
-	    {
-	      sub_node_t *next = n->next;
-
-
-	      free (n->topic);
-	      free (n);
-	      n = next;
-	    }
-	  free (dead);
-	  return;
-	}
-    }
+  topic_index_unbind (ctx);
 }
 
 
@@ -1533,10 +1508,14 @@ cmd_subscribe_add (client_ctx_t *ctx, json_t *root)
       return 0;
     }
   const char *topic = json_string_value (v);
+  char topic_buf[65];
 
 
-  if (!is_ascii_printable (topic) || !len_leq (topic, 64)
-      || !is_allowed_topic (topic))
+  if (is_ascii_printable (topic) && len_leq (topic, 64))
+    {
+      topic = topic_lower (topic, topic_buf);
+    }
+  if (topic != topic_buf || !is_allowed_topic (topic))
     {
       send_response_error (ctx, root, ERR_INVALID_ARG, "invalid topic");
       return 0;
@@ -1613,6 +1592,7 @@ cmd_subscribe_add (client_ctx_t *ctx, json_t *root)
       send_response_error (ctx, root, ERR_UNKNOWN, "db error");
       return 0;
     }
+  topic_index_add (ctx->player_id, topic);
   json_t *resp = json_object ();
 
 
@@ -1651,10 +1631,14 @@ cmd_subscribe_remove (client_ctx_t *ctx, json_t *root)
       return 0;
     }
   const char *topic = json_string_value (v);
+  char topic_buf[65];
 
 
-  if (!is_ascii_printable (topic) || !len_leq (topic, 64)
-      || !is_allowed_topic (topic))
+  if (is_ascii_printable (topic) && len_leq (topic, 64))
+    {
+      topic = topic_lower (topic, topic_buf);
+    }
+  if (topic != topic_buf || !is_allowed_topic (topic))
     {
       send_response_error (ctx, root, ERR_INVALID_ARG, "invalid topic");
       return 0;
@@ -1688,6 +1672,7 @@ cmd_subscribe_remove (client_ctx_t *ctx, json_t *root)
 			   ERR_USER_NOT_FOUND, "subscription not found");
       return 0;
     }
+  topic_index_remove (ctx->player_id, topic);
   json_t *resp = json_object ();
 
 
@@ -27,7 +27,7 @@ extern "C"
 /*admin */
   int cmd_admin_notice (client_ctx_t * ctx, json_t * root);
   int cmd_admin_shutdown_warning (client_ctx_t * ctx, json_t * root);
-/* Optional: free subs for a disconnected client; call from your disconnect path */
+/* Drop a disconnecting client from the topic index (topic_index.h) */
   void comm_clear_subscriptions (client_ctx_t * ctx);
 
 /* Publish an event to subscribers of sector.* and sector.{sector_id}.
@@ -57,7 +57,8 @@ extern "C"
 // who are subscribed (exact or domain.*). Data is borrowed (not stolen).
   int server_broadcast_event (const char *event_type, json_t * data);
 // Broadcast an event (type + payload) to all currently-connected players
-// in a specific sector. Payload is borrowed (not stolen).
+// in a specific sector, and to sector.{id} / sector.* subscribers elsewhere
+// (each connection once). Payload is borrowed (not stolen).
   int server_broadcast_to_sector (int sector_id, const char *event_name,
 				  json_t * payload);
 #ifdef __cplusplus
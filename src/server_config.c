@@ -29,6 +29,7 @@
 #include "globals.h"		// Include globals.h for xp_align_config_t and g_xp_align declaration
 #include "game_db.h"		// Include game_db.h
 #include "db/db_api.h"		// Include generic DB API
+#include "event_batch.h"
 
 server_config_t g_cfg;
 json_t *g_capabilities;
@@ -140,6 +141,23 @@ config_set_defaults (void)
   g_cfg.tls_required = 0;
   g_cfg.tls_cert_path[0] = '\0';
   g_cfg.tls_key_path[0] = '\0';
+  g_cfg.tls_handshake_timeout_ms = 10000;
+  g_cfg.tls_session_cache_size = 20480;
+  g_cfg.tls_session_timeout_s = 7200;
+  g_cfg.net_worker_threads = 0;
+  g_cfg.net_outq_max_kb = 1024;
+  g_cfg.net_outq_drop = 0;
+  g_cfg.event_batch_ms = 0;
+  g_cfg.event_batch_max = 64;
+  g_cfg.session_cache_ttl_ms = 2000;
+  g_cfg.pg_stmt_cache_size = 0;
+  g_cfg.db_pool_min = 2;
+  g_cfg.db_pool_max = 0;
+  g_cfg.db_pool_wait_ms = 5000;
+  g_cfg.db_slow_query_ms = 500;
+  g_cfg.trace_ring_spans = 4096;
+  g_cfg.trace_log_sample = 0;
+  g_cfg.db_replica_stick_ms = 2000;
 }
 
 
@@ -688,6 +706,74 @@ apply_db (db_t *db)
 	    {
 	      snprintf (g_cfg.tls_key_path, sizeof (g_cfg.tls_key_path), "%s", val);
 	    }
+	  else if (strcmp (key, "tls_handshake_timeout_ms") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.tls_handshake_timeout_ms);
+	    }
+	  else if (strcmp (key, "tls_session_cache_size") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.tls_session_cache_size);
+	    }
+	  else if (strcmp (key, "tls_session_timeout_s") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.tls_session_timeout_s);
+	    }
+	  else if (strcmp (key, "net_worker_threads") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.net_worker_threads);
+	    }
+	  else if (strcmp (key, "net_outq_max_kb") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.net_outq_max_kb);
+	    }
+	  else if (strcmp (key, "net_outq_drop") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.net_outq_drop);
+	    }
+	  else if (strcmp (key, "event_batch_ms") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.event_batch_ms);
+	    }
+	  else if (strcmp (key, "event_batch_max") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.event_batch_max);
+	    }
+	  else if (strcmp (key, "session_cache_ttl_ms") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.session_cache_ttl_ms);
+	    }
+	  else if (strcmp (key, "pg_stmt_cache_size") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.pg_stmt_cache_size);
+	    }
+	  else if (strcmp (key, "db_pool_min") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.db_pool_min);
+	    }
+	  else if (strcmp (key, "db_pool_max") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.db_pool_max);
+	    }
+	  else if (strcmp (key, "db_pool_wait_ms") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.db_pool_wait_ms);
+	    }
+	  else if (strcmp (key, "db_slow_query_ms") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.db_slow_query_ms);
+	    }
+	  else if (strcmp (key, "trace_ring_spans") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.trace_ring_spans);
+	    }
+	  else if (strcmp (key, "trace_log_sample") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.trace_log_sample);
+	    }
+	  else if (strcmp (key, "db_replica_stick_ms") == 0)
+	    {
+	      cfg_parse_int (val, type, &g_cfg.db_replica_stick_ms);
+	    }
 	  /* Log unknown keys as debug (ignore) */
 	  else
 	    {
@@ -727,6 +813,40 @@ apply_env (void)
 }
 
 
+/* Copy a connection string template into out, replacing %DB% with db_name */
+static int
+expand_conn_tmpl (const char *tmpl, const char *db_name, char *out,
+		  size_t out_size)
+{
+  const char *marker = "%DB%";
+  const char *found = strstr (tmpl, marker);
+
+
+  if (!found)
+    {
+      snprintf (out, out_size, "%s", tmpl);
+      return 0;
+    }
+
+  size_t prefix_len = found - tmpl;
+  size_t suffix_len = strlen (found + strlen (marker));
+  size_t db_len = strlen (db_name);
+
+
+  if (prefix_len + db_len + suffix_len + 1 > out_size)
+    {
+      LOGE ("Connection string too long.");
+      return -1;
+    }
+
+  memcpy (out, tmpl, prefix_len);
+  memcpy (out + prefix_len, db_name, db_len);
+  memcpy (out + prefix_len + db_len, found + strlen (marker), suffix_len);
+  out[prefix_len + db_len + suffix_len] = '\0';
+  return 0;
+}
+
+
 int
 load_bootstrap_config (const char *filename)
 {
@@ -741,6 +861,8 @@ load_bootstrap_config (const char *filename)
 
   const char *app_conn_tmpl =
     json_string_value (json_object_get (root, "app"));
+  const char *replica_conn_tmpl =
+    json_string_value (json_object_get (root, "replica"));
   const char *db_name = json_string_value (json_object_get (root, "db"));
 
 
@@ -758,34 +880,22 @@ load_bootstrap_config (const char *filename)
 
   // Perform simple replacement of %DB% with db_name
   // We assume the string is roughly "dbname=%DB% ..."
-  const char *marker = "%DB%";
-  const char *found = strstr (app_conn_tmpl, marker);
-
-
-  if (found)
+  if (expand_conn_tmpl (app_conn_tmpl, db_name, g_cfg.pg_conn_str,
+			sizeof (g_cfg.pg_conn_str)) != 0)
     {
-      size_t prefix_len = found - app_conn_tmpl;
-      size_t suffix_len = strlen (found + strlen (marker));
-      size_t db_len = strlen (db_name);
-
-
-      if (prefix_len + db_len + suffix_len + 1 > sizeof (g_cfg.pg_conn_str))
-	{
-	  LOGE ("Connection string too long.");
-	  json_decref (root);
-	  return -1;
-	}
-
-      memcpy (g_cfg.pg_conn_str, app_conn_tmpl, prefix_len);
-      memcpy (g_cfg.pg_conn_str + prefix_len, db_name, db_len);
-      memcpy (g_cfg.pg_conn_str + prefix_len + db_len,
-	      found + strlen (marker), suffix_len);
-      g_cfg.pg_conn_str[prefix_len + db_len + suffix_len] = '\0';
+      json_decref (root);
+      return -1;
     }
-  else
+
+  /* Optional streaming replica for read-only commands, same template rules */
+  g_cfg.pg_replica_conn_str[0] = '\0';
+  if (replica_conn_tmpl && replica_conn_tmpl[0]
+      && expand_conn_tmpl (replica_conn_tmpl, db_name,
+			   g_cfg.pg_replica_conn_str,
+			   sizeof (g_cfg.pg_replica_conn_str)) != 0)
     {
-      snprintf (g_cfg.pg_conn_str,
-		sizeof (g_cfg.pg_conn_str), "%s", app_conn_tmpl);
+      json_decref (root);
+      return -1;
     }
 
   LOGI ("Loaded bootstrap DB config: %s (redacted)", "********");	// Do not log credentials
@@ -885,10 +995,28 @@ cmd_system_hello (client_ctx_t *ctx, json_t *root)
 {
   json_t *payload = json_object ();
   json_t *limits = json_object ();
-
-
+  json_t *caps = json_object_get (json_object_get (root, "data"),
+				  "capabilities");
+  size_t i;
+  json_t *cap;
+  bool batched = false;
+
+
+  json_array_foreach (caps, i, cap)
+  {
+    if (json_is_string (cap)
+	&& strcmp (json_string_value (cap), "events.batch_v1") == 0)
+      {
+	batched = event_batch_enable (ctx);
+      }
+  }
   json_object_set_new (limits, "max_frame_size", json_integer (131072));
   json_object_set_new (limits, "max_req_per_min", json_integer (200));
+  if (batched)
+    {
+      json_object_set_new (limits, "event_batch_ms",
+			   json_integer (event_batch_window_ms ()));
+    }
 
   json_object_set (payload, "capabilities", g_capabilities);
   json_object_set_new (payload, "limits", limits);
@@ -929,9 +1057,9 @@ cmd_session_disconnect (client_ctx_t *ctx, json_t *root)
   json_t *data = json_object ();
   json_object_set_new (data, "message", json_string ("Goodbye"));
   send_response_ok_take (ctx, root, "system.goodbye", &data);
+  /* The reactor sees the hangup and closes the fd once this request returns */
   shutdown (ctx->fd, SHUT_RDWR);
-  close (ctx->fd);
-  return 0;			/* or break your per-connection loop appropriately */
+  return 0;
 }
 
 
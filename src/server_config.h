@@ -88,6 +88,7 @@ extern "C"
     int planet_type_count;
     int server_port;
     char pg_conn_str[512];
+    char pg_replica_conn_str[512];	/* optional; read-only commands */
 
 
     struct
@@ -227,6 +228,36 @@ extern "C"
     int tls_required;
     char tls_cert_path[512];
     char tls_key_path[512];
+    int tls_handshake_timeout_ms;	/* abort handshakes slower than this */
+    int tls_session_cache_size;	/* server-side session cache entries */
+    int tls_session_timeout_s;	/* lifetime of cached sessions/tickets */
+    /* Client I/O worker threads (0 = one per online CPU) */
+    int net_worker_threads;
+    /* Output queued per client before it counts as a laggard (0 = no
+       limit); laggards are disconnected, or lose new messages if
+       net_outq_drop is set */
+    int net_outq_max_kb;
+    int net_outq_drop;
+    /* Coalescing window for clients that opt in to events.batch_v1
+       (0 = off), and the most events sent in one frame */
+    int event_batch_ms;
+    int event_batch_max;
+    /* Per-request auth cache lifetime (0 = disabled) */
+    int session_cache_ttl_ms;
+    /* Prepared statements kept per DB connection (0 = default, <0 = off) */
+    int pg_stmt_cache_size;
+    /* Request connection pool (max 0 = one connection per thread) */
+    int db_pool_min;
+    int db_pool_max;
+    int db_pool_wait_ms;	/* give up on a checkout after this long */
+    /* Log statements slower than this (0 = off) */
+    int db_slow_query_ms;
+    /* Request tracing: spans kept for sysop.trace.dump, and log a
+       summary of every Nth request (0 = off for either) */
+    int trace_ring_spans;
+    int trace_log_sample;
+    /* Reads stay on the primary this long after a player's writes */
+    int db_replica_stick_ms;
   } server_config_t;
 /* Single global instance (defined in server_config.c) */
   extern server_config_t g_cfg;
@@ -18,6 +18,7 @@
 #include "common.h"
 #include "server_cron.h"
 #include "db/sql_driver.h"
+#include "session_cache.h"
 
 
 int
@@ -288,6 +289,7 @@ cmd_corp_transfer_ceo (client_ctx_t *ctx, json_t *root)
 			   "Failed to commit transaction.");
       return 0;
     }
+  session_cache_invalidate_player (target_player_id);
 
   json_t *resp = json_object ();
 
@@ -440,6 +442,7 @@ cmd_corp_create (client_ctx_t *ctx, json_t *root)
       return 0;
     }
 
+  session_cache_invalidate_player (ctx->player_id);
   ctx->corp_id = corp_id;
   json_t *response_data = json_object ();
 
@@ -544,6 +547,7 @@ cmd_corp_join (client_ctx_t *ctx, json_t *root)
       send_response_error (ctx, root, err.code, "Commit failed (join)");
       return 0;
     }
+  session_cache_invalidate_player (ctx->player_id);
 
   json_t *response_data = json_object ();
 
@@ -815,6 +819,7 @@ cmd_corp_kick (client_ctx_t *ctx, json_t *root)
 			   ERR_DB, "Database error while kicking member.");
       return 0;
     }
+  session_cache_invalidate_player (target_player_id);
   json_t *response_data = json_object ();
 
 
@@ -905,6 +910,8 @@ cmd_corp_dissolve (client_ctx_t *ctx, json_t *root)
       send_response_error (ctx, root, err.code, "Commit failed (dissolve)");
       return 0;
     }
+  /* Every member lost their corp; rare enough to drop the whole cache */
+  session_cache_invalidate_all ();
 
   json_t *response_data = json_object ();
 
@@ -989,6 +996,7 @@ cmd_corp_leave (client_ctx_t *ctx, json_t *root)
 	  send_response_error (ctx, root, err.code, "Commit failed (leave)");
 	  return 0;
 	}
+      session_cache_invalidate_player (ctx->player_id);
 
       json_t *response_data = json_object ();
 
@@ -1009,6 +1017,7 @@ cmd_corp_leave (client_ctx_t *ctx, json_t *root)
 			       "Database error while leaving corporation.");
 	  return 0;
 	}
+      session_cache_invalidate_player (ctx->player_id);
       json_t *response_data = json_object ();
 
 
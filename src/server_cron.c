@@ -27,6 +27,8 @@
 #include "server_clusters.h"	// Cluster Economy & Law
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "session_cache.h"
+#include "client_registry.h"
 
 int iss_init_once (void);
 #define INITIAL_QUEUE_CAPACITY 64
@@ -193,6 +195,8 @@ tow_ship (db_t *db, int ship_id, int new_sector_id, int admin_id,
       db_tx_rollback (db, &err);
       return -1;
     }
+  session_cache_invalidate_player (owner_id);
+  client_registry_move_player (owner_id, new_sector_id);
 
   return 0;
 }
@@ -1315,104 +1319,157 @@ h_port_economy_tick (db_t *db, int64_t now_s)
     }
   LOGI ("port_economy_tick: Starting port economy update.");
 
-  json_t *ports_data = NULL;
-  if (db_cron_port_get_economy_data_json (db, &ports_data) != 0)
+  port_economy_row_t *rows = NULL;
+  int n_rows = 0;
+
+  if (db_cron_port_load_economy (db, &rows, &n_rows) != 0)
     {
       LOGE ("port_economy_tick: Failed to get data");
       unlock (db, "port_economy_tick");
       return -1;
     }
 
-  int orders_processed = 0;
-  size_t index;
-  json_t *item;
+  /* Decide every row in memory, then write each kind of change in bulk */
+  size_t cap = n_rows > 0 ? (size_t) n_rows : 1;
+  port_econ_order_t *inserts = malloc (cap * sizeof (*inserts));
+  port_econ_order_t *bumps = malloc (cap * sizeof (*bumps));
+  port_econ_order_t *cancels = malloc (cap * sizeof (*cancels));
+  int n_ins = 0, n_bump = 0, n_cancel = 0;
 
-  json_array_foreach (ports_data, index, item)
-  {
-    int port_id = json_integer_value (json_object_get (item, "port_id"));
-    int port_type = json_integer_value (json_object_get (item, "port_type"));
-    int port_size = json_integer_value (json_object_get (item, "port_size"));
-    const char *commodity_code =
-      json_string_value (json_object_get (item, "commodity_code"));
-    int current_quantity =
-      json_integer_value (json_object_get (item, "current_quantity"));
-    double base_restock_rate =
-      json_real_value (json_object_get (item, "base_restock_rate"));
-    int commodity_id =
-      json_integer_value (json_object_get (item, "commodity_id"));
+  if (!inserts || !bumps || !cancels)
+    {
+      LOGE ("port_economy_tick: OOM for %d rows", n_rows);
+      free (inserts);
+      free (bumps);
+      free (cancels);
+      free (rows);
+      unlock (db, "port_economy_tick");
+      return -1;
+    }
 
-    int max_capacity = port_size * 1000;
-    double desired_level_ratio =
-      (port_type == PORT_TYPE_STARDOCK) ? 0.9 : 0.5;
-    int desired_stock = (int) (max_capacity * desired_level_ratio);
+  for (int i = 0; i < n_rows; i++)
+    {
+      const port_economy_row_t *r = &rows[i];
+      int port_type = r->port_type;
+      int current_quantity = r->current_quantity;
+      double base_restock_rate = r->base_restock_rate;
 
-    int shortage =
-      (desired_stock >
-       current_quantity) ? (desired_stock - current_quantity) : 0;
-    int surplus =
-      (current_quantity >
-       desired_stock) ? (current_quantity - desired_stock) : 0;
+      int max_capacity = r->port_size * 1000;
+      double desired_level_ratio =
+	(port_type == PORT_TYPE_STARDOCK) ? 0.9 : 0.5;
+      int desired_stock = (int) (max_capacity * desired_level_ratio);
 
-    int order_qty = 0;
-    const char *side = NULL;
+      int shortage =
+	(desired_stock >
+	 current_quantity) ? (desired_stock - current_quantity) : 0;
+      int surplus =
+	(current_quantity >
+	 desired_stock) ? (current_quantity - desired_stock) : 0;
 
-    if (shortage > 0)
-      {
-	order_qty = (int) (shortage * base_restock_rate);
-	side = "buy";
-      }
-    else if (surplus > 0)
-      {
-	order_qty = (int) (surplus * base_restock_rate);
-	side = "sell";
-      }
+      int order_qty = 0;
+      const char *side = NULL;
 
-    if ((shortage > 0 || surplus > 0) && base_restock_rate > 0
-	&& order_qty == 0)
-      {
-	order_qty = 1;
-      }
+      if (shortage > 0)
+	{
+	  order_qty = (int) (shortage * base_restock_rate);
+	  side = "buy";
+	}
+      else if (surplus > 0)
+	{
+	  order_qty = (int) (surplus * base_restock_rate);
+	  side = "sell";
+	}
 
-    if (order_qty > 0 && side != NULL)
-      {
-	int price = (strcmp (side, "buy") == 0) ?
-	  h_calculate_port_buy_price (db, port_id, commodity_code) :
-	  h_calculate_port_sell_price (db, port_id, commodity_code);
+      if ((shortage > 0 || surplus > 0) && base_restock_rate > 0
+	  && order_qty == 0)
+	{
+	  order_qty = 1;
+	}
 
-	commodity_order_t existing_order;
-	int find_rc =
-	  db_get_open_order_for_port (db, port_id, commodity_id, side,
-				      &existing_order);
+      if (order_qty > 0 && side != NULL)
+	{
+	  int is_buy = (strcmp (side, "buy") == 0);
+	  int existing_id = is_buy ? r->buy_order_id : r->sell_order_id;
 
-	if (find_rc == 0)
-	  {
-	    int new_total = existing_order.filled_quantity + order_qty;
-	    db_update_commodity_order (db, existing_order.id, new_total,
-				       existing_order.filled_quantity,
-				       "open");
-	  }
-	else
-	  {
-	    db_insert_commodity_order (db, "port", port_id, "port", port_id,
-				       commodity_id, side, order_qty, price,
-				       0);
-	  }
-	orders_processed++;
-      }
-    else
-      {
-	db_cancel_commodity_orders_for_port_and_commodity (db, port_id,
-							   commodity_id,
-							   "buy");
-	db_cancel_commodity_orders_for_port_and_commodity (db, port_id,
-							   commodity_id,
-							   "sell");
-      }
-  }
+	  if (existing_id > 0)
+	    {
+	      /* Same as before: open quantity becomes order_qty on top of
+	         what has already filled */
+	      port_econ_order_t *o = &bumps[n_bump++];
+
+	      memset (o, 0, sizeof (*o));
+	      o->order_id = existing_id;
+	      o->port_id = r->port_id;
+	      o->commodity_id = r->commodity_id;
+	      o->quantity = order_qty;
+	    }
+	  else
+	    {
+	      port_econ_order_t *o = &inserts[n_ins++];
+	      int price = is_buy ?
+		h_port_buy_price_from (r->base_price, current_quantity,
+				       max_capacity, r->techlevel,
+				       r->price_elasticity,
+				       r->volatility_factor) :
+		h_port_sell_price_from (r->base_price, current_quantity,
+					max_capacity, r->techlevel,
+					r->price_elasticity,
+					r->volatility_factor);
+
+	      memset (o, 0, sizeof (*o));
+	      o->port_id = r->port_id;
+	      o->commodity_id = r->commodity_id;
+	      o->side = side;
+	      o->quantity = order_qty;
+	      o->price = price;
+	    }
+	}
+      else if (r->open_orders > 0)
+	{
+	  port_econ_order_t *o = &cancels[n_cancel++];
 
-  json_decref (ports_data);
+	  memset (o, 0, sizeof (*o));
+	  o->port_id = r->port_id;
+	  o->commodity_id = r->commodity_id;
+	}
+    }
+
+  db_error_t err;
+  int rc = -1;
+
+  db_error_clear (&err);
+  if (db_tx_begin (db, DB_TX_DEFAULT, &err))
+    {
+      if (db_cron_port_insert_orders (db, inserts, n_ins) == 0
+	  && db_cron_port_bump_orders (db, bumps, n_bump) == 0
+	  && db_cron_port_cancel_orders (db, cancels, n_cancel) == 0
+	  && db_tx_commit (db, &err))
+	{
+	  rc = 0;
+	}
+      else
+	{
+	  db_tx_rollback (db, &err);
+	}
+    }
+
+  if (rc == 0)
+    {
+      LOGI
+	("port_economy_tick: %d rows, %d new orders, %d topped up, %d cancelled.",
+	 n_rows, n_ins, n_bump, n_cancel);
+    }
+  else
+    {
+      LOGE ("port_economy_tick: Failed to apply order changes");
+    }
+
+  free (inserts);
+  free (bumps);
+  free (cancels);
+  free (rows);
   unlock (db, "port_economy_tick");
-  return 0;
+  return rc;
 }
 
 
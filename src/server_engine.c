@@ -870,6 +870,7 @@ engine_main_loop (int shutdown_fd)
     }
   LOGD ("[engine] g_cfg.s2s.frame_size_limit: %d",
 	g_cfg.s2s.frame_size_limit);
+  db_set_slow_query_ms (g_cfg.db_slow_query_ms);
   // Initialize tavern settings (load from DB) for engine cron jobs
   if (tavern_settings_load () != 0)
     {
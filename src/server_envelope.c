@@ -15,7 +15,12 @@
 #include "server_config.h"
 #include "server_log.h"
 #include "s2s_transport.h"
+#include "request_trace.h"
+#include "server_reactor.h"
 #include "common.h"		/* now_iso8601, strip_ansi */
+
+/* Longest a sender waits on a full socket buffer before giving up */
+#define SEND_WAIT_MS 5000
 int toss;
 
 
@@ -338,30 +343,67 @@ cmd_system_schema_list (client_ctx_t *ctx, json_t *root)
 }
 
 
+/* Client sockets are non-blocking under the reactor; wait for room rather
+   than spinning. Returns 0 when writable, -1 on timeout or error. */
+static int
+wait_writable (int fd)
+{
+  struct pollfd pfd = {.fd = fd,.events = POLLOUT,.revents = 0 };
+
+  for (;;)
+    {
+      int rc = poll (&pfd, 1, SEND_WAIT_MS);
+
+      if (rc > 0)
+	{
+	  return (pfd.revents & (POLLERR | POLLNVAL)) ? -1 : 0;
+	}
+      if (rc == 0)
+	{
+	  LOGW ("send: fd=%d not writable after %d ms", fd, SEND_WAIT_MS);
+	  return -1;
+	}
+      if (errno != EINTR)
+	{
+	  return -1;
+	}
+    }
+}
+
+
 static int
 send_all (int fd, const char *buf, size_t len)
 {
   client_ctx_t *ctx = g_ctx_for_send;
 
-  if (ctx && ctx->is_tls && ctx->ssl_conn)
+  /* g_ctx_for_send is the requester; only use its TLS session when the
+     write is actually addressed to it. */
+  if (ctx && ctx->fd == fd && ctx->is_tls && ctx->ssl_conn)
     {
       /* TLS write path */
       size_t off = 0;
+      int rc = 0;
+
+      pthread_mutex_lock (&ctx->io_mu);
       while (off < len)
 	{
 	  int n = SSL_write (ctx->ssl_conn, buf + off, len - off);
 	  if (n <= 0)
 	    {
 	      int err = SSL_get_error (ctx->ssl_conn, n);
-	      if (err == SSL_ERROR_WANT_WRITE)
+	      if ((err == SSL_ERROR_WANT_WRITE || err == SSL_ERROR_WANT_READ)
+		  && wait_writable (fd) == 0)
 		{
 		  continue;
 		}
 	      LOGD ("SSL_write error: %d", err);
-	      return -1;
+	      rc = -1;
+	      break;
 	    }
 	  off += (size_t) n;
 	}
+      pthread_mutex_unlock (&ctx->io_mu);
+      return rc;
     }
   else
     {
@@ -377,6 +419,11 @@ send_all (int fd, const char *buf, size_t len)
 		{
 		  continue;
 		}
+	      if ((errno == EAGAIN || errno == EWOULDBLOCK)
+		  && wait_writable (fd) == 0)
+		{
+		  continue;
+		}
 	      return -1;
 	    }
 	  off += (size_t) n;
@@ -450,6 +497,7 @@ send_all_json (int fd, json_t *obj)
     }
   
   char *s;
+  int span = trace_span_begin ("serialize", NULL);
   if (fd == -1) 
     {
       s = json_dumps (obj, JSON_INDENT(2) | JSON_SORT_KEYS | JSON_ENCODE_ANY);
@@ -458,6 +506,7 @@ send_all_json (int fd, json_t *obj)
     {
       s = json_dumps (obj, JSON_COMPACT);
     }
+  trace_span_end (span);
 
 
   if (s)
@@ -469,14 +518,68 @@ send_all_json (int fd, json_t *obj)
         }
       else
         {
-          (void) send_all (fd, s, strlen (s));
-          (void) send_all (fd, "\n", 1);
+          size_t len = strlen (s);
+
+          span = trace_span_begin ("write", NULL);
+          if (reactor_send_line (fd, s, len) == -2)
+            {
+              /* No reactor (offline tools): write through */
+              (void) send_all (fd, s, len);
+              (void) send_all (fd, "\n", 1);
+            }
+          trace_span_end (span);
         }
       free (s);
     }
 }
 
 
+reactor_buf_t *
+render_json_line (json_t *obj)
+{
+  int span = trace_span_begin ("serialize", NULL);
+  char *s = json_dumps (obj, JSON_COMPACT);
+  reactor_buf_t *b = s ? reactor_buf_new (s, strlen (s)) : NULL;
+
+  trace_span_end (span);
+  free (s);
+  return b;
+}
+
+
+void
+send_all_rendered (int fd, reactor_buf_t *b)
+{
+  if (g_ctx_for_send)
+    {
+      g_ctx_for_send->responses_sent++;
+    }
+  if (!b)
+    {
+      return;
+    }
+
+  int span = trace_span_begin ("write", NULL);
+
+  if (fd == -1 || reactor_send_buf (fd, b) == -2)
+    {
+      size_t len;
+      const char *s = reactor_buf_data (b, &len);
+
+      if (fd == -1)
+        {
+          fwrite (s, 1, len, stdout);
+          fflush (stdout);
+        }
+      else
+        {
+          (void) send_all (fd, s, len);
+        }
+    }
+  trace_span_end (span);
+}
+
+
 void
 send_error_json (int fd, int code, const char *msg)
 {
@@ -518,9 +621,9 @@ make_default_meta (void)
 }
 
 
-/* send_enveloped_ok NOW BORROWS data */
-void
-send_enveloped_ok (int fd, json_t *req, const char *type, json_t *data)
+/* The ok envelope around data (borrowed) */
+static json_t *
+make_ok_envelope (json_t *req, const char *type, json_t *data)
 {
   json_t *resp = json_object ();
   json_object_set_new (resp, "id", json_string ("srv-ok"));
@@ -556,11 +659,32 @@ send_enveloped_ok (int fd, json_t *req, const char *type, json_t *data)
     {
       sanitize_json_strings (resp);
     }
+  return resp;
+}
+
+
+/* send_enveloped_ok NOW BORROWS data */
+void
+send_enveloped_ok (int fd, json_t *req, const char *type, json_t *data)
+{
+  json_t *resp = make_ok_envelope (req, type, data);
+
   send_all_json (fd, resp);
   json_decref (resp);
 }
 
 
+reactor_buf_t *
+render_enveloped_ok (const char *type, json_t *data)
+{
+  json_t *resp = make_ok_envelope (NULL, type, data);
+  reactor_buf_t *b = render_json_line (resp);
+
+  json_decref (resp);
+  return b;
+}
+
+
 void
 send_enveloped_error (int fd, json_t *req, int code, const char *message)
 {
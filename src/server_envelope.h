@@ -4,6 +4,7 @@
 #include <jansson.h>
 
 #include "common.h"		// For client_ctx_t
+#include "server_reactor.h"	// For reactor_buf_t
 
 // Defined in server_loop.c, used by send functions to access thread's context
 extern __thread client_ctx_t *g_ctx_for_send;
@@ -66,6 +67,14 @@ void send_enveloped_error (int fd, json_t * req, int code,
 void send_enveloped_refused (int fd, json_t * req, int code, const char *msg,
 			     json_t * data_opt);
 
+/* Fan-out: render a message once, then queue the same bytes to every
+   recipient (release with reactor_buf_release). Renders return NULL when
+   serialisation fails; send_all_rendered ignores a NULL buffer. */
+reactor_buf_t *render_json_line (json_t * obj);
+/* send_enveloped_ok's envelope with no request to reply to; borrows data */
+reactor_buf_t *render_enveloped_ok (const char *type, json_t * data);
+void send_all_rendered (int fd, reactor_buf_t * b);
+
 /* Context-aware wrappers */
 void send_response_error (client_ctx_t * ctx,
 			  json_t * req, int code, const char *msg);
@@ -54,6 +54,13 @@
 #include "db/db_api.h"
 #include "db/sql_driver.h"
 #include "server_sysop.h"
+#include "server_reactor.h"
+#include "cmd_index.h"
+#include "session_cache.h"
+#include "request_trace.h"
+#include "topic_index.h"
+#include "client_registry.h"
+#include "event_batch.h"
 
 typedef int (*command_handler_fn) (client_ctx_t * ctx, json_t * root);
 
@@ -82,8 +89,6 @@ static SSL_CTX *g_ssl_ctx = NULL;
 void send_all_json (int fd, json_t * obj);
 
 /* Forward declarations */
-static void loop_add_client (client_ctx_t *ctx);
-static void loop_remove_client (client_ctx_t *ctx);
 
 /* rate-limit helper prototypes (defined later) */
 void attach_rate_limit_meta (json_t * env, client_ctx_t * ctx);
@@ -246,7 +251,7 @@ static const command_entry_t k_command_registry[] = {
   {"bank.deposit", cmd_bank_deposit, "Deposit credits to bank",
    schema_placeholder, 0, false, NULL},
   {"bank.history", cmd_bank_history, "Get bank history", schema_bank_history,
-   0, false, NULL},
+   CMD_FLAG_READONLY, false, NULL},
   {"bank.leaderboard", cmd_bank_leaderboard, "Get bank leaderboard",
    schema_bank_leaderboard, 0, false, NULL},
   {"bank.transfer", cmd_bank_transfer, "Transfer credits between players",
@@ -334,7 +339,8 @@ static const command_entry_t k_command_registry[] = {
   {"hardware.list", cmd_hardware_list, "List available ship hardware",
    schema_hardware_list, 0, false, NULL},
   {"mail.delete", cmd_mail_delete, "Delete mail", schema_mail_delete, 0, false, NULL},
-  {"mail.inbox", cmd_mail_inbox, "Mail inbox", schema_mail_inbox, 0, false, NULL},
+  {"mail.inbox", cmd_mail_inbox, "Mail inbox", schema_mail_inbox,
+   CMD_FLAG_READONLY, false, NULL},
   {"mail.read", cmd_mail_read, "Read mail", schema_mail_read, 0, false, NULL},
   {"mail.send", cmd_mail_send, "Send mail", schema_mail_send, 0, false, NULL},
   {"move.autopilot.start", w_move_autopilot_start, "Start autopilot",
@@ -344,7 +350,7 @@ static const command_entry_t k_command_registry[] = {
   {"move.autopilot.stop", cmd_move_autopilot_stop, "Stop autopilot",
    schema_move_autopilot_stop, 0, false, NULL},
   {"move.describe_sector", cmd_move_describe_sector, "Describe a sector",
-   schema_move_describe_sector, 0, false, NULL},
+   schema_move_describe_sector, CMD_FLAG_READONLY, false, NULL},
   {"move.pathfind", cmd_move_pathfind, "Find path between sectors",
    schema_move_pathfind, 0, false, NULL},
   {"move.scan", cmd_move_scan, "Scan adjacent sectors", schema_move_scan, 0, false, NULL},
@@ -418,6 +424,9 @@ static const command_entry_t k_command_registry[] = {
   {"sysop.universe.summary", cmd_sysop_universe_summary, "Universe summary", schema_placeholder, 0, false, NULL},
 
   {"sysop.engine_status.get", cmd_sysop_engine_status_get, "Get engine status", schema_placeholder, 0, false, NULL},
+  {"sysop.db_stats.get", cmd_sysop_db_stats_get, "Get per-statement DB timings", schema_placeholder, 0, false, NULL},
+  {"sysop.trace.dump", cmd_sysop_trace_dump, "Dump recent request traces", schema_placeholder, 0, false, NULL},
+  {"sysop.metrics.get", cmd_sysop_metrics_get, "Get server runtime metrics", schema_placeholder, 0, false, NULL},
   {"sysop.jobs.list", cmd_sysop_jobs_list, "List engine jobs", schema_placeholder, 0, false, NULL},
   {"sysop.jobs.get", cmd_sysop_jobs_get, "Get job details", schema_placeholder, 0, false, NULL},
   {"sysop.jobs.retry", cmd_sysop_jobs_retry, "Retry a job", schema_placeholder, 0, false, NULL},
@@ -446,7 +455,7 @@ static const command_entry_t k_command_registry[] = {
   {"player.list_online", cmd_player_list_online, "List online players",
    schema_player_list_online_request, 0, false, NULL},
   {"player.my_info", cmd_player_my_info, "Current player info",
-   schema_player_my_info, 0, false, NULL},
+   schema_player_my_info, CMD_FLAG_READONLY, false, NULL},
   {"player.rankings", cmd_player_rankings, "Player rankings",
    schema_placeholder, 0, false, NULL},
   {"player.computer.recommend_routes", cmd_player_computer_recommend_routes,
@@ -493,7 +502,8 @@ static const command_entry_t k_command_registry[] = {
    schema_sector_info, 0, false, NULL},
   {"sector.mine_disrupt", cmd_sector_mine_disrupt, "Disrupt (remove) owned mines",
    schema_placeholder, 0, false, NULL},
-  {"sector.scan", w_sector_scan, "Scan a sector", schema_sector_scan, 0, false, NULL},
+  {"sector.scan", w_sector_scan, "Scan a sector", schema_sector_scan,
+   CMD_FLAG_READONLY, false, NULL},
   {"sector.scan.density", w_sector_scan_density, "Scan sector density",
    schema_sector_scan_density, 0, false, NULL},
   {"sector.search", cmd_sector_search, "Search a sector",
@@ -628,7 +638,7 @@ static const command_entry_t k_command_registry[] = {
   {"trade.cancel", cmd_trade_cancel, "Cancel a trade offer",
    schema_trade_cancel, 0, false, NULL},
   {"trade.history", cmd_trade_history, "View recent trade transactions",
-   schema_trade_history, 0, false, NULL},
+   schema_trade_history, CMD_FLAG_READONLY, false, NULL},
   {"trade.jettison", cmd_trade_jettison, "Dump cargo into space",
    schema_trade_jettison, 0, false, NULL},
   {"trade.offer", cmd_trade_offer, "Create a trade offer to another player",
@@ -649,72 +659,115 @@ static const command_entry_t k_command_registry[] = {
 };
 
 
-/* Provide authoritative list to others */
-void
-loop_get_supported_commands (const cmd_desc_t **out_tbl, size_t *out_n)
+/* --------------------------------------------------------------------------
+   Command index: a descriptor per registry row, hashed on the case-folded
+   name and built once on first use. Dispatch and schema lookups no longer
+   scan k_command_registry.
+   -------------------------------------------------------------------------- */
+
+typedef struct
 {
-  static cmd_desc_t *s_descs = NULL;
-  static size_t s_count = 0;
+  const char *name;
+  command_handler_fn handler;
+  int flags;
+  bool validate;		/* schema is not schema_placeholder */
+  json_t *schema;		/* registry schema, for describe/list */
+  schema_prog_t *validator;	/* compiled schema_get() result for name */
+} command_desc_t;
 
-  if (!s_descs)
-    {
-      size_t n = 0;
-      size_t count = 0;
+static command_desc_t *g_cmd_descs = NULL;
+static cmd_index_t *g_cmd_index = NULL;
+static cmd_desc_t *g_public_descs = NULL;
+static size_t g_public_count = 0;
+static pthread_once_t g_cmd_once = PTHREAD_ONCE_INIT;
 
-      while (k_command_registry[n].name)
-	{
+
+static bool
+command_is_public (const command_entry_t *e)
+{
 #ifdef BUILD_PRODUCTION
-	  if (k_command_registry[n].flags & CMD_FLAG_DEBUG_ONLY)
-	    {
-	      n++;
-	      continue;
-	    }
+  if (e->flags & CMD_FLAG_DEBUG_ONLY)
+    {
+      return false;
+    }
 #endif
-	  if (k_command_registry[n].flags & CMD_FLAG_HIDDEN)
-	    {
-	      n++;
-	      continue;
-	    }
-	  n++;
-	  count++;
+  return !(e->flags & CMD_FLAG_HIDDEN);
+}
+
+
+static void
+command_index_build (void)
+{
+  size_t n = 0;
+
+  while (k_command_registry[n].name)
+    {
+      n++;
+    }
+  g_cmd_descs = calloc (n, sizeof (command_desc_t));
+  g_public_descs = calloc (n, sizeof (cmd_desc_t));
+  g_cmd_index = cmd_index_new (n);
+  if (!g_cmd_descs || !g_public_descs || !g_cmd_index)
+    {
+      LOGE ("command index: allocation failed");
+      return;
+    }
+
+  for (size_t i = 0; i < n; i++)
+    {
+      const command_entry_t *e = &k_command_registry[i];
+      command_desc_t *d = &g_cmd_descs[i];
+
+      d->name = e->name;
+      d->handler = e->handler;
+      d->flags = e->flags;
+      d->validate = (e->schema != schema_placeholder);
+      d->schema = e->schema ? e->schema () : NULL;
+
+      /* Same resolution order as schema_get(): built-in table first */
+      json_t *resolved = schema_lookup_builtin (e->name);
+
+      d->validator = schema_compile (resolved ? resolved : d->schema);
+      if (resolved)
+	{
+	  json_decref (resolved);
 	}
-      s_descs = calloc (count, sizeof (cmd_desc_t));
-      if (s_descs)
+      /* Earlier rows win on duplicate names, as with the old linear scan */
+      (void) cmd_index_put (g_cmd_index, e->name, d);
+
+      if (command_is_public (e))
 	{
-	  size_t j = 0;
-	  size_t i = 0;
+	  cmd_desc_t *p = &g_public_descs[g_public_count++];
 
-	  while (k_command_registry[i].name)
-	    {
-#ifdef BUILD_PRODUCTION
-	      if (k_command_registry[i].flags & CMD_FLAG_DEBUG_ONLY)
-		{
-		  i++;
-		  continue;
-		}
-#endif
-	      if (k_command_registry[i].flags & CMD_FLAG_HIDDEN)
-		{
-		  i++;
-		  continue;
-		}
-	      s_descs[j].name = k_command_registry[i].name;
-	      s_descs[j].summary = k_command_registry[i].summary;
-	      s_descs[j].is_deprecated = k_command_registry[i].is_deprecated;
-	      s_descs[j].replacement = k_command_registry[i].replacement;
-	      j++;
-	      i++;
-	    }
-	  s_count = count;
+	  p->name = e->name;
+	  p->summary = e->summary;
+	  p->is_deprecated = e->is_deprecated;
+	  p->replacement = e->replacement;
 	}
     }
+}
+
+
+static const command_desc_t *
+command_lookup (const char *name)
+{
+  pthread_once (&g_cmd_once, command_index_build);
+  return (const command_desc_t *) cmd_index_get (g_cmd_index, name);
+}
+
+
+/* Provide authoritative list to others */
+void
+loop_get_supported_commands (const cmd_desc_t **out_tbl, size_t *out_n)
+{
+  pthread_once (&g_cmd_once, command_index_build);
   if (out_tbl)
     {
-      *out_tbl = (const cmd_desc_t *) s_descs;
+      *out_tbl = (const cmd_desc_t *) g_public_descs;
     }
   if (out_n)
     {
-      *out_n = s_count;
+      *out_n = g_public_count;
     }
 }
 
@@ -725,21 +778,17 @@ loop_get_schema_for_command (const char *name)
     {
       return NULL;
     }
-  for (int i = 0; k_command_registry[i].name != NULL; i++)
-    {
-      if (strcasecmp (name, k_command_registry[i].name) == 0)
-	{
-	  if (k_command_registry[i].schema)
-	    {
-	      return k_command_registry[i].schema ();
-	    }
-	  else
-	    {
-	      return NULL;
-	    }
-	}
-    }
-  return NULL;
+  const command_desc_t *d = command_lookup (name);
+
+  return (d && d->schema) ? json_incref (d->schema) : NULL;
+}
+
+const schema_prog_t *
+loop_get_validator_for_command (const char *name)
+{
+  const command_desc_t *d = name ? command_lookup (name) : NULL;
+
+  return d ? d->validator : NULL;
 }
 
 json_t *
@@ -848,69 +897,60 @@ broadcast_sweep_once (db_t *db, int max_rows)
   return rows;
 }
 
-client_node_t *g_clients = NULL;
-pthread_mutex_t g_clients_mu = PTHREAD_MUTEX_INITIALIZER;
 
 void
-server_register_client (client_ctx_t *ctx)
+server_deliver_to_ctx (client_ctx_t *c, const char *event_type,
+		       json_t *data, reactor_buf_t **rendered)
 {
-  pthread_mutex_lock (&g_clients_mu);
-  client_node_t *n = (client_node_t *) calloc (1, sizeof (*n));
+  if (c == g_ctx_for_send && c->captured_envelopes_valid
+      && c->captured_envelopes)
+    {
+      json_t *tmp = json_incref (data);
 
-  if (n)
+      send_response_ok_take (c, NULL, event_type, &tmp);	/* bulk */
+      return;
+    }
+  if (event_batch_push (c, event_type, data))
     {
-      n->ctx = ctx;
-      n->next = g_clients;
-      g_clients = n;
+      return;
     }
-  pthread_mutex_unlock (&g_clients_mu);
+  /* Rendered once, on the first online recipient */
+  if (!*rendered)
+    {
+      *rendered = render_enveloped_ok (event_type, data);
+    }
+  send_all_rendered (c->fd, *rendered);
 }
 
-void
-server_unregister_client (client_ctx_t *ctx)
+
+struct deliver_ctx
 {
-  pthread_mutex_lock (&g_clients_mu);
-  client_node_t **pp = &g_clients;
+  const char *event_type;
+  json_t *data;
+  reactor_buf_t *rendered;
+};
 
-  while (*pp)
-    {
-      if ((*pp)->ctx == ctx)
-	{
-	  client_node_t *dead = *pp;
-	  *pp = (*pp)->next;
-	  free (dead);
-	  break;
-	}
-      pp = &((*pp)->next);
-    }
-  pthread_mutex_unlock (&g_clients_mu);
+
+static void
+deliver_cb (client_ctx_t *c, void *arg)
+{
+  struct deliver_ctx *d = (struct deliver_ctx *) arg;
+
+  server_deliver_to_ctx (c, d->event_type, d->data, &d->rendered);
 }
 
+
 int
 server_deliver_to_player (int player_id, const char *event_type, json_t *data)
 {
-  int delivered = 0;
-  pthread_mutex_lock (&g_clients_mu);
-  for (client_node_t * n = g_clients; n; n = n->next)
-    {
-      client_ctx_t *c = n->ctx;
-
-      if (!c)
-	{
-	  continue;
-	}
-      if (c->player_id == player_id && c->fd >= 0)
-	{
-	  json_t *tmp = json_incref (data);
+  struct deliver_ctx d = {.event_type = event_type,.data = data };
+  int delivered = client_registry_for_each_player (player_id, deliver_cb, &d);
 
-	  send_response_ok_take (c, NULL, event_type, &tmp);
-	  delivered++;
-	}
-    }
-  pthread_mutex_unlock (&g_clients_mu);
+  reactor_buf_release (d.rendered);
   return (delivered > 0) ? 0 : -1;
 }
 
+
 /* ------------------------ idempotency helpers  ------------------------ */
 static uint64_t
 fnv1a64 (const unsigned char *s, size_t n)
@@ -1078,53 +1118,70 @@ server_dispatch_command (client_ctx_t *ctx, json_t *root)
 
   const char *c = json_string_value (cmd);
   // LOGD ("Dispatching command: '%s'", c);
+  const command_desc_t *d = command_lookup (c);
 
-  for (int i = 0; k_command_registry[i].name != NULL; i++)
+  if (!d)
     {
-      if (strcasecmp (c, k_command_registry[i].name) == 0)
-	{
+      return -1;
+    }
 #ifdef BUILD_PRODUCTION
-	  if (k_command_registry[i].flags & CMD_FLAG_DEBUG_ONLY)
-	    {
-	      return -1;
-	    }
+  if (d->flags & CMD_FLAG_DEBUG_ONLY)
+    {
+      return -1;
+    }
 #endif
 
-	  /* SCHEMA VALIDATION */
-	  json_t *data = json_object_get (root, "data");
-	  char *why = NULL;
-	  if (k_command_registry[i].schema != schema_placeholder &&
-	      schema_validate_payload (k_command_registry[i].name, data, &why) !=
-	      0)
-	    {
-	      int err_code = ERR_INVALID_SCHEMA;
-	      if (why && strstr (why, "missing"))
-		{
-		  err_code = ERR_MISSING_FIELD;
-		}
-	      send_response_error (ctx, root, err_code, why ? why : "Invalid request schema");
-	      free (why);
-	      return 0;		/* Error handled */
-	    }
+  /* SCHEMA VALIDATION */
+  json_t *data = json_object_get (root, "data");
+  char *why = NULL;
+  int span = trace_span_begin ("schema", NULL);
+  int invalid = d->validate
+    && schema_prog_validate (d->validator, data, &why) != 0;
 
-	  /* AUTH GATE — SINGLE SOURCE OF TRUTH */
-	  if (!(k_command_registry[i].flags & CMD_FLAG_AUTH_FREE))
-	    {
-	      if (ctx->player_id <= 0)
-		{
-		  send_response_error (ctx,
-				       root,
-				       ERR_NOT_AUTHENTICATED,
-				       "Not authenticated");
-		  return -1;
-		}
-	    }
+  trace_span_end (span);
+  if (invalid)
+    {
+      int err_code = ERR_INVALID_SCHEMA;
+      if (why && strstr (why, "missing"))
+	{
+	  err_code = ERR_MISSING_FIELD;
+	}
+      send_response_error (ctx, root, err_code, why ? why : "Invalid request schema");
+      free (why);
+      return 0;		/* Error handled */
+    }
 
-	  return k_command_registry[i].handler (ctx, root);
+  /* AUTH GATE — SINGLE SOURCE OF TRUTH */
+  if (!(d->flags & CMD_FLAG_AUTH_FREE))
+    {
+      if (ctx->player_id <= 0)
+	{
+	  send_response_error (ctx,
+			       root,
+			       ERR_NOT_AUTHENTICATED,
+			       "Not authenticated");
+	  return -1;
 	}
     }
 
-  return -1;
+  /* Read-only commands may run on the replica; anything else may write,
+     so keep this player's next reads on the primary */
+  int replica = (d->flags & CMD_FLAG_READONLY)
+    ? game_db_begin_readonly (ctx->player_id) : 0;
+
+  span = trace_span_begin (replica ? "handler.replica" : "handler", c);
+  int rc = d->handler (ctx, root);
+
+  trace_span_end (span);
+  if (d->flags & CMD_FLAG_READONLY)
+    {
+      game_db_end_readonly (replica);
+    }
+  else
+    {
+      game_db_note_write (ctx->player_id);
+    }
+  return rc;
 }
 
 static void
@@ -1143,6 +1200,7 @@ process_message (client_ctx_t *ctx, json_t *root)
   json_t *jmeta = json_object_get (root, "meta");
   json_t *jauth = json_object_get (root, "auth");
   const char *session_token = NULL;
+  int span = trace_span_begin ("session", NULL);
 
   if (json_is_object (jmeta))
     {
@@ -1173,21 +1231,45 @@ process_message (client_ctx_t *ctx, json_t *root)
       /* sector_id: keep as-is if already set, but do not treat it as auth. */
     }
 
-  if (session_token)
+  session_info_t sess = { 0 };
+
+  if (session_token && session_cache_get (session_token, &sess))
+    {
+      ctx->player_id = sess.player_id;
+      ctx->corp_id = sess.corp_id;
+      ctx->ship_id = sess.ship_id;
+      if (sess.sector_id > 0)
+	{
+	  ctx->sector_id = sess.sector_id;
+	}
+      if (ctx->sector_id <= 0)
+	{
+	  ctx->sector_id = 1;
+	}
+    }
+  else if (session_token)
     {
       int32_t pid = 0;
       int64_t exp = 0;
+      session_ticket_t ticket;
+
+      session_cache_begin (&ticket);
       int rc = repo_session_lookup (db, session_token, &pid, &exp);
       if (rc == 0 && pid > 0)
 	{
-	  ctx->player_id = (int) pid;
-	  ctx->corp_id = h_get_player_corp_id (db, (int) pid);
-	  ctx->ship_id = h_get_active_ship_id (db, (int) pid);
-	  int db_sector = h_get_player_sector (db, (int) pid);
-
-	  if (db_sector > 0)
+	  session_cache_bind_player (&ticket, (int) pid);
+	  sess.player_id = (int) pid;
+	  sess.corp_id = h_get_player_corp_id (db, (int) pid);
+	  sess.ship_id = h_get_active_ship_id (db, (int) pid);
+	  sess.sector_id = h_get_player_sector (db, (int) pid);
+	  session_cache_put (&ticket, session_token, &sess, exp);
+
+	  ctx->player_id = sess.player_id;
+	  ctx->corp_id = sess.corp_id;
+	  ctx->ship_id = sess.ship_id;
+	  if (sess.sector_id > 0)
 	    {
-	      ctx->sector_id = db_sector;
+	      ctx->sector_id = sess.sector_id;
 	    }
 	  if (ctx->sector_id <= 0)
 	    {
@@ -1206,6 +1288,8 @@ process_message (client_ctx_t *ctx, json_t *root)
     {
       ctx->sector_id = 1;
     }
+  client_registry_update (ctx);
+  trace_span_end (span);
   if (!(cmd && json_is_string (cmd)) && !(evt && json_is_string (evt)))
     {
       send_response_error (ctx,
@@ -1233,152 +1317,125 @@ process_message (client_ctx_t *ctx, json_t *root)
 			       "Unknown command");
 	}
     }
+  /* Pub/sub delivery follows the player this connection last spoke for */
+  if (ctx->player_id > 0)
+    {
+      topic_index_bind (ctx, ctx->player_id, game_db_get_handle ());
+    }
 }
 
-/* TLS helper: read a line from SSL connection (buffered for partial reads) */
-static ssize_t
-ssl_readline (SSL *ssl, unsigned char *buf, size_t buf_len,
-	      unsigned char *read_buf, size_t *read_pos, size_t *read_used)
+/* Reactor callbacks: run on a worker thread that owns the connection */
+static void
+on_client_message (client_ctx_t *ctx, json_t *root)
 {
-  size_t line_len = 0;
+  json_t *cmd = json_object_get (root, "command");
+
+  ctx->trace = trace_request_begin (ctx->cid, json_is_string (cmd) ?
+				    json_string_value (cmd) : NULL);
+  int span = trace_span_begin ("db.checkout", NULL);
+
+  game_db_checkout ();
+  trace_span_end (span);
+  process_message (ctx, root);
+  game_db_checkin ();
+  trace_request_end (ctx->trace);
+  ctx->trace = NULL;
+}
+
 
-  while (line_len < buf_len - 1)
+static void
+on_client_close (client_ctx_t *ctx)
+{
+  comm_clear_subscriptions (ctx);
+  client_registry_remove (ctx);
+  /* After both: no publisher can reach ctx any more */
+  event_batch_drop (ctx);
+  if (ctx->is_tls && ctx->ssl_conn)
     {
-      /* Check if we have data in buffer */
-      if (*read_pos < *read_used)
-	{
-	  unsigned char ch = read_buf[(*read_pos)++];
-	  buf[line_len++] = ch;
-	  if (ch == '\n')
-	    {
-	      buf[line_len] = '\0';
-	      return (ssize_t) line_len;
-	    }
-	}
-      else
-	{
-	  /* Buffer empty, read more */
-	  int n = SSL_read (ssl, read_buf, 8192);
-	  if (n > 0)
-	    {
-	      *read_used = (size_t) n;
-	      *read_pos = 0;
-	    }
-	  else if (n == 0)
-	    {
-	      /* Connection closed cleanly */
-	      if (line_len > 0)
-		{
-		  buf[line_len] = '\0';
-		  return (ssize_t) line_len;
-		}
-	      return 0;
-	    }
-	  else
-	    {
-	      /* SSL error */
-	      int err = SSL_get_error (ssl, n);
-	      if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
-		{
-		  continue;	/* Retry */
-		}
-	      LOGD ("SSL_read error: %d", err);
-	      return -1;
-	    }
-	}
+      SSL_shutdown (ctx->ssl_conn);
+      SSL_free (ctx->ssl_conn);
+      ctx->ssl_conn = NULL;
     }
-
-  /* Line too long */
-  LOGD ("SSL readline: line exceeds max length %zu", buf_len);
-  return -1;
+  if (ctx->is_tls)
+    {
+      pthread_mutex_destroy (&ctx->io_mu);
+    }
+  if (ctx->fd >= 0)
+    {
+      close (ctx->fd);
+    }
+  LOGI ("[cid=%" PRIu64 "] client closed", ctx->cid);
+  free (ctx);
 }
 
-void *
-connection_thread (void *arg)
+
+/* Accept one pending connection and hand it to the reactor.
+   Returns 0 if a client was accepted, -1 when the backlog is drained. */
+static int
+accept_one (int listen_fd, volatile sig_atomic_t *running)
 {
-  client_ctx_t *ctx = (client_ctx_t *) arg;
-  int fd = ctx->fd;
+  static atomic_uint_fast64_t next_cid = 1;
+  client_ctx_t *ctx = calloc (1, sizeof (*ctx));
 
-  char *line = NULL;
-  size_t line_len = 0;
-  ssize_t read_len;
+  if (!ctx)
+    {
+      LOGE ("malloc failed\n");
+      return -1;
+    }
+  socklen_t sl = sizeof (ctx->peer);
+  int cfd = accept4 (listen_fd, (struct sockaddr *) &ctx->peer, &sl,
+		     SOCK_CLOEXEC | SOCK_NONBLOCK);
 
-  if (ctx->is_tls)
+  if (cfd < 0)
     {
-      /* TLS path: use ssl_readline */
-      char line_buf[65536];
-      while ((read_len = ssl_readline (ctx->ssl_conn, (unsigned char *) line_buf,
-					sizeof (line_buf),
-					ctx->ssl_read_buf, &ctx->ssl_read_pos,
-					&ctx->ssl_read_used)) > 0)
+      free (ctx);
+      if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)
 	{
-	  json_error_t jerr;
-	  json_t *root = json_loads (line_buf, 0, &jerr);
-
-	  if (!root || !json_is_object (root))
-	    {
-	      send_enveloped_error (fd, NULL, ERR_INVALID_SCHEMA,
-				    "Malformed JSON");
-	      if (root)
-		json_decref (root);
-	    }
-	  else
-	    {
-	      process_message (ctx, root);
-	      json_decref (root);
-	    }
+	  perror ("accept");
 	}
+      return -1;
     }
-  else
+
+  /* TLS: the handshake itself is driven by the reactor workers */
+  if (g_cfg.tls_enabled && g_ssl_ctx)
     {
-      /* Plaintext path: use FILE* and getline */
-      FILE *f = fdopen (fd, "r");
-      if (!f)
+      SSL *ssl = SSL_new (g_ssl_ctx);
+      if (!ssl)
 	{
-	  close (fd);
+	  LOGE ("SSL_new failed\n");
+	  close (cfd);
 	  free (ctx);
-	  return NULL;
+	  return 0;
 	}
 
-      while (getline (&line, &line_len, f) != -1)
+      if (SSL_set_fd (ssl, cfd) <= 0)
 	{
-	  json_error_t jerr;
-	  json_t *root = json_loads (line, 0, &jerr);
-
-	  if (!root || !json_is_object (root))
-	    {
-	      send_enveloped_error (fd, NULL, ERR_INVALID_SCHEMA,
-				    "Malformed JSON");
-	      if (root)
-		json_decref (root);
-	    }
-	  else
-	    {
-	      process_message (ctx, root);
-	      json_decref (root);
-	    }
+	  LOGE ("SSL_set_fd failed\n");
+	  SSL_free (ssl);
+	  close (cfd);
+	  free (ctx);
+	  return 0;
 	}
+      SSL_set_accept_state (ssl);
 
-      free (line);
-      fclose (f);
-    }
-
-  /* TLS cleanup */
-  if (ctx->is_tls && ctx->ssl_conn)
-    {
-      SSL_shutdown (ctx->ssl_conn);
-      SSL_free (ctx->ssl_conn);
-    }
-
-  if (ctx->is_tls)
-    {
-      close (fd);
+      ctx->is_tls = 1;
+      ctx->ssl_conn = ssl;
+      pthread_mutex_init (&ctx->io_mu, NULL);
     }
 
-  db_close_thread ();
-  loop_remove_client (ctx);
-  free (ctx);
-  return NULL;
+  ctx->cid = atomic_fetch_add (&next_cid, 1);
+  ctx->fd = cfd;
+  ctx->running = (sig_atomic_t *) running;
+  client_registry_add (ctx);
+  char ip[INET_ADDRSTRLEN];
+
+  inet_ntop (AF_INET, &ctx->peer.sin_addr, ip, sizeof (ip));
+  LOGI ("[cid=%" PRIu64 "] Client connected: %s:%u (fd=%d, tls=%d)\n",
+	ctx->cid, ip, (unsigned) ntohs (ctx->peer.sin_port), cfd,
+	ctx->is_tls);
+  /* On failure the reactor has already closed and freed ctx */
+  (void) reactor_add_client (ctx);
+  return 0;
 }
 
 int
@@ -1426,6 +1483,16 @@ server_loop (volatile sig_atomic_t *running)
 	}
 
       SSL_CTX_set_options (g_ssl_ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+
+      /* Session resumption: server-side cache for TLS 1.2 session IDs and
+         stateless tickets (TLS 1.2 and 1.3) so reconnecting clients skip
+         the full handshake. */
+      SSL_CTX_clear_options (g_ssl_ctx, SSL_OP_NO_TICKET);
+      SSL_CTX_set_session_cache_mode (g_ssl_ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_set_session_id_context (g_ssl_ctx,
+				      (const unsigned char *) "twclone", 7);
+      SSL_CTX_sess_set_cache_size (g_ssl_ctx, g_cfg.tls_session_cache_size);
+      SSL_CTX_set_timeout (g_ssl_ctx, g_cfg.tls_session_timeout_s);
       LOGI ("TLS initialized with cert=%s, key=%s\n",
 	    g_cfg.tls_cert_path, g_cfg.tls_key_path);
     }
@@ -1440,16 +1507,32 @@ server_loop (volatile sig_atomic_t *running)
       return -1;
     }
   LOGI ("Listening on 0.0.0.0:%d\n", g_cfg.server_port);
-  struct pollfd pfd = {.fd = listen_fd,.events = POLLIN,.revents = 0 };
-  pthread_attr_t attr;
+  session_cache_init (g_cfg.session_cache_ttl_ms);
+  db_set_slow_query_ms (g_cfg.db_slow_query_ms);
+  trace_init (g_cfg.trace_ring_spans, g_cfg.trace_log_sample);
+  if (reactor_start (g_cfg.net_worker_threads, on_client_message,
+		     on_client_close) != 0 || reactor_add_listener (listen_fd) != 0)
+    {
+      LOGE ("Server loop exiting: reactor initialisation failed.\n");
+      close (listen_fd);
+      if (g_ssl_ctx)
+	SSL_CTX_free (g_ssl_ctx);
+      return -1;
+    }
+  reactor_set_handshake_timeout (g_cfg.tls_handshake_timeout_ms);
+  reactor_set_outq_limit (g_cfg.net_outq_max_kb, g_cfg.net_outq_drop != 0);
+  event_batch_configure (g_cfg.event_batch_ms, g_cfg.event_batch_max);
 
-  pthread_attr_init (&attr);
-  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+  /* Batches are flushed once per tick; keep ticks within one window */
+  int tick_ms = (g_cfg.event_batch_ms > 0 && g_cfg.event_batch_ms < 100)
+    ? g_cfg.event_batch_ms : 100;
 
   while (*running)
     {
       g_server_tick++;
-      int rc = poll (&pfd, 1, 100);
+      int rc = reactor_run_once (tick_ms);
+
+      event_batch_flush_due ();
       {
 	static uint64_t last_broadcast_ms = 0;
 	uint64_t now_ms = monotonic_millis ();
@@ -1463,138 +1546,21 @@ server_loop (volatile sig_atomic_t *running)
 
       if (rc < 0)
 	{
-	  if (errno == EINTR)
-	    {
-	      continue;
-	    }
-	  perror ("poll");
+	  perror ("epoll_wait");
 	  break;
 	}
-      if (rc == 0)
-	{
-	  continue;
-	}
-      if (pfd.revents & POLLIN)
+      if (rc > 0)
 	{
-	  client_ctx_t *ctx = calloc (1, sizeof (*ctx));
-
-	  if (!ctx)
-	    {
-	      LOGE ("malloc failed\n");
-	      continue;
-	    }
-	  socklen_t sl = sizeof (ctx->peer);
-	  int cfd = accept (listen_fd, (struct sockaddr *) &ctx->peer, &sl);
-
-	  if (cfd < 0)
-	    {
-	      free (ctx);
-	      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
-		{
-		  continue;
-		}
-	      perror ("accept");
-	      continue;
-	    }
-
-	  /* TLS handshake if enabled */
-	  if (g_cfg.tls_enabled && g_ssl_ctx)
-	    {
-	      SSL *ssl = SSL_new (g_ssl_ctx);
-	      if (!ssl)
-		{
-		  LOGE ("SSL_new failed\n");
-		  close (cfd);
-		  free (ctx);
-		  continue;
-		}
-
-	      if (SSL_set_fd (ssl, cfd) <= 0)
-		{
-		  LOGE ("SSL_set_fd failed\n");
-		  SSL_free (ssl);
-		  close (cfd);
-		  free (ctx);
-		  continue;
-		}
-
-	      int ret = SSL_accept (ssl);
-	      if (ret <= 0)
-		{
-		  int err = SSL_get_error (ssl, ret);
-		  LOGE ("SSL_accept failed: %d\n", err);
-		  SSL_free (ssl);
-		  close (cfd);
-		  free (ctx);
-		  continue;
-		}
-
-	      ctx->is_tls = 1;
-	      ctx->ssl_conn = ssl;
-	      ctx->ssl_read_pos = 0;
-	      ctx->ssl_read_used = 0;
-	    }
-
-	  loop_add_client (ctx);
-	  ctx->fd = cfd;
-	  ctx->running = (sig_atomic_t *) running;
-	  char ip[INET_ADDRSTRLEN];
-
-	  inet_ntop (AF_INET, &ctx->peer.sin_addr, ip, sizeof (ip));
-	  LOGI ("Client connected: %s:%u (fd=%d, tls=%d)\n", ip,
-		(unsigned) ntohs (ctx->peer.sin_port), cfd, ctx->is_tls);
-	  pthread_t th;
-	  int prc = pthread_create (&th, &attr, connection_thread, ctx);
-
-	  if (prc == 0)
-	    {
-	      LOGI ("[cid=%" PRIu64 "] thread created", ctx->cid);
-	    }
-	  else
+	  /* Level-triggered listener: drain the backlog */
+	  while (*running && accept_one (listen_fd, running) == 0)
 	    {
-	      LOGE ("pthread_create: %s\n", strerror (prc));
-	      loop_remove_client (ctx);
-	      if (ctx->is_tls && ctx->ssl_conn)
-		{
-		  SSL_free (ctx->ssl_conn);
-		}
-	      close (cfd);
-	      free (ctx);
+	      ;
 	    }
 	}
     }
-  pthread_attr_destroy (&attr);
+  reactor_stop ();
   close (listen_fd);
   LOGI ("Server loop exiting...\n");
   return 0;
 }
 
-void
-loop_add_client (client_ctx_t *ctx)
-{
-  pthread_mutex_lock (&g_clients_mu);
-  client_node_t *n = malloc (sizeof (client_node_t));
-  n->ctx = ctx;
-  n->next = g_clients;
-  g_clients = n;
-  pthread_mutex_unlock (&g_clients_mu);
-}
-
-void
-loop_remove_client (client_ctx_t *ctx)
-{
-  pthread_mutex_lock (&g_clients_mu);
-  client_node_t **pp = &g_clients;
-  while (*pp)
-    {
-      if ((*pp)->ctx == ctx)
-	{
-	  client_node_t *tmp = *pp;
-	  *pp = (*pp)->next;
-	  free (tmp);
-	  break;
-	}
-      pp = &((*pp)->next);
-    }
-  pthread_mutex_unlock (&g_clients_mu);
-}
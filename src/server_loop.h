@@ -4,6 +4,7 @@
 #include <signal.h>
 #include "db/repo/repo_database.h"	/* for db_handle, etc. */
 #include "common.h"
+#include "server_reactor.h"	/* reactor_buf_t */
 
 
 
@@ -13,18 +14,6 @@ void attach_rate_limit_meta (json_t * env, client_ctx_t * ctx);
 void rl_tick (client_ctx_t * ctx);
 
 
-/* ---- client registry / delivery (used by broadcast path) ---- */
-void server_register_client (client_ctx_t * ctx);
-void server_unregister_client (client_ctx_t * ctx);
-typedef struct client_node_s
-{
-  client_ctx_t *ctx;
-  struct client_node_s *next;
-} client_node_t;
-
-extern client_node_t *g_clients;
-extern pthread_mutex_t g_clients_mu;
-
 /* Returns 0 if delivered/handled, -1 if command not found. */
 int server_dispatch_command (client_ctx_t * ctx, json_t * root);
 
@@ -32,10 +21,17 @@ int server_dispatch_command (client_ctx_t * ctx, json_t * root);
 #define CMD_FLAG_HIDDEN         (1 << 1)
 #define CMD_FLAG_AUTH_REQUIRED   (1 << 2)
 #define CMD_FLAG_AUTH_FREE       (1 << 3)
+/* Reads only: may run on the read replica (game_db_begin_readonly) */
+#define CMD_FLAG_READONLY        (1 << 4)
 
 /* Returns 0 if something was delivered; -1 if no online client for player_id.
    Does NOT steal 'data'. */
 int server_deliver_to_player (int player_id, const char *event_type,
 			      json_t * data);
+/* Deliver to one live connection, for fan-out over topic_index: *rendered
+   (NULL at first, then released by the caller with reactor_buf_release)
+   keeps the envelope serialised once across calls. */
+void server_deliver_to_ctx (client_ctx_t * c, const char *event_type,
+			    json_t * data, reactor_buf_t ** rendered);
 void idemp_fingerprint_json (json_t * obj, char out[17]);
 #endif /* SERVER_LOOP_H */
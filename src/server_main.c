@@ -91,6 +91,8 @@ build_capabilities (void)
   json_object_set_new (features, "sector.describe", json_true ());
   json_object_set_new (features, "trade.buy", json_true ());
   json_object_set_new (features, "server_autopilot", json_false ());
+  json_object_set_new (features, "events.batch_v1",
+		       json_boolean (g_cfg.event_batch_ms > 0));
   json_object_set_new (g_capabilities, "features", features);
   json_object_set_new (g_capabilities, "version",
 		       json_string ("1.0.0-alpha"));
@@ -30,6 +30,7 @@
 #include "server_ports.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "client_registry.h"
 
 #ifndef GENESIS_ENABLED
 #define GENESIS_ENABLED 1
@@ -711,6 +712,7 @@ cmd_planet_land (client_ctx_t *ctx, json_t *root)
 
   // Update context
   ctx->sector_id = 0;		// Not in a sector anymore
+  client_registry_update (ctx);
   json_t *response_data = json_object ();
 
 
@@ -754,6 +756,7 @@ cmd_planet_launch (client_ctx_t *ctx, json_t *root)
 
   // Update context
   ctx->sector_id = sector_id;
+  client_registry_update (ctx);
 
   /* Canon #471: Sector assets engage on entry */
   if (server_combat_apply_entry_hazards (db, ctx, sector_id))
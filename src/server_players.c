@@ -28,6 +28,8 @@
 #include "server_bank.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "session_cache.h"
+#include "client_registry.h"
 
 /* Constants */
 enum
@@ -35,11 +37,6 @@ enum
 enum
 { MAX_AVOIDS = 64 };
 
-/* Externs */
-extern client_node_t *g_clients;
-extern pthread_mutex_t g_clients_mu;
-
-
 int
 cmd_player_list_online (client_ctx_t *ctx, json_t *root)
 {
@@ -1372,6 +1369,8 @@ spawn_starter_ship (db_t *db, int player_id, int sector_id)
     {
       return -1;
     }
+  session_cache_invalidate_player (player_id);
+  client_registry_move_player (player_id, sector_id);
 
   return 0;
 }
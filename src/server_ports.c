@@ -429,6 +429,22 @@ h_calculate_port_sell_price (db_t *db, int port_id, const char *commodity)
       return 0;
     }
 
+  return h_port_sell_price_from (base_price, quantity, max_capacity,
+				 techlevel, price_elasticity,
+				 volatility_factor);
+}
+
+
+int
+h_port_sell_price_from (int base_price, int quantity, int max_capacity,
+			int techlevel, double price_elasticity,
+			double volatility_factor)
+{
+  if (base_price <= 0)
+    {
+      return 0;
+    }
+
   double price_multiplier = 1.0;
 
 
@@ -1277,6 +1293,22 @@ h_calculate_port_buy_price (db_t *db, int port_id, const char *commodity)
       return 0;
     }
 
+  return h_port_buy_price_from (base_price, quantity, max_capacity,
+				techlevel, price_elasticity,
+				volatility_factor);
+}
+
+
+int
+h_port_buy_price_from (int base_price, int quantity, int max_capacity,
+		       int techlevel, double price_elasticity,
+		       double volatility_factor)
+{
+  if (quantity >= max_capacity || base_price <= 0)
+    {
+      return 0;
+    }
+
   double price_multiplier = 1.0;
 
 
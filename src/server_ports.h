@@ -61,6 +61,13 @@ int h_calculate_port_buy_price (db_t * db, int port_id,
 				const char *commodity);
 int h_calculate_port_sell_price (db_t * db, int port_id,
 				 const char *commodity);
+/* Same pricing from already-loaded inputs (see db_ports_get_price_info) */
+int h_port_buy_price_from (int base_price, int quantity, int max_capacity,
+			   int techlevel, double price_elasticity,
+			   double volatility_factor);
+int h_port_sell_price_from (int base_price, int quantity, int max_capacity,
+			    int techlevel, double price_elasticity,
+			    double volatility_factor);
 
 int parse_trade_lines (json_t * jitems, TradeLine ** out_lines,
 		       size_t *out_n);
@@ -0,0 +1,1431 @@
+/* src/server_reactor.c */
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <jansson.h>
+
+/* local includes */
+#include "server_reactor.h"
+#include "server_envelope.h"
+#include "server_log.h"
+#include "errors.h"
+
+#define REACTOR_MAX_EVENTS   256
+#define REACTOR_INBUF_INIT   16384
+#define REACTOR_INBUF_MAX    (REACTOR_MAX_FRAME * 2)
+/* Messages a worker handles before requeueing a busy connection (fairness) */
+#define REACTOR_MSG_BUDGET   16
+/* How often the reactor thread looks for stalled TLS handshakes */
+#define REACTOR_HS_SWEEP_MS  250
+/* Queued lines gathered into one sendmsg, and bytes into one TLS record */
+#define REACTOR_IOV_MAX      64
+#define REACTOR_TLS_RECORD   16384
+
+/* Tag used for the listener in epoll_event.data.ptr */
+static char g_listener_tag;
+
+/* A rendered line shared by every queue it was sent to */
+struct reactor_buf_s
+{
+  atomic_int refs;
+  size_t len;			/* newline included */
+  char data[];
+};
+
+/* One queued outbound line, newline included: either its own copy in
+   data or a reference to a shared buffer */
+typedef struct out_chunk_s
+{
+  struct out_chunk_s *next;
+  reactor_buf_t *shared;
+  const char *bytes;		/* data or shared->data */
+  size_t len;
+  size_t off;			/* bytes already written */
+  char data[];
+} out_chunk_t;
+
+typedef struct reactor_conn_s
+{
+  client_ctx_t *ctx;
+  int fd;
+
+  /* guarded by mu */
+  pthread_mutex_t mu;
+  bool readable;		/* epoll reported data/hangup since last read */
+  bool scheduled;		/* queued for, or owned by, a worker */
+  bool dead;			/* torn down; waiting for the reactor to free it */
+
+  /* TLS handshake; the reactor thread reads these for the timeout sweep */
+  atomic_bool handshaking;
+  atomic_bool hs_expired;
+  uint64_t hs_start_ms;
+
+  /* owned by the scheduled worker */
+  char *inbuf;
+  size_t in_off;
+  size_t in_len;
+  size_t in_cap;
+  bool eof;
+
+  /* outbound queue; any thread may append. Lock order: out_mu, then
+     ctx->io_mu. */
+  pthread_mutex_t out_mu;
+  out_chunk_t *out_head;
+  out_chunk_t *out_tail;
+  size_t out_bytes;		/* queued, staged TLS record included */
+  size_t out_msgs;
+  bool out_armed;		/* socket full; EPOLLOUT requested */
+  bool out_closed;		/* torn down or cut off; drop further output */
+  char *tls_stage;		/* record being written: SSL_write must be */
+  size_t tls_len;		/* retried with the same buffer */
+
+  struct reactor_conn_s *next_ready;
+  struct reactor_conn_s *prev_live;
+  struct reactor_conn_s *next_live;
+  struct reactor_conn_s *next_dead;
+} reactor_conn_t;
+
+static int g_epfd = -1;
+static reactor_msg_fn g_on_message = NULL;
+static reactor_close_fn g_on_close = NULL;
+
+static pthread_t *g_workers = NULL;
+static int g_n_workers = 0;
+static atomic_bool g_stopping;
+static atomic_int g_live_count;
+
+/* TLS handshake accounting */
+static int g_hs_timeout_ms = 10000;
+static const uint64_t k_hs_bucket_ms[] = { 10, 50, 100, 250, 1000, 5000 };
+
+#define HS_BUCKETS (sizeof (k_hs_bucket_ms) / sizeof (k_hs_bucket_ms[0]))
+static atomic_uint_fast64_t g_hs_ok;
+static atomic_uint_fast64_t g_hs_failed;
+static atomic_uint_fast64_t g_hs_timed_out;
+static atomic_uint_fast64_t g_hs_resumed;
+static atomic_uint_fast64_t g_hs_ms_total;
+static atomic_uint_fast64_t g_hs_ms_max;
+static atomic_uint_fast64_t g_hs_hist[HS_BUCKETS + 1];
+
+/* Outbound queues: high-water mark per connection (0 = unbounded) and
+   what happens to a client above it */
+static size_t g_outq_max = 1024 * 1024;
+static bool g_outq_drop = false;
+static atomic_uint_fast64_t g_outq_bytes;
+static atomic_uint_fast64_t g_outq_msgs;
+static atomic_uint_fast64_t g_outq_peak;
+static atomic_int g_outq_backlogged;
+static atomic_uint_fast64_t g_outq_sent_msgs;
+static atomic_uint_fast64_t g_outq_sent_bytes;
+static atomic_uint_fast64_t g_outq_writes;
+static atomic_uint_fast64_t g_outq_dropped;
+static atomic_uint_fast64_t g_outq_cut;
+
+/* Connections by fd, for senders that only know the socket. Senders hold
+   the read side while queueing; teardown unmaps under the write side
+   before the fd can be closed and reused, and must not starve behind a
+   steady stream of senders. */
+static pthread_rwlock_t g_fd_lock =
+  PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+static reactor_conn_t **g_by_fd = NULL;
+static int g_by_fd_cap = 0;
+
+/* ready queue (FIFO) */
+static pthread_mutex_t g_ready_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_ready_cv = PTHREAD_COND_INITIALIZER;
+static reactor_conn_t *g_ready_head = NULL;
+static reactor_conn_t *g_ready_tail = NULL;
+
+/* live connections, and torn-down ones awaiting free on the reactor thread */
+static pthread_mutex_t g_live_mu = PTHREAD_MUTEX_INITIALIZER;
+static reactor_conn_t *g_live = NULL;
+static reactor_conn_t *g_dead = NULL;
+
+
+static uint64_t
+now_ms (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000ULL + (uint64_t) ts.tv_nsec / 1000000ULL;
+}
+
+
+static int
+set_nonblocking (int fd)
+{
+  int fl = fcntl (fd, F_GETFL, 0);
+  if (fl < 0)
+    {
+      return -1;
+    }
+  return fcntl (fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+
+static void
+ready_push (reactor_conn_t *c)
+{
+  pthread_mutex_lock (&g_ready_mu);
+  c->next_ready = NULL;
+  if (g_ready_tail)
+    {
+      g_ready_tail->next_ready = c;
+    }
+  else
+    {
+      g_ready_head = c;
+    }
+  g_ready_tail = c;
+  pthread_cond_signal (&g_ready_cv);
+  pthread_mutex_unlock (&g_ready_mu);
+}
+
+
+static reactor_conn_t *
+ready_pop (void)
+{
+  pthread_mutex_lock (&g_ready_mu);
+  while (!g_ready_head && !atomic_load (&g_stopping))
+    {
+      pthread_cond_wait (&g_ready_cv, &g_ready_mu);
+    }
+  reactor_conn_t *c = g_ready_head;
+
+  if (c)
+    {
+      g_ready_head = c->next_ready;
+      if (!g_ready_head)
+	{
+	  g_ready_tail = NULL;
+	}
+      c->next_ready = NULL;
+    }
+  pthread_mutex_unlock (&g_ready_mu);
+  return c;
+}
+
+
+/* Mark readable and hand to a worker unless one already owns it. */
+static void
+conn_signal (reactor_conn_t *c)
+{
+  bool enqueue = false;
+
+  pthread_mutex_lock (&c->mu);
+  if (!c->dead)
+    {
+      c->readable = true;
+      if (!c->scheduled)
+	{
+	  c->scheduled = true;
+	  enqueue = true;
+	}
+    }
+  pthread_mutex_unlock (&c->mu);
+  if (enqueue)
+    {
+      ready_push (c);
+    }
+}
+
+
+static int
+fd_map (reactor_conn_t *c)
+{
+  int rc = 0;
+
+  pthread_rwlock_wrlock (&g_fd_lock);
+  if (c->fd >= g_by_fd_cap)
+    {
+      int ncap = g_by_fd_cap ? g_by_fd_cap : 1024;
+
+      while (ncap <= c->fd)
+	{
+	  ncap *= 2;
+	}
+      reactor_conn_t **nm = realloc (g_by_fd, (size_t) ncap * sizeof (*nm));
+
+      if (nm)
+	{
+	  memset (nm + g_by_fd_cap, 0,
+		  (size_t) (ncap - g_by_fd_cap) * sizeof (*nm));
+	  g_by_fd = nm;
+	  g_by_fd_cap = ncap;
+	}
+      else
+	{
+	  rc = -1;
+	}
+    }
+  if (rc == 0)
+    {
+      g_by_fd[c->fd] = c;
+    }
+  pthread_rwlock_unlock (&g_fd_lock);
+  return rc;
+}
+
+
+static void
+fd_unmap (reactor_conn_t *c)
+{
+  pthread_rwlock_wrlock (&g_fd_lock);
+  if (c->fd < g_by_fd_cap && g_by_fd[c->fd] == c)
+    {
+      g_by_fd[c->fd] = NULL;
+    }
+  pthread_rwlock_unlock (&g_fd_lock);
+}
+
+
+/* Request (or stop requesting) writability events. out_mu held. */
+static void
+out_arm (reactor_conn_t *c, bool on)
+{
+  if (c->out_armed == on)
+    {
+      return;
+    }
+  struct epoll_event ev = {
+    .events = EPOLLIN | EPOLLRDHUP | EPOLLET | (on ? EPOLLOUT : 0),
+    .data.ptr = c
+  };
+
+  epoll_ctl (g_epfd, EPOLL_CTL_MOD, c->fd, &ev);
+  c->out_armed = on;
+  atomic_fetch_add (&g_outq_backlogged, on ? 1 : -1);
+}
+
+
+/* Account for n bytes that left the queue. out_mu held. */
+static void
+out_written (reactor_conn_t *c, size_t n)
+{
+  c->out_bytes -= n;
+  atomic_fetch_sub (&g_outq_bytes, n);
+  atomic_fetch_add (&g_outq_sent_bytes, n);
+  atomic_fetch_add (&g_outq_writes, 1);
+}
+
+
+static void
+out_pop (reactor_conn_t *c)
+{
+  out_chunk_t *k = c->out_head;
+
+  c->out_head = k->next;
+  if (!c->out_head)
+    {
+      c->out_tail = NULL;
+    }
+  c->out_msgs--;
+  atomic_fetch_sub (&g_outq_msgs, 1);
+  if (k->shared)
+    {
+      reactor_buf_release (k->shared);
+    }
+  free (k);
+}
+
+
+/* Drop everything queued and refuse further output. out_mu held. */
+static void
+out_discard (reactor_conn_t *c)
+{
+  c->out_closed = true;
+  while (c->out_head)
+    {
+      out_pop (c);
+    }
+  atomic_fetch_sub (&g_outq_bytes, c->out_bytes);
+  c->out_bytes = 0;
+  c->tls_len = 0;
+  if (c->out_armed)
+    {
+      c->out_armed = false;
+      atomic_fetch_sub (&g_outq_backlogged, 1);
+    }
+}
+
+
+/* Gather queued lines into TLS records of up to REACTOR_TLS_RECORD bytes. */
+static int
+out_flush_tls (reactor_conn_t *c, client_ctx_t *ctx)
+{
+  SSL *ssl = (SSL *) ctx->ssl_conn;
+
+  for (;;)
+    {
+      if (c->tls_len == 0)
+	{
+	  if (!c->out_head)
+	    {
+	      return 1;
+	    }
+	  if (!c->tls_stage
+	      && !(c->tls_stage = malloc (REACTOR_TLS_RECORD)))
+	    {
+	      return -1;
+	    }
+	  while (c->out_head && c->tls_len < REACTOR_TLS_RECORD)
+	    {
+	      out_chunk_t *k = c->out_head;
+	      size_t take = k->len - k->off;
+
+	      if (take > REACTOR_TLS_RECORD - c->tls_len)
+		{
+		  take = REACTOR_TLS_RECORD - c->tls_len;
+		}
+	      memcpy (c->tls_stage + c->tls_len, k->bytes + k->off, take);
+	      c->tls_len += take;
+	      k->off += take;
+	      if (k->off == k->len)
+		{
+		  atomic_fetch_add (&g_outq_sent_msgs, 1);
+		  out_pop (c);
+		}
+	    }
+	}
+
+      pthread_mutex_lock (&ctx->io_mu);
+      int r = SSL_write (ssl, c->tls_stage, (int) c->tls_len);
+      int serr = (r <= 0) ? SSL_get_error (ssl, r) : 0;
+
+      pthread_mutex_unlock (&ctx->io_mu);
+      if (r > 0)
+	{
+	  out_written (c, c->tls_len);
+	  c->tls_len = 0;
+	  continue;
+	}
+      if (serr == SSL_ERROR_WANT_WRITE || serr == SSL_ERROR_WANT_READ)
+	{
+	  return 0;
+	}
+      LOGD ("SSL_write error: %d", serr);
+      ERR_clear_error ();
+      return -1;
+    }
+}
+
+
+/* Write queued output until the queue is empty or the socket is full.
+   out_mu held. Returns 1 when drained, 0 if the socket would block, -1 on
+   error. */
+static int
+out_flush (reactor_conn_t *c)
+{
+  client_ctx_t *ctx = c->ctx;
+
+  if (ctx->is_tls && ctx->ssl_conn)
+    {
+      return out_flush_tls (c, ctx);
+    }
+  while (c->out_head)
+    {
+      struct iovec iov[REACTOR_IOV_MAX];
+      struct msghdr msg = {.msg_iov = iov };
+      size_t n = 0;
+
+      for (out_chunk_t *k = c->out_head; k && n < REACTOR_IOV_MAX; k = k->next)
+	{
+	  iov[n].iov_base = (char *) k->bytes + k->off;
+	  iov[n].iov_len = k->len - k->off;
+	  n++;
+	}
+      msg.msg_iovlen = n;
+
+      /* sendmsg rather than writev: a vanished peer must not raise SIGPIPE */
+      ssize_t w = sendmsg (c->fd, &msg, MSG_NOSIGNAL);
+
+      if (w < 0)
+	{
+	  if (errno == EINTR)
+	    {
+	      continue;
+	    }
+	  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	}
+      out_written (c, (size_t) w);
+      while (w > 0)
+	{
+	  out_chunk_t *k = c->out_head;
+	  size_t take = k->len - k->off;
+
+	  if (take > (size_t) w)
+	    {
+	      take = (size_t) w;
+	    }
+	  k->off += take;
+	  w -= (ssize_t) take;
+	  if (k->off == k->len)
+	    {
+	      atomic_fetch_add (&g_outq_sent_msgs, 1);
+	      out_pop (c);
+	    }
+	}
+    }
+  return 1;
+}
+
+
+/* Flush and keep EPOLLOUT in step with what is left. out_mu held. */
+static void
+out_pump (reactor_conn_t *c)
+{
+  int r = out_flush (c);
+
+  if (r < 0)
+    {
+      /* The peer is gone; the hangup reaches the owning worker anyway */
+      LOGD ("[cid=%" PRIu64 "] write failed; dropping %zu queued bytes",
+	    c->ctx->cid, c->out_bytes);
+      out_discard (c);
+      return;
+    }
+  out_arm (c, r == 0);
+}
+
+
+/* Worker side: drain what the socket takes now, e.g. after EPOLLOUT. */
+static void
+conn_out_resume (reactor_conn_t *c)
+{
+  pthread_mutex_lock (&c->out_mu);
+  if (!c->out_closed && (c->out_head || c->tls_len || c->out_armed))
+    {
+      out_pump (c);
+    }
+  pthread_mutex_unlock (&c->out_mu);
+}
+
+
+/* Worker-side teardown. The struct itself is freed later by the reactor
+   thread so that events already harvested by epoll_wait stay safe. */
+static void
+conn_teardown (reactor_conn_t *c)
+{
+  fd_unmap (c);
+
+  /* Last chance for queued output (e.g. a final error), then none */
+  pthread_mutex_lock (&c->out_mu);
+  if (!c->out_closed && c->ctx && !atomic_load (&c->handshaking))
+    {
+      (void) out_flush (c);
+    }
+  out_discard (c);
+  pthread_mutex_unlock (&c->out_mu);
+  epoll_ctl (g_epfd, EPOLL_CTL_DEL, c->fd, NULL);
+
+  pthread_mutex_lock (&c->mu);
+  c->dead = true;
+  pthread_mutex_unlock (&c->mu);
+
+  /* Off the live list before the close hook releases the fd: the number
+     can be handed straight to a new client, and the handshake sweep must
+     not shut that one down. */
+  pthread_mutex_lock (&g_live_mu);
+  if (c->prev_live)
+    {
+      c->prev_live->next_live = c->next_live;
+    }
+  else
+    {
+      g_live = c->next_live;
+    }
+  if (c->next_live)
+    {
+      c->next_live->prev_live = c->prev_live;
+    }
+  pthread_mutex_unlock (&g_live_mu);
+
+  client_ctx_t *ctx = c->ctx;
+
+  c->ctx = NULL;
+  if (ctx)
+    {
+      ctx->io = NULL;
+      g_on_close (ctx);
+    }
+
+  pthread_mutex_lock (&g_live_mu);
+  c->next_dead = g_dead;
+  g_dead = c;
+  pthread_mutex_unlock (&g_live_mu);
+  atomic_fetch_sub (&g_live_count, 1);
+}
+
+
+static void
+reap_dead (void)
+{
+  pthread_mutex_lock (&g_live_mu);
+  reactor_conn_t *d = g_dead;
+
+  g_dead = NULL;
+  pthread_mutex_unlock (&g_live_mu);
+
+  while (d)
+    {
+      reactor_conn_t *next = d->next_dead;
+
+      pthread_mutex_destroy (&d->mu);
+      pthread_mutex_destroy (&d->out_mu);
+      free (d->tls_stage);
+      free (d->inbuf);
+      free (d);
+      d = next;
+    }
+}
+
+
+static void
+hs_record_ok (reactor_conn_t *c, SSL *ssl)
+{
+  uint64_t ms = now_ms () - c->hs_start_ms;
+  uint64_t prev = atomic_load (&g_hs_ms_max);
+  size_t b = 0;
+
+  while (b < HS_BUCKETS && ms > k_hs_bucket_ms[b])
+    {
+      b++;
+    }
+  atomic_fetch_add (&g_hs_hist[b], 1);
+  atomic_fetch_add (&g_hs_ok, 1);
+  atomic_fetch_add (&g_hs_ms_total, ms);
+  while (ms > prev
+	 && !atomic_compare_exchange_weak (&g_hs_ms_max, &prev, ms))
+    {
+      ;
+    }
+  if (SSL_session_reused (ssl))
+    {
+      atomic_fetch_add (&g_hs_resumed, 1);
+    }
+}
+
+
+/* Advance a non-blocking TLS handshake. Returns 1 when complete, 0 if it
+   needs more I/O, -1 on failure. */
+static int
+conn_handshake (reactor_conn_t *c)
+{
+  client_ctx_t *ctx = c->ctx;
+  SSL *ssl = (SSL *) ctx->ssl_conn;
+
+  if (atomic_load (&c->hs_expired))
+    {
+      atomic_fetch_add (&g_hs_timed_out, 1);
+      LOGW ("[cid=%" PRIu64 "] TLS handshake timed out after %d ms",
+	    ctx->cid, g_hs_timeout_ms);
+      return -1;
+    }
+
+  pthread_mutex_lock (&ctx->io_mu);
+  int r = SSL_do_handshake (ssl);
+  int serr = (r <= 0) ? SSL_get_error (ssl, r) : 0;
+
+  pthread_mutex_unlock (&ctx->io_mu);
+  if (r == 1)
+    {
+      hs_record_ok (c, ssl);
+
+      /* Writability only mattered while negotiating. Senders leave output
+         queued until handshaking clears, so none of them can have asked
+         for EPOLLOUT yet. */
+      struct epoll_event ev = {
+	.events = EPOLLIN | EPOLLRDHUP | EPOLLET,
+	.data.ptr = c
+      };
+      epoll_ctl (g_epfd, EPOLL_CTL_MOD, c->fd, &ev);
+      atomic_store (&c->handshaking, false);
+      return 1;
+    }
+  if (serr == SSL_ERROR_WANT_READ || serr == SSL_ERROR_WANT_WRITE)
+    {
+      return 0;
+    }
+  atomic_fetch_add (&g_hs_failed, 1);
+  LOGE ("[cid=%" PRIu64 "] SSL handshake failed: %d (%s)", ctx->cid, serr,
+	ERR_reason_error_string (ERR_peek_last_error ())
+	? ERR_reason_error_string (ERR_peek_last_error ()) : "no detail");
+  ERR_clear_error ();
+  return -1;
+}
+
+
+/* Read into inbuf. Returns 1 if more data may be pending (budget hit),
+   0 if the socket is drained, -1 on EOF or a fatal error. */
+static int
+conn_fill (reactor_conn_t *c)
+{
+  client_ctx_t *ctx = c->ctx;
+
+  if (c->in_off > 0)
+    {
+      memmove (c->inbuf, c->inbuf + c->in_off, c->in_len - c->in_off);
+      c->in_len -= c->in_off;
+      c->in_off = 0;
+    }
+
+  for (;;)
+    {
+      if (c->in_len == c->in_cap)
+	{
+	  if (c->in_cap >= REACTOR_INBUF_MAX)
+	    {
+	      return 1;		/* let the caller consume lines first */
+	    }
+	  size_t ncap = c->in_cap ? c->in_cap * 2 : REACTOR_INBUF_INIT;
+	  char *nb = realloc (c->inbuf, ncap);
+
+	  if (!nb)
+	    {
+	      LOGE ("[cid=%" PRIu64 "] input buffer allocation failed",
+		    ctx->cid);
+	      return -1;
+	    }
+	  c->inbuf = nb;
+	  c->in_cap = ncap;
+	}
+
+      size_t room = c->in_cap - c->in_len;
+      ssize_t n;
+
+      if (ctx->is_tls && ctx->ssl_conn)
+	{
+	  pthread_mutex_lock (&ctx->io_mu);
+	  int r = SSL_read ((SSL *) ctx->ssl_conn, c->inbuf + c->in_len,
+			    (int) room);
+	  int serr = (r <= 0) ? SSL_get_error ((SSL *) ctx->ssl_conn, r) : 0;
+
+	  pthread_mutex_unlock (&ctx->io_mu);
+	  if (r > 0)
+	    {
+	      n = r;
+	    }
+	  else if (serr == SSL_ERROR_WANT_READ || serr == SSL_ERROR_WANT_WRITE)
+	    {
+	      return 0;
+	    }
+	  else
+	    {
+	      if (serr != SSL_ERROR_ZERO_RETURN)
+		{
+		  LOGD ("SSL_read error: %d", serr);
+		}
+	      return -1;
+	    }
+	}
+      else
+	{
+	  n = recv (c->fd, c->inbuf + c->in_len, room, 0);
+	  if (n == 0)
+	    {
+	      return -1;
+	    }
+	  if (n < 0)
+	    {
+	      if (errno == EINTR)
+		{
+		  continue;
+		}
+	      if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+		  return 0;
+		}
+	      return -1;
+	    }
+	}
+      c->in_len += (size_t) n;
+    }
+}
+
+
+/* Detach the next complete line from inbuf (NUL-terminated in place).
+   At EOF a trailing unterminated line is returned as well. */
+static char *
+conn_take_line (reactor_conn_t *c, size_t *out_len)
+{
+  if (c->in_off >= c->in_len)
+    {
+      return NULL;
+    }
+  char *start = c->inbuf + c->in_off;
+  size_t avail = c->in_len - c->in_off;
+  char *nl = memchr (start, '\n', avail);
+
+  if (!nl)
+    {
+      if (!c->eof || c->in_len == c->in_cap)
+	{
+	  return NULL;
+	}
+      /* final unterminated line; inbuf has spare room for the NUL */
+      start[avail] = '\0';
+      c->in_off = c->in_len;
+      *out_len = avail;
+      return start;
+    }
+  *nl = '\0';
+  *out_len = (size_t) (nl - start);
+  c->in_off += *out_len + 1;
+  return start;
+}
+
+
+static void
+conn_dispatch_line (reactor_conn_t *c, const char *line, size_t len)
+{
+  client_ctx_t *ctx = c->ctx;
+  json_error_t jerr;
+  json_t *root = json_loadb (line, len, 0, &jerr);
+
+  if (!root || !json_is_object (root))
+    {
+      g_ctx_for_send = ctx;
+      send_enveloped_error (ctx->fd, NULL, ERR_INVALID_SCHEMA,
+			    "Malformed JSON");
+      if (root)
+	{
+	  json_decref (root);
+	}
+      return;
+    }
+  g_on_message (ctx, root);
+  json_decref (root);
+}
+
+
+/* Runs on a worker that owns c (scheduled == true). */
+static void
+conn_service (reactor_conn_t *c)
+{
+  int handled = 0;
+
+  while (atomic_load (&c->handshaking))
+    {
+      pthread_mutex_lock (&c->mu);
+      c->readable = false;
+      pthread_mutex_unlock (&c->mu);
+
+      int hs = conn_handshake (c);
+
+      if (hs < 0)
+	{
+	  conn_teardown (c);
+	  return;
+	}
+      if (hs > 0)
+	{
+	  /* The final flight may have carried application data */
+	  pthread_mutex_lock (&c->mu);
+	  c->readable = true;
+	  pthread_mutex_unlock (&c->mu);
+	  conn_out_resume (c);	/* anything queued during the handshake */
+	  break;
+	}
+      pthread_mutex_lock (&c->mu);
+      if (!c->readable)
+	{
+	  c->scheduled = false;
+	  pthread_mutex_unlock (&c->mu);
+	  return;
+	}
+      pthread_mutex_unlock (&c->mu);
+    }
+
+  for (;;)
+    {
+      size_t len = 0;
+      char *line = conn_take_line (c, &len);
+
+      if (line)
+	{
+	  conn_dispatch_line (c, line, len);
+	  if (++handled >= REACTOR_MSG_BUDGET)
+	    {
+	      ready_push (c);	/* still scheduled; go to the back of the line */
+	      return;
+	    }
+	  continue;
+	}
+
+      if (!c->eof && c->in_len - c->in_off >= REACTOR_MAX_FRAME)
+	{
+	  LOGW ("[cid=%" PRIu64 "] frame exceeds %d bytes; closing",
+		c->ctx->cid, REACTOR_MAX_FRAME);
+	  g_ctx_for_send = c->ctx;
+	  send_enveloped_error (c->fd, NULL, ERR_INVALID_SCHEMA,
+				"Frame too large");
+	  c->eof = true;
+	  c->in_off = c->in_len;
+	}
+
+      pthread_mutex_lock (&c->mu);
+      bool rd = c->readable;
+
+      c->readable = false;
+      pthread_mutex_unlock (&c->mu);
+
+      if (rd && !c->eof)
+	{
+	  int r = conn_fill (c);
+
+	  if (r < 0)
+	    {
+	      c->eof = true;
+	    }
+	  else if (r > 0)
+	    {
+	      pthread_mutex_lock (&c->mu);
+	      c->readable = true;	/* edge already consumed; remember it */
+	      pthread_mutex_unlock (&c->mu);
+	    }
+	  /* The event may have been EPOLLOUT for a backlogged queue */
+	  conn_out_resume (c);
+	  continue;
+	}
+
+      pthread_mutex_lock (&c->mu);
+      if (c->readable && !c->eof)
+	{
+	  pthread_mutex_unlock (&c->mu);
+	  continue;
+	}
+      if (c->eof)
+	{
+	  pthread_mutex_unlock (&c->mu);
+	  conn_teardown (c);
+	  return;
+	}
+      c->scheduled = false;
+      pthread_mutex_unlock (&c->mu);
+      return;
+    }
+}
+
+
+static void *
+reactor_worker (void *arg)
+{
+  (void) arg;
+  while (!atomic_load (&g_stopping))
+    {
+      reactor_conn_t *c = ready_pop ();
+
+      if (c)
+	{
+	  conn_service (c);
+	}
+    }
+  return NULL;
+}
+
+
+int
+reactor_start (int n_workers, reactor_msg_fn on_message,
+	       reactor_close_fn on_close)
+{
+  if (!on_message || !on_close)
+    {
+      return -1;
+    }
+  if (n_workers <= 0)
+    {
+      long ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+      n_workers = (ncpu > 0) ? (int) ncpu : 4;
+    }
+
+  g_epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (g_epfd < 0)
+    {
+      LOGE ("epoll_create1: %s", strerror (errno));
+      return -1;
+    }
+  g_on_message = on_message;
+  g_on_close = on_close;
+  atomic_store (&g_stopping, false);
+
+  g_workers = calloc ((size_t) n_workers, sizeof (pthread_t));
+  if (!g_workers)
+    {
+      close (g_epfd);
+      g_epfd = -1;
+      return -1;
+    }
+  for (int i = 0; i < n_workers; i++)
+    {
+      int prc = pthread_create (&g_workers[i], NULL, reactor_worker, NULL);
+
+      if (prc != 0)
+	{
+	  LOGE ("reactor worker pthread_create: %s", strerror (prc));
+	  break;
+	}
+      g_n_workers++;
+    }
+  if (g_n_workers == 0)
+    {
+      free (g_workers);
+      g_workers = NULL;
+      close (g_epfd);
+      g_epfd = -1;
+      return -1;
+    }
+  LOGI ("Reactor started with %d worker threads", g_n_workers);
+  return 0;
+}
+
+
+int
+reactor_worker_count (void)
+{
+  return g_n_workers;
+}
+
+
+int
+reactor_client_count (void)
+{
+  return atomic_load (&g_live_count);
+}
+
+
+void
+reactor_set_handshake_timeout (int timeout_ms)
+{
+  if (timeout_ms > 0)
+    {
+      g_hs_timeout_ms = timeout_ms;
+    }
+}
+
+
+void
+reactor_set_outq_limit (int max_kb, bool drop)
+{
+  g_outq_max = max_kb > 0 ? (size_t) max_kb * 1024 : 0;
+  g_outq_drop = drop;
+}
+
+
+/* Over the high-water mark: drop this line, or cut the client off. The
+   shutdown wakes the owning worker, which tears the connection down.
+   out_mu held. */
+static void
+out_overflow (reactor_conn_t *c, size_t len)
+{
+  atomic_fetch_add (&g_outq_dropped, 1);
+  if (g_outq_drop)
+    {
+      return;
+    }
+  LOGW ("[cid=%" PRIu64 "] not reading: %zu bytes queued, %zu more over "
+	"%zu; disconnecting", c->ctx->cid, c->out_bytes, len, g_outq_max);
+  atomic_fetch_add (&g_outq_cut, 1);
+  out_discard (c);
+  shutdown (c->fd, SHUT_RDWR);
+}
+
+
+reactor_buf_t *
+reactor_buf_new (const char *buf, size_t len)
+{
+  reactor_buf_t *b = malloc (sizeof (*b) + len + 1);
+
+  if (b)
+    {
+      atomic_init (&b->refs, 1);
+      memcpy (b->data, buf, len);
+      b->data[len] = '\n';
+      b->len = len + 1;
+    }
+  return b;
+}
+
+
+void
+reactor_buf_release (reactor_buf_t *b)
+{
+  if (b && atomic_fetch_sub (&b->refs, 1) == 1)
+    {
+      free (b);
+    }
+}
+
+
+const char *
+reactor_buf_data (const reactor_buf_t *b, size_t *len)
+{
+  *len = b->len;
+  return b->data;
+}
+
+
+/* Queue a copy of buf, or a reference to shared, for the client on fd. */
+static int
+reactor_enqueue (int fd, const char *buf, size_t len, reactor_buf_t *shared)
+{
+  int rc = 0;
+
+  pthread_rwlock_rdlock (&g_fd_lock);
+  reactor_conn_t *c = (fd >= 0 && fd < g_by_fd_cap) ? g_by_fd[fd] : NULL;
+
+  if (!c)
+    {
+      /* With the reactor up every client is registered: an unknown fd
+         is a closed connection, whose number may already be reused */
+      pthread_rwlock_unlock (&g_fd_lock);
+      if (g_epfd < 0)
+	{
+	  return -2;
+	}
+      atomic_fetch_add (&g_outq_dropped, 1);
+      return -1;
+    }
+
+  pthread_mutex_lock (&c->out_mu);
+  out_chunk_t *k = NULL;
+
+  if (c->out_closed)
+    {
+      atomic_fetch_add (&g_outq_dropped, 1);
+      rc = -1;
+    }
+  else if (g_outq_max && c->out_bytes > 0
+	   && c->out_bytes + len + 1 > g_outq_max)
+    {
+      out_overflow (c, len + 1);
+      rc = -1;
+    }
+  else if (!(k = malloc (sizeof (*k) + (shared ? 0 : len + 1))))
+    {
+      atomic_fetch_add (&g_outq_dropped, 1);
+      rc = -1;
+    }
+  else
+    {
+      if (shared)
+	{
+	  atomic_fetch_add (&shared->refs, 1);
+	  k->shared = shared;
+	  k->bytes = shared->data;
+	}
+      else
+	{
+	  memcpy (k->data, buf, len);
+	  k->data[len] = '\n';
+	  k->shared = NULL;
+	  k->bytes = k->data;
+	}
+      k->len = len + 1;
+      k->off = 0;
+      k->next = NULL;
+      if (c->out_tail)
+	{
+	  c->out_tail->next = k;
+	}
+      else
+	{
+	  c->out_head = k;
+	}
+      c->out_tail = k;
+      c->out_bytes += k->len;
+      c->out_msgs++;
+      atomic_fetch_add (&g_outq_bytes, k->len);
+      atomic_fetch_add (&g_outq_msgs, 1);
+
+      uint64_t peak = atomic_load (&g_outq_peak);
+
+      while (c->out_bytes > peak
+	     && !atomic_compare_exchange_weak (&g_outq_peak, &peak,
+					       c->out_bytes))
+	{
+	  ;
+	}
+
+      /* With a backlog the reactor drains on EPOLLOUT; during a TLS
+         handshake the worker flushes once it completes. */
+      if (!c->out_armed && !atomic_load (&c->handshaking))
+	{
+	  out_pump (c);
+	}
+    }
+  pthread_mutex_unlock (&c->out_mu);
+  pthread_rwlock_unlock (&g_fd_lock);
+  return rc;
+}
+
+
+int
+reactor_send_line (int fd, const char *buf, size_t len)
+{
+  return reactor_enqueue (fd, buf, len, NULL);
+}
+
+
+int
+reactor_send_buf (int fd, reactor_buf_t *b)
+{
+  return reactor_enqueue (fd, b->data, b->len - 1, b);
+}
+
+
+json_t *
+reactor_outq_stats_json (void)
+{
+  json_t *o = json_object ();
+
+  json_object_set_new (o, "max_kb", json_integer ((json_int_t) (g_outq_max
+								/ 1024)));
+  json_object_set_new (o, "overflow",
+		       json_string (g_outq_drop ? "drop" : "disconnect"));
+  json_object_set_new (o, "pending_bytes",
+		       json_integer ((json_int_t) atomic_load (&g_outq_bytes)));
+  json_object_set_new (o, "pending_msgs",
+		       json_integer ((json_int_t) atomic_load (&g_outq_msgs)));
+  json_object_set_new (o, "backlogged_clients",
+		       json_integer (atomic_load (&g_outq_backlogged)));
+  json_object_set_new (o, "peak_client_bytes",
+		       json_integer ((json_int_t) atomic_load (&g_outq_peak)));
+  json_object_set_new (o, "msgs_sent",
+		       json_integer ((json_int_t)
+				     atomic_load (&g_outq_sent_msgs)));
+  json_object_set_new (o, "bytes_sent",
+		       json_integer ((json_int_t)
+				     atomic_load (&g_outq_sent_bytes)));
+  json_object_set_new (o, "writes",
+		       json_integer ((json_int_t) atomic_load (&g_outq_writes)));
+  json_object_set_new (o, "dropped",
+		       json_integer ((json_int_t) atomic_load (&g_outq_dropped)));
+  json_object_set_new (o, "disconnected",
+		       json_integer ((json_int_t) atomic_load (&g_outq_cut)));
+  return o;
+}
+
+
+json_t *
+reactor_tls_stats_json (void)
+{
+  json_t *o = json_object ();
+  json_t *hist = json_object ();
+  uint64_t ok = atomic_load (&g_hs_ok);
+  char key[32];
+
+  json_object_set_new (o, "handshakes_ok", json_integer ((json_int_t) ok));
+  json_object_set_new (o, "handshakes_failed",
+		       json_integer ((json_int_t) atomic_load (&g_hs_failed)));
+  json_object_set_new (o, "handshakes_timed_out",
+		       json_integer ((json_int_t)
+				     atomic_load (&g_hs_timed_out)));
+  json_object_set_new (o, "sessions_resumed",
+		       json_integer ((json_int_t) atomic_load (&g_hs_resumed)));
+  json_object_set_new (o, "latency_ms_avg",
+		       json_real (ok ? (double) atomic_load (&g_hs_ms_total)
+				  / (double) ok : 0.0));
+  json_object_set_new (o, "latency_ms_max",
+		       json_integer ((json_int_t) atomic_load (&g_hs_ms_max)));
+  for (size_t i = 0; i <= HS_BUCKETS; i++)
+    {
+      if (i < HS_BUCKETS)
+	{
+	  snprintf (key, sizeof (key), "le_%" PRIu64, k_hs_bucket_ms[i]);
+	}
+      else
+	{
+	  snprintf (key, sizeof (key), "gt_%" PRIu64,
+		    k_hs_bucket_ms[HS_BUCKETS - 1]);
+	}
+      json_object_set_new (hist, key,
+			   json_integer ((json_int_t)
+					 atomic_load (&g_hs_hist[i])));
+    }
+  json_object_set_new (o, "latency_ms_hist", hist);
+  return o;
+}
+
+
+int
+reactor_add_listener (int fd)
+{
+  struct epoll_event ev = {.events = EPOLLIN,.data.ptr = &g_listener_tag };
+
+  if (set_nonblocking (fd) < 0)
+    {
+      return -1;
+    }
+  return epoll_ctl (g_epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+
+int
+reactor_add_client (client_ctx_t *ctx)
+{
+  reactor_conn_t *c = calloc (1, sizeof (*c));
+
+  if (!c || set_nonblocking (ctx->fd) < 0)
+    {
+      LOGE ("[cid=%" PRIu64 "] cannot register with reactor", ctx->cid);
+      free (c);
+      g_on_close (ctx);
+      return -1;
+    }
+  pthread_mutex_init (&c->mu, NULL);
+  pthread_mutex_init (&c->out_mu, NULL);
+  c->ctx = ctx;
+  c->fd = ctx->fd;
+  ctx->io = c;
+
+  bool hs = ctx->is_tls && ctx->ssl_conn
+    && !SSL_is_init_finished ((SSL *) ctx->ssl_conn);
+
+  if (hs)
+    {
+      atomic_store (&c->handshaking, true);
+      c->hs_start_ms = now_ms ();
+    }
+  atomic_fetch_add (&g_live_count, 1);
+
+  pthread_mutex_lock (&g_live_mu);
+  c->next_live = g_live;
+  if (g_live)
+    {
+      g_live->prev_live = c;
+    }
+  g_live = c;
+  pthread_mutex_unlock (&g_live_mu);
+
+  struct epoll_event ev = {
+    .events = EPOLLIN | EPOLLRDHUP | EPOLLET | (hs ? EPOLLOUT : 0),
+    .data.ptr = c
+  };
+
+  if (fd_map (c) < 0 || epoll_ctl (g_epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0)
+    {
+      LOGE ("epoll_ctl(ADD, fd=%d): %s", c->fd, strerror (errno));
+      pthread_mutex_lock (&c->mu);
+      c->scheduled = true;
+      pthread_mutex_unlock (&c->mu);
+      conn_teardown (c);
+      return -1;
+    }
+
+  /* Data may have arrived before registration (and TLS may hold decrypted
+     bytes already); an initial pass costs one EAGAIN at worst. */
+  conn_signal (c);
+  return 0;
+}
+
+
+/* Shut down connections whose TLS handshake has stalled. The resulting
+   hangup wakes a worker, which sees hs_expired and tears the client down. */
+static void
+sweep_handshakes (void)
+{
+  static uint64_t last_sweep = 0;
+  uint64_t now = now_ms ();
+
+  if (now - last_sweep < REACTOR_HS_SWEEP_MS)
+    {
+      return;
+    }
+  last_sweep = now;
+
+  pthread_mutex_lock (&g_live_mu);
+  for (reactor_conn_t *c = g_live; c; c = c->next_live)
+    {
+      if (atomic_load (&c->handshaking) && !atomic_load (&c->hs_expired)
+	  && now - c->hs_start_ms >= (uint64_t) g_hs_timeout_ms)
+	{
+	  atomic_store (&c->hs_expired, true);
+	  shutdown (c->fd, SHUT_RDWR);
+	}
+    }
+  pthread_mutex_unlock (&g_live_mu);
+}
+
+
+int
+reactor_run_once (int timeout_ms)
+{
+  struct epoll_event evs[REACTOR_MAX_EVENTS];
+  int listener_ready = 0;
+
+  reap_dead ();
+  int n = epoll_wait (g_epfd, evs, REACTOR_MAX_EVENTS, timeout_ms);
+
+  if (n < 0)
+    {
+      return (errno == EINTR) ? 0 : -1;
+    }
+  for (int i = 0; i < n; i++)
+    {
+      if (evs[i].data.ptr == &g_listener_tag)
+	{
+	  listener_ready = 1;
+	  continue;
+	}
+      conn_signal ((reactor_conn_t *) evs[i].data.ptr);
+    }
+  sweep_handshakes ();
+  return listener_ready;
+}
+
+
+void
+reactor_stop (void)
+{
+  if (g_epfd < 0)
+    {
+      return;
+    }
+  atomic_store (&g_stopping, true);
+  pthread_mutex_lock (&g_ready_mu);
+  pthread_cond_broadcast (&g_ready_cv);
+  pthread_mutex_unlock (&g_ready_mu);
+  for (int i = 0; i < g_n_workers; i++)
+    {
+      pthread_join (g_workers[i], NULL);
+    }
+  free (g_workers);
+  g_workers = NULL;
+  g_n_workers = 0;
+  g_ready_head = g_ready_tail = NULL;
+
+  /* No workers remain, so every live connection can be torn down here. */
+  for (;;)
+    {
+      pthread_mutex_lock (&g_live_mu);
+      reactor_conn_t *c = g_live;
+
+      pthread_mutex_unlock (&g_live_mu);
+      if (!c)
+	{
+	  break;
+	}
+      conn_teardown (c);
+    }
+  reap_dead ();
+  close (g_epfd);
+  g_epfd = -1;
+  pthread_rwlock_wrlock (&g_fd_lock);
+  free (g_by_fd);
+  g_by_fd = NULL;
+  g_by_fd_cap = 0;
+  pthread_rwlock_unlock (&g_fd_lock);
+}
@@ -0,0 +1,80 @@
+#ifndef SERVER_REACTOR_H
+#define SERVER_REACTOR_H
+#include <jansson.h>
+#include "common.h"
+
+/*
+ * Client socket reactor.
+ *
+ * One thread (the caller of reactor_run_once, i.e. server_loop) waits on an
+ * edge-triggered epoll set and only demultiplexes readiness. A fixed pool of
+ * worker threads does the actual reads, frames newline-delimited JSON and
+ * hands each complete message to the on_message callback.
+ *
+ * A connection is owned by at most one worker at a time, so messages from a
+ * client are processed strictly in order and never concurrently, exactly as
+ * the old thread-per-connection loop did. Per-thread DB handles therefore
+ * scale with the worker count rather than with connected clients.
+ *
+ * Output goes the other way through a bounded per-connection queue: any
+ * thread may append a line, which is written at once if the socket takes
+ * it and otherwise drained by the owning side on EPOLLOUT, several lines
+ * per sendmsg (or per TLS record). Senders never wait on a slow reader.
+ */
+
+/* Maximum accepted frame (one JSON line), mirrors system.hello max_frame_size */
+#define REACTOR_MAX_FRAME 131072
+
+/* Called on a worker thread for every parsed JSON object. Borrows root. */
+typedef void (*reactor_msg_fn) (client_ctx_t * ctx, json_t * root);
+
+/* Called on a worker thread once the connection is finished. Must unregister
+   the client, release TLS state, close ctx->fd and free ctx. */
+typedef void (*reactor_close_fn) (client_ctx_t * ctx);
+
+int reactor_start (int n_workers, reactor_msg_fn on_message,
+		   reactor_close_fn on_close);
+/* Register an accepted client; ctx->fd must already be set. Takes ownership
+   of ctx: on failure on_close has already run. If ctx->ssl_conn is set and
+   not yet negotiated, the handshake is driven non-blockingly by the workers
+   before any message is read. */
+int reactor_add_client (client_ctx_t * ctx);
+/* Register a listening socket; its readiness is reported by reactor_run_once. */
+int reactor_add_listener (int fd);
+/* Wait up to timeout_ms and dispatch client events. Returns 1 if the listener
+   is readable, 0 otherwise, -1 on error. */
+int reactor_run_once (int timeout_ms);
+/* Stop the workers and tear down every remaining connection. */
+void reactor_stop (void);
+
+/* Abort TLS handshakes that have not completed within timeout_ms. */
+void reactor_set_handshake_timeout (int timeout_ms);
+/* Output a client may have queued (max_kb <= 0: unbounded). Past it, new
+   lines are dropped if drop is set; otherwise the client is disconnected. */
+void reactor_set_outq_limit (int max_kb, bool drop);
+
+/* Queue buf (len bytes, a newline is appended) for the client on fd. Never
+   blocks. Returns 0 when queued, -1 when dropped (over the limit, or the
+   connection is gone) and -2 if the reactor is not running. */
+int reactor_send_line (int fd, const char *buf, size_t len);
+
+/* The same line for many clients: rendered once, queued by reference. */
+typedef struct reactor_buf_s reactor_buf_t;
+
+/* New buffer holding a copy of buf plus a newline, with one reference
+   (NULL when out of memory). */
+reactor_buf_t *reactor_buf_new (const char *buf, size_t len);
+void reactor_buf_release (reactor_buf_t * b);
+/* The bytes, newline included */
+const char *reactor_buf_data (const reactor_buf_t * b, size_t *len);
+/* reactor_send_line for a shared buffer; queues take their own reference. */
+int reactor_send_buf (int fd, reactor_buf_t * b);
+
+int reactor_worker_count (void);
+int reactor_client_count (void);
+/* New reference: handshake counters and latency histogram. */
+json_t *reactor_tls_stats_json (void);
+/* New reference: outbound queue depth, bytes pending and overflow counters. */
+json_t *reactor_outq_stats_json (void);
+
+#endif /* SERVER_REACTOR_H */
@@ -37,6 +37,8 @@
 #include "server_ports.h"
 #include "db/db_api.h"
 #include "db/sql_driver.h"
+#include "session_cache.h"
+#include "client_registry.h"
 
 
 #define UUID_STR_LEN 37		// 36 chars + null terminator
@@ -129,6 +131,9 @@ handle_ship_destruction (db_t *db, ship_kill_context_t *ctx)
       LOGE ("handle_ship_destruction: Repository error");
       return -1;
     }
+  session_cache_invalidate_player (ctx->victim_player_id);
+  client_registry_move_player (ctx->victim_player_id,
+			       h_get_player_sector (db, ctx->victim_player_id));
 
   if (rc != 0)
     {
@@ -541,6 +546,7 @@ cmd_ship_claim (client_ctx_t *ctx, json_t *root)
 				   "Ship not claimable", NULL);
       return 0;
     }
+  session_cache_invalidate_player (ctx->player_id);
   json_t *payload = json_object ();
 
 
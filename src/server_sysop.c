@@ -10,6 +10,12 @@
 #include "db/repo/repo_sysop.h"
 #include "db/repo/repo_communication.h"
 #include "server_communication.h"
+#include "server_reactor.h"
+#include "session_cache.h"
+#include "request_trace.h"
+#include "topic_index.h"
+#include "client_registry.h"
+#include "event_batch.h"
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -488,21 +494,15 @@ int cmd_sysop_universe_summary(client_ctx_t *ctx, json_t *root) {
     return 0;
 }
 
+static void kick_cb(client_ctx_t *c, void *arg) {
+    (void) arg;
+    // Shut down only; the reactor owns the fd and closes it on hangup
+    if (c->fd >= 0) shutdown(c->fd, SHUT_RDWR);
+}
+
 int server_sysop_kick_player(int target_player_id) {
-    int count = 0;
-    pthread_mutex_lock(&g_clients_mu);
-    for (client_node_t *n = g_clients; n; n = n->next) {
-        client_ctx_t *c = n->ctx;
-        if (c && c->player_id == target_player_id && c->fd >= 0) {
-            // Close socket to force disconnect in connection_thread
-            shutdown(c->fd, SHUT_RDWR);
-            close(c->fd); 
-            c->fd = -1; // Mark as closed
-            count++;
-        }
-    }
-    pthread_mutex_unlock(&g_clients_mu);
-    return count;
+    session_cache_invalidate_player(target_player_id);
+    return client_registry_for_each_player(target_player_id, kick_cb, NULL);
 }
 
 /* Phase 3: Engine & Jobs */
@@ -540,6 +540,99 @@ int cmd_sysop_engine_status_get(client_ctx_t *ctx, json_t *root) {
     return 0;
 }
 
+/* Per-template statement timings of this process, heaviest first. */
+int cmd_sysop_db_stats_get(client_ctx_t *ctx, json_t *root) {
+    if (!check_sysop_role(ctx)) {
+        send_response_refused(ctx, root, 1407, "Forbidden: SysOp role required", NULL);
+        return 0;
+    }
+
+    json_t *j_data = json_object_get(root, "data");
+    json_t *j_limit = json_object_get(j_data, "limit");
+    int limit = json_is_integer(j_limit) ? (int)json_integer_value(j_limit) : 50;
+    if (limit < 1) limit = 1;
+    if (limit > 500) limit = 500;
+
+    db_query_stat_t *st = NULL;
+    uint64_t overflow = 0;
+    size_t n = db_query_stats(&st, &overflow);
+
+    json_t *list = json_array();
+    for (size_t i = 0; i < n && i < (size_t)limit; i++) {
+        json_t *s = json_object();
+        json_object_set_new(s, "sql", json_string(st[i].sql));
+        json_object_set_new(s, "calls", json_integer((json_int_t)st[i].calls));
+        json_object_set_new(s, "errors", json_integer((json_int_t)st[i].errors));
+        json_object_set_new(s, "rows", json_integer((json_int_t)st[i].rows));
+        json_object_set_new(s, "total_ms", json_real((double)st[i].total_us / 1000.0));
+        json_object_set_new(s, "avg_ms", json_real(st[i].calls ? (double)st[i].total_us / 1000.0 / (double)st[i].calls : 0.0));
+        json_object_set_new(s, "p50_ms", json_real((double)st[i].p50_us / 1000.0));
+        json_object_set_new(s, "p90_ms", json_real((double)st[i].p90_us / 1000.0));
+        json_object_set_new(s, "p99_ms", json_real((double)st[i].p99_us / 1000.0));
+        json_object_set_new(s, "max_ms", json_real((double)st[i].max_us / 1000.0));
+        json_array_append_new(list, s);
+    }
+    db_query_stats_free(st);
+
+    json_t *out = json_object();
+    json_object_set_new(out, "templates", json_integer((json_int_t)n));
+    json_object_set_new(out, "untracked_calls", json_integer((json_int_t)overflow));
+    json_object_set_new(out, "slow_query_ms", json_integer(db_slow_query_ms()));
+    json_object_set_new(out, "statements", list);
+    send_response_ok_take(ctx, root, "sysop.db_stats_v1", &out);
+    return 0;
+}
+
+/* Recent request spans of this process as Chrome trace-event JSON. */
+int cmd_sysop_trace_dump(client_ctx_t *ctx, json_t *root) {
+    if (!check_sysop_role(ctx)) {
+        send_response_refused(ctx, root, 1407, "Forbidden: SysOp role required", NULL);
+        return 0;
+    }
+
+    json_t *trace = trace_dump_chrome_json();
+    send_response_ok_take(ctx, root, "sysop.trace_v1", &trace);
+    return 0;
+}
+
+/* In-process counters for this server instance (no DB access). */
+int cmd_sysop_metrics_get(client_ctx_t *ctx, json_t *root) {
+    if (!check_sysop_role(ctx)) {
+        send_response_refused(ctx, root, 1407, "Forbidden: SysOp role required", NULL);
+        return 0;
+    }
+
+    json_t *net = json_object();
+    json_object_set_new(net, "workers", json_integer(reactor_worker_count()));
+    json_object_set_new(net, "clients", json_integer(reactor_client_count()));
+    json_object_set_new(net, "tls", reactor_tls_stats_json());
+    json_object_set_new(net, "outq", reactor_outq_stats_json());
+    json_object_set_new(net, "registry", client_registry_stats_json());
+    json_object_set_new(net, "event_batch", event_batch_stats_json());
+
+    json_t *metrics = json_object();
+    json_object_set_new(metrics, "net", net);
+    json_object_set_new(metrics, "session_cache", session_cache_stats_json());
+    json_object_set_new(metrics, "topics", topic_index_stats_json());
+
+    db_stmt_cache_stats_t st;
+    db_stmt_cache_stats(&st);
+    json_t *stmts = json_object();
+    json_object_set_new(stmts, "hits", json_integer((json_int_t)st.hits));
+    json_object_set_new(stmts, "misses", json_integer((json_int_t)st.misses));
+    json_object_set_new(stmts, "prepares", json_integer((json_int_t)st.prepares));
+    json_object_set_new(stmts, "evictions", json_integer((json_int_t)st.evictions));
+    json_object_set_new(stmts, "resets", json_integer((json_int_t)st.resets));
+    json_object_set_new(stmts, "hit_rate",
+                        json_real(st.hits + st.misses ? (double)st.hits / (double)(st.hits + st.misses) : 0.0));
+    json_object_set_new(metrics, "db_statements", stmts);
+    json_object_set_new(metrics, "db_pool", game_db_pool_stats_json());
+    json_object_set_new(metrics, "db_replica", game_db_replica_stats_json());
+
+    send_response_ok_take(ctx, root, "sysop.metrics_v1", &metrics);
+    return 0;
+}
+
 int cmd_sysop_jobs_list(client_ctx_t *ctx, json_t *root) {
     if (!check_sysop_role(ctx)) {
         send_response_refused(ctx, root, 1407, "Forbidden: SysOp role required", NULL);
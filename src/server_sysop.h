@@ -19,6 +19,9 @@ int cmd_sysop_universe_summary(client_ctx_t *ctx, json_t *root);
 
 /* Phase 3: Engine & Jobs */
 int cmd_sysop_engine_status_get(client_ctx_t *ctx, json_t *root);
+int cmd_sysop_db_stats_get(client_ctx_t *ctx, json_t *root);
+int cmd_sysop_trace_dump(client_ctx_t *ctx, json_t *root);
+int cmd_sysop_metrics_get(client_ctx_t *ctx, json_t *root);
 int cmd_sysop_jobs_list(client_ctx_t *ctx, json_t *root);
 int cmd_sysop_jobs_get(client_ctx_t *ctx, json_t *root);
 int cmd_sysop_jobs_retry(client_ctx_t *ctx, json_t *root);
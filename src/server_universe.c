@@ -42,6 +42,9 @@
 #include "db/repo/repo_corporation.h"
 #include "db/repo/repo_cmds.h"
 #include "db/repo/repo_ports.h"
+#include "session_cache.h"
+#include "warp_graph.h"
+#include "client_registry.h"
 
 #define UUID_STR_LEN 37
 
@@ -103,123 +106,134 @@ fer_event_json (const char *type, int sector_id, const char *fmt, ...)
 
 /* ============ Navigation Helper Functions ============ */
 
-/* Breadth-first search to find one hop toward goal sector from start sector */
-int
-nav_next_hop (db_t *db, int start, int goal)
+/* Next-hop tables for goals many NPCs head to (Stardock, Ferengi and Orion
+   homes).
+   Rebuilt lazily whenever the warp graph snapshot changes. */
+#define NAV_PINNED_MAX 8
+
+typedef struct
 {
-  if (!db || start <= 0 || goal <= 0 || start == goal)
+  int goal;
+  uint64_t gen;
+  int max_id;
+  int *next;
+} nav_hop_table_t;
+
+static nav_hop_table_t g_nav_pinned[NAV_PINNED_MAX];
+static int g_nav_pinned_n = 0;
+static pthread_mutex_t g_nav_mu = PTHREAD_MUTEX_INITIALIZER;
+
+
+void
+nav_pin_goal (int goal)
+{
+  if (goal <= 0)
     {
-      return 0;
+      return;
     }
+  pthread_mutex_lock (&g_nav_mu);
+  for (int i = 0; i < g_nav_pinned_n; i++)
+    {
+      if (g_nav_pinned[i].goal == goal)
+	{
+	  pthread_mutex_unlock (&g_nav_mu);
+	  return;
+	}
+    }
+  if (g_nav_pinned_n < NAV_PINNED_MAX)
+    {
+      g_nav_pinned[g_nav_pinned_n].goal = goal;
+      g_nav_pinned[g_nav_pinned_n].gen = 0;
+      g_nav_pinned[g_nav_pinned_n].next = NULL;
+      g_nav_pinned_n++;
+    }
+  else
+    {
+      LOGW ("nav_pin_goal: table full, sector %d not pinned", goal);
+    }
+  pthread_mutex_unlock (&g_nav_mu);
+}
 
-  enum
-  { MAX_Q = 4096, MAX_SEEN = 8192 };
-  int q[MAX_Q], head = 0, tail = 0;
-
-  typedef struct
-  {
-    int key, prev;
-  } kv_t;
-  kv_t seen[MAX_SEEN];
-  int seen_n = 0;
 
-  /* Helper: lookup seen table */
-  auto int seen_get (int key)
-  {
-    for (int i = 0; i < seen_n; ++i)
-      {
-	if (seen[i].key == key)
-	  {
-	    return i;
-	  }
-      }
-    return -1;
-  };
+static int
+nav_table_fresh (const nav_hop_table_t *t, const warp_graph_t *g)
+{
+  return t->next && t->gen == g->gen && t->max_id == g->max_id;
+}
 
-  /* Helper: insert into seen table */
-  auto int seen_put (int key, int prev)
-  {
-    if (seen_n >= MAX_SEEN)
-      {
-	return -1;
-      }
-    seen[seen_n].key = key;
-    seen[seen_n].prev = prev;
-    return seen_n++;
-  };
 
-  /* Initialize BFS queue with start sector */
-  q[0] = start;
-  head = 0;
-  tail = 1;
-  seen_put (start, -1);
+/* 1 and *hop set if goal is pinned, 0 to fall back to a search. A stale
+   table is rebuilt outside g_nav_mu, so lookups toward other goals (and
+   toward this one, on the old table) are not held up by the reverse BFS. */
+static int
+nav_pinned_hop (const warp_graph_t *g, int start, int goal, int *hop)
+{
+  int i;
 
-  db_error_t err;
-  int found = -1;
+  pthread_mutex_lock (&g_nav_mu);
+  for (i = 0; i < g_nav_pinned_n && g_nav_pinned[i].goal != goal; i++)
+    {
+    }
+  if (i == g_nav_pinned_n)
+    {
+      pthread_mutex_unlock (&g_nav_mu);
+      return 0;
+    }
+  /* Entries are only ever appended, so i stays valid while unlocked */
+  nav_hop_table_t *t = &g_nav_pinned[i];
 
-  /* BFS to find goal */
-  while (head != tail && found == -1)
+  if (!nav_table_fresh (t, g))
     {
-      int cur = q[head++ % MAX_Q];
+      pthread_mutex_unlock (&g_nav_mu);
+      int *next = malloc (((size_t) g->max_id + 1) * sizeof (int));
 
-      db_res_t *res = repo_universe_get_adjacent_sectors (db, cur, &err);
-      if (!res)
+      if (!next || warp_graph_hop_table (g, goal, next) != 0)
 	{
-	  /* Query failed; return 0 to indicate no path */
+	  free (next);
 	  return 0;
 	}
-
-      while (db_res_step (res, &err))
+      pthread_mutex_lock (&g_nav_mu);
+      if (nav_table_fresh (t, g))
 	{
-	  int nb = db_res_col_int (res, 0, &err);
-
-	  if (seen_get (nb) != -1)
-	    {
-	      continue;
-	    }
-	  seen_put (nb, cur);
-	  if (nb == goal)
-	    {
-	      found = nb;
-	      break;
-	    }
-	  if ((tail - head) < (MAX_Q - 1))
-	    {
-	      q[tail++ % MAX_Q] = nb;
-	    }
+	  free (next);		/* another thread got there first */
+	}
+      else
+	{
+	  free (t->next);
+	  t->next = next;
+	  t->max_id = g->max_id;
+	  t->gen = g->gen;
 	}
-
-      db_res_finalize (res);
     }
+  *hop = t->next[start];
+  pthread_mutex_unlock (&g_nav_mu);
+  return 1;
+}
 
-  if (found == -1)
+
+/* One hop toward goal from start on the shared warp graph; 0 if none */
+int
+nav_next_hop (db_t *db, int start, int goal)
+{
+  if (!db || start <= 0 || goal <= 0 || start == goal)
     {
       return 0;
     }
 
-  /* Reconstruct one hop toward goal */
-  int step = found, prev = -2;
+  const warp_graph_t *g = warp_graph_acquire (db);
+  int hop = 0;
 
-  for (;;)
+  if (!g)
     {
-      int i = seen_get (step);
-
-      if (i < 0)
-	{
-	  break;
-	}
-      prev = seen[i].prev;
-      if (prev == -1)
-	{
-	  break;		/* step == start */
-	}
-      if (prev == start)
-	{
-	  return step;		/* first hop away from start */
-	}
-      step = prev;
+      return 0;
     }
-  return step;			/* neighbour fallback */
+  if (warp_graph_has_sector (g, start) && warp_graph_has_sector (g, goal)
+      && !nav_pinned_hop (g, start, goal, &hop))
+    {
+      hop = warp_graph_next_hop (g, start, goal);
+    }
+  warp_graph_release (g);
+  return hop;
 }
 
 /* Get random adjacent sector */
@@ -240,8 +254,8 @@ nav_random_neighbor (db_t *db, int sector)
 }
 
 /* Forward statics */
-static void attach_sector_asset_counts (db_t * db,
-					int sector_id, json_t * data_out);
+static void attach_sector_asset_counts (const json_t * assets,
+					json_t * data_out);
 
 
 int
@@ -307,16 +321,23 @@ ori_move_all_ships (void)
 	  new_target = (new_target % 999) + 1;
 	}
 
-      /* Move the ship to the new sector */
-      if (repo_universe_update_ship_sector (ori_db, ship_id, new_target) == 0)
+      /* One warp toward the target per tick; stay put if there is no path */
+      int hop = nav_next_hop (ori_db, current_sector, new_target);
+
+      if (hop <= 0)
 	{
-	  LOGD ("[cron] ori_move: Ship %d moved to sector %d (from %d).",
-	      ship_id, new_target, current_sector);
+	  ship_count++;
+	  continue;
+	}
+      if (repo_universe_update_ship_sector (ori_db, ship_id, hop) == 0)
+	{
+	  LOGD ("[cron] ori_move: Ship %d moved to sector %d (from %d, heading for %d).",
+	      ship_id, hop, current_sector, new_target);
 	}
       else
 	{
 	  LOGW ("[cron] ori_move: Failed to move ship %d to sector %d.",
-	      ship_id, new_target);
+	      ship_id, hop);
 	}
       ship_count++;
     }
@@ -365,6 +386,7 @@ ori_init_once (db_t *db)
 
   LOGI ("[ori]: Orion Syndicate owner ID is %d, Home Sector is %d",
 	ori_owner_id, ori_home_sector_id);
+  nav_pin_goal (ori_home_sector_id);
   ori_initialized = true;
   return 1;
 }
@@ -616,46 +638,38 @@ build_sector_scan_json (db_t *db, int sector_id, int player_id, bool holo)
       return NULL;
     }
   json_object_set_new (root, "server_tick", json_integer (g_server_tick));
-  json_t *basic = NULL;
+  db_sector_scan_t scan;
 
 
-  if (db_sector_basic_json (db, sector_id, &basic) == 0 && basic)
+  db_sector_scan_json (db, sector_id, &scan);
+  if (scan.basic)
     {
       json_object_set_new (root, "sector_id", json_integer (sector_id));
-      json_object_set (root, "name", json_object_get (basic, "name"));
-      json_object_set (root, "beacon", json_object_get (basic, "beacon"));
-      json_decref (basic);
+      json_object_set (root, "name", json_object_get (scan.basic, "name"));
+      json_object_set (root, "beacon", json_object_get (scan.basic, "beacon"));
+      json_decref (scan.basic);
     }
-  json_t *adj = NULL;
-
-
-  if (db_adjacent_sectors_json (db, sector_id, &adj) == 0 && adj)
+  if (scan.adjacent)
     {
-      json_object_set_new (root, "adjacent_sectors", adj);
+      json_object_set_new (root, "adjacent_sectors", scan.adjacent);
     }
-  json_t *ships = NULL;
-  if (db_ships_at_sector_json (db, player_id, sector_id, &ships) == 0)
+  if (scan.ships)
     {
-      json_object_set_new (root, "ships_present", ships ? : json_array ());
+      json_object_set_new (root, "ships_present", scan.ships);
     }
-  json_t *ports = NULL;
-
-
-  if (db_ports_at_sector_json (db, sector_id, &ports) == 0)
+  if (scan.ports)
     {
-      json_object_set_new (root, "ports", ports ? : json_array ());
+      json_object_set_new (root, "ports", scan.ports);
     }
-  json_t *planets = NULL;
-
-
-  if (db_planets_at_sector_json (db, sector_id, &planets) == 0)
+  if (scan.planets)
     {
-      json_object_set_new (root, "celestial_objects",
-			   planets ? : json_array ());
+      json_object_set_new (root, "celestial_objects", scan.planets);
     }
 
 
-  attach_sector_asset_counts (db, sector_id, root);
+  attach_sector_asset_counts (scan.assets, root);
+  json_decref (scan.assets);
+  (void) player_id;
   (void) holo;
   return root;
 }
@@ -966,6 +980,8 @@ cmd_move_warp (client_ctx_t *ctx, json_t *root)
 
   if (db_player_set_sector (ctx->player_id, to) == 0)
     {
+      session_cache_invalidate_player (ctx->player_id);
+
       /* Record visit */
       repo_players_record_visit (db, ctx->player_id, to);
 
@@ -974,6 +990,9 @@ cmd_move_warp (client_ctx_t *ctx, json_t *root)
 
       LOGD ("Player %d warped from %d to %d", ctx->player_id, ctx->sector_id, to);
       ctx->sector_id = to;
+      client_registry_update (ctx);
+      /* The player's other connections went along */
+      client_registry_move_player (ctx->player_id, to);
 
       /* Canon #471: Sector assets engage on entry */
       if (server_combat_apply_entry_hazards (db, ctx, to))
@@ -1041,284 +1060,87 @@ cmd_move_pathfind (client_ctx_t *ctx, json_t *root)
       return 0;
     }
 
-  int max_id = 0;
-  db_error_t err;
-  db_res_t *res = NULL;
-
+  const warp_graph_t *g = warp_graph_acquire (db);
 
-  if (repo_universe_get_max_sector_id (db, &max_id) != 0)
+  if (!g)
     {
       send_response_error (ctx, root, ERR_DB,
-			   "Failed to query universe size");
+			   "Failed to load warp graph");
       return 0;
     }
 
-  if (max_id <= 0)
-    {
-      send_response_error (ctx, root, ERR_NOT_FOUND,
-			   "No sectors in universe");
-      return 0;
-    }
-
-  if (from <= 0 || from > max_id || to <= 0 || to > max_id)
+  if (!warp_graph_has_sector (g, from) || !warp_graph_has_sector (g, to))
     {
+      warp_graph_release (g);
       send_response_error (ctx, root, ERR_SECTOR_NOT_FOUND,
 			   "Sector not found");
       return 0;
     }
 
-  size_t N = (size_t) max_id + 1;
-  unsigned char *avoid = calloc (N, 1);
-  unsigned char *seen = calloc (N, 1);
-  int *prev = malloc (N * sizeof (int));
-  int *queue = malloc (N * sizeof (int));
+  int *path = NULL;
+  int hops = warp_graph_path (g, from, to, NULL, &path);
 
 
-  if (!avoid || !seen || !prev || !queue)
+  warp_graph_release (g);
+  if (hops == -2)
     {
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
       send_response_error (ctx, root, ERR_NOMEM, "Out of memory");
       return 0;
     }
-  for (size_t i = 0; i < N; ++i)
-    {
-      prev[i] = -1;
-    }
-
-  if (from == to)
-    {
-      json_t *steps = json_array ();
-
-
-      json_array_append_new (steps, json_integer (from));
-      json_t *out = json_object ();
-
-
-      json_object_set_new (out, "steps", steps);
-      json_object_set_new (out, "hops", json_integer (0));
-      send_response_ok_take (ctx, root, "move.pathfind", &out);
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      return 0;
-    }
-
-  int *head = malloc (N * sizeof (int));
-  int *to_v = NULL;
-  int *next = NULL;
-  int edges = 0;
-
-
-  for (size_t i = 0; i < N; i++)
-    {
-      head[i] = -1;
-    }
-
-  if (repo_universe_get_warp_count (db, &edges) != 0)
-    {
-      // Memory cleanup
-      free (head);
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      send_response_error (ctx,
-			   root, ERR_DB, "Pathfind init failed (edge count)");
-      return 0;
-    }
-
-  if (edges > 0)
-    {
-      to_v = malloc ((size_t) edges * sizeof (int));
-      next = malloc ((size_t) edges * sizeof (int));
-      if (!to_v || !next)
-	{
-	  free (to_v);
-	  free (next);
-	  free (head);
-	  free (avoid);
-	  free (seen);
-	  free (prev);
-	  free (queue);
-	  send_response_error (ctx, root, ERR_NOMEM, "Out of memory");
-	  return 0;
-	}
-
-      if ((res = repo_universe_get_all_warps (db, &err)) == NULL)
-	{
-	  free (to_v);
-	  free (next);
-	  free (head);
-	  free (avoid);
-	  free (seen);
-	  free (prev);
-	  free (queue);
-	  send_response_error (ctx,
-			       root,
-			       ERR_DB, "Pathfind init failed (edge read)");
-	  return 0;
-	}
-      int e = 0;
-
-
-      while (db_res_step (res, &err))
-	{
-	  if (e >= edges)
-	    {
-	      break;
-	    }
-	  int u = (int) db_res_col_i64 (res, 0, &err);
-	  int v = (int) db_res_col_i64 (res, 1, &err);
-
-
-	  if (u > 0 && u <= max_id && v > 0 && v <= max_id)
-	    {
-	      to_v[e] = v;
-	      next[e] = head[u];
-	      head[u] = e++;
-	    }
-	}
-      db_res_finalize (res);
-    }
-
-  int qh = 0, qt = 0;
-
-
-  queue[qt++] = from;
-  seen[from] = 1;
-  int found = 0;
-
-
-  while (qh < qt)
-    {
-      int u = queue[qh++];
-
-
-      for (int ei = head[u]; ei != -1; ei = next[ei])
-	{
-	  int v = to_v[ei];
-
-
-	  if (avoid[v] || seen[v])
-	    {
-	      continue;
-	    }
-	  seen[v] = 1;
-	  prev[v] = u;
-	  queue[qt++] = v;
-	  if (v == to)
-	    {
-	      found = 1;
-	      break;
-	    }
-	}
-      if (found)
-	{
-	  break;
-	}
-    }
-
-  free (to_v);
-  free (next);
-  free (head);
-
-  if (!found)
+  if (hops < 0)
     {
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
       send_response_error (ctx, root, ERR_NOT_FOUND, "Path not found");
       return 0;
     }
 
-  int *stack = malloc (N * sizeof (int));
-  int sp = 0;
-  int cur = to;
-
-
-  while (cur != -1)
-    {
-      stack[sp++] = cur;
-      if (cur == from)
-	{
-	  break;
-	}
-      cur = prev[cur];
-    }
-
-  if (sp <= 0 || stack[sp - 1] != from)
-    {
-      free (stack);
-      free (avoid);
-      free (seen);
-      free (prev);
-      free (queue);
-      send_response_error (ctx,
-			   root,
-			   ERR_SERVER_ERROR, "Path reconstruction failed");
-      return 0;
-    }
-
   json_t *steps = json_array ();
 
 
-  for (int i = sp - 1; i >= 0; --i)
+  for (int i = 0; i <= hops; ++i)
     {
-      json_array_append_new (steps, json_integer (stack[i]));
+      json_array_append_new (steps, json_integer (path[i]));
     }
+  free (path);
 
   json_t *out = json_object ();
 
 
   json_object_set_new (out, "steps", steps);
-  json_object_set_new (out, "hops", json_integer (sp - 1));
+  json_object_set_new (out, "hops", json_integer (hops));
   send_response_ok_take (ctx, root, "move.pathfind", &out);
-
-  free (stack);
-  free (avoid);
-  free (seen);
-  free (prev);
-  free (queue);
   return 0;
 }
 
 
+/* assets: rows of {asset_type, quantity} from db_sector_scan_json, or NULL */
 static void
-attach_sector_asset_counts (db_t *db, int sid, json_t *out)
+attach_sector_asset_counts (const json_t *assets, json_t *out)
 {
   int ftrs = 0, armid = 0, limpet = 0;
-  db_res_t *res = NULL;
-  db_error_t err;
+  size_t i;
+  json_t *row;
 
-  if ((res = repo_universe_get_asset_counts (db, sid, &err)) != NULL)
+  json_array_foreach (assets, i, row)
     {
-      while (db_res_step (res, &err))
-	{
-	  int type = db_res_col_i32 (res, 0, &err);
-	  int qty = db_res_col_i32 (res,
-				    1,
-				    &err);
+      int type = (int) json_integer_value (json_object_get (row, "asset_type"));
+      json_t *jq = json_object_get (row, "quantity");
+      /* SUM() may come back as numeric (real or text) depending on backend */
+      int qty = json_is_string (jq) ? atoi (json_string_value (jq))
+	: (int) json_number_value (jq);
 
 
-	  if (type == 2)
-	    {
-	      ftrs += qty;
-	    }
-	  else if (type == 1)
-	    {
-	      armid += qty;
-	    }
-	  else if (type == 4)
-	    {
-	      limpet += qty;
-	    }
+      if (type == 2)
+	{
+	  ftrs += qty;
+	}
+      else if (type == 1)
+	{
+	  armid += qty;
+	}
+      else if (type == 4)
+	{
+	  limpet += qty;
 	}
-      db_res_finalize (res);
     }
   json_t *c = json_object ();
 
@@ -1653,7 +1475,10 @@ cmd_move_transwarp (client_ctx_t *ctx, json_t *root)
       return 0;
     }
 
+  session_cache_invalidate_player (ctx->player_id);
   ctx->sector_id = to_sector_id;
+  client_registry_update (ctx);
+  client_registry_move_player (ctx->player_id, to_sector_id);
 
   /* Canon #471: Sector assets engage on entry */
   if (server_combat_apply_entry_hazards (db, ctx, to_sector_id))
@@ -1941,6 +1766,7 @@ fer_init_once (db_t *db)
       /* Non-fatal: traders can still trade (conceptually), just can't spawn warships */
     }
 
+  nav_pin_goal (home);
   g_fer_inited = 1;
   LOGI ("[fer] Ferengi traders initialized");
   return 1;
@@ -2058,6 +1884,7 @@ iss_init_once (void)
     {
       g_iss_sector = sector;
     }
+  nav_pin_goal (g_stardock_sector);
   g_patrol_budget = kIssPatrolBudget;
   srand ((unsigned) time (NULL));
   g_iss_inited = 1;
@@ -23,6 +23,8 @@ int iss_init_once (void);
 
 int no_zero_ship (db_t * db, int set_sector, int ship_id);
 int nav_next_hop (db_t * db, int start, int goal);
+/* Keep a precomputed next-hop table for a frequently targeted sector. */
+void nav_pin_goal (int goal);
 int nav_random_neighbor (db_t * db, int sector);
 int h_warp_exists (db_t * db, int from, int to);
 int h_check_interdiction (db_t * db, int sector_id, int player_id,
@@ -0,0 +1,361 @@
+/* src/session_cache.c */
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/* local includes */
+#include "session_cache.h"
+
+#define SC_SHARDS        64	/* power of two */
+#define SC_BUCKETS       256	/* per shard, power of two */
+#define SC_SHARD_MAX     4096	/* entries per shard before purging */
+#define SC_PLAYER_SLOTS  4096	/* power of two; collisions only over-invalidate */
+#define SC_TOKEN_MAX     128
+
+typedef struct sc_entry_s
+{
+  struct sc_entry_s *next;
+  uint32_t hash;
+  session_info_t info;
+  int64_t expires;		/* unix seconds, 0 = unknown */
+  uint64_t deadline_ms;		/* monotonic */
+  uint32_t epoch;
+  uint32_t player_gen;
+  char token[];
+} sc_entry_t;
+
+typedef struct
+{
+  pthread_mutex_t mu;
+  size_t count;
+  sc_entry_t *buckets[SC_BUCKETS];
+} sc_shard_t;
+
+static sc_shard_t g_shards[SC_SHARDS];
+static int g_ttl_ms = 0;
+
+/* Bumped by token invalidation; fills started before it are dropped */
+static _Atomic uint64_t g_revoke_seq = 0;
+/* Bumped by invalidate_all; older entries are stale */
+static _Atomic uint32_t g_epoch = 0;
+/* Bumped by invalidate_player for the player's slot */
+static _Atomic uint32_t g_player_gen[SC_PLAYER_SLOTS];
+
+static _Atomic uint64_t g_hits = 0;
+static _Atomic uint64_t g_misses = 0;
+static _Atomic uint64_t g_invalidations = 0;
+
+
+static uint64_t
+sc_now_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000ULL + (uint64_t) ts.tv_nsec / 1000000ULL;
+}
+
+
+/* FNV-1a; low bits pick the shard, the next ones the bucket */
+static uint32_t
+sc_hash (const char *token)
+{
+  uint32_t h = 2166136261u;
+
+  for (const unsigned char *p = (const unsigned char *) token; *p; p++)
+    {
+      h ^= *p;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+
+static inline sc_shard_t *
+sc_shard (uint32_t h)
+{
+  return &g_shards[h & (SC_SHARDS - 1)];
+}
+
+
+static inline sc_entry_t **
+sc_bucket (sc_shard_t *sh, uint32_t h)
+{
+  return &sh->buckets[(h >> 6) & (SC_BUCKETS - 1)];
+}
+
+
+static inline _Atomic uint32_t *
+sc_player_slot (int player_id)
+{
+  return &g_player_gen[(uint32_t) player_id & (SC_PLAYER_SLOTS - 1)];
+}
+
+
+static int
+sc_entry_valid (const sc_entry_t *e, uint64_t now_ms, time_t now_s)
+{
+  if (now_ms >= e->deadline_ms)
+    {
+      return 0;
+    }
+  if (e->expires > 0 && (int64_t) now_s >= e->expires)
+    {
+      return 0;
+    }
+  if (e->epoch != atomic_load (&g_epoch))
+    {
+      return 0;
+    }
+  return e->player_gen == atomic_load (sc_player_slot (e->info.player_id));
+}
+
+
+/* Caller holds sh->mu */
+static void
+sc_purge_locked (sc_shard_t *sh, uint64_t now_ms, time_t now_s)
+{
+  for (int b = 0; b < SC_BUCKETS; b++)
+    {
+      sc_entry_t **pp = &sh->buckets[b];
+
+      while (*pp)
+	{
+	  sc_entry_t *e = *pp;
+
+	  if (sc_entry_valid (e, now_ms, now_s))
+	    {
+	      pp = &e->next;
+	      continue;
+	    }
+	  *pp = e->next;
+	  free (e);
+	  sh->count--;
+	}
+    }
+}
+
+
+void
+session_cache_init (int ttl_ms)
+{
+  for (int i = 0; i < SC_SHARDS; i++)
+    {
+      pthread_mutex_init (&g_shards[i].mu, NULL);
+    }
+  g_ttl_ms = ttl_ms;
+}
+
+
+int
+session_cache_get (const char *token, session_info_t *out)
+{
+  if (g_ttl_ms <= 0 || !token || !out)
+    {
+      return 0;
+    }
+
+  uint32_t h = sc_hash (token);
+  sc_shard_t *sh = sc_shard (h);
+  int hit = 0;
+
+  pthread_mutex_lock (&sh->mu);
+  for (sc_entry_t **pp = sc_bucket (sh, h); *pp; pp = &(*pp)->next)
+    {
+      sc_entry_t *e = *pp;
+
+      if (e->hash != h || strcmp (e->token, token) != 0)
+	{
+	  continue;
+	}
+      if (sc_entry_valid (e, sc_now_ms (), time (NULL)))
+	{
+	  *out = e->info;
+	  hit = 1;
+	}
+      else
+	{
+	  *pp = e->next;
+	  free (e);
+	  sh->count--;
+	}
+      break;
+    }
+  pthread_mutex_unlock (&sh->mu);
+
+  atomic_fetch_add (hit ? &g_hits : &g_misses, 1);
+  return hit;
+}
+
+
+void
+session_cache_begin (session_ticket_t *t)
+{
+  t->revoke_seq = atomic_load (&g_revoke_seq);
+  t->epoch = atomic_load (&g_epoch);
+  t->player_gen = 0;
+}
+
+
+void
+session_cache_bind_player (session_ticket_t *t, int player_id)
+{
+  t->player_gen = atomic_load (sc_player_slot (player_id));
+}
+
+
+void
+session_cache_put (const session_ticket_t *t, const char *token,
+		   const session_info_t *info, int64_t expires)
+{
+  if (g_ttl_ms <= 0 || !t || !token || !info || info->player_id <= 0)
+    {
+      return;
+    }
+
+  size_t len = strlen (token);
+  time_t now_s = time (NULL);
+  uint64_t now_ms = sc_now_ms ();
+
+  if (len == 0 || len > SC_TOKEN_MAX || (expires > 0 && expires <= now_s))
+    {
+      return;
+    }
+
+  sc_entry_t *e = malloc (sizeof (*e) + len + 1);
+
+  if (!e)
+    {
+      return;
+    }
+  e->hash = sc_hash (token);
+  e->info = *info;
+  e->expires = expires;
+  e->deadline_ms = now_ms + (uint64_t) g_ttl_ms;
+  e->epoch = t->epoch;
+  e->player_gen = t->player_gen;
+  memcpy (e->token, token, len + 1);
+
+  sc_shard_t *sh = sc_shard (e->hash);
+  sc_entry_t **head = sc_bucket (sh, e->hash);
+
+  pthread_mutex_lock (&sh->mu);
+  /* A token was revoked while this fill was reading the DB */
+  if (atomic_load (&g_revoke_seq) != t->revoke_seq)
+    {
+      pthread_mutex_unlock (&sh->mu);
+      free (e);
+      return;
+    }
+  for (sc_entry_t **pp = head; *pp; pp = &(*pp)->next)
+    {
+      if ((*pp)->hash == e->hash && strcmp ((*pp)->token, token) == 0)
+	{
+	  sc_entry_t *old = *pp;
+
+	  e->next = old->next;
+	  *pp = e;
+	  pthread_mutex_unlock (&sh->mu);
+	  free (old);
+	  return;
+	}
+    }
+  if (sh->count >= SC_SHARD_MAX)
+    {
+      sc_purge_locked (sh, now_ms, now_s);
+    }
+  if (sh->count >= SC_SHARD_MAX)
+    {
+      pthread_mutex_unlock (&sh->mu);
+      free (e);
+      return;
+    }
+  e->next = *head;
+  *head = e;
+  sh->count++;
+  pthread_mutex_unlock (&sh->mu);
+}
+
+
+void
+session_cache_invalidate_token (const char *token)
+{
+  if (!token)
+    {
+      return;
+    }
+
+  uint32_t h = sc_hash (token);
+  sc_shard_t *sh = sc_shard (h);
+  sc_entry_t *victim = NULL;
+
+  atomic_fetch_add (&g_revoke_seq, 1);
+  atomic_fetch_add (&g_invalidations, 1);
+
+  pthread_mutex_lock (&sh->mu);
+  for (sc_entry_t **pp = sc_bucket (sh, h); *pp; pp = &(*pp)->next)
+    {
+      if ((*pp)->hash == h && strcmp ((*pp)->token, token) == 0)
+	{
+	  victim = *pp;
+	  *pp = victim->next;
+	  sh->count--;
+	  break;
+	}
+    }
+  pthread_mutex_unlock (&sh->mu);
+  free (victim);
+}
+
+
+void
+session_cache_invalidate_player (int player_id)
+{
+  if (player_id <= 0)
+    {
+      return;
+    }
+  atomic_fetch_add (sc_player_slot (player_id), 1);
+  atomic_fetch_add (&g_invalidations, 1);
+}
+
+
+void
+session_cache_invalidate_all (void)
+{
+  atomic_fetch_add (&g_epoch, 1);
+  atomic_fetch_add (&g_invalidations, 1);
+}
+
+
+json_t *
+session_cache_stats_json (void)
+{
+  size_t entries = 0;
+
+  for (int i = 0; i < SC_SHARDS; i++)
+    {
+      pthread_mutex_lock (&g_shards[i].mu);
+      entries += g_shards[i].count;
+      pthread_mutex_unlock (&g_shards[i].mu);
+    }
+
+  uint64_t hits = atomic_load (&g_hits);
+  uint64_t misses = atomic_load (&g_misses);
+  json_t *o = json_object ();
+
+  json_object_set_new (o, "enabled", json_boolean (g_ttl_ms > 0));
+  json_object_set_new (o, "ttl_ms", json_integer (g_ttl_ms));
+  json_object_set_new (o, "entries", json_integer ((json_int_t) entries));
+  json_object_set_new (o, "hits", json_integer ((json_int_t) hits));
+  json_object_set_new (o, "misses", json_integer ((json_int_t) misses));
+  json_object_set_new (o, "hit_rate",
+		       json_real (hits + misses ?
+				  (double) hits / (double) (hits + misses) :
+				  0.0));
+  json_object_set_new (o, "invalidations",
+		       json_integer ((json_int_t)
+				     atomic_load (&g_invalidations)));
+  return o;
+}
@@ -0,0 +1,61 @@
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+#include <stdint.h>
+#include <jansson.h>
+
+/*
+ * Per-request authentication cache.
+ *
+ * process_message() resolves the session token, corp, active ship and sector
+ * for every request. This cache keeps the result keyed by token in a fixed
+ * set of independently locked shards so workers rarely contend.
+ *
+ * An entry is served until the earliest of: the session's own expiry, the
+ * configured TTL (session_cache_ttl_ms), or an explicit invalidation. The TTL
+ * bounds staleness for changes made outside this process (engine jobs, SQL
+ * functions); code paths in the server that change ship, corp or sector call
+ * session_cache_invalidate_player() so the next request reloads.
+ *
+ * Fills are race-free against invalidation: call session_cache_begin()
+ * before looking the token up, session_cache_bind_player() once the player is
+ * known and before reading corp/ship/sector, then session_cache_put(). An
+ * invalidation that lands in between leaves the new entry stale or drops it.
+ * Invalidate only after the change is committed.
+ */
+
+typedef struct
+{
+  int player_id;
+  int corp_id;
+  int ship_id;
+  int sector_id;
+} session_info_t;
+
+/* ttl_ms <= 0 disables the cache (every lookup misses). */
+void session_cache_init (int ttl_ms);
+
+/* 1 and *out filled on hit, 0 on miss. */
+int session_cache_get (const char *token, session_info_t * out);
+
+typedef struct
+{
+  uint64_t revoke_seq;
+  uint32_t epoch;
+  uint32_t player_gen;
+} session_ticket_t;
+
+void session_cache_begin (session_ticket_t * t);
+void session_cache_bind_player (session_ticket_t * t, int player_id);
+/* expires is the session's expiry in unix seconds (0 = unknown). */
+void session_cache_put (const session_ticket_t * t, const char *token,
+			const session_info_t * info, int64_t expires);
+
+void session_cache_invalidate_token (const char *token);
+void session_cache_invalidate_player (int player_id);
+/* Drop everything, e.g. after a bulk move of several players. */
+void session_cache_invalidate_all (void);
+
+/* New reference: entries, hits, misses, hit_rate, invalidations. */
+json_t *session_cache_stats_json (void);
+
+#endif /* SESSION_CACHE_H */
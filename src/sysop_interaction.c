@@ -172,6 +172,20 @@ h_engine_status (void)
   sysop_local_call (cmd_sysop_engine_status_get, NULL);
 }
 
+/* sysop.metrics.get -> sysop.metrics_v1 */
+static void
+h_metrics (void)
+{
+  sysop_local_call (cmd_sysop_metrics_get, NULL);
+}
+
+/* sysop.db_stats.get -> sysop.db_stats_v1 */
+static void
+h_db_stats (void)
+{
+  sysop_local_call (cmd_sysop_db_stats_get, NULL);
+}
+
 
 /* sysop.logs.tail -> sysop.audit_tail_v1 (stub; later: tail your logfile) */
 static void
@@ -275,6 +289,8 @@ h_help (void)
 	"  player sessions <id>    -> sysop.player.sessions.get\n"
 	"  universe summary        -> sysop.universe.summary\n"
 	"  engine status           -> sysop.engine_status.get\n"
+	"  metrics                 -> sysop.metrics.get\n"
+	"  db stats                -> sysop.db_stats.get\n"
 	"  job list                -> sysop.jobs.list\n"
 	"  job info <id>           -> sysop.jobs.get\n"
 	"  job cancel <id>         -> sysop.jobs.cancel\n"
@@ -357,6 +373,16 @@ sysop_dispatch_line (char *line)
       h_engine_status ();
       return;
     }
+  if (!strcmp (line, "metrics"))
+    {
+      h_metrics ();
+      return;
+    }
+  if (!strcmp (line, "db stats"))
+    {
+      h_db_stats ();
+      return;
+    }
   if (!strcmp (line, "g l") || !strcmp (line, "logs tail"))
     {
       h_logs_tail ();
@@ -509,6 +535,16 @@ sysop_dispatch_line (char *line)
       h_engine_status ();
       return;
     }
+  if (!strcmp (line, "sysop.metrics.get"))
+    {
+      h_metrics ();
+      return;
+    }
+  if (!strcmp (line, "sysop.db_stats.get"))
+    {
+      h_db_stats ();
+      return;
+    }
   if (!strcmp (line, "sysop.logs.tail"))
     {
       h_logs_tail ();
@@ -0,0 +1,699 @@
+/* src/topic_index.c */
+#include <ctype.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+/* local includes */
+#include "topic_index.h"
+#include "server_log.h"
+#include "db/repo/repo_communication.h"
+
+#define TOPIC_CONN_BUCKETS  1024	/* connections by player id */
+#define TOPIC_INIT_CAP      256	/* exact-topic buckets, power of two */
+#define TOPIC_BIND_TRIES    4	/* loads before bind gives up on a busy player */
+
+typedef struct topic_sub_s topic_sub_t;
+
+/* An exact topic and the connections subscribed to it */
+typedef struct topic_entry_s
+{
+  struct topic_entry_s *next;
+  uint64_t hash;
+  topic_sub_t *subs;
+  char topic[];
+} topic_entry_t;
+
+/* One character of a wildcard prefix; subs holds the patterns that end
+   here */
+typedef struct trie_node_s
+{
+  struct trie_node_s *parent;
+  struct trie_node_s *child;
+  struct trie_node_s *sibling;
+  topic_sub_t *subs;
+  char c;
+} trie_node_t;
+
+typedef struct topic_conn_s
+{
+  client_ctx_t *ctx;
+  int player_id;
+  topic_sub_t *subs;
+  unsigned gen;			/* bumped by every remove; see bind */
+  struct topic_conn_s *next;	/* same player bucket */
+} topic_conn_t;
+
+/* One connection subscribed to one topic or pattern */
+struct topic_sub_s
+{
+  topic_conn_t *conn;
+  topic_sub_t *prev;		/* in the entry's or node's list */
+  topic_sub_t *next;
+  topic_sub_t *next_of_conn;
+  topic_entry_t *entry;		/* exact topic, or NULL */
+  trie_node_t *node;		/* wildcard pattern, or NULL */
+  char key[];			/* as subscribed, lower-cased */
+};
+
+/* Publishers share the read side; (un)subscribing takes the write side */
+static pthread_rwlock_t g_lock =
+  PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
+static topic_entry_t **g_topics = NULL;
+static size_t g_topics_cap = 0;
+static size_t g_topics_n = 0;
+static trie_node_t g_trie;
+static topic_conn_t *g_conns[TOPIC_CONN_BUCKETS];
+static size_t g_n_conns = 0;
+static size_t g_n_wild = 0;
+static size_t g_n_subs = 0;
+
+static _Atomic uint64_t g_publishes = 0;
+static _Atomic uint64_t g_deliveries = 0;
+
+
+/* Topics match case-insensitively: everything stored is lower-cased, and
+   lookups fold case as they hash, compare and walk */
+static char
+topic_fold (char c)
+{
+  return (char) tolower ((unsigned char) c);
+}
+
+
+static uint64_t
+topic_hash (const char *s)
+{
+  uint64_t h = 1469598103934665603ULL;
+
+  for (const char *p = s; *p; p++)
+    {
+      h ^= (unsigned char) topic_fold (*p);
+      h *= 1099511628211ULL;
+    }
+  return h;
+}
+
+
+static topic_conn_t **
+conn_bucket (int player_id)
+{
+  return &g_conns[(unsigned) player_id % TOPIC_CONN_BUCKETS];
+}
+
+
+static topic_entry_t *
+entry_find (const char *topic, uint64_t h)
+{
+  if (!g_topics)
+    {
+      return NULL;
+    }
+  for (topic_entry_t * e = g_topics[h & (g_topics_cap - 1)]; e; e = e->next)
+    {
+      if (e->hash == h && strcasecmp (e->topic, topic) == 0)
+	{
+	  return e;
+	}
+    }
+  return NULL;
+}
+
+
+/* Keep the exact-topic table at most one entry per bucket on average */
+static void
+entries_grow (void)
+{
+  size_t ncap = g_topics_cap ? g_topics_cap * 2 : TOPIC_INIT_CAP;
+  topic_entry_t **nt = calloc (ncap, sizeof (*nt));
+
+  if (!nt)
+    {
+      return;			/* longer chains, still correct */
+    }
+  for (size_t i = 0; i < g_topics_cap; i++)
+    {
+      topic_entry_t *e = g_topics[i];
+
+      while (e)
+	{
+	  topic_entry_t *next = e->next;
+	  size_t b = e->hash & (ncap - 1);
+
+	  e->next = nt[b];
+	  nt[b] = e;
+	  e = next;
+	}
+    }
+  free (g_topics);
+  g_topics = nt;
+  g_topics_cap = ncap;
+}
+
+
+static topic_entry_t *
+entry_get (const char *topic)
+{
+  uint64_t h = topic_hash (topic);
+  topic_entry_t *e = entry_find (topic, h);
+
+  if (e)
+    {
+      return e;
+    }
+  if (g_topics_n >= g_topics_cap)
+    {
+      entries_grow ();
+      if (!g_topics)
+	{
+	  return NULL;
+	}
+    }
+  size_t len = strlen (topic);
+
+  e = malloc (sizeof (*e) + len + 1);
+  if (!e)
+    {
+      return NULL;
+    }
+  for (size_t i = 0; i <= len; i++)
+    {
+      e->topic[i] = topic_fold (topic[i]);
+    }
+  e->hash = h;
+  e->subs = NULL;
+
+  size_t b = h & (g_topics_cap - 1);
+
+  e->next = g_topics[b];
+  g_topics[b] = e;
+  g_topics_n++;
+  return e;
+}
+
+
+static void
+entry_drop (topic_entry_t *e)
+{
+  topic_entry_t **pp = &g_topics[e->hash & (g_topics_cap - 1)];
+
+  while (*pp != e)
+    {
+      pp = &(*pp)->next;
+    }
+  *pp = e->next;
+  g_topics_n--;
+  free (e);
+}
+
+
+static trie_node_t *
+trie_child (const trie_node_t *n, char c)
+{
+  for (trie_node_t * k = n->child; k; k = k->sibling)
+    {
+      if (k->c == c)
+	{
+	  return k;
+	}
+    }
+  return NULL;
+}
+
+
+static trie_node_t *
+trie_get (const char *prefix, size_t len)
+{
+  trie_node_t *n = &g_trie;
+
+  for (size_t i = 0; i < len; i++)
+    {
+      char c = topic_fold (prefix[i]);
+      trie_node_t *k = trie_child (n, c);
+
+      if (!k)
+	{
+	  k = calloc (1, sizeof (*k));
+	  if (!k)
+	    {
+	      return NULL;
+	    }
+	  k->c = c;
+	  k->parent = n;
+	  k->sibling = n->child;
+	  n->child = k;
+	}
+      n = k;
+    }
+  return n;
+}
+
+
+/* Free nodes that no longer lead to a pattern */
+static void
+trie_prune (trie_node_t *n)
+{
+  while (n != &g_trie && !n->subs && !n->child)
+    {
+      trie_node_t *parent = n->parent;
+      trie_node_t **pp = &parent->child;
+
+      while (*pp != n)
+	{
+	  pp = &(*pp)->sibling;
+	}
+      *pp = n->sibling;
+      free (n);
+      n = parent;
+    }
+}
+
+
+static void
+sub_add (topic_conn_t *conn, const char *key)
+{
+  for (topic_sub_t * s = conn->subs; s; s = s->next_of_conn)
+    {
+      if (strcasecmp (s->key, key) == 0)
+	{
+	  return;
+	}
+    }
+
+  size_t len = strlen (key);
+  topic_sub_t *s = calloc (1, sizeof (*s) + len + 1);
+
+  if (!s)
+    {
+      return;
+    }
+  for (size_t i = 0; i <= len; i++)
+    {
+      s->key[i] = topic_fold (key[i]);
+    }
+  key = s->key;
+
+  const char *star = strchr (key, '*');
+  topic_sub_t **head;
+
+  if (star)
+    {
+      s->node = trie_get (key, (size_t) (star - key));
+      head = s->node ? &s->node->subs : NULL;
+    }
+  else
+    {
+      s->entry = entry_get (key);
+      head = s->entry ? &s->entry->subs : NULL;
+    }
+  if (!head)
+    {
+      LOGW ("topic index: out of memory adding '%s'", key);
+      free (s);
+      return;
+    }
+
+  s->conn = conn;
+  s->next = *head;
+  if (*head)
+    {
+      (*head)->prev = s;
+    }
+  *head = s;
+  s->next_of_conn = conn->subs;
+  conn->subs = s;
+  g_n_subs++;
+  if (star)
+    {
+      g_n_wild++;
+    }
+}
+
+
+/* Unlink s from its topic or pattern and free it; the caller has already
+   taken it off the connection's list. */
+static void
+sub_free (topic_sub_t *s)
+{
+  topic_sub_t **head = s->entry ? &s->entry->subs : &s->node->subs;
+
+  if (s->prev)
+    {
+      s->prev->next = s->next;
+    }
+  else
+    {
+      *head = s->next;
+    }
+  if (s->next)
+    {
+      s->next->prev = s->prev;
+    }
+  if (s->entry)
+    {
+      if (!s->entry->subs)
+	{
+	  entry_drop (s->entry);
+	}
+    }
+  else
+    {
+      g_n_wild--;
+      trie_prune (s->node);
+    }
+  g_n_subs--;
+  free (s);
+}
+
+
+void
+topic_index_unbind (client_ctx_t *ctx)
+{
+  pthread_rwlock_wrlock (&g_lock);
+  topic_conn_t *conn = (topic_conn_t *) ctx->topics;
+
+  if (!conn)
+    {
+      pthread_rwlock_unlock (&g_lock);
+      return;
+    }
+  topic_conn_t **pp = conn_bucket (conn->player_id);
+
+  while (*pp != conn)
+    {
+      pp = &(*pp)->next;
+    }
+  *pp = conn->next;
+  while (conn->subs)
+    {
+      topic_sub_t *s = conn->subs;
+
+      conn->subs = s->next_of_conn;
+      sub_free (s);
+    }
+  ctx->topics = NULL;
+  g_n_conns--;
+  pthread_rwlock_unlock (&g_lock);
+  free (conn);
+}
+
+
+static void
+topics_free (char **topics, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+      free (topics[i]);
+    }
+  free (topics);
+}
+
+
+/* The enabled subscriptions of player_id, as a new array of n strings */
+static bool
+topics_load (client_ctx_t *ctx, int player_id, db_t *db, char ***out,
+	     size_t *out_n)
+{
+  db_error_t err;
+  db_res_t *res = db ? repo_comm_list_subscriptions (db, player_id, &err)
+    : NULL;
+
+  if (!res)
+    {
+      LOGW ("[cid=%" PRIu64 "] topic index: cannot load subscriptions of "
+	    "player %d", ctx->cid, player_id);
+      return false;
+    }
+
+  /* event_type, locked, enabled, ... */
+  char **topics = NULL;
+  size_t n = 0, cap = 0;
+
+  while (db_res_step (res, &err))
+    {
+      const char *t = db_res_col_text (res, 0, &err);
+
+      if (!t || !db_res_col_bool (res, 2, &err))
+	{
+	  continue;
+	}
+      if (n == cap)
+	{
+	  size_t ncap = cap ? cap * 2 : 16;
+	  char **nt = realloc (topics, ncap * sizeof (*nt));
+
+	  if (!nt)
+	    {
+	      break;
+	    }
+	  topics = nt;
+	  cap = ncap;
+	}
+      if ((topics[n] = strdup (t)) != NULL)
+	{
+	  n++;
+	}
+    }
+  db_res_finalize (res);
+  *out = topics;
+  *out_n = n;
+  return true;
+}
+
+
+void
+topic_index_bind (client_ctx_t *ctx, int player_id, db_t *db)
+{
+  topic_conn_t *conn = (topic_conn_t *) ctx->topics;
+
+  if (player_id <= 0 || (conn && conn->player_id == player_id))
+    {
+      return;
+    }
+  topic_index_unbind (ctx);
+
+  conn = calloc (1, sizeof (*conn));
+  if (!conn)
+    {
+      return;
+    }
+  conn->ctx = ctx;
+  conn->player_id = player_id;
+
+  /* Registered before the load, so a concurrent subscribe.add by another
+     connection of this player reaches it either way */
+  pthread_rwlock_wrlock (&g_lock);
+  topic_conn_t **bucket = conn_bucket (player_id);
+
+  conn->next = *bucket;
+  *bucket = conn;
+  ctx->topics = conn;
+  g_n_conns++;
+  pthread_rwlock_unlock (&g_lock);
+
+  /* A remove that lands while the list is read from the DB would be undone
+     by adding the list afterwards: load again until no remove intervened */
+  for (int tries = 0; tries < TOPIC_BIND_TRIES; tries++)
+    {
+      pthread_rwlock_rdlock (&g_lock);
+      unsigned gen = conn->gen;
+
+      pthread_rwlock_unlock (&g_lock);
+
+      char **topics = NULL;
+      size_t n = 0;
+
+      if (!topics_load (ctx, player_id, db, &topics, &n))
+	{
+	  return;
+	}
+      pthread_rwlock_wrlock (&g_lock);
+      bool current = conn->gen == gen;
+
+      for (size_t i = 0; current && i < n; i++)
+	{
+	  sub_add (conn, topics[i]);
+	}
+      pthread_rwlock_unlock (&g_lock);
+      topics_free (topics, n);
+      if (current)
+	{
+	  return;
+	}
+    }
+  LOGW ("[cid=%" PRIu64 "] topic index: subscriptions of player %d keep "
+	"changing, not loaded", ctx->cid, player_id);
+}
+
+
+void
+topic_index_add (int player_id, const char *topic)
+{
+  if (player_id <= 0 || !topic || !*topic)
+    {
+      return;
+    }
+  pthread_rwlock_wrlock (&g_lock);
+  for (topic_conn_t * c = *conn_bucket (player_id); c; c = c->next)
+    {
+      if (c->player_id == player_id)
+	{
+	  sub_add (c, topic);
+	}
+    }
+  pthread_rwlock_unlock (&g_lock);
+}
+
+
+void
+topic_index_remove (int player_id, const char *topic)
+{
+  if (player_id <= 0 || !topic)
+    {
+      return;
+    }
+  pthread_rwlock_wrlock (&g_lock);
+  for (topic_conn_t * c = *conn_bucket (player_id); c; c = c->next)
+    {
+      if (c->player_id != player_id)
+	{
+	  continue;
+	}
+      c->gen++;
+      for (topic_sub_t ** pp = &c->subs; *pp; pp = &(*pp)->next_of_conn)
+	{
+	  if (strcasecmp ((*pp)->key, topic) == 0)
+	    {
+	      topic_sub_t *s = *pp;
+
+	      *pp = s->next_of_conn;
+	      sub_free (s);
+	      break;
+	    }
+	}
+    }
+  pthread_rwlock_unlock (&g_lock);
+}
+
+
+typedef struct
+{
+  client_ctx_t **ctx;
+  size_t n;
+  size_t cap;
+} topic_hits_t;
+
+
+static void
+hits_collect (topic_hits_t *h, const topic_sub_t *s)
+{
+  for (; s; s = s->next)
+    {
+      if (h->n == h->cap)
+	{
+	  size_t ncap = h->cap ? h->cap * 2 : 64;
+	  client_ctx_t **nc = realloc (h->ctx, ncap * sizeof (*nc));
+
+	  if (!nc)
+	    {
+	      LOGW ("topic index: out of memory, publish truncated");
+	      return;
+	    }
+	  h->ctx = nc;
+	  h->cap = ncap;
+	}
+      h->ctx[h->n++] = s->conn->ctx;
+    }
+}
+
+
+static int
+hits_cmp (const void *a, const void *b)
+{
+  uintptr_t x = (uintptr_t) * (client_ctx_t * const *) a;
+  uintptr_t y = (uintptr_t) * (client_ctx_t * const *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+
+int
+topic_index_for_each (const char *topic, topic_visit_fn fn, void *arg)
+{
+  topic_hits_t h = { 0 };
+
+  if (!topic || !fn)
+    {
+      return 0;
+    }
+
+  pthread_rwlock_rdlock (&g_lock);
+  topic_entry_t *e = entry_find (topic, topic_hash (topic));
+
+  if (e)
+    {
+      hits_collect (&h, e->subs);
+    }
+
+  /* Every pattern along the topic's path is a prefix of it */
+  const trie_node_t *n = &g_trie;
+
+  hits_collect (&h, n->subs);
+  for (const char *p = topic;
+       *p && (n = trie_child (n, topic_fold (*p))) != NULL; p++)
+    {
+      hits_collect (&h, n->subs);
+    }
+
+  /* A connection matching several patterns still gets the event once */
+  size_t uniq = h.n;
+
+  if (h.n > 1)
+    {
+      qsort (h.ctx, h.n, sizeof (*h.ctx), hits_cmp);
+      uniq = 1;
+      for (size_t i = 1; i < h.n; i++)
+	{
+	  if (h.ctx[i] != h.ctx[uniq - 1])
+	    {
+	      h.ctx[uniq++] = h.ctx[i];
+	    }
+	}
+    }
+  for (size_t i = 0; i < uniq; i++)
+    {
+      fn (h.ctx[i], arg);
+    }
+  pthread_rwlock_unlock (&g_lock);
+
+  free (h.ctx);
+  atomic_fetch_add_explicit (&g_publishes, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit (&g_deliveries, uniq, memory_order_relaxed);
+  return (int) uniq;
+}
+
+
+json_t *
+topic_index_stats_json (void)
+{
+  json_t *o = json_object ();
+
+  pthread_rwlock_rdlock (&g_lock);
+  json_object_set_new (o, "connections", json_integer ((json_int_t) g_n_conns));
+  json_object_set_new (o, "topics", json_integer ((json_int_t) g_topics_n));
+  json_object_set_new (o, "wildcard_subscriptions",
+		       json_integer ((json_int_t) g_n_wild));
+  json_object_set_new (o, "subscriptions",
+		       json_integer ((json_int_t) g_n_subs));
+  pthread_rwlock_unlock (&g_lock);
+  json_object_set_new (o, "publishes",
+		       json_integer ((json_int_t) atomic_load (&g_publishes)));
+  json_object_set_new (o, "deliveries",
+		       json_integer ((json_int_t) atomic_load (&g_deliveries)));
+  return o;
+}
@@ -0,0 +1,47 @@
+#ifndef TOPIC_INDEX_H
+#define TOPIC_INDEX_H
+#include <jansson.h>
+#include "common.h"
+#include "db/db_api.h"
+
+/*
+ * In-memory pub/sub index: which live connections receive a topic.
+ *
+ * Subscriptions are stored per player in the subscriptions table; this index
+ * mirrors the enabled ones for every connection bound to a player, so that
+ * publishing costs a hash lookup plus one trie walk and no DB query. Exact
+ * topics ("system.notice", "sector.42") live in a hash map; wildcard
+ * patterns ("sector.*", anything up to the first '*') in a character trie,
+ * and a topic reaches every pattern that is a prefix of it. Matching ignores
+ * case, as the old per-client matcher did.
+ *
+ * A connection is bound to its player once a request authenticates
+ * (topic_index_bind loads the player's subscriptions) and unbound on logout
+ * and close. Code that changes a player's subscriptions in the DB calls
+ * topic_index_add/remove afterwards, which updates every connection of that
+ * player.
+ */
+
+/* Bind ctx to player_id, loading its enabled subscriptions through db.
+   No-op when ctx is already bound to player_id. Call on ctx's own thread. */
+void topic_index_bind (client_ctx_t * ctx, int player_id, db_t * db);
+/* Drop ctx from the index; before ctx is freed, and on logout. */
+void topic_index_unbind (client_ctx_t * ctx);
+
+/* Subscribe / unsubscribe every connection of player_id. */
+void topic_index_add (int player_id, const char *topic);
+void topic_index_remove (int player_id, const char *topic);
+
+/* Called once per connection subscribed to the topic, however many of its
+   patterns match. Runs under the index's read lock: it must not block or
+   call back into topic_index. */
+typedef void (*topic_visit_fn) (client_ctx_t * ctx, void *arg);
+
+/* Returns the number of connections visited. */
+int topic_index_for_each (const char *topic, topic_visit_fn fn, void *arg);
+
+/* New reference: connections, exact topics, subscriptions (wildcard ones
+   among them), publishes and deliveries. */
+json_t *topic_index_stats_json (void);
+
+#endif /* TOPIC_INDEX_H */
@@ -0,0 +1,652 @@
+/* src/warp_graph.c */
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* local includes */
+#include "warp_graph.h"
+#include "db/repo/repo_universe.h"
+#include "server_log.h"
+
+/* Current snapshot; pointer and refcounts are guarded by g_swap_mu */
+static warp_graph_t *g_graph = NULL;
+static pthread_mutex_t g_swap_mu = PTHREAD_MUTEX_INITIALIZER;
+/* Serialises rebuilds so a burst of invalidations loads the table once */
+static pthread_mutex_t g_build_mu = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic uint64_t g_want_gen = 1;
+
+/* Hop-distance rows shared across requests, guarded by g_hops_mu */
+#define WARP_HOPS_CACHE 64
+
+typedef struct hops_row_s
+{
+  uint64_t gen;
+  int src;
+  int max_hops;
+  int refs;
+  int cached;			/* owned by g_hops[]; else freed on last release */
+  uint64_t used;
+  warp_hops_t d[];
+} hops_row_t;
+
+static hops_row_t *g_hops[WARP_HOPS_CACHE];
+static uint64_t g_hops_tick = 0;
+static pthread_mutex_t g_hops_mu = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void
+warp_graph_free (warp_graph_t *g)
+{
+  if (!g)
+    {
+      return;
+    }
+  free (g->off);
+  free (g->adj);
+  free (g->roff);
+  free (g->radj);
+  free (g);
+}
+
+
+static int
+cmp_int (const void *a, const void *b)
+{
+  int x = *(const int *) a;
+  int y = *(const int *) b;
+
+  return (x > y) - (x < y);
+}
+
+
+/* Bucket n (from, to) pairs by pairs[2 * i + key] into CSR rows holding the
+   other endpoint, each row sorted so BFS tie-breaks are deterministic. */
+static int
+csr_build (int max_id, const int *pairs, size_t n, int key,
+	   int **out_off, int **out_adj)
+{
+  int *off = calloc ((size_t) max_id + 2, sizeof (int));
+  int *adj = malloc ((n ? n : 1) * sizeof (int));
+  int *fill = malloc (((size_t) max_id + 1) * sizeof (int));
+
+  if (!off || !adj || !fill)
+    {
+      free (off);
+      free (adj);
+      free (fill);
+      return -1;
+    }
+
+  /* off[u + 1] = degree(u), prefix-summed into row starts */
+  for (size_t i = 0; i < n; i++)
+    {
+      off[pairs[2 * i + key] + 1]++;
+    }
+  for (int u = 1; u <= max_id + 1; u++)
+    {
+      off[u] += off[u - 1];
+    }
+  memcpy (fill, off, ((size_t) max_id + 1) * sizeof (int));
+  for (size_t i = 0; i < n; i++)
+    {
+      adj[fill[pairs[2 * i + key]]++] = pairs[2 * i + (key ^ 1)];
+    }
+  free (fill);
+
+  for (int u = 1; u <= max_id; u++)
+    {
+      int deg = off[u + 1] - off[u];
+
+      if (deg > 1)
+	{
+	  qsort (&adj[off[u]], (size_t) deg, sizeof (int), cmp_int);
+	}
+    }
+  *out_off = off;
+  *out_adj = adj;
+  return 0;
+}
+
+
+static warp_graph_t *
+warp_graph_load (db_t *db, uint64_t gen)
+{
+  int max_id = 0;
+
+  if (repo_universe_get_max_sector_id (db, &max_id) != 0 || max_id <= 0)
+    {
+      return NULL;
+    }
+
+  db_error_t err = { 0 };
+  db_res_t *res = repo_universe_get_all_warps (db, &err);
+
+  if (!res)
+    {
+      return NULL;
+    }
+
+  /* Collect (from, to) pairs, then bucket them by source */
+  size_t cap = 4096, n = 0;
+  int *pairs = malloc (cap * 2 * sizeof (int));
+  int ok = pairs != NULL;
+
+  while (ok && db_res_step (res, &err))
+    {
+      int u = (int) db_res_col_i64 (res, 0, &err);
+      int v = (int) db_res_col_i64 (res, 1, &err);
+
+      if (u <= 0 || u > max_id || v <= 0 || v > max_id)
+	{
+	  continue;
+	}
+      if (n == cap)
+	{
+	  int *tmp = realloc (pairs, cap * 4 * sizeof (int));
+
+	  if (!tmp)
+	    {
+	      ok = 0;
+	      break;
+	    }
+	  pairs = tmp;
+	  cap *= 2;
+	}
+      pairs[2 * n] = u;
+      pairs[2 * n + 1] = v;
+      n++;
+    }
+  db_res_finalize (res);
+  if (!ok || err.code != 0)
+    {
+      free (pairs);
+      return NULL;
+    }
+
+  warp_graph_t *g = calloc (1, sizeof (*g));
+
+  if (!g
+      || csr_build (max_id, pairs, n, 0, &g->off, &g->adj) != 0
+      || csr_build (max_id, pairs, n, 1, &g->roff, &g->radj) != 0)
+    {
+      warp_graph_free (g);
+      free (pairs);
+      return NULL;
+    }
+  free (pairs);
+  g->max_id = max_id;
+  g->gen = gen;
+  g->n_edges = (int) n;
+  return g;
+}
+
+
+/* Caller holds g_swap_mu */
+static void
+warp_graph_unref_locked (warp_graph_t *g)
+{
+  if (g && --g->refs == 0)
+    {
+      warp_graph_free (g);
+    }
+}
+
+
+const warp_graph_t *
+warp_graph_acquire (db_t *db)
+{
+  warp_graph_t *g;
+  uint64_t want = atomic_load (&g_want_gen);
+
+  pthread_mutex_lock (&g_swap_mu);
+  g = g_graph;
+  if (g)
+    {
+      g->refs++;
+    }
+  pthread_mutex_unlock (&g_swap_mu);
+
+  if (g && g->gen == want)
+    {
+      return g;
+    }
+
+  /* Stale or missing. With a usable snapshot, only one reader rebuilds and
+     the rest carry on with what they have. */
+  if (g)
+    {
+      if (pthread_mutex_trylock (&g_build_mu) != 0)
+	{
+	  return g;
+	}
+    }
+  else
+    {
+      pthread_mutex_lock (&g_build_mu);
+    }
+
+  want = atomic_load (&g_want_gen);
+  pthread_mutex_lock (&g_swap_mu);
+  warp_graph_t *cur = g_graph;
+  pthread_mutex_unlock (&g_swap_mu);
+
+  if (!cur || cur->gen != want)
+    {
+      warp_graph_t *fresh = db ? warp_graph_load (db, want) : NULL;
+
+      if (fresh)
+	{
+	  fresh->refs = 1;	/* the global pointer's reference */
+	  pthread_mutex_lock (&g_swap_mu);
+	  warp_graph_t *old = g_graph;
+
+	  g_graph = fresh;
+	  warp_graph_unref_locked (old);
+	  pthread_mutex_unlock (&g_swap_mu);
+	  LOGI ("warp_graph: loaded %d sectors, %d warps", fresh->max_id,
+		fresh->n_edges);
+	}
+      else
+	{
+	  LOGE ("warp_graph: failed to load sector_warps");
+	}
+    }
+  pthread_mutex_unlock (&g_build_mu);
+
+  /* Swap our reference for the newest snapshot (may be unchanged) */
+  pthread_mutex_lock (&g_swap_mu);
+  warp_graph_unref_locked (g);
+  g = g_graph;
+  if (g)
+    {
+      g->refs++;
+    }
+  pthread_mutex_unlock (&g_swap_mu);
+  return g;
+}
+
+
+void
+warp_graph_release (const warp_graph_t *g)
+{
+  if (!g)
+    {
+      return;
+    }
+  pthread_mutex_lock (&g_swap_mu);
+  warp_graph_unref_locked ((warp_graph_t *) g);
+  pthread_mutex_unlock (&g_swap_mu);
+}
+
+
+void
+warp_graph_invalidate (void)
+{
+  atomic_fetch_add (&g_want_gen, 1);
+}
+
+
+int
+warp_graph_path (const warp_graph_t *g, int from, int to,
+		 const unsigned char *avoid, int **out_path)
+{
+  if (!g || !out_path || !warp_graph_has_sector (g, from)
+      || !warp_graph_has_sector (g, to))
+    {
+      return -1;
+    }
+  *out_path = NULL;
+  if (avoid && (avoid[from] || avoid[to]))
+    {
+      return -1;
+    }
+
+  size_t N = (size_t) g->max_id + 1;
+  int *prev = malloc (N * sizeof (int));
+  int *queue = malloc (N * sizeof (int));
+
+  if (!prev || !queue)
+    {
+      free (prev);
+      free (queue);
+      return -2;
+    }
+  /* prev doubles as the visited set: -1 = unseen */
+  for (size_t i = 0; i < N; i++)
+    {
+      prev[i] = -1;
+    }
+
+  int qh = 0, qt = 0;
+  int found = (from == to);
+
+  queue[qt++] = from;
+  prev[from] = from;
+  while (!found && qh < qt)
+    {
+      int u = queue[qh++];
+      int deg;
+      const int *nb = warp_graph_neighbours (g, u, &deg);
+
+      for (int i = 0; i < deg; i++)
+	{
+	  int v = nb[i];
+
+	  if (prev[v] != -1 || (avoid && avoid[v]))
+	    {
+	      continue;
+	    }
+	  prev[v] = u;
+	  if (v == to)
+	    {
+	      found = 1;
+	      break;
+	    }
+	  queue[qt++] = v;
+	}
+    }
+
+  if (!found)
+    {
+      free (prev);
+      free (queue);
+      return -1;
+    }
+
+  /* Walk back to count hops, then write the path front to back */
+  int hops = 0;
+
+  for (int cur = to; cur != from; cur = prev[cur])
+    {
+      hops++;
+    }
+
+  int *path = malloc (((size_t) hops + 1) * sizeof (int));
+
+  if (!path)
+    {
+      free (prev);
+      free (queue);
+      return -2;
+    }
+  for (int cur = to, i = hops; i >= 0; cur = prev[cur], i--)
+    {
+      path[i] = cur;
+    }
+  free (prev);
+  free (queue);
+  *out_path = path;
+  return hops;
+}
+
+
+int
+warp_graph_next_hop (const warp_graph_t *g, int start, int goal)
+{
+  if (!g || start == goal || !warp_graph_has_sector (g, start)
+      || !warp_graph_has_sector (g, goal))
+    {
+      return 0;
+    }
+
+  /* Carry the first hop along with each queued sector instead of a parent
+     array, so the visited set can be a bitset */
+  size_t N = (size_t) g->max_id + 1;
+  uint64_t *seen = calloc ((N + 63) / 64, sizeof (uint64_t));
+  int *queue = malloc (N * sizeof (int));
+  int *first = malloc (N * sizeof (int));
+  int hop = 0;
+
+  if (!seen || !queue || !first)
+    {
+      free (seen);
+      free (queue);
+      free (first);
+      return 0;
+    }
+
+  int qh = 0, qt = 0;
+
+  seen[start >> 6] |= 1ULL << (start & 63);
+  queue[qt] = start;
+  first[qt++] = 0;
+  while (!hop && qh < qt)
+    {
+      int u = queue[qh];
+      int via = first[qh++];
+      int deg;
+      const int *nb = warp_graph_neighbours (g, u, &deg);
+
+      for (int i = 0; i < deg; i++)
+	{
+	  int v = nb[i];
+	  uint64_t bit = 1ULL << (v & 63);
+
+	  if (seen[v >> 6] & bit)
+	    {
+	      continue;
+	    }
+	  seen[v >> 6] |= bit;
+	  if (v == goal)
+	    {
+	      hop = via ? via : v;
+	      break;
+	    }
+	  queue[qt] = v;
+	  first[qt++] = via ? via : v;
+	}
+    }
+  free (seen);
+  free (queue);
+  free (first);
+  return hop;
+}
+
+
+int
+warp_graph_hop_table (const warp_graph_t *g, int goal, int *next)
+{
+  size_t N = (size_t) g->max_id + 1;
+
+  memset (next, 0, N * sizeof (int));
+  if (!warp_graph_has_sector (g, goal))
+    {
+      return 0;
+    }
+
+  int *queue = malloc (N * sizeof (int));
+
+  if (!queue)
+    {
+      return -2;
+    }
+
+  /* Reverse BFS from goal: the sector we reach s from is s's next hop.
+     next[] doubles as the visited set; goal marks itself for the walk. */
+  int qh = 0, qt = 0;
+
+  next[goal] = goal;
+  queue[qt++] = goal;
+  while (qh < qt)
+    {
+      int u = queue[qh++];
+      int deg = g->roff[u + 1] - g->roff[u];
+      const int *in = &g->radj[g->roff[u]];
+
+      for (int i = 0; i < deg; i++)
+	{
+	  int s = in[i];
+
+	  if (next[s])
+	    {
+	      continue;
+	    }
+	  next[s] = u;
+	  queue[qt++] = s;
+	}
+    }
+  next[goal] = 0;
+  free (queue);
+  return 0;
+}
+
+
+/* Caller holds g_hops_mu */
+static hops_row_t *
+hops_find_locked (uint64_t gen, int src, int max_hops)
+{
+  for (int i = 0; i < WARP_HOPS_CACHE; i++)
+    {
+      hops_row_t *r = g_hops[i];
+
+      if (r && r->gen == gen && r->src == src && r->max_hops == max_hops)
+	{
+	  r->refs++;
+	  r->used = ++g_hops_tick;
+	  return r;
+	}
+    }
+  return NULL;
+}
+
+
+const warp_hops_t *
+warp_graph_hops_acquire (const warp_graph_t *g, int src, int max_hops)
+{
+  if (!g || !warp_graph_has_sector (g, src))
+    {
+      return NULL;
+    }
+  if (max_hops < 0)
+    {
+      max_hops = 0;
+    }
+  if (max_hops >= WARP_HOPS_NONE)
+    {
+      max_hops = WARP_HOPS_NONE - 1;
+    }
+
+  hops_row_t *r;
+
+  pthread_mutex_lock (&g_hops_mu);
+  r = hops_find_locked (g->gen, src, max_hops);
+  pthread_mutex_unlock (&g_hops_mu);
+  if (r)
+    {
+      return r->d;
+    }
+
+  /* Miss: bounded BFS outside the lock */
+  size_t N = (size_t) g->max_id + 1;
+  int *queue = malloc (N * sizeof (int));
+
+  r = malloc (sizeof (*r) + N * sizeof (warp_hops_t));
+  if (!r || !queue)
+    {
+      free (r);
+      free (queue);
+      return NULL;
+    }
+  r->gen = g->gen;
+  r->src = src;
+  r->max_hops = max_hops;
+  r->refs = 1;
+  r->cached = 0;
+  memset (r->d, 0xFF, N * sizeof (warp_hops_t));
+
+  int qh = 0, qt = 0;
+
+  r->d[src] = 0;
+  queue[qt++] = src;
+  while (qh < qt)
+    {
+      int u = queue[qh++];
+
+      if (r->d[u] >= max_hops)
+	{
+	  continue;
+	}
+
+      int deg;
+      const int *nb = warp_graph_neighbours (g, u, &deg);
+
+      for (int i = 0; i < deg; i++)
+	{
+	  int v = nb[i];
+
+	  if (r->d[v] == WARP_HOPS_NONE)
+	    {
+	      r->d[v] = (warp_hops_t) (r->d[u] + 1);
+	      queue[qt++] = v;
+	    }
+	}
+    }
+  free (queue);
+
+  pthread_mutex_lock (&g_hops_mu);
+  hops_row_t *dup = hops_find_locked (g->gen, src, max_hops);
+
+  if (dup)
+    {
+      pthread_mutex_unlock (&g_hops_mu);
+      free (r);
+      return dup->d;
+    }
+
+  /* Take an empty slot, else the least recently used idle row; rows from
+     an older snapshot go first */
+  int victim = -1;
+
+  for (int i = 0; i < WARP_HOPS_CACHE; i++)
+    {
+      hops_row_t *c = g_hops[i];
+
+      if (!c)
+	{
+	  victim = i;
+	  break;
+	}
+      if (c->refs > 0)
+	{
+	  continue;
+	}
+      if (victim < 0
+	  || (c->gen != g->gen && g_hops[victim]->gen == g->gen)
+	  || ((c->gen != g->gen) == (g_hops[victim]->gen != g->gen)
+	      && c->used < g_hops[victim]->used))
+	{
+	  victim = i;
+	}
+    }
+  if (victim >= 0)
+    {
+      free (g_hops[victim]);
+      r->cached = 1;
+      r->used = ++g_hops_tick;
+      g_hops[victim] = r;
+    }
+  pthread_mutex_unlock (&g_hops_mu);
+  return r->d;
+}
+
+
+void
+warp_graph_hops_release (const warp_hops_t *row)
+{
+  if (!row)
+    {
+      return;
+    }
+
+  hops_row_t *r =
+    (hops_row_t *) ((char *) row - offsetof (hops_row_t, d));
+
+  pthread_mutex_lock (&g_hops_mu);
+  if (--r->refs == 0 && !r->cached)
+    {
+      free (r);
+    }
+  pthread_mutex_unlock (&g_hops_mu);
+}
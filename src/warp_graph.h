@@ -0,0 +1,89 @@
+#ifndef WARP_GRAPH_H
+#define WARP_GRAPH_H
+#include <stdint.h>
+#include "db/db_api.h"
+
+/*
+ * Process-wide warp graph in compressed sparse row form.
+ *
+ * sector_warps is loaded once into two flat arrays: the neighbours of sector
+ * u are adj[off[u]] .. adj[off[u + 1] - 1], sorted ascending. Sector ids run
+ * 1..max_id; off has max_id + 2 entries. roff/radj hold the reverse graph
+ * (in-neighbours) in the same layout.
+ *
+ * Readers take a reference with warp_graph_acquire() and drop it with
+ * warp_graph_release(); a snapshot never changes while referenced. Writers
+ * that change sector_warps register db_on_commit (db, warp_graph_invalidate)
+ * so it runs once the change is committed (a rebuild before that would
+ * reload the old rows); the next acquire builds a fresh snapshot and swaps
+ * the global pointer, and the old one is freed when its last reader lets
+ * go. Readers that arrive while a rebuild is running keep using the
+ * previous snapshot.
+ */
+typedef struct warp_graph_s
+{
+  int max_id;
+  int n_edges;
+  int *off;
+  int *adj;
+  int *roff;
+  int *radj;
+  uint64_t gen;			/* invalidation generation it was built for */
+  int refs;			/* guarded by the swap lock */
+} warp_graph_t;
+
+/* NULL if the graph cannot be loaded. */
+const warp_graph_t *warp_graph_acquire (db_t * db);
+void warp_graph_release (const warp_graph_t * g);
+void warp_graph_invalidate (void);
+
+static inline int
+warp_graph_has_sector (const warp_graph_t *g, int sector_id)
+{
+  return sector_id > 0 && sector_id <= g->max_id;
+}
+
+/* Out-neighbours of u; *n receives the count. u must be a valid sector. */
+static inline const int *
+warp_graph_neighbours (const warp_graph_t *g, int u, int *n)
+{
+  *n = g->off[u + 1] - g->off[u];
+  return &g->adj[g->off[u]];
+}
+
+/*
+ * Breadth-first shortest path from -> to, skipping sectors flagged in avoid
+ * (max_id + 1 bytes, may be NULL). On success returns the hop count and
+ * stores a malloc'd array of hops + 1 sector ids (from first) in *out_path.
+ * Returns -1 if unreachable or on bad input, -2 if out of memory.
+ */
+int warp_graph_path (const warp_graph_t * g, int from, int to,
+		     const unsigned char *avoid, int **out_path);
+
+/* First hop of a shortest path start -> goal, 0 if unreachable or equal. */
+int warp_graph_next_hop (const warp_graph_t * g, int start, int goal);
+
+/*
+ * For every sector s, next[s] = first hop of a shortest path s -> goal
+ * (0 if unreachable, and for goal itself). next has max_id + 1 entries.
+ * One reverse BFS; worth it for goals many movers head to. Returns 0, or -2
+ * if out of memory.
+ */
+int warp_graph_hop_table (const warp_graph_t * g, int goal, int *next);
+
+/*
+ * Bounded hop distances from src: row[s] is the hop count of a shortest
+ * src -> s path if it is at most max_hops, else WARP_HOPS_NONE. Rows have
+ * max_id + 1 entries and come from a small LRU shared by all callers
+ * (keyed by snapshot, src and max_hops), so repeated queries from popular
+ * sectors are free. Release every row acquired; NULL if src is not a
+ * sector or out of memory.
+ */
+typedef uint16_t warp_hops_t;
+#define WARP_HOPS_NONE 0xFFFF
+
+const warp_hops_t *warp_graph_hops_acquire (const warp_graph_t * g, int src,
+					    int max_hops);
+void warp_graph_hops_release (const warp_hops_t * row);
+
+#endif /* WARP_GRAPH_H */
@@ -0,0 +1,91 @@
+import os
+import sys
+from twclient import TWClient, check
+
+# Configuration
+HOST = os.getenv("HOST", "127.0.0.1")
+PORT = int(os.getenv("PORT", 1234))
+
+def warp_to(client: TWClient, target: int) -> bool:
+    resp = client.request("player.my_info")
+    current = resp["data"]["player"]["sector"]
+    if current == target:
+        return True
+    resp = client.request("move.pathfind", {"from": current, "to": target})
+    if resp.get("status") != "ok":
+        return False
+    for step in resp["data"]["steps"][1:]:
+        if client.request("move.warp", {"to_sector_id": step}).get("status") != "ok":
+            return False
+    return True
+
+def pick_exit(client: TWClient) -> int:
+    # A Federation neighbour of sector 1, away from the rigged hazards in 2 and 3
+    resp = client.request("move.describe_sector", {"sector_id": 1})
+    adj = sorted(w["to_sector"] for w in resp["data"].get("adjacent_sectors", []))
+    fed = [s for s in adj if 4 <= s <= 10]
+    rest = [s for s in adj if s not in (2, 3)]
+    return (fed or rest or [0])[0]
+
+def chat_counts(buyer: TWClient, conns, text: str):
+    if buyer.request("chat.send", {"to_player": "reg_listener", "message": text}).get("status") != "ok":
+        return [-1] * len(conns)
+    return [len([e for e in c.collect("chat.private_v1")
+                 if e.get("data", {}).get("message") == text]) for c in conns]
+
+def round_counts(buyer: TWClient, conns):
+    if buyer.request("tavern.round.buy").get("status") != "ok":
+        return [-1] * len(conns)
+    return [len([e for e in c.collect("tavern.round.bought")
+                 if e.get("data", {}).get("sector_id") == 1]) for c in conns]
+
+def test_client_registry():
+    # reg_listener is logged in twice; reg_buyer whispers to it and buys
+    # rounds in the sector 1 tavern
+    l1 = TWClient(host=HOST, port=PORT)
+    l2 = TWClient(host=HOST, port=PORT)
+    buyer = TWClient(host=HOST, port=PORT)
+    try:
+        for c in (l1, l2, buyer):
+            c.connect()
+        if not l1.login("reg_listener", "password"): return False
+        if not l2.login("reg_listener", "password"): return False
+        if not buyer.login("reg_buyer", "password"): return False
+        if not warp_to(l1, 1) or not warp_to(buyer, 1): return False
+        # l2 has to learn where the player is before it can be filed there
+        l2.request("player.my_info")
+
+        ok = True
+        ok &= check(chat_counts(buyer, (l1, l2), "registry 1") == [1, 1],
+                    "whisper reaches both connections of the player")
+        ok &= check(round_counts(buyer, (l1, l2)) == [1, 1],
+                    "sector event reaches both connections in sector 1")
+
+        exit_sector = pick_exit(l1)
+        if not check(exit_sector > 0 and warp_to(l1, exit_sector),
+                     f"warp out to sector {exit_sector}"):
+            return False
+        # l2 sends nothing here: the warp on l1 has to refile it as well
+        ok &= check(round_counts(buyer, (l1, l2)) == [0, 0],
+                    "sector 1 event no longer reaches either connection")
+        ok &= check(chat_counts(buyer, (l1, l2), "registry 2") == [1, 1],
+                    "whisper still reaches both connections after the move")
+
+        if not check(warp_to(l1, 1), "warp back to sector 1"):
+            return False
+        ok &= check(round_counts(buyer, (l1, l2)) == [1, 1],
+                    "sector event reaches both connections again")
+        return ok
+
+    except Exception as e:
+        print(f"Error: {e}")
+        return False
+    finally:
+        l1.close()
+        l2.close()
+        buyer.close()
+
+if __name__ == "__main__":
+    if not test_client_registry():
+        sys.exit(1)
+    print("E2E Client Registry Test Passed.")
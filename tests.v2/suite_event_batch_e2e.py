@@ -0,0 +1,91 @@
+import os
+import sys
+import uuid
+from twclient import TWClient, check
+
+# Configuration
+HOST = os.getenv("HOST", "127.0.0.1")
+PORT = int(os.getenv("PORT", 1234))
+
+def whisper_burst(sender: TWClient, texts):
+    # Sent back to back so they land in one batching window
+    ids = []
+    for text in texts:
+        rid = str(uuid.uuid4())
+        ids.append(rid)
+        sender.send_json({"id": rid, "command": "chat.send",
+                          "data": {"to_player": "batch_listener", "message": text}})
+    pending = set(ids)
+    while pending:
+        resp = sender.recv_json()
+        if not resp:
+            raise ConnectionError("Connection closed")
+        if resp.get("reply_to") in pending:
+            if resp.get("status") != "ok":
+                return False
+            pending.discard(resp.get("reply_to"))
+    return True
+
+def test_event_batch():
+    # batch_listener is logged in twice, once with events.batch_v1 and once
+    # without; batch_sender whispers to it
+    batched = TWClient(host=HOST, port=PORT)
+    plain = TWClient(host=HOST, port=PORT)
+    sender = TWClient(host=HOST, port=PORT)
+    kinds = {"events.batch_v1", "chat.private_v1"}
+    try:
+        for c in (batched, plain, sender):
+            c.connect()
+        hello = batched.request("system.hello",
+                                {"client_version": "0.0.0", "capabilities": ["events.batch_v1"]})
+        window = hello.get("data", {}).get("limits", {}).get("event_batch_ms", 0)
+        if not check(window > 0, f"batching accepted ({window} ms window)"):
+            print("  (set event_batch_ms in the config table; test_rig.json does)")
+            return False
+        if not batched.login("batch_listener", "password"): return False
+        if not plain.login("batch_listener", "password"): return False
+        if not sender.login("batch_sender", "password"): return False
+
+        ok = True
+        texts = [f"batch {i}" for i in range(3)]
+        if not check(whisper_burst(sender, texts), "three whispers sent"):
+            return False
+
+        frames = batched.collect(kinds)
+        ok &= check(len(frames) == 1 and frames[0]["type"] == "events.batch_v1",
+                    "batching connection gets one events.batch_v1 frame")
+        if frames and frames[0]["type"] == "events.batch_v1":
+            data = frames[0].get("data", {})
+            events = data.get("events", [])
+            ok &= check([e.get("type") for e in events] == ["chat.private_v1"] * 3,
+                        "frame holds the three events")
+            ok &= check([e.get("data", {}).get("message") for e in events] == texts,
+                        "events are in publish order")
+            ok &= check(data.get("collapsed") == 0,
+                        "whispers are not state events: nothing collapsed")
+
+        frames = plain.collect(kinds)
+        ok &= check([f["type"] for f in frames] == ["chat.private_v1"] * 3,
+                    "connection without the capability gets plain frames")
+
+        if not check(whisper_burst(sender, ["batch lone"]), "one whisper sent"):
+            return False
+        frames = batched.collect(kinds)
+        ok &= check(len(frames) == 1 and frames[0]["type"] == "chat.private_v1"
+                    and frames[0].get("data", {}).get("message") == "batch lone",
+                    "a lone event in a window goes out unbatched")
+        plain.collect(kinds, 0.5)
+        return ok
+
+    except Exception as e:
+        print(f"Error: {e}")
+        return False
+    finally:
+        batched.close()
+        plain.close()
+        sender.close()
+
+if __name__ == "__main__":
+    if not test_event_batch():
+        sys.exit(1)
+    print("E2E Event Batch Test Passed.")
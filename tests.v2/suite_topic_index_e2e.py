@@ -0,0 +1,57 @@
+import os
+import sys
+from twclient import TWClient, check
+
+# Configuration
+HOST = os.getenv("HOST", "127.0.0.1")
+PORT = int(os.getenv("PORT", 1234))
+
+def round_seen_by(actor: TWClient, obs: TWClient) -> int:
+    resp = actor.request("tavern.round.buy")
+    if resp.get("status") != "ok":
+        print(f"tavern.round.buy failed: {resp}")
+        return -1
+    return len([e for e in obs.collect("tavern.round.bought")
+                if e.get("data", {}).get("sector_id") == 1])
+
+def test_topic_index():
+    # topic_observer sits in sector 2 and only hears sector 1 through its
+    # subscriptions; topic_actor buys rounds in the sector 1 tavern
+    obs = TWClient(host=HOST, port=PORT)
+    act = TWClient(host=HOST, port=PORT)
+    try:
+        obs.connect()
+        act.connect()
+        if not obs.login("topic_observer", "password"): return False
+        if not act.login("topic_actor", "password"): return False
+
+        ok = True
+        ok &= check(obs.request("subscribe.add", {"topic": "sector.1"}).get("status") == "ok",
+                    "subscribe exact sector.1")
+        ok &= check(obs.request("subscribe.add", {"topic": "Sector.*"}).get("status") == "ok",
+                    "subscribe wildcard Sector.*")
+        ok &= check(round_seen_by(act, obs) == 1,
+                    "exact and wildcard match: event delivered once")
+
+        ok &= check(obs.request("subscribe.remove", {"topic": "SECTOR.1"}).get("status") == "ok",
+                    "remove exact topic in upper case")
+        ok &= check(round_seen_by(act, obs) == 1,
+                    "wildcard alone still matches")
+
+        ok &= check(obs.request("subscribe.remove", {"topic": "sector.*"}).get("status") == "ok",
+                    "remove wildcard")
+        ok &= check(round_seen_by(act, obs) == 0,
+                    "no subscription left: nothing delivered")
+        return ok
+
+    except Exception as e:
+        print(f"Error: {e}")
+        return False
+    finally:
+        obs.close()
+        act.close()
+
+if __name__ == "__main__":
+    if not test_topic_index():
+        sys.exit(1)
+    print("E2E Topic Index Test Passed.")
@@ -89,6 +89,40 @@ class TWClient:
             return resp
         raise TimeoutError("Timed out waiting for non-notice response")
 
+    def request(self, command: str, data: Optional[Dict[str, Any]] = None) -> Dict[str, Any]:
+        """Sends a command with an id and returns the reply to it, skipping pushed events."""
+        rid = str(uuid.uuid4())
+        msg = {"id": rid, "command": command}
+        if data is not None:
+            msg["data"] = data
+        self.send_json(msg)
+        while True:
+            resp = self.recv_json()
+            if not resp:
+                raise ConnectionError("Connection closed")
+            if resp.get("reply_to") == rid:
+                return resp
+
+    def collect(self, types, seconds: float = 1.5) -> List[Dict[str, Any]]:
+        """Gathers pushed events of one type (or any of a set of types) for a while."""
+        if isinstance(types, str):
+            types = (types,)
+        seen = []
+        deadline = time.time() + seconds
+        while True:
+            left = deadline - time.time()
+            if left <= 0:
+                break
+            self.sock.settimeout(left)
+            try:
+                evt = self.recv_json()
+            except socket.timeout:
+                break
+            if evt and evt.get("type") in types:
+                seen.append(evt)
+        self.sock.settimeout(self.timeout)
+        return seen
+
     def register(self, username: str, password: str, fail_if_exists: bool = False) -> bool:
         """Registers a user. Returns True if successful or already exists (unless fail_if_exists)."""
         cmd = {
@@ -131,3 +165,9 @@ class TWClient:
         self.send_json(cmd)
         resp = self.recv_next_non_notice()
         return resp.get("status") == "ok"
+
+
+def check(ok: bool, what: str) -> bool:
+    """Prints one step of an e2e suite and passes its result through."""
+    print(f"  {what}: {'ok' if ok else 'FAIL'}")
+    return ok
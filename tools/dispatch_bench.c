@@ -0,0 +1,153 @@
+/**
+ * @file dispatch_bench.c
+ * @brief Command-name lookup cost: linear registry scan vs cmd_index.
+ *
+ * Loads the published command list (system.cmd_list snapshot), then times
+ * the lookup server_dispatch_command() performs for every request: the old
+ * strcasecmp walk over the registry against the hashed cmd_index. Queries
+ * cycle through every command with mixed case, plus a share of unknown
+ * names, which were the worst case for the scan.
+ *
+ * Build: gcc -O2 -I../src -o dispatch_bench dispatch_bench.c ../src/cmd_index.c -ljansson
+ * Run:   ./dispatch_bench [-f ../published_commands.json] [-n iterations] [-m miss_pct]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <jansson.h>
+#include "cmd_index.h"
+
+static double
+now_sec (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static const char *
+linear_find (const char **names, size_t n, const char *q)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+      if (strcasecmp (q, names[i]) == 0)
+	{
+	  return names[i];
+	}
+    }
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *path = "../published_commands.json";
+  long iters = 2000000;
+  int miss_pct = 5;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "f:n:m:")) != -1)
+    {
+      switch (opt)
+	{
+	case 'f':
+	  path = optarg;
+	  break;
+	case 'n':
+	  iters = atol (optarg);
+	  break;
+	case 'm':
+	  miss_pct = atoi (optarg);
+	  break;
+	default:
+	  fprintf (stderr, "usage: %s [-f cmd_list.json] [-n iters] [-m miss_pct]\n", argv[0]);
+	  return 2;
+	}
+    }
+
+  json_error_t jerr;
+  json_t *root = json_load_file (path, 0, &jerr);
+  json_t *cmds = root ? json_object_get (json_object_get (root, "data"), "commands") : NULL;
+
+  if (!json_is_array (cmds) || json_array_size (cmds) == 0)
+    {
+      fprintf (stderr, "cannot read command list from %s\n", path);
+      return 1;
+    }
+
+  size_t n = json_array_size (cmds);
+  const char **names = calloc (n, sizeof (*names));
+  cmd_index_t *ix = cmd_index_new (n);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      names[i] = json_string_value (json_object_get (json_array_get (cmds, i), "cmd"));
+      cmd_index_put (ix, names[i], (void *) names[i]);
+    }
+
+  /* Query set: every name in upper case (forces case folding) plus misses */
+  size_t nq = n + (n * (size_t) miss_pct) / 100;
+  char **queries = calloc (nq, sizeof (*queries));
+
+  for (size_t i = 0; i < nq; i++)
+    {
+      if (i < n)
+	{
+	  queries[i] = strdup (names[i]);
+	  for (char *p = queries[i]; *p; p++)
+	    {
+	      *p = (char) toupper ((unsigned char) *p);
+	    }
+	}
+      else
+	{
+	  char buf[64];
+	  snprintf (buf, sizeof (buf), "unknown.command_%zu", i);
+	  queries[i] = strdup (buf);
+	}
+    }
+
+  volatile size_t hits = 0;
+  double t0 = now_sec ();
+
+  for (long k = 0; k < iters; k++)
+    {
+      if (linear_find (names, n, queries[k % nq]))
+	{
+	  hits++;
+	}
+    }
+  double t_lin = now_sec () - t0;
+  size_t lin_hits = hits;
+
+  hits = 0;
+  t0 = now_sec ();
+  for (long k = 0; k < iters; k++)
+    {
+      if (cmd_index_get (ix, queries[k % nq]))
+	{
+	  hits++;
+	}
+    }
+  double t_ix = now_sec () - t0;
+
+  printf ("commands=%zu queries=%zu (miss %d%%) iterations=%ld\n", n, nq, miss_pct, iters);
+  printf ("linear scan : %8.1f ns/lookup  (hits %zu)\n", t_lin * 1e9 / (double) iters, lin_hits);
+  printf ("cmd_index   : %8.1f ns/lookup  (hits %zu)\n", t_ix * 1e9 / (double) iters, (size_t) hits);
+  printf ("speedup     : %8.1fx\n", t_ix > 0 ? t_lin / t_ix : 0.0);
+
+  for (size_t i = 0; i < nq; i++)
+    {
+      free (queries[i]);
+    }
+  free (queries);
+  free (names);
+  cmd_index_free (ix);
+  json_decref (root);
+  return (lin_hits == hits) ? 0 : 1;
+}
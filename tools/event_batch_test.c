@@ -0,0 +1,195 @@
+/**
+ * @file event_batch_test.c
+ * @brief Checks events.batch_v1 framing and state-event collapse.
+ *
+ * Links event_batch.c on its own; rendering and sending are replaced by
+ * stubs that keep the last frame, so the frames can be inspected without a
+ * socket.
+ *
+ * Build: gcc -D_GNU_SOURCE -I.. -I../src -o event_batch_test event_batch_test.c \
+ *          ../src/event_batch.c ../src/server_log.c -ljansson -lpthread
+ * Run:   ./event_batch_test   (exit status 0 = pass)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <jansson.h>
+#include "event_batch.h"
+#include "server_envelope.h"
+
+#define WINDOW_MS 20
+
+struct reactor_buf_s
+{
+  json_t *frame;
+};
+
+static json_t *g_last;		/* last frame "sent" */
+static int g_frames;
+static int g_failed;
+
+
+reactor_buf_t *
+render_enveloped_ok (const char *type, json_t *data)
+{
+  reactor_buf_t *b = malloc (sizeof (*b));
+
+  b->frame = json_pack ("{s:s, s:O}", "type", type, "data", data);
+  return b;
+}
+
+
+void
+send_all_rendered (int fd, reactor_buf_t *b)
+{
+  (void) fd;
+  json_decref (g_last);
+  g_last = json_incref (b->frame);
+  g_frames++;
+}
+
+
+void
+reactor_buf_release (reactor_buf_t *b)
+{
+  if (b)
+    {
+      json_decref (b->frame);
+      free (b);
+    }
+}
+
+
+static void
+check (int ok, const char *what)
+{
+  printf ("%-56s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok)
+    {
+      g_failed++;
+    }
+}
+
+
+static void
+push (client_ctx_t *c, const char *type, const char *fmt, int a, int b)
+{
+  json_t *data = json_pack (fmt, "npc_id", a, "sector_id", b);
+
+  event_batch_push (c, type, data);
+  json_decref (data);
+}
+
+
+/* Waits out the window and returns the frame it produced (borrowed) */
+static json_t *
+flush (void)
+{
+  int before = g_frames;
+
+  usleep ((WINDOW_MS + 5) * 1000);
+  event_batch_flush_due ();
+  return g_frames > before ? g_last : NULL;
+}
+
+
+static size_t
+batch_size (json_t *frame)
+{
+  return json_array_size (json_object_get (json_object_get (frame, "data"),
+					   "events"));
+}
+
+
+static json_int_t
+batch_collapsed (json_t *frame)
+{
+  return json_integer_value (json_object_get
+			     (json_object_get (frame, "data"), "collapsed"));
+}
+
+
+int
+main (void)
+{
+  client_ctx_t c;
+  json_t *f;
+
+  memset (&c, 0, sizeof (c));
+  c.fd = -1;
+  check (!event_batch_enable (&c), "off until configured");
+  event_batch_configure (WINDOW_MS, 8);
+  check (event_batch_enable (&c), "client opts in");
+
+  /* Framing: several events in one events.batch_v1, in publish order */
+  push (&c, "combat.hit", "{s:i, s:i}", 0, 42);
+  push (&c, "sector.notice", "{s:i, s:i}", 0, 42);
+  event_batch_flush_due ();
+  check (g_frames == 0, "nothing sent before the window ends");
+  f = flush ();
+  check (f && strcmp (json_string_value (json_object_get (f, "type")),
+		      "events.batch_v1") == 0, "one events.batch_v1 frame");
+  check (f && batch_size (f) == 2, "both events in it");
+  check (f && strcmp (json_string_value
+		      (json_object_get
+		       (json_array_get
+			(json_object_get (json_object_get (f, "data"),
+					  "events"), 0), "type")),
+		      "combat.hit") == 0, "in publish order");
+
+  /* A lone event goes out as an ordinary frame */
+  push (&c, "combat.hit", "{s:i, s:i}", 0, 42);
+  f = flush ();
+  check (f && strcmp (json_string_value (json_object_get (f, "type")),
+		      "combat.hit") == 0, "single event sent unbatched");
+
+  /* Two moves of one NPC collapse to the latest */
+  push (&c, "npc.move.v1", "{s:i, s:i}", 7, 10);
+  push (&c, "npc.move.v1", "{s:i, s:i}", 7, 11);
+  push (&c, "combat.hit", "{s:i, s:i}", 0, 42);
+  f = flush ();
+  check (f && batch_size (f) == 2 && batch_collapsed (f) == 1,
+	 "two moves of one npc collapse");
+  check (f && json_integer_value
+	 (json_object_get
+	  (json_object_get
+	   (json_array_get
+	    (json_object_get (json_object_get (f, "data"), "events"), 0),
+	    "data"), "sector_id")) == 11, "the latest move is kept");
+
+  /* Moves of two NPCs do not */
+  push (&c, "npc.move.v1", "{s:i, s:i}", 7, 10);
+  push (&c, "npc.move.v1", "{s:i, s:i}", 8, 10);
+  f = flush ();
+  check (f && batch_size (f) == 2 && batch_collapsed (f) == 0,
+	 "moves of two npcs are both sent");
+
+  /* The ISS is one entity: its type alone decides */
+  push (&c, "iss.move", "{s:i, s:i}", 0, 3);
+  push (&c, "iss.move", "{s:i, s:i}", 0, 4);
+  push (&c, "combat.hit", "{s:i, s:i}", 0, 42);
+  f = flush ();
+  check (f && batch_size (f) == 2 && batch_collapsed (f) == 1,
+	 "iss.move collapses on type");
+
+  /* A full queue is sent without waiting for the window */
+  int before = g_frames;
+
+  for (int i = 0; i < 8; i++)
+    {
+      push (&c, "combat.hit", "{s:i, s:i}", 0, i);
+    }
+  check (g_frames == before + 1 && batch_size (g_last) == 8,
+	 "full batch sent at max_events");
+
+  event_batch_drop (&c);
+  json_t *d = json_object ();
+
+  check (!event_batch_push (&c, "combat.hit", d), "dropped client no longer batches");
+  json_decref (d);
+  json_decref (g_last);
+  printf ("%s\n", g_failed ? "FAILED" : "PASSED");
+  return g_failed ? 1 : 0;
+}
@@ -0,0 +1,368 @@
+/**
+ * @file pg_stress_bench.c
+ * @brief Multi-threaded PostgreSQL driver throughput benchmark.
+ *
+ * Each worker thread opens its own db_t (as game_db_get_handle() does for
+ * server threads) and runs a mix of trade.buy-shaped and move.warp-shaped
+ * transactions against a populated universe. Every transaction is rolled
+ * back, so the benchmark leaves the game state untouched.
+ *
+ * The run is repeated for 1, 2, 4, ... up to -t threads so scaling can be
+ * read straight off the output. Pass -s to force the legacy process-wide
+ * serialization and compare.
+ *
+ * Build: gcc -D_GNU_SOURCE -DDB_BACKEND_PG -I../src -I../src/db -I/usr/include/postgresql \
+ *          -o pg_stress_bench pg_stress_bench.c ../src/db/db_api.c ../src/db/db_stats.c \
+ *          ../src/db/sql_driver.c ../src/db/pg/db_pg.c ../src/db/mysql/db_mysql.c \
+ *          ../src/server_log.c -lpq -ljansson -lpthread
+ * Run:   ./pg_stress_bench -c "dbname=twclone" -t 16 -d 5 -w 50
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "db/db_api.h"
+
+#define MAX_SAMPLES 1024
+
+typedef struct
+{
+  int64_t a;
+  int64_t b;
+  int64_t c;
+} sample_t;
+
+static sample_t g_warps[MAX_SAMPLES];	/* from, to, ship */
+static int g_n_warps = 0;
+static sample_t g_stock[MAX_SAMPLES];	/* port_id, player_id, unused */
+static char g_stock_code[MAX_SAMPLES][16];
+static int g_n_stock = 0;
+
+static const char *g_conninfo = "dbname=twclone";
+static bool g_serialize = false;
+static int g_warp_pct = 50;
+static atomic_bool g_stop;
+static atomic_int_fast64_t g_ops;
+static atomic_int_fast64_t g_errors;
+
+
+static db_t *
+bench_open (void)
+{
+  db_config_t cfg = { 0 };
+  db_error_t err = { 0 };
+
+  cfg.backend = DB_BACKEND_POSTGRES;
+  cfg.pg_conninfo = g_conninfo;
+  cfg.pg_serialize = g_serialize;
+  db_t *db = db_open (&cfg, &err);
+  if (!db)
+    {
+      fprintf (stderr, "db_open failed: %s\n", err.message);
+    }
+  return db;
+}
+
+
+static int
+load_samples (db_t *db)
+{
+  db_error_t err;
+  db_res_t *res = NULL;
+
+  if (db_query (db,
+		"SELECT w.from_sector, w.to_sector, COALESCE(p.ship_id, 0) "
+		"FROM sector_warps w "
+		"JOIN players p ON p.sector_id = w.from_sector "
+		"WHERE p.ship_id IS NOT NULL LIMIT 1024",
+		NULL, 0, &res, &err))
+    {
+      while (g_n_warps < MAX_SAMPLES && db_res_step (res, &err))
+	{
+	  g_warps[g_n_warps].a = db_res_col_i64 (res, 0, &err);
+	  g_warps[g_n_warps].b = db_res_col_i64 (res, 1, &err);
+	  g_warps[g_n_warps].c = db_res_col_i64 (res, 2, &err);
+	  g_n_warps++;
+	}
+      db_res_finalize (res);
+    }
+
+  if (g_n_warps == 0 && db_query (db,
+				  "SELECT from_sector, to_sector, 0 FROM sector_warps LIMIT 1024",
+				  NULL, 0, &res, &err))
+    {
+      while (g_n_warps < MAX_SAMPLES && db_res_step (res, &err))
+	{
+	  g_warps[g_n_warps].a = db_res_col_i64 (res, 0, &err);
+	  g_warps[g_n_warps].b = db_res_col_i64 (res, 1, &err);
+	  g_warps[g_n_warps].c = 0;
+	  g_n_warps++;
+	}
+      db_res_finalize (res);
+    }
+
+  if (db_query (db,
+		"SELECT es.entity_id, es.commodity_code, "
+		"       (SELECT MIN(player_id) FROM players) "
+		"FROM entity_stock es WHERE es.entity_type = 'port' LIMIT 1024",
+		NULL, 0, &res, &err))
+    {
+      while (g_n_stock < MAX_SAMPLES && db_res_step (res, &err))
+	{
+	  const char *code = db_res_col_text (res, 1, &err);
+
+	  g_stock[g_n_stock].a = db_res_col_i64 (res, 0, &err);
+	  g_stock[g_n_stock].b = db_res_col_i64 (res, 2, &err);
+	  snprintf (g_stock_code[g_n_stock], sizeof (g_stock_code[0]), "%s",
+		    code ? code : "");
+	  g_n_stock++;
+	}
+      db_res_finalize (res);
+    }
+
+  if (g_n_warps == 0 && g_n_stock == 0)
+    {
+      fprintf (stderr, "No warps or port stock found; run bigbang first.\n");
+      return -1;
+    }
+  return 0;
+}
+
+
+/* move.warp shape: warp check, turn burn, ship + player relocation, visit. */
+static bool
+op_warp (db_t *db, unsigned *seed)
+{
+  db_error_t err;
+  db_res_t *res = NULL;
+  const sample_t *w = &g_warps[rand_r (seed) % g_n_warps];
+  bool ok = false;
+
+  if (!db_tx_begin (db, DB_TX_DEFAULT, &err))
+    {
+      return false;
+    }
+
+  db_bind_t pw[] = { db_bind_i64 (w->a), db_bind_i64 (w->b) };
+  if (!db_query (db,
+		 "SELECT 1 FROM sector_warps WHERE from_sector = $1 AND to_sector = $2",
+		 pw, 2, &res, &err))
+    {
+      goto done;
+    }
+  db_res_finalize (res);
+
+  if (w->c > 0)
+    {
+      db_bind_t ps[] = { db_bind_i64 (w->b), db_bind_i64 (w->c) };
+      if (!db_exec (db, "UPDATE ships SET sector_id = $1 WHERE ship_id = $2",
+		    ps, 2, &err))
+	{
+	  goto done;
+	}
+      if (!db_exec (db,
+		    "UPDATE players SET sector_id = $1 WHERE ship_id = $2",
+		    ps, 2, &err))
+	{
+	  goto done;
+	}
+    }
+
+  db_bind_t pn[] = { db_bind_i64 (w->b) };
+  if (!db_query (db,
+		 "SELECT s.sector_id, s.name, "
+		 "       (SELECT COUNT(*) FROM sector_warps WHERE from_sector = s.sector_id) "
+		 "FROM sectors s WHERE s.sector_id = $1", pn, 1, &res, &err))
+    {
+      goto done;
+    }
+  while (db_res_step (res, &err))
+    {
+    }
+  db_res_finalize (res);
+  ok = true;
+
+done:
+  db_tx_rollback (db, &err);
+  return ok;
+}
+
+
+/* trade.buy shape: locked stock read, stock decrement, credit debit. */
+static bool
+op_trade (db_t *db, unsigned *seed)
+{
+  db_error_t err;
+  db_res_t *res = NULL;
+  int idx = rand_r (seed) % g_n_stock;
+  const sample_t *s = &g_stock[idx];
+  bool ok = false;
+
+  if (!db_tx_begin (db, DB_TX_DEFAULT, &err))
+    {
+      return false;
+    }
+
+  db_bind_t pk[] = { db_bind_i64 (s->a), db_bind_text (g_stock_code[idx]) };
+  if (!db_query (db,
+		 "SELECT quantity, price FROM entity_stock "
+		 "WHERE entity_type = 'port' AND entity_id = $1 AND commodity_code = $2 "
+		 "FOR UPDATE", pk, 2, &res, &err))
+    {
+      goto done;
+    }
+  db_res_finalize (res);
+
+  if (!db_exec (db,
+		"UPDATE entity_stock SET quantity = GREATEST(quantity - 1, 0) "
+		"WHERE entity_type = 'port' AND entity_id = $1 AND commodity_code = $2",
+		pk, 2, &err))
+    {
+      goto done;
+    }
+
+  db_bind_t pp[] = { db_bind_i64 (s->b) };
+  if (!db_exec (db,
+		"UPDATE players SET credits = credits - 1 WHERE player_id = $1",
+		pp, 1, &err))
+    {
+      goto done;
+    }
+  ok = true;
+
+done:
+  db_tx_rollback (db, &err);
+  return ok;
+}
+
+
+static void *
+worker (void *arg)
+{
+  unsigned seed = (unsigned) (uintptr_t) arg ^ (unsigned) time (NULL);
+  db_t *db = bench_open ();
+
+  if (!db)
+    {
+      atomic_fetch_add (&g_errors, 1);
+      return NULL;
+    }
+  while (!atomic_load (&g_stop))
+    {
+      bool warp = g_n_stock == 0
+	|| (g_n_warps > 0 && (int) (rand_r (&seed) % 100) < g_warp_pct);
+      bool ok = warp ? op_warp (db, &seed) : op_trade (db, &seed);
+
+      atomic_fetch_add (ok ? &g_ops : &g_errors, 1);
+    }
+  db_close (db);
+  return NULL;
+}
+
+
+static double
+run_round (int n_threads, int seconds)
+{
+  pthread_t *th = calloc ((size_t) n_threads, sizeof (*th));
+  struct timespec t0, t1;
+
+  atomic_store (&g_stop, false);
+  atomic_store (&g_ops, 0);
+  atomic_store (&g_errors, 0);
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < n_threads; i++)
+    {
+      pthread_create (&th[i], NULL, worker, (void *) (uintptr_t) (i + 1));
+    }
+  sleep ((unsigned) seconds);
+  atomic_store (&g_stop, true);
+  for (int i = 0; i < n_threads; i++)
+    {
+      pthread_join (th[i], NULL);
+    }
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  free (th);
+
+  double secs = (double) (t1.tv_sec - t0.tv_sec)
+    + (double) (t1.tv_nsec - t0.tv_nsec) / 1e9;
+  return (double) atomic_load (&g_ops) / secs;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int max_threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  int seconds = 5;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "c:t:d:w:s")) != -1)
+    {
+      switch (opt)
+	{
+	case 'c':
+	  g_conninfo = optarg;
+	  break;
+	case 't':
+	  max_threads = atoi (optarg);
+	  break;
+	case 'd':
+	  seconds = atoi (optarg);
+	  break;
+	case 'w':
+	  g_warp_pct = atoi (optarg);
+	  break;
+	case 's':
+	  g_serialize = true;
+	  break;
+	default:
+	  fprintf (stderr,
+		   "usage: %s [-c conninfo] [-t max_threads] [-d seconds] "
+		   "[-w warp_pct] [-s]\n", argv[0]);
+	  return 2;
+	}
+    }
+  if (max_threads < 1)
+    {
+      max_threads = 1;
+    }
+
+  db_t *db = bench_open ();
+  if (!db)
+    {
+      return 1;
+    }
+  int rc = load_samples (db);
+  db_close (db);
+  if (rc != 0)
+    {
+      return 1;
+    }
+
+  printf ("=== pg_stress_bench (%s, warp=%d%%, %ds/round, %d warp / %d stock samples) ===\n",
+	  g_serialize ? "serialized" : "per-connection", g_warp_pct, seconds,
+	  g_n_warps, g_n_stock);
+  printf ("%8s %12s %10s %8s\n", "threads", "ops/sec", "speedup", "errors");
+
+  double base = 0.0;
+  for (int n = 1; n <= max_threads; n = (n < max_threads && n * 2 > max_threads) ? max_threads : n * 2)
+    {
+      double ops = run_round (n, seconds);
+      if (n == 1)
+	{
+	  base = ops;
+	}
+      printf ("%8d %12.1f %9.2fx %8" PRIdFAST64 "\n", n, ops,
+	      base > 0 ? ops / base : 0.0, atomic_load (&g_errors));
+      if (n == max_threads)
+	{
+	  break;
+	}
+    }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file pg_tx_lost_test.c
+ * @brief Checks that a transaction whose backend dies is not committed.
+ *
+ * Opens a transaction, has a second connection terminate its backend, then
+ * expects the next statement and the COMMIT to fail rather than run on a
+ * fresh session, and the connection to work again after the rollback.
+ * Writes nothing: the transaction only reads.
+ *
+ * Build: gcc -D_GNU_SOURCE -DDB_BACKEND_PG -I../src -I../src/db -I/usr/include/postgresql \
+ *          -o pg_tx_lost_test pg_tx_lost_test.c ../src/db/db_api.c ../src/db/db_stats.c \
+ *          ../src/db/sql_driver.c ../src/db/pg/db_pg.c ../src/db/mysql/db_mysql.c \
+ *          ../src/server_log.c -lpq -ljansson -lpthread
+ * Run:   ./pg_tx_lost_test -c "dbname=twclone"   (exit status 0 = pass)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "db/db_api.h"
+
+static const char *g_conninfo = "dbname=twclone";
+static int g_failed = 0;
+
+
+static void
+check (bool ok, const char *what)
+{
+  printf ("%-52s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok)
+    {
+      g_failed++;
+    }
+}
+
+
+static db_t *
+test_open (void)
+{
+  db_config_t cfg = { 0 };
+  db_error_t err = { 0 };
+
+  cfg.backend = DB_BACKEND_POSTGRES;
+  cfg.pg_conninfo = g_conninfo;
+  db_t *db = db_open (&cfg, &err);
+  if (!db)
+    {
+      fprintf (stderr, "db_open failed: %s\n", err.message);
+    }
+  return db;
+}
+
+
+static int64_t
+backend_pid (db_t *db)
+{
+  db_error_t err = { 0 };
+  db_res_t *res = NULL;
+  int64_t pid = -1;
+
+  if (db_query (db, "SELECT pg_backend_pid()", NULL, 0, &res, &err))
+    {
+      if (db_res_step (res, &err))
+	{
+	  pid = db_res_col_i64 (res, 0, &err);
+	}
+      db_res_finalize (res);
+    }
+  return pid;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int opt;
+
+  while ((opt = getopt (argc, argv, "c:")) != -1)
+    {
+      if (opt != 'c')
+	{
+	  fprintf (stderr, "usage: %s [-c conninfo]\n", argv[0]);
+	  return 2;
+	}
+      g_conninfo = optarg;
+    }
+
+  db_t *db = test_open ();
+  db_t *killer = test_open ();
+  if (!db || !killer)
+    {
+      return 1;
+    }
+  db_error_t err = { 0 };
+
+  check (db_tx_begin (db, DB_TX_DEFAULT, &err), "BEGIN");
+  int64_t pid = backend_pid (db);
+  check (pid > 0, "backend pid inside the transaction");
+
+  db_bind_t p[] = { db_bind_i64 (pid) };
+  check (db_exec (killer, "SELECT pg_terminate_backend($1)", p, 1, &err),
+	 "terminate the backend from a second connection");
+  usleep (200 * 1000);
+
+  check (!db_exec (db, "SELECT 1", NULL, 0, &err),
+	 "statement after the backend died fails");
+  check (!db_exec (db, "SELECT 1", NULL, 0, &err),
+	 "later statement in the same transaction fails");
+  check (!db_tx_commit (db, &err), "COMMIT fails");
+  printf ("  commit error: %s\n", err.message);
+
+  check (db_tx_depth (db) == 0, "transaction is over");
+  check (db_exec (db, "SELECT 1", NULL, 0, &err),
+	 "connection usable again afterwards");
+
+  db_close (killer);
+  db_close (db);
+  printf ("%s\n", g_failed ? "FAILED" : "PASSED");
+  return g_failed ? 1 : 0;
+}